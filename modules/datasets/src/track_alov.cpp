@@ -335,6 +335,7 @@ bool TRACK_alovImpl::initDataset(int id)
     if (id > 0 && id <= (int)data.size())
     {
         activeDatasetID = id;
+        frameCounter = 0;
         return true;
     }
     else
@@ -274,6 +274,10 @@ class CV_EXPORTS BinaryDescriptor : public Algorithm
     @param images input images
     @param keylines set of vectors that will store extracted lines for one or more images
     @param masks vector of mask matrices to detect only KeyLines of interest from each input image
+
+    Images are processed in parallel. Every worker thread owns a private workspace (EDLine detectors,
+    Gaussian pyramid and gradient images) that is kept alive between calls, so that processing
+    batches of images of the same size does not reallocate internal buffers.
      */
   void detect( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, const std::vector<Mat>& masks =
                    std::vector<Mat>() ) const;
@@ -293,6 +297,8 @@ class CV_EXPORTS BinaryDescriptor : public Algorithm
     @param keylines set of vectors containing lines for which descriptors must be computed
     @param descriptors
     @param returnFloatDescr flag (when set to true, original non-binary descriptors are returned)
+
+    As for multi-image detection, images are processed in parallel using per-thread workspaces.
      */
   void compute( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, std::vector<Mat>& descriptors, bool returnFloatDescr =
                     false ) const;
@@ -867,6 +873,22 @@ std::vector<cv::Mat> dxImg_vector, dyImg_vector;
 /* Gaussian pyramid */
 std::vector<cv::Mat> octaveImages;
 
+/* gray version of the last processed image, when the input is not already gray */
+cv::Mat grayImage_;
+
+/* blurred and downsampled images of each octave used by line detection */
+std::vector<cv::Mat> octaveBlur_, octaveResized_;
+
+/* lines of the last processed image, grouped across octaves */
+ScaleLines scaleLines_;
+
+/* per-thread workspaces used by multi-image detection and description; they are
+ kept between calls, so that their internal buffers are reused */
+std::vector<Ptr<BinaryDescriptor> > workspaces_;
+
+/* make sure that at least numWorkspaces workspaces, sharing current parameters, are available */
+void prepareWorkspaces( int numWorkspaces );
+
 };
 
 /**
@@ -75,3 +75,40 @@ PERF_TEST_P(file_str, descriptors, testing::Values(IMAGES))
   SANITY_CHECK_NOTHING();
 
 }
+
+typedef perf::TestBaseWithParam<int> batch_size;
+
+PERF_TEST_P(batch_size, descriptors_batch, testing::Values(4, 16, 64))
+{
+  std::string filename = getDataPath( "cv/line_descriptor/cameraman.jpg" );
+
+  Mat frame = imread( filename, 1 );
+
+  if( frame.empty() )
+    FAIL()<< "Unable to load source image " << filename;
+
+  int numImages = GetParam();
+  std::vector<Mat> images;
+  for ( int i = 0; i < numImages; i++ )
+  {
+    Mat shifted;
+    Mat affine = ( Mat_<double>( 2, 3 ) << 1, 0, i % 8, 0, 1, i / 8 );
+    warpAffine( frame, shifted, affine, frame.size() );
+    images.push_back( shifted );
+  }
+
+  std::vector<std::vector<KeyLine> > keylines;
+  std::vector<Mat> descriptors;
+  Ptr<BinaryDescriptor> bd = BinaryDescriptor::createBinaryDescriptor();
+
+  /* warm up per-thread workspaces */
+  bd->detect( images, keylines );
+
+  TEST_CYCLE()
+  {
+    bd->detect( images, keylines );
+    bd->compute( images, keylines, descriptors );
+  }
+
+  SANITY_CHECK_NOTHING();
+}
@@ -349,23 +349,21 @@ static inline int get2Pow( int i )
 /* compute Gaussian pyramids */
 void BinaryDescriptor::computeGaussianPyramid( const Mat& image, const int numOctaves )
 {
-  /* clear class fields */
+  /* clear class fields; pyramid images are kept, so that their buffers are reused */
   images_sizes.clear();
-  octaveImages.clear();
+  octaveImages.resize( numOctaves );
 
   /* insert input image into pyramid */
-  cv::Mat currentMat = image.clone();
-  cv::GaussianBlur( currentMat, currentMat, cv::Size( 5, 5 ), 1 );
-  octaveImages.push_back( currentMat );
-  images_sizes.push_back( currentMat.size() );
+  cv::GaussianBlur( image, octaveImages[0], cv::Size( 5, 5 ), 1 );
+  images_sizes.push_back( octaveImages[0].size() );
 
   /* fill Gaussian pyramid */
   for ( int pyrCounter = 1; pyrCounter < numOctaves; pyrCounter++ )
   {
     /* compute and store next image in pyramid and its size */
-    pyrDown( currentMat, currentMat, Size( currentMat.cols / params.reductionRatio, currentMat.rows / params.reductionRatio ) );
-    octaveImages.push_back( currentMat );
-    images_sizes.push_back( currentMat.size() );
+    const cv::Mat& previousMat = octaveImages[pyrCounter - 1];
+    pyrDown( previousMat, octaveImages[pyrCounter], Size( previousMat.cols / params.reductionRatio, previousMat.rows / params.reductionRatio ) );
+    images_sizes.push_back( octaveImages[pyrCounter].size() );
   }
 }
 
@@ -376,10 +374,7 @@ void BinaryDescriptor::computeSobel( const cv::Mat& image, const int numOctaves
   /* compute Gaussian pyramids */
   computeGaussianPyramid( image, numOctaves );
 
-  /* reinitialize class structures */
-  dxImg_vector.clear();
-  dyImg_vector.clear();
-
+  /* reinitialize class structures, keeping the derivatives buffers */
 //  dxImg_vector.resize( params.numOfOctave_ );
 //  dyImg_vector.resize( params.numOfOctave_ );
 
@@ -427,6 +422,92 @@ void BinaryDescriptor::detect( const Mat& image, CV_OUT std::vector<KeyLine>& ke
   detectImpl( image, keylines, mask );
 }
 
+/* parallel body for multi-image detection: worker w processes images w, w + numWorkers, ... */
+class BinaryDescriptorDetectInvoker : public ParallelLoopBody
+{
+ public:
+  BinaryDescriptorDetectInvoker( const std::vector<Ptr<BinaryDescriptor> >& workspaces, const std::vector<Mat>& images,
+                                 std::vector<std::vector<KeyLine> >& keylines, const std::vector<Mat>& masks ) :
+      workspaces_( workspaces ),
+      images_( images ),
+      keylines_( keylines ),
+      masks_( masks )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    int numWorkers = (int) workspaces_.size();
+    for ( int w = range.start; w < range.end; w++ )
+    {
+      for ( size_t i = w; i < images_.size(); i += numWorkers )
+      {
+        keylines_[i].clear();
+        if( masks_.empty() )
+          workspaces_[w]->detect( images_[i], keylines_[i] );
+        else
+          workspaces_[w]->detect( images_[i], keylines_[i], masks_[i] );
+      }
+    }
+  }
+
+ private:
+  const std::vector<Ptr<BinaryDescriptor> >& workspaces_;
+  const std::vector<Mat>& images_;
+  std::vector<std::vector<KeyLine> >& keylines_;
+  const std::vector<Mat>& masks_;
+};
+
+/* parallel body for multi-image descriptors computation */
+class BinaryDescriptorComputeInvoker : public ParallelLoopBody
+{
+ public:
+  BinaryDescriptorComputeInvoker( const std::vector<Ptr<BinaryDescriptor> >& workspaces, const std::vector<Mat>& images,
+                                  std::vector<std::vector<KeyLine> >& keylines, std::vector<Mat>& descriptors, bool returnFloatDescr ) :
+      workspaces_( workspaces ),
+      images_( images ),
+      keylines_( keylines ),
+      descriptors_( descriptors ),
+      returnFloatDescr_( returnFloatDescr )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    int numWorkers = (int) workspaces_.size();
+    for ( int w = range.start; w < range.end; w++ )
+    {
+      for ( size_t i = w; i < images_.size(); i += numWorkers )
+        workspaces_[w]->compute( images_[i], keylines_[i], descriptors_[i], returnFloatDescr_ );
+    }
+  }
+
+ private:
+  const std::vector<Ptr<BinaryDescriptor> >& workspaces_;
+  const std::vector<Mat>& images_;
+  std::vector<std::vector<KeyLine> >& keylines_;
+  std::vector<Mat>& descriptors_;
+  bool returnFloatDescr_;
+};
+
+/* create (or re-create, if parameters changed) per-thread workspaces */
+void BinaryDescriptor::prepareWorkspaces( int numWorkspaces )
+{
+  for ( size_t i = 0; i < workspaces_.size(); i++ )
+  {
+    const Params& wp = workspaces_[i]->params;
+    if( wp.numOfOctave_ != params.numOfOctave_ || wp.widthOfBand_ != params.widthOfBand_ || wp.reductionRatio != params.reductionRatio
+        || wp.ksize_ != params.ksize_ )
+    {
+      workspaces_.clear();
+      break;
+    }
+  }
+
+  while( (int) workspaces_.size() < numWorkspaces )
+    workspaces_.push_back( Ptr<BinaryDescriptor>( new BinaryDescriptor( params ) ) );
+}
+
 /* requires line detection (more than one image) */
 void BinaryDescriptor::detect( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, const std::vector<Mat>& masks ) const
 {
@@ -437,37 +518,48 @@ void BinaryDescriptor::detect( const std::vector<Mat>& images, std::vector<std::
     return;
   }
 
-  /* detect lines from each image */
-  for ( size_t counter = 0; counter < images.size(); counter++ )
+  if( !masks.empty() && masks.size() != images.size() )
+    CV_Error( Error::StsBadArg, "Mask error while detecting lines: number of masks must match number of images" );
+
+  /* check masks before starting any work */
+  for ( size_t counter = 0; counter < masks.size(); counter++ )
   {
     if( masks[counter].data != NULL && ( masks[counter].size() != images[counter].size() || masks[counter].type() != CV_8UC1 ) )
       CV_Error( Error::StsBadArg, "Mask error while detecting lines: please check its dimensions and that data type is CV_8UC1" );
-
-    else
-      detectImpl( images[counter], keylines[counter], masks[counter] );
   }
+
+  keylines.resize( images.size() );
+
+  /* detect lines from each image, using one workspace per worker */
+  int numWorkers = std::max( 1, std::min( getNumThreads(), (int) images.size() ) );
+  BinaryDescriptor *bn = const_cast<BinaryDescriptor*>( this );
+  bn->prepareWorkspaces( numWorkers );
+
+  std::vector<Ptr<BinaryDescriptor> > workers( workspaces_.begin(), workspaces_.begin() + numWorkers );
+  parallel_for_( Range( 0, numWorkers ), BinaryDescriptorDetectInvoker( workers, images, keylines, masks ), numWorkers );
 }
 
 void BinaryDescriptor::detectImpl( const Mat& imageSrc, std::vector<KeyLine>& keylines, const Mat& mask ) const
 {
+  /* create a pointer to self */
+  BinaryDescriptor *bn = const_cast<BinaryDescriptor*>( this );
 
+  /* convert input image to gray scale into the workspace; a gray image is used directly */
   cv::Mat image;
   if( imageSrc.channels() != 1 )
   {
-    cvtColor( imageSrc, image, COLOR_BGR2GRAY );
+    cvtColor( imageSrc, bn->grayImage_, COLOR_BGR2GRAY );
+    image = bn->grayImage_;
   }
   else
-    image = imageSrc.clone();
+    image = imageSrc;
 
   /*check whether image depth is different from 0 */
   if( image.depth() != 0 )
     CV_Error( Error::BadDepth, "Warning, depth image!= 0" );
 
-  /* create a pointer to self */
-  BinaryDescriptor *bn = const_cast<BinaryDescriptor*>( this );
-
   /* detect and arrange lines across octaves */
-  ScaleLines sl;
+  ScaleLines& sl = bn->scaleLines_;
   bn->OctaveKeyLines( image, sl );
 
   /* fill KeyLines vector */
@@ -538,20 +630,38 @@ void BinaryDescriptor::compute( const Mat& image, CV_OUT CV_IN_OUT std::vector<K
 void BinaryDescriptor::compute( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, std::vector<Mat>& descriptors,
                                 bool returnFloatDescr ) const
 {
-  for ( size_t i = 0; i < images.size(); i++ )
-    computeImpl( images[i], keylines[i], descriptors[i], returnFloatDescr, false );
+  if( images.empty() )
+    return;
+
+  if( keylines.size() != images.size() )
+    CV_Error( Error::StsBadArg, "Number of keyline vectors must match number of images" );
+
+  descriptors.resize( images.size() );
+
+  /* compute descriptors for each image, using one workspace per worker */
+  int numWorkers = std::max( 1, std::min( getNumThreads(), (int) images.size() ) );
+  BinaryDescriptor *bn = const_cast<BinaryDescriptor*>( this );
+  bn->prepareWorkspaces( numWorkers );
+
+  std::vector<Ptr<BinaryDescriptor> > workers( workspaces_.begin(), workspaces_.begin() + numWorkers );
+  parallel_for_( Range( 0, numWorkers ), BinaryDescriptorComputeInvoker( workers, images, keylines, descriptors, returnFloatDescr ), numWorkers );
 }
 
 /* implementation of descriptors computation */
 void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& keylines, Mat& descriptors, bool returnFloatDescr,
                                     bool useDetectionData ) const
 {
-  /* convert input image to gray scale */
+  BinaryDescriptor* bd = const_cast<BinaryDescriptor*>( this );
+
+  /* convert input image to gray scale into the workspace; a gray image is used directly */
   cv::Mat image;
   if( imageSrc.channels() != 1 )
-    cvtColor( imageSrc, image, COLOR_BGR2GRAY );
+  {
+    cvtColor( imageSrc, bd->grayImage_, COLOR_BGR2GRAY );
+    image = bd->grayImage_;
+  }
   else
-    image = imageSrc.clone();
+    image = imageSrc;
 
   /*check whether image's depth is different from 0 */
   if( image.depth() != 0 )
@@ -564,8 +674,6 @@ void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& k
     return;
   }
 
-  BinaryDescriptor* bd = const_cast<BinaryDescriptor*>( this );
-
   /* get maximum class_id and octave*/
   int numLines = 0;
   int octaveIndex = -1;
@@ -586,8 +694,10 @@ void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& k
 //  fictiousOSL.octaveCount = params.numOfOctave_ + 1;
 //  LinesVec lv( params.numOfOctave_, fictiousOSL );
   fictiousOSL.octaveCount = octaveIndex + 1;
-  LinesVec lv( octaveIndex + 1, fictiousOSL );
-  ScaleLines sl( numLines + 1, lv );
+  ScaleLines& sl = bd->scaleLines_;
+  sl.resize( numLines + 1 );
+  for ( size_t i = 0; i < sl.size(); i++ )
+    sl[i].assign( octaveIndex + 1, fictiousOSL );
 
   /* create a map to record association between KeyLines and their position
    in ScaleLines vector */
@@ -702,11 +812,14 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
   float curSigma2 = 1.0;  //[sqrt(2)]^0=1;
   double factor = sqrt( 2.0 );  //the down sample factor between connective two octave images
 
+  octaveBlur_.resize( params.numOfOctave_ );
+  octaveResized_.resize( params.numOfOctave_ );
+
   /* loop over number of octaves */
   for ( int octaveCount = 0; octaveCount < params.numOfOctave_; octaveCount++ )
   {
-    /* matrix storing results from blurring processes */
-    cv::Mat blur;
+    /* matrix storing results from blurring processes, kept in the workspace */
+    cv::Mat& blur = octaveBlur_[octaveCount];
 
     /* apply Gaussian blur */
     float increaseSigma = sqrt( curSigma2 - preSigma2 );
@@ -723,7 +836,8 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
     numOfFinalLine += edLineVec_[octaveCount]->lines_.numOfLines;
 
     /* resize image for next level of pyramid */
-    cv::resize( blur, image, cv::Size(), ( 1.f / factor ), ( 1.f / factor ) );
+    cv::resize( blur, octaveResized_[octaveCount], cv::Size(), ( 1.f / factor ), ( 1.f / factor ) );
+    image = octaveResized_[octaveCount];
 
     /* update sigma values */
     preSigma2 = curSigma2;
@@ -768,7 +882,7 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
   }
 
   /* create and fill an array to store scale factors */
-  float *scale = new float[params.numOfOctave_];
+  cv::AutoBuffer<float> scale( params.numOfOctave_ );
   scale[0] = 1;
   for ( int octaveCount = 1; octaveCount < params.numOfOctave_; octaveCount++ )
   {
@@ -945,7 +1059,8 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
 
   ////////////////////////////////////
   //Reorganize the detected lines into keyLines
-  keyLines.clear();
+  for ( size_t i = 0; i < keyLines.size(); i++ )
+    keyLines[i].clear();
   keyLines.resize( lineIDInScaleLineVec );
   unsigned int tempID;
   float s1, e1, s2, e2;
@@ -1024,7 +1139,6 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
     keyLines[tempID].push_back( singleLine );
   }
 
-  delete[] scale;
   return 1;
 }
 
@@ -1032,8 +1146,8 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
 {
   //the default length of the band is the line length.
   short numOfFinalLine = (short) keyLines.size();
-  float *dL = new float[2];  //line direction cos(dir), sin(dir)
-  float *dO = new float[2];  //the clockwise orthogonal vector of line direction.
+  float dL[2];  //line direction cos(dir), sin(dir)
+  float dO[2];  //the clockwise orthogonal vector of line direction.
   short heightOfLSP = (short) ( params.widthOfBand_ * NUM_OF_BANDS );  //the height of line support region;
   short descriptor_size = NUM_OF_BANDS * 8;  //each band, we compute the m( pgdL, ngdL,  pgdO, ngdO) and std( pgdL, ngdL,  pgdO, ngdO);
   float pgdLRowSum;  //the summation of {g_dL |g_dL>0 } for each row of the region;
@@ -1045,14 +1159,14 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
   float pgdO2RowSum;  //the summation of {g_dO^2 |g_dO>0 } for each row of the region;
   float ngdO2RowSum;  //the summation of {g_dO^2 |g_dO<0 } for each row of the region;
 
-  float *pgdLBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL |g_dL>0 } for each band of the region;
-  float *ngdLBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL |g_dL<0 } for each band of the region;
-  float *pgdL2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL>0 } for each band of the region;
-  float *ngdL2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL<0 } for each band of the region;
-  float *pgdOBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO |g_dO>0 } for each band of the region;
-  float *ngdOBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO |g_dO<0 } for each band of the region;
-  float *pgdO2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO>0 } for each band of the region;
-  float *ngdO2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO<0 } for each band of the region;
+  float pgdLBandSum[NUM_OF_BANDS];  //the summation of {g_dL |g_dL>0 } for each band of the region;
+  float ngdLBandSum[NUM_OF_BANDS];  //the summation of {g_dL |g_dL<0 } for each band of the region;
+  float pgdL2BandSum[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL>0 } for each band of the region;
+  float ngdL2BandSum[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL<0 } for each band of the region;
+  float pgdOBandSum[NUM_OF_BANDS];  //the summation of {g_dO |g_dO>0 } for each band of the region;
+  float ngdOBandSum[NUM_OF_BANDS];  //the summation of {g_dO |g_dO<0 } for each band of the region;
+  float pgdO2BandSum[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO>0 } for each band of the region;
+  float ngdO2BandSum[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO<0 } for each band of the region;
 
   short numOfBitsBand = NUM_OF_BANDS * sizeof(float);
   short lengthOfLSP;  //the length of line support region, varies with lines
@@ -1347,30 +1461,9 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
     }/* end for(short lineIDInSameLine = 0; lineIDInSameLine<sameLineSize;
      lineIDInSameLine++) */
 
-    cv::Mat appoggio = cv::Mat( 1, 32, CV_32FC1 );
-    float* pointerToRow = appoggio.ptr<float>( 0 );
-    for ( int g = 0; g < 32; g++ )
-    {
-      /* get LBD data */
-      float* des_Vec = &keyLines[lineIDInScaleVec][0].descriptor.front();
-      *pointerToRow = des_Vec[g];
-      pointerToRow++;
-
-    }
-
   }/* end for(short lineIDInScaleVec = 0;
    lineIDInScaleVec<numOfFinalLine; lineIDInScaleVec++) */
 
-  delete[] dL;
-  delete[] dO;
-  delete[] pgdLBandSum;
-  delete[] ngdLBandSum;
-  delete[] pgdL2BandSum;
-  delete[] ngdL2BandSum;
-  delete[] pgdOBandSum;
-  delete[] ngdOBandSum;
-  delete[] pgdO2BandSum;
-  delete[] ngdO2BandSum;
 
   return 1;
 
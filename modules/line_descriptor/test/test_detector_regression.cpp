@@ -337,3 +337,53 @@ TEST( BinaryDescriptor_Detector, regression )
   CV_BinaryDescriptorDetectorTest test( std::string( "edl_detector_keylines_cameraman" ) );
   test.safe_run();
 }
+
+TEST( BinaryDescriptor_Detector, batch_matches_single_image )
+{
+  std::string imgFilename = std::string( cvtest::TS::ptr()->get_data_path() ) + LINE_DESCRIPTOR_DIR + "/" + IMAGE_FILENAME;
+  Mat image = imread( imgFilename );
+  ASSERT_FALSE( image.empty() );
+
+  /* mix of image sizes, so that workspaces have to adapt their buffers */
+  std::vector<Mat> images;
+  Mat flipped, smaller;
+  flip( image, flipped, 1 );
+  resize( image, smaller, Size(), 0.5, 0.5 );
+  images.push_back( image );
+  images.push_back( flipped );
+  images.push_back( smaller );
+  images.push_back( image );
+  images.push_back( smaller );
+
+  Ptr<BinaryDescriptor> bd = BinaryDescriptor::createBinaryDescriptor();
+  std::vector<std::vector<KeyLine> > batchKeylines;
+  std::vector<Mat> batchDescriptors;
+
+  /* run twice to exercise reuse of workspaces */
+  for ( int run = 0; run < 2; run++ )
+  {
+    bd->detect( images, batchKeylines );
+    bd->compute( images, batchKeylines, batchDescriptors );
+  }
+
+  ASSERT_EQ( images.size(), batchKeylines.size() );
+  ASSERT_EQ( images.size(), batchDescriptors.size() );
+
+  for ( size_t i = 0; i < images.size(); i++ )
+  {
+    Ptr<BinaryDescriptor> single = BinaryDescriptor::createBinaryDescriptor();
+    std::vector<KeyLine> keylines;
+    Mat descriptors;
+    single->detect( images[i], keylines );
+    single->compute( images[i], keylines, descriptors );
+
+    ASSERT_EQ( keylines.size(), batchKeylines[i].size() );
+    for ( size_t k = 0; k < keylines.size(); k++ )
+    {
+      EXPECT_EQ( keylines[k].class_id, batchKeylines[i][k].class_id );
+      EXPECT_EQ( keylines[k].octave, batchKeylines[i][k].octave );
+      EXPECT_EQ( keylines[k].pt, batchKeylines[i][k].pt );
+    }
+    EXPECT_EQ( 0, cv::norm( descriptors, batchDescriptors[i], NORM_INF ) );
+  }
+}
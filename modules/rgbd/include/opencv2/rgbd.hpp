@@ -350,14 +350,130 @@ namespace rgbd
   void
   rescaleDepth(InputArray in, int depth, OutputArray out);
 
+  /** Depth front-end that registers a depth image to an external camera, cleans it with the NIL method of
+   * DepthCleaner and converts it to an organized set of 3d points, in one parallel pass over bands of rows
+   * of the external image. It gives the same result as chaining registerDepth, DepthCleaner and depthTo3d,
+   * except on the image borders, without the intermediate images of the chained calls.
+   * The outputs are only reallocated when their size changes, so they can be reused from frame to frame.
+   */
+  class CV_EXPORTS DepthPreprocessor: public Algorithm
+  {
+  public:
+    DepthPreprocessor()
+        :
+          depthDilation_(false),
+          clean_(true)
+    {
+    }
+
+    /** Constructor
+     * @param unregisteredCameraMatrix the camera matrix of the depth camera
+     * @param registeredCameraMatrix the camera matrix of the external camera
+     * @param registeredDistCoeffs the distortion coefficients of the external camera (can be empty)
+     * @param Rt the rigid body transform between the cameras. Transforms points from depth camera frame to
+     *        external camera frame.
+     * @param outputImagePlaneSize the image plane dimensions of the external camera (width, height)
+     * @param depthDilation whether or not the depth is dilated as in registerDepth
+     * @param clean whether or not the registered depth is cleaned
+     */
+    DepthPreprocessor(InputArray unregisteredCameraMatrix, InputArray registeredCameraMatrix,
+                      InputArray registeredDistCoeffs, InputArray Rt, const Size& outputImagePlaneSize,
+                      bool depthDilation = false, bool clean = true);
+
+    /** Registers, cleans and back-projects a depth image
+     * @param depth the depth image of the depth camera (CV_16UC1 in millimeters, or CV_32FC1/CV_64FC1 in meters)
+     * @param registeredDepth the cleaned depth in the external camera (CV_32FC1 in meters, NaN where there is no
+     *        depth)
+     * @param points3d the 3d points of registeredDepth in the external camera frame (CV_32FC3, NaN where there is
+     *        no depth)
+     */
+    void
+    operator()(InputArray depth, OutputArray registeredDepth, OutputArray points3d = noArray());
+
+    Mat getUnregisteredCameraMatrix() const
+    {
+        return unregisteredCameraMatrix_;
+    }
+    void setUnregisteredCameraMatrix(const Mat& val)
+    {
+        unregisteredCameraMatrix_ = val;
+    }
+    Mat getRegisteredCameraMatrix() const
+    {
+        return registeredCameraMatrix_;
+    }
+    void setRegisteredCameraMatrix(const Mat& val)
+    {
+        registeredCameraMatrix_ = val;
+    }
+    Mat getRegisteredDistCoeffs() const
+    {
+        return registeredDistCoeffs_;
+    }
+    void setRegisteredDistCoeffs(const Mat& val)
+    {
+        registeredDistCoeffs_ = val;
+    }
+    Mat getRt() const
+    {
+        return Rt_;
+    }
+    void setRt(const Mat& val)
+    {
+        Rt_ = val;
+    }
+    Size getOutputImagePlaneSize() const
+    {
+        return outputImagePlaneSize_;
+    }
+    void setOutputImagePlaneSize(const Size& val)
+    {
+        outputImagePlaneSize_ = val;
+    }
+    bool getDepthDilation() const
+    {
+        return depthDilation_;
+    }
+    void setDepthDilation(bool val)
+    {
+        depthDilation_ = val;
+    }
+    bool getClean() const
+    {
+        return clean_;
+    }
+    void setClean(bool val)
+    {
+        clean_ = val;
+    }
+
+  protected:
+    Mat unregisteredCameraMatrix_;
+    Mat registeredCameraMatrix_;
+    Mat registeredDistCoeffs_;
+    Mat Rt_;
+    Size outputImagePlaneSize_;
+    bool depthDilation_;
+    bool clean_;
+
+    // projections of the depth pixels and their row bounds, kept from frame to frame
+    Mat projected_;
+    Mat projectedDepth_;
+    Mat projectedRows_;
+  };
+
   /** Object that can compute planes in an image
    */
   class CV_EXPORTS RgbdPlane: public Algorithm
   {
   public:
+    /** RGBD_PLANE_METHOD_DEFAULT grows the planes tile by tile from the most planar tiles.
+     * RGBD_PLANE_METHOD_BLOCK_MERGE fits a plane to every tile in parallel, merges neighboring tiles
+     * that fit a common plane with a union-find, and then labels the pixels in parallel.
+     */
     enum RGBD_PLANE_METHOD
     {
-      RGBD_PLANE_METHOD_DEFAULT
+      RGBD_PLANE_METHOD_DEFAULT, RGBD_PLANE_METHOD_BLOCK_MERGE
     };
 
     RgbdPlane(RGBD_PLANE_METHOD method = RGBD_PLANE_METHOD_DEFAULT)
@@ -368,7 +484,8 @@ namespace rgbd
           threshold_(0.01),
           sensor_error_a_(0),
           sensor_error_b_(0),
-          sensor_error_c_(0)
+          sensor_error_c_(0),
+          temporal_(false)
     {
     }
 
@@ -449,6 +566,19 @@ namespace rgbd
     {
         sensor_error_c_ = val;
     }
+    /** With RGBD_PLANE_METHOD_BLOCK_MERGE, seed the segmentation with the planes found by the previous
+     * call: tiles lying on one of them are merged first, and the planes found again come first in the
+     * output, in their previous order. Changing the value forgets the previous planes.
+     */
+    bool getTemporal() const
+    {
+        return temporal_;
+    }
+    void setTemporal(bool val)
+    {
+        temporal_ = val;
+        previous_planes_.release();
+    }
 
   private:
     /** The method to use to compute the planes */
@@ -461,6 +591,10 @@ namespace rgbd
     double threshold_;
     /** coefficient of the sensor error with respect to the. All 0 by default but you want a=0.0075 for a Kinect */
     double sensor_error_a_, sensor_error_b_, sensor_error_c_;
+    /** Whether to seed the segmentation with the planes of the previous call */
+    bool temporal_;
+    /** The plane coefficients found by the previous call, as CV_32FC4 */
+    Mat previous_planes_;
   };
 
   /** Object that contains a frame data.
@@ -1031,6 +1165,86 @@ namespace rgbd
   warpFrame(const Mat& image, const Mat& depth, const Mat& mask, const Mat& Rt, const Mat& cameraMatrix,
             const Mat& distCoeff, OutputArray warpedImage, OutputArray warpedDepth = noArray(), OutputArray warpedMask = noArray());
 
+  /** Volume storing a truncated signed distance function (TSDF) of the scene, that depth frames are fused into
+   * as in "KinectFusion: Real-Time Dense Surface Mapping and Tracking", R. A. Newcombe et al., ISMAR 2011.
+   * Raycasting the volume from the current pose gives the model depth and normals that can be used as the
+   * reference frame of the ICP odometry for the next frame.
+   */
+  class CV_EXPORTS TSDFVolume: public Algorithm
+  {
+  public:
+    enum TSDF_VOLUME_TYPE
+    {
+      /** Box of voxels, allocated at once */
+      TSDF_VOLUME_DENSE = 0,
+      /** Blocks of 8x8x8 voxels allocated around the observed surfaces, for scenes of any size */
+      TSDF_VOLUME_HASHED = 1
+    };
+
+    static inline float
+    DEFAULT_TRUNCATION_DISTANCE_VOXELS()
+    {
+      return 5.f; // in voxels
+    }
+    static inline int
+    DEFAULT_MAX_WEIGHT()
+    {
+      return 64;
+    }
+
+    /** Creates an empty volume
+     * @param volumeType TSDF_VOLUME_DENSE or TSDF_VOLUME_HASHED
+     * @param voxelSize Size of a voxel (in meters)
+     * @param resolution Number of voxels along each axis of a dense volume (ignored by the hashed volume)
+     * @param origin Position of the corner of a dense volume in world coordinates (ignored by the hashed volume)
+     */
+    static Ptr<TSDFVolume>
+    create(int volumeType, float voxelSize, const Vec3i& resolution = Vec3i(256, 256, 256),
+           const Point3f& origin = Point3f(0, 0, 0));
+
+    /** Removes all the integrated data */
+    virtual void
+    reset() = 0;
+
+    /** Fuses a depth frame into the volume
+     * @param depth The depth (CV_32FC1 in meters or CV_16UC1 in millimeters, invalid values are NaN or 0)
+     * @param cameraMatrix Camera matrix of the depth
+     * @param cameraPose Transformation from the camera frame to the world frame (4x4 matrix of CV_32FC1 or CV_64FC1
+     * type), e.g. the accumulated Rt of the odometry
+     * @param mask Mask of the pixels to fuse (CV_8UC1, optional)
+     */
+    virtual void
+    integrate(const Mat& depth, const Mat& cameraMatrix, const Mat& cameraPose, const Mat& mask = Mat()) = 0;
+
+    /** Fuses the depth and the mask of a frame, e.g. an OdometryFrame
+     */
+    void
+    integrate(const Ptr<RgbdFrame>& frame, const Mat& cameraMatrix, const Mat& cameraPose);
+
+    /** Renders the surface stored in the volume as seen by a camera
+     * @param cameraPose Transformation from the camera frame to the world frame
+     * @param cameraMatrix Camera matrix
+     * @param size Size of the rendered images
+     * @param depth The rendered depth (CV_32FC1, in meters, NaN where no surface is seen)
+     * @param normals The rendered normals in the camera frame (CV_32FC3, pointing towards the camera, NaN where
+     * no surface is seen)
+     */
+    virtual void
+    raycast(const Mat& cameraPose, const Mat& cameraMatrix, const Size& size, OutputArray depth,
+            OutputArray normals = noArray()) const = 0;
+
+    /** Size of a voxel (in meters) */
+    virtual float getVoxelSize() const = 0;
+    /** @see setTruncationDistance */
+    virtual float getTruncationDistance() const = 0;
+    /** Distance to the surface (in meters) over which the signed distance is truncated */
+    virtual void setTruncationDistance(float val) = 0;
+    /** @see setMaxWeight */
+    virtual int getMaxWeight() const = 0;
+    /** Maximum number of observations averaged in a voxel, a lower value adapts faster to changes in the scene */
+    virtual void setMaxWeight(int val) = 0;
+  };
+
 // TODO Depth interpolation
 // Curvature
 // Get rescaleDepth return dubles if asked for
@@ -45,6 +45,7 @@
 #define __OPENCV_OBJDETECT_LINEMOD_HPP__
 
 #include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
 #include <map>
 
 /****************************************************************************************\
@@ -314,6 +315,9 @@ Match::Match(int _x, int _y, float _similarity, const String& _class_id, int _te
     : x(_x), y(_y), similarity(_similarity), class_id(_class_id), template_id(_template_id)
 {}
 
+/// Packed template storage used by Detector for matching, defined in the implementation.
+class TemplateBank;
+
 /**
  * \brief Object detector using the LINE template matching algorithm with any set of
  * modalities.
@@ -401,7 +405,7 @@ public:
 
   CV_WRAP int numTemplates() const;
   CV_WRAP int numTemplates(const String& class_id) const;
-  CV_WRAP int numClasses() const { return static_cast<int>(class_templates.size()); }
+  CV_WRAP int numClasses() const;
 
   CV_WRAP std::vector<String> classIds() const;
 
@@ -415,6 +419,21 @@ public:
                    const String& format = "templates_%s.yml.gz");
   CV_WRAP void writeClasses(const String& format = "templates_%s.yml.gz") const;
 
+  /**
+   * \brief Save the templates of all classes to a binary file.
+   *
+   * Features are stored as packed x/y/label arrays, contiguous per pyramid level, in a
+   * layout that loadTemplates() maps into memory without parsing.
+   */
+  CV_WRAP void saveTemplates(const String& filename) const;
+
+  /**
+   * \brief Replace all templates by those of a file written by saveTemplates().
+   *
+   * The modalities and number of pyramid levels of the file must match the detector.
+   */
+  CV_WRAP void loadTemplates(const String& filename);
+
 protected:
   std::vector< Ptr<Modality> > modalities;
   int pyramid_levels;
@@ -422,12 +441,25 @@ protected:
 
   typedef std::vector<Template> TemplatePyramid;
   typedef std::map<String, std::vector<TemplatePyramid> > TemplatesMap;
-  TemplatesMap class_templates;
+  mutable TemplatesMap class_templates;
 
   typedef std::vector<Mat> LinearMemories;
   // Indexed as [pyramid level][modality][quantized label]
   typedef std::vector< std::vector<LinearMemories> > LinearMemoryPyramid;
 
+  /// Packed copy of class_templates used for matching, built on first use and released
+  /// when templates are added
+  mutable Ptr<TemplateBank> template_bank;
+  /// True after loadTemplates(), until class_templates is unpacked from template_bank
+  mutable bool templates_packed_only;
+  /// Guards the lazy packing and unpacking of the templates
+  mutable Mutex templates_mutex;
+
+  /// Packed templates, built from class_templates if needed
+  Ptr<TemplateBank> templateBank() const;
+  /// Makes class_templates hold the templates of a loaded template file
+  void unpackTemplates() const;
+
   void matchClass(const LinearMemoryPyramid& lm_pyramid,
                   const std::vector<Size>& sizes,
                   float threshold, std::vector<Match>& matches,
@@ -0,0 +1,60 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+
+typedef std::tr1::tuple<string, int> DepthPreprocessorParams;
+typedef TestBaseWithParam<DepthPreprocessorParams> DepthPreprocessorPerf;
+
+PERF_TEST_P(DepthPreprocessorPerf, registerCleanProject,
+            testing::Combine(
+              testing::Values("chained", "fused"),
+              testing::Values(1, 4) // threads
+            ))
+{
+  const string method = std::tr1::get<0>(GetParam());
+  const int numThreads = std::tr1::get<1>(GetParam());
+
+  // the TUM depth of the test data is in 1/5000 m, the Kinect one is in millimeters
+  Mat depth16 = imread(getDataPath("cv/rgbd/depth.png"), IMREAD_UNCHANGED);
+  ASSERT_FALSE(depth16.empty());
+  Mat depth;
+  depth16.convertTo(depth, CV_16U, 0.2);
+
+  // K from a VGA Kinect, and the baseline between its cameras
+  Mat K = (Mat_<float>(3, 3) << 525.f, 0.f, 319.5f, 0.f, 525.f, 239.5f, 0.f, 0.f, 1.f);
+  Matx44f Rt = Matx44f::eye();
+  Rt(0, 3) = 0.025f;
+  const Size size = depth.size();
+
+  DepthPreprocessor preprocessor(K, K, Mat(), Rt, size);
+  DepthCleaner cleaner(CV_16U, 3, DepthCleaner::DEPTH_CLEANER_NIL);
+  Mat registered, cleaned, points3d;
+
+  const int savedThreads = getNumThreads();
+  setNumThreads(numThreads);
+
+  if (method == "chained")
+  {
+    TEST_CYCLE()
+    {
+      registerDepth(K, K, Mat(), Rt, depth, size, registered);
+      cleaner(registered, cleaned);
+      depthTo3d(cleaned, K, points3d);
+    }
+  }
+  else
+  {
+    TEST_CYCLE() preprocessor(depth, cleaned, points3d);
+  }
+
+  setNumThreads(savedThreads);
+
+  SANITY_CHECK_NOTHING();
+}
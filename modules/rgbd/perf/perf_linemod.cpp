@@ -0,0 +1,68 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+
+namespace
+{
+
+const int numClasses = 4;
+
+// Random template pyramid of a 64x64 object with the maximal number of features
+vector<linemod::Template> makeTemplatePyramid(const Ptr<linemod::Detector>& detector, RNG& rng)
+{
+  vector<linemod::Template> tp(detector->pyramidLevels());
+  for (int l = 0; l < (int)tp.size(); l++)
+  {
+    int size = 64 >> l;
+    tp[l].width = size;
+    tp[l].height = size;
+    tp[l].pyramid_level = l;
+    for (int i = 0; i < 63; i++)
+      tp[l].features.push_back(linemod::Feature(rng.uniform(0, size), rng.uniform(0, size), rng.uniform(0, 8)));
+  }
+  return tp;
+}
+
+}
+
+typedef std::tr1::tuple<int, int> LinemodParams;
+typedef TestBaseWithParam<LinemodParams> LinemodPerf;
+
+PERF_TEST_P(LinemodPerf, match,
+            testing::Combine(
+              testing::Values(100, 500, 2000), // templates
+              testing::Values(1, 4) // threads
+            ))
+{
+  const int numTemplates = std::tr1::get<0>(GetParam());
+  const int numThreads = std::tr1::get<1>(GetParam());
+
+  Mat image = imread(getDataPath("cv/rgbd/rgb.png"), IMREAD_COLOR);
+  ASSERT_FALSE(image.empty());
+
+  Ptr<linemod::Detector> detector = linemod::getDefaultLINE();
+  RNG rng(0x1234);
+  for (int i = 0; i < numTemplates; i++)
+  {
+    String class_id = format("class%d", i % numClasses);
+    ASSERT_GE(detector->addSyntheticTemplate(makeTemplatePyramid(detector, rng), class_id), 0);
+  }
+
+  vector<Mat> sources(1, image);
+  vector<linemod::Match> matches;
+
+  const int savedThreads = getNumThreads();
+  setNumThreads(numThreads);
+
+  TEST_CYCLE() detector->match(sources, 80.f, matches);
+
+  setNumThreads(savedThreads);
+
+  SANITY_CHECK_NOTHING();
+}
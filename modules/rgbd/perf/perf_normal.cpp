@@ -0,0 +1,86 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+
+namespace
+{
+
+Matx33f makeK(const Size& size)
+{
+  const float f = 525.f * size.width / 640.f;
+  return Matx33f(f, 0, size.width / 2.f - 0.5f,
+                 0, f, size.height / 2.f - 0.5f,
+                 0, 0, 1);
+}
+
+// A slanted plane with a sphere in front of it and a few holes, as 3d points
+Mat makePoints(const Size& size, const Matx33f& K)
+{
+  Mat depth(size, CV_32F);
+  const Point2f center(size.width * 0.5f, size.height * 0.5f);
+  const float radius = size.height * 0.25f;
+  for (int y = 0; y < size.height; y++)
+  {
+    float* row = depth.ptr<float>(y);
+    for (int x = 0; x < size.width; x++)
+    {
+      float d = 2.f + 0.5f * x / size.width + 0.25f * y / size.height;
+      const float dx = x - center.x, dy = y - center.y;
+      const float rr = (dx * dx + dy * dy) / (radius * radius);
+      if (rr < 1.f)
+        d -= 0.5f * std::sqrt(1.f - rr);
+      if ((x / 16 + y / 16) % 23 == 0)
+        d = std::numeric_limits<float>::quiet_NaN();
+      row[x] = d;
+    }
+  }
+
+  Mat points3d;
+  depthTo3d(depth, K, points3d);
+  return points3d;
+}
+
+}
+
+CV_ENUM(NormalsMethod, RgbdNormals::RGBD_NORMALS_METHOD_FALS, RgbdNormals::RGBD_NORMALS_METHOD_LINEMOD,
+        RgbdNormals::RGBD_NORMALS_METHOD_SRI);
+
+typedef std::tr1::tuple<NormalsMethod, Size, MatDepth> NormalsParams;
+typedef TestBaseWithParam<NormalsParams> RgbdNormalsPerf;
+
+PERF_TEST_P(RgbdNormalsPerf, compute,
+            testing::Combine(
+              NormalsMethod::all(),
+              testing::Values(szVGA, sz720p),
+              testing::Values(CV_32F, CV_64F)
+            ))
+{
+  const int method = std::tr1::get<0>(GetParam());
+  const Size size = std::tr1::get<1>(GetParam());
+  const int depth = std::tr1::get<2>(GetParam());
+
+  const Matx33f K = makeK(size);
+  Mat points3d = makePoints(size, K);
+  if (depth != CV_32F)
+    points3d.convertTo(points3d, depth);
+
+  RgbdNormals normals_computer(size.height, size.width, depth, K, 5, method);
+  normals_computer.initialize();
+
+  Mat normals;
+  declare.in(points3d).out(normals);
+
+  TEST_CYCLE()
+  {
+    normals_computer(points3d, normals);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
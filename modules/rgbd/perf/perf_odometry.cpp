@@ -0,0 +1,88 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+
+namespace
+{
+
+const int sequenceLength = 10;
+
+Mat getCameraMatrix()
+{
+  return (Mat_<float>(3, 3) << 525.f, 0.f, 319.5f,
+                               0.f, 525.f, 239.5f,
+                               0.f, 0.f, 1.f);
+}
+
+// Stand-in for a recorded TUM sequence: the recorded frame of the test data seen by
+// a camera moving along a smooth trajectory
+void makeSequence(const Mat& K, vector<Mat>& images, vector<Mat>& depths)
+{
+  Mat image = imread(getDataPath("cv/rgbd/rgb.png"), IMREAD_GRAYSCALE);
+  Mat depth16 = imread(getDataPath("cv/rgbd/depth.png"), IMREAD_UNCHANGED);
+  ASSERT_FALSE(image.empty());
+  ASSERT_FALSE(depth16.empty());
+
+  Mat depth;
+  depth16.convertTo(depth, CV_32FC1, 1.f/5000.f);
+  depth.setTo(std::numeric_limits<float>::quiet_NaN(), depth < FLT_EPSILON);
+
+  images.resize(sequenceLength);
+  depths.resize(sequenceLength);
+  for (int i = 0; i < sequenceLength; i++)
+  {
+    // 0.5 degree and 5 mm between consecutive frames
+    Mat rvec = (Mat_<double>(3, 1) << 0.0, i * 0.5 * CV_PI / 180., i * 0.2 * CV_PI / 180.);
+    Mat R, Rt = Mat::eye(4, 4, CV_64FC1), dst = Rt(Rect(0, 0, 3, 3));
+    Rodrigues(rvec, R);
+    R.copyTo(dst);
+    Rt.at<double>(0, 3) = i * 0.005;
+    Rt.at<double>(2, 3) = i * 0.002;
+
+    warpFrame(image, depth, Mat(), Rt, K, Mat(), images[i], depths[i]);
+  }
+}
+
+}
+
+typedef std::tr1::tuple<string, int> OdometryParams;
+typedef TestBaseWithParam<OdometryParams> OdometryPerf;
+
+PERF_TEST_P(OdometryPerf, sequence,
+            testing::Combine(
+              testing::Values("RgbdOdometry", "ICPOdometry", "RgbdICPOdometry"),
+              testing::Values(1, 4) // threads
+            ))
+{
+  const string odometryType = std::tr1::get<0>(GetParam());
+  const int numThreads = std::tr1::get<1>(GetParam());
+
+  Mat K = getCameraMatrix();
+  vector<Mat> images, depths;
+  makeSequence(K, images, depths);
+
+  Ptr<Odometry> odometry = Odometry::create(odometryType);
+  ASSERT_FALSE(odometry.empty());
+  odometry->setCameraMatrix(K);
+
+  const int savedThreads = getNumThreads();
+  setNumThreads(numThreads);
+
+  Mat Rt;
+  TEST_CYCLE()
+  {
+    for (int i = 1; i < sequenceLength; i++)
+      odometry->compute(images[i - 1], depths[i - 1], Mat(), images[i], depths[i], Mat(), Rt);
+  }
+
+  setNumThreads(savedThreads);
+
+  SANITY_CHECK_NOTHING();
+}
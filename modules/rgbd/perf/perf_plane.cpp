@@ -0,0 +1,96 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+
+namespace
+{
+
+Matx33f makeK(const Size& size)
+{
+  const float f = 525.f * size.width / 640.f;
+  return Matx33f(f, 0, size.width / 2.f - 0.5f,
+                 0, f, size.height / 2.f - 0.5f,
+                 0, 0, 1);
+}
+
+// A room corner: a floor, two walls and a box standing on the floor, as 3d points
+Mat makeRoom(const Size& size, const Matx33f& K)
+{
+  // planes n.p + d = 0, each one limited to a box for the obstacle
+  const Vec4f planes[] =
+  {
+    Vec4f(0.f, -1.f, 0.f, 1.2f),        // floor, 1.2 m below the camera
+    Vec4f(0.6f, 0.f, -0.8f, 3.f),       // left wall
+    Vec4f(-0.6f, 0.f, -0.8f, 3.f),      // right wall
+    Vec4f(0.f, 0.f, -1.f, 2.f)          // front face of the box
+  };
+  const Matx33f Kinv = K.inv();
+
+  Mat depth(size, CV_32F);
+  for (int y = 0; y < size.height; y++)
+  {
+    float* row = depth.ptr<float>(y);
+    for (int x = 0; x < size.width; x++)
+    {
+      const Vec3f ray = Kinv * Vec3f((float)x, (float)y, 1.f);
+      float z = std::numeric_limits<float>::quiet_NaN();
+      for (int i = 0; i < 4; i++)
+      {
+        const Vec3f n(planes[i][0], planes[i][1], planes[i][2]);
+        const float t = -planes[i][3] / n.dot(ray);
+        if (t <= 0.f || (!cvIsNaN(z) && t >= z))
+          continue;
+        // the box is 0.8 m wide and 0.6 m high
+        const Vec3f p = ray * t;
+        if (i == 3 && (std::abs(p[0]) > 0.4f || p[1] < 0.6f))
+          continue;
+        z = t;
+      }
+      row[x] = z;
+    }
+  }
+
+  Mat points3d;
+  depthTo3d(depth, K, points3d);
+  return points3d;
+}
+
+}
+
+typedef std::tr1::tuple<string, Size> PlaneParams;
+typedef TestBaseWithParam<PlaneParams> RgbdPlanePerf;
+
+PERF_TEST_P(RgbdPlanePerf, compute,
+            testing::Combine(
+              testing::Values("default", "block_merge", "block_merge_temporal"),
+              testing::Values(szVGA, sz720p)
+            ))
+{
+  const string method = std::tr1::get<0>(GetParam());
+  const Size size = std::tr1::get<1>(GetParam());
+
+  const Matx33f K = makeK(size);
+  Mat points3d = makeRoom(size, K);
+
+  RgbdPlane plane_computer(method == "default" ? RgbdPlane::RGBD_PLANE_METHOD_DEFAULT
+                                               : RgbdPlane::RGBD_PLANE_METHOD_BLOCK_MERGE);
+  plane_computer.setTemporal(method == "block_merge_temporal");
+
+  Mat mask;
+  vector<Vec4f> plane_coefficients;
+  // the first frame seeds the temporal mode
+  plane_computer(points3d, mask, plane_coefficients);
+
+  declare.in(points3d).out(mask);
+
+  TEST_CYCLE() plane_computer(points3d, mask, plane_coefficients);
+
+  SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,88 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+
+namespace
+{
+
+const float volumeSide = 2.56f; // in meters
+
+Mat getCameraMatrix()
+{
+  return (Mat_<float>(3, 3) << 525.f, 0.f, 319.5f,
+                               0.f, 525.f, 239.5f,
+                               0.f, 0.f, 1.f);
+}
+
+// Depth of a sphere in front of a slanted wall, seen from the origin
+Mat makeDepth(const Size& size, const Mat& K)
+{
+  const float fx = K.at<float>(0, 0), fy = K.at<float>(1, 1), cx = K.at<float>(0, 2), cy = K.at<float>(1, 2);
+  const Point3f sphereCenter(0.2f, 0.f, 1.6f);
+  const float sphereRadius = 0.4f;
+
+  Mat depth(size, CV_32FC1);
+  for (int y = 0; y < size.height; y++)
+  {
+    float* row = depth.ptr<float>(y);
+    for (int x = 0; x < size.width; x++)
+    {
+      Point3f dir((x - cx) / fx, (y - cy) / fy, 1.f);
+
+      // wall: z = 2.2 + 0.3 x
+      float d = 2.2f / (1.f - 0.3f * dir.x);
+
+      // sphere: |t dir - c|^2 = r^2
+      float a = dir.dot(dir), b = -2.f * dir.dot(sphereCenter);
+      float c = sphereCenter.dot(sphereCenter) - sphereRadius * sphereRadius;
+      float delta = b * b - 4 * a * c;
+      if (delta >= 0)
+        d = std::min(d, (-b - std::sqrt(delta)) / (2 * a));
+      row[x] = d;
+    }
+  }
+  return depth;
+}
+
+}
+
+CV_ENUM(TSDFVolumeType, TSDFVolume::TSDF_VOLUME_DENSE, TSDFVolume::TSDF_VOLUME_HASHED);
+
+typedef std::tr1::tuple<TSDFVolumeType, int> TSDFParams;
+typedef TestBaseWithParam<TSDFParams> TSDFPerf;
+
+// One frame of fusion: integration of the depth and raycast of the model for the next odometry step
+PERF_TEST_P(TSDFPerf, frame,
+            testing::Combine(
+              TSDFVolumeType::all(),
+              testing::Values(128, 256, 384) // voxels along each side of the scene
+            ))
+{
+  const int volumeType = std::tr1::get<0>(GetParam());
+  const int resolution = std::tr1::get<1>(GetParam());
+
+  Mat K = getCameraMatrix();
+  Mat depth = makeDepth(szVGA, K);
+  Mat pose = Mat::eye(4, 4, CV_64FC1);
+
+  Ptr<TSDFVolume> volume = TSDFVolume::create(volumeType, volumeSide / resolution,
+                                              Vec3i(resolution, resolution, resolution),
+                                              Point3f(-volumeSide / 2, -volumeSide / 2, 0.5f));
+  volume->integrate(depth, K, pose);
+
+  Mat modelDepth, modelNormals;
+  TEST_CYCLE()
+  {
+    volume->integrate(depth, K, pose);
+    volume->raycast(pose, K, szVGA, modelDepth, modelNormals);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
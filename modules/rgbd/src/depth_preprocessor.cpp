@@ -0,0 +1,370 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+
+#include <cfloat>
+#include <climits>
+
+namespace cv
+{
+namespace rgbd
+{
+
+  // Parameters of the NIL cleaning, as in DepthCleaner
+  static const float NIL_SIGMA_L = (float)(0.8 + 0.035 * (30. * CV_PI / 180) / (CV_PI / 2 - 30. * CV_PI / 180));
+  // depths further apart than that (in meters) are not averaged, 10 units of a depth in millimeters
+  static const float NIL_DIFFERENCE_THRESHOLD = 0.01f;
+
+  static inline float
+  nilSigmaZ(float z)
+  {
+    return 0.0012f + 0.0019f * (z - 0.4f) * (z - 0.4f);
+  }
+
+  template<typename T>
+  static void
+  depthRowToMeters(const T* depth, int cols, float scale, float* z)
+  {
+    for (int x = 0; x < cols; ++x)
+    {
+      z[x] = float(depth[x]) * scale;
+      // 0 is the no depth value of CV_16U, CV_32F and CV_64F use NaN
+      if (!(z[x] > 0))
+        z[x] = std::numeric_limits<float>::quiet_NaN();
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////////
+
+  /** Projects the pixels of the depth image in the external camera
+   * Each pixel gets the offset of the pixel it falls on in the external image (-1 if none) and its depth in the
+   * external camera frame. Each row also gets the first and last row of the external image its pixels fall on.
+   */
+  class DepthProjectInvoker : public ParallelLoopBody
+  {
+  public:
+    DepthProjectInvoker(const Mat& depth, float scale, const Matx44f& projection, const Matx33f& registeredK,
+                        const Mat_<float>& distCoeffs, const Size& size, Mat& projected, Mat& projectedDepth,
+                        Mat& projectedRows)
+        :
+          depth_(depth),
+          scale_(scale),
+          projection_(projection),
+          registeredK_(registeredK),
+          distCoeffs_(distCoeffs),
+          hasDistortion_(!distCoeffs.empty() && countNonZero(distCoeffs) > 0),
+          size_(size),
+          projected_(projected),
+          projectedDepth_(projectedDepth),
+          projectedRows_(projectedRows)
+    {
+    }
+
+    virtual void operator()(const Range& range) const
+    {
+      const int cols = depth_.cols;
+      const Rect bounds(Point(), size_);
+      AutoBuffer<float> _z(cols);
+      float* z = _z;
+      std::vector<Point3f> transformed(cols);
+      std::vector<Point2f> projected(cols);
+
+      for (int y = range.start; y < range.end; ++y)
+      {
+        switch (depth_.depth())
+        {
+          case CV_16U:
+            depthRowToMeters(depth_.ptr<ushort>(y), cols, scale_, z);
+            break;
+          case CV_32F:
+            depthRowToMeters(depth_.ptr<float>(y), cols, scale_, z);
+            break;
+          default:
+            depthRowToMeters(depth_.ptr<double>(y), cols, scale_, z);
+            break;
+        }
+
+        // Transform the pixels (x*z, y*z, z) like perspectiveTransform does in registerDepth
+        for (int x = 0; x < cols; ++x)
+        {
+          const Matx44f& P = projection_;
+          const float px = x * z[x], py = y * z[x], pz = z[x];
+          float w = P(3, 0) * px + P(3, 1) * py + P(3, 2) * pz + P(3, 3);
+          w = std::abs(w) > FLT_EPSILON ? 1.f / w : 0.f;
+          transformed[x] = Point3f((P(0, 0) * px + P(0, 1) * py + P(0, 2) * pz + P(0, 3)) * w,
+                                   (P(1, 0) * px + P(1, 1) * py + P(1, 2) * pz + P(1, 3)) * w,
+                                   (P(2, 0) * px + P(2, 1) * py + P(2, 2) * pz + P(2, 3)) * w);
+        }
+
+        if (hasDistortion_)
+          projectPoints(transformed, Vec3f(0, 0, 0), Vec3f(0, 0, 0), registeredK_, distCoeffs_, projected);
+        else
+          for (int x = 0; x < cols; ++x)
+            projected[x] = Point2f(transformed[x].x / transformed[x].z, transformed[x].y / transformed[x].z);
+
+        int* offset = projected_.ptr<int>(y);
+        float* projectedDepth = projectedDepth_.ptr<float>(y);
+        int min_row = INT_MAX, max_row = INT_MIN;
+        for (int x = 0; x < cols; ++x)
+        {
+          offset[x] = -1;
+          const float depth = transformed[x].z;
+          if (!(depth > 0) || cvIsNaN(projected[x].x) || cvIsNaN(projected[x].y))
+            continue;
+          const Point2i location = projected[x];
+          if (!bounds.contains(location))
+            continue;
+          offset[x] = location.y * size_.width + location.x;
+          projectedDepth[x] = depth;
+          min_row = std::min(min_row, location.y);
+          max_row = std::max(max_row, location.y);
+        }
+        projectedRows_.at<Vec2i>(y) = Vec2i(min_row, max_row);
+      }
+    }
+
+  private:
+    const Mat& depth_;
+    float scale_;
+    Matx44f projection_;
+    Matx33f registeredK_;
+    const Mat_<float>& distCoeffs_;
+    bool hasDistortion_;
+    Size size_;
+    Mat& projected_;
+    Mat& projectedDepth_;
+    Mat& projectedRows_;
+
+    DepthProjectInvoker& operator=(const DepthProjectInvoker&);
+  };
+
+///////////////////////////////////////////////////////////////////////////////////
+
+  /** Builds, cleans and back-projects a band of rows of the registered depth
+   * The z-buffer of the band has one more row on each side so that the cleaning of the band does not depend on
+   * the other bands.
+   */
+  class DepthBandInvoker : public ParallelLoopBody
+  {
+  public:
+    DepthBandInvoker(const Mat& projected, const Mat& projectedDepth, const Mat& projectedRows, bool depthDilation,
+                     bool clean, const Matx33f& registeredK, Mat& registeredDepth, Mat& points3d)
+        :
+          projected_(projected),
+          projectedDepth_(projectedDepth),
+          projectedRows_(projectedRows),
+          depthDilation_(depthDilation),
+          clean_(clean),
+          registeredDepth_(registeredDepth),
+          points3d_(points3d)
+    {
+      const int cols = registeredDepth.cols;
+      inv_fx_ = 1.f / registeredK(0, 0);
+      inv_fy_ = 1.f / registeredK(1, 1);
+      oy_ = registeredK(1, 2);
+      x_cache_.resize(cols);
+      for (int x = 0; x < cols; ++x)
+        x_cache_[x] = (x - registeredK(0, 2)) * inv_fx_;
+      // spatial weights of the direct and diagonal neighbors
+      spatial_weight_[0] = 1.f;
+      spatial_weight_[1] = std::exp(-1.f / (2 * NIL_SIGMA_L * NIL_SIGMA_L));
+      spatial_weight_[2] = std::exp(-2.f / (2 * NIL_SIGMA_L * NIL_SIGMA_L));
+    }
+
+    virtual void operator()(const Range& range) const
+    {
+      const int rows = registeredDepth_.rows, cols = registeredDepth_.cols;
+      const int first = std::max(range.start - 1, 0), last = std::min(range.end + 1, rows);
+      const float no_depth = std::numeric_limits<float>::max();
+      Mat_<float> zbuffer(last - first, cols, no_depth);
+
+      // Splat the projected pixels falling on the band, keeping the closest depth
+      const int dilation = depthDilation_ ? 1 : 0;
+      for (int j = 0; j < projected_.rows; ++j)
+      {
+        const Vec2i& row_bounds = projectedRows_.at<Vec2i>(j);
+        if (row_bounds[1] < first || row_bounds[0] - dilation >= last)
+          continue;
+        const int* offset = projected_.ptr<int>(j);
+        const float* depth = projectedDepth_.ptr<float>(j);
+        for (int i = 0; i < projected_.cols; ++i)
+        {
+          if (offset[i] < 0)
+            continue;
+          const int v = offset[i] / cols, u = offset[i] - v * cols;
+          const float z = depth[i];
+          if (v >= first && v < last)
+            splat(zbuffer, v - first, u, z);
+          // 2x2 dilation with the projected location in the bottom right, as in registerDepth
+          if (dilation)
+          {
+            if (u > 0 && v >= first && v < last)
+              splat(zbuffer, v - first, u - 1, z);
+            if (v - 1 >= first && v - 1 < last)
+            {
+              splat(zbuffer, v - 1 - first, u, z);
+              if (u > 0)
+                splat(zbuffer, v - 1 - first, u - 1, z);
+            }
+          }
+        }
+      }
+
+      const float nan = std::numeric_limits<float>::quiet_NaN();
+      for (int y = range.start; y < range.end; ++y)
+      {
+        const float* zrow = zbuffer[y - first];
+        const float* zrow_up = y > 0 ? zbuffer[y - 1 - first] : 0;
+        const float* zrow_down = y + 1 < rows ? zbuffer[y + 1 - first] : 0;
+        float* depth = registeredDepth_.ptr<float>(y);
+        for (int x = 0; x < cols; ++x)
+        {
+          float z = zrow[x];
+          if (z == no_depth)
+          {
+            depth[x] = nan;
+            continue;
+          }
+          if (clean_)
+          {
+            // NIL weights of the 3x3 neighborhood with the depth noise of the center pixel
+            const float sigma_z = nilSigmaZ(z);
+            const float inv_2sigma_z2 = 1.f / (2 * sigma_z * sigma_z);
+            float w_sum = 1.f, dw_sum = z;
+            const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, cols - 1);
+            const float* neighbor_rows[3] = { zrow_up, zrow, zrow_down };
+            for (int j = 0; j < 3; ++j)
+            {
+              const float* neighbors = neighbor_rows[j];
+              if (!neighbors)
+                continue;
+              for (int i = x0; i <= x1; ++i)
+              {
+                const float delta_z = std::abs(neighbors[i] - z);
+                if ((j == 1 && i == x) || !(delta_z < NIL_DIFFERENCE_THRESHOLD))
+                  continue;
+                const float w = spatial_weight_[(j != 1) + (i != x)] * std::exp(-delta_z * delta_z * inv_2sigma_z2);
+                w_sum += w;
+                dw_sum += neighbors[i] * w;
+              }
+            }
+            z = dw_sum / w_sum;
+          }
+          depth[x] = z;
+        }
+
+        if (points3d_.empty())
+          continue;
+        // Back-project as depthTo3d does
+        const float y_cache = (y - oy_) * inv_fy_;
+        Vec3f* point = points3d_.ptr<Vec3f>(y);
+        for (int x = 0; x < cols; ++x)
+          point[x] = Vec3f(x_cache_[x] * depth[x], y_cache * depth[x], depth[x]);
+      }
+    }
+
+  private:
+    static inline void
+    splat(Mat_<float>& zbuffer, int v, int u, float z)
+    {
+      float& value = zbuffer(v, u);
+      if (z < value)
+        value = z;
+    }
+
+    const Mat& projected_;
+    const Mat& projectedDepth_;
+    const Mat& projectedRows_;
+    bool depthDilation_;
+    bool clean_;
+    float inv_fx_, inv_fy_, oy_;
+    std::vector<float> x_cache_;
+    float spatial_weight_[3];
+    Mat& registeredDepth_;
+    Mat& points3d_;
+
+    DepthBandInvoker& operator=(const DepthBandInvoker&);
+  };
+
+///////////////////////////////////////////////////////////////////////////////////
+
+  DepthPreprocessor::DepthPreprocessor(InputArray unregisteredCameraMatrix, InputArray registeredCameraMatrix,
+                                       InputArray registeredDistCoeffs, InputArray Rt,
+                                       const Size& outputImagePlaneSize, bool depthDilation, bool clean)
+      :
+        unregisteredCameraMatrix_(unregisteredCameraMatrix.getMat()),
+        registeredCameraMatrix_(registeredCameraMatrix.getMat()),
+        registeredDistCoeffs_(registeredDistCoeffs.getMat()),
+        Rt_(Rt.getMat()),
+        outputImagePlaneSize_(outputImagePlaneSize),
+        depthDilation_(depthDilation),
+        clean_(clean)
+  {
+  }
+
+  void
+  DepthPreprocessor::operator()(InputArray depth_in, OutputArray registeredDepth_out, OutputArray points3d_out)
+  {
+    CV_Assert(unregisteredCameraMatrix_.depth() == CV_64F || unregisteredCameraMatrix_.depth() == CV_32F);
+    CV_Assert(registeredCameraMatrix_.depth() == CV_64F || registeredCameraMatrix_.depth() == CV_32F);
+    CV_Assert(registeredDistCoeffs_.empty() || registeredDistCoeffs_.depth() == CV_64F ||
+              registeredDistCoeffs_.depth() == CV_32F);
+    CV_Assert(Rt_.depth() == CV_64F || Rt_.depth() == CV_32F);
+    CV_Assert(outputImagePlaneSize_.height > 0 && outputImagePlaneSize_.width > 0);
+
+    Mat depth = depth_in.getMat();
+    CV_Assert(!depth.empty() && depth.channels() == 1 &&
+              (depth.depth() == CV_16U || depth.depth() == CV_32F || depth.depth() == CV_64F));
+    const float scale = depth.depth() == CV_16U ? .001f : 1.f;
+
+    // Implicitly checking dimensions of the parameters
+    Matx33f unregisteredK = unregisteredCameraMatrix_;
+    Matx33f registeredK = registeredCameraMatrix_;
+    Mat_<float> distCoeffs = registeredDistCoeffs_;
+    Matx44f rbtRgb2Depth = Rt_;
+    const bool hasDistortion = !distCoeffs.empty() && countNonZero(distCoeffs) > 0;
+
+    // Same chaining of the projection as in registerDepth
+    Matx44f K = Matx44f::zeros();
+    for (int j = 0; j < 3; ++j)
+      for (int i = 0; i < 3; ++i)
+        K(j, i) = unregisteredK(j, i);
+    K(3, 3) = 1;
+    Matx44f projection = rbtRgb2Depth * K.inv();
+    if (!hasDistortion)
+    {
+      Matx44f registeredK4 = Matx44f::zeros();
+      for (int j = 0; j < 3; ++j)
+        for (int i = 0; i < 3; ++i)
+          registeredK4(j, i) = registeredK(j, i);
+      registeredK4(3, 3) = 1;
+      projection = registeredK4 * projection;
+    }
+
+    projected_.create(depth.size(), CV_32S);
+    projectedDepth_.create(depth.size(), CV_32F);
+    projectedRows_.create(depth.rows, 1, CV_32SC2);
+    parallel_for_(Range(0, depth.rows),
+                  DepthProjectInvoker(depth, scale, projection, registeredK, distCoeffs, outputImagePlaneSize_,
+                                      projected_, projectedDepth_, projectedRows_));
+
+    registeredDepth_out.create(outputImagePlaneSize_, CV_32F);
+    Mat registeredDepth = registeredDepth_out.getMat();
+    Mat points3d;
+    if (points3d_out.needed())
+    {
+      points3d_out.create(outputImagePlaneSize_, CV_32FC3);
+      points3d = points3d_out.getMat();
+    }
+
+    // bands of 16 rows: the z-buffer rows of the band borders are computed twice
+    parallel_for_(Range(0, outputImagePlaneSize_.height),
+                  DepthBandInvoker(projected_, projectedDepth_, projectedRows_, depthDilation_, clean_, registeredK,
+                                   registeredDepth, points3d),
+                  outputImagePlaneSize_.height / 16.);
+  }
+
+} /* namespace rgbd */
+} /* namespace cv */
@@ -41,6 +41,8 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include "mapped_file.hpp"
 
 namespace cv
 {
@@ -1127,6 +1129,19 @@ static void linearize(const Mat& response_map, Mat& linearized, int T)
 *                               Linearized similarities                                  *
 \****************************************************************************************/
 
+/**
+ * \brief Features of one template as packed arrays, see TemplateBank.
+ */
+struct TemplateView
+{
+  int width;
+  int height;
+  int num_features;
+  const short* x;
+  const short* y;
+  const uchar* label;
+};
+
 static const unsigned char* accessLinearMemory(const std::vector<Mat>& linear_memories,
           const Feature& f, int T, int W)
 {
@@ -1152,6 +1167,36 @@ static const unsigned char* accessLinearMemory(const std::vector<Mat>& linear_me
   return memory + lm_index;
 }
 
+/**
+ * \brief Add a run of linear memory responses to an 8-bit similarity accumulator.
+ *
+ * Templates have at most 63 features with a response of at most 4 each, so the sums
+ * fit in 8 bits and a plain byte-wise add is enough.
+ */
+static inline void addLinearMemory(const uchar* lm_ptr, uchar* dst_ptr, int length, bool haveAVX2)
+{
+  int j = 0;
+#if CV_AVX2
+  if (haveAVX2)
+  {
+    for ( ; j <= length - 32; j += 32)
+    {
+      __m256i responses = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lm_ptr + j));
+      __m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst_ptr + j));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst_ptr + j), _mm256_add_epi8(sum, responses));
+    }
+  }
+#else
+  (void)haveAVX2;
+#endif
+#if CV_SIMD128
+  for ( ; j <= length - 16; j += 16)
+    v_store(dst_ptr + j, v_load(dst_ptr + j) + v_load(lm_ptr + j));
+#endif
+  for ( ; j < length; ++j)
+    dst_ptr[j] = uchar(dst_ptr[j] + lm_ptr[j]);
+}
+
 /**
  * \brief Compute similarity measure for a given template at each sampled image location.
  *
@@ -1163,14 +1208,14 @@ static const unsigned char* accessLinearMemory(const std::vector<Mat>& linear_me
  * \param      size            Size (W, H) of the original input image.
  * \param      T               Sampling step.
  */
-static void similarity(const std::vector<Mat>& linear_memories, const Template& templ,
+static void similarity(const std::vector<Mat>& linear_memories, const TemplateView& templ,
                 Mat& dst, Size size, int T)
 {
   // 63 features or less is a special case because the max similarity per-feature is 4.
   // 255/4 = 63, so up to that many we can add up similarities in 8 bits without worrying
   // about overflow. Therefore here we use _mm_add_epi8 as the workhorse, whereas a more
   // general function would use _mm_add_epi16.
-  CV_Assert(templ.features.size() <= 63);
+  CV_Assert(templ.num_features <= 63);
   /// @todo Handle more than 255/MAX_RESPONSE features!!
 
   // Decimate input image size by factor of T
@@ -1193,59 +1238,31 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
 
   /// @todo In old code, dst is buffer of size m_U. Could make it something like
   /// (span_x)x(span_y) instead?
-  dst = Mat::zeros(H, W, CV_8U);
+  // dst is reused across templates, so only reallocate when the image size changes
+  dst.create(H, W, CV_8U);
+  dst.setTo(Scalar::all(0));
   uchar* dst_ptr = dst.ptr<uchar>();
-
-#if CV_SSE2
-  volatile bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
-#if CV_SSE3
-  volatile bool haveSSE3 = checkHardwareSupport(CV_CPU_SSE3);
-#endif
-#endif
+  const bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
 
   // Compute the similarity measure for this template by accumulating the contribution of
   // each feature
-  for (int i = 0; i < (int)templ.features.size(); ++i)
+  for (int i = 0; i < templ.num_features; ++i)
   {
     // Add the linear memory at the appropriate offset computed from the location of
     // the feature in the template
-    Feature f = templ.features[i];
+    Feature f(templ.x[i], templ.y[i], templ.label[i]);
     // Discard feature if out of bounds
     /// @todo Shouldn't actually see x or y < 0 here?
     if (f.x < 0 || f.x >= size.width || f.y < 0 || f.y >= size.height)
       continue;
+    // Features outside of the template or with an invalid label only come from a corrupted
+    // template file, they would read past the linear memories
+    if (f.x > templ.width || f.y > templ.height || f.label >= 8)
+      continue;
     const uchar* lm_ptr = accessLinearMemory(linear_memories, f, T, W);
 
-    // Now we do an aligned/unaligned add of dst_ptr and lm_ptr with template_positions elements
-    int j = 0;
-    // Process responses 16 at a time if vectorization possible
-#if CV_SSE2
-#if CV_SSE3
-    if (haveSSE3)
-    {
-      // LDDQU may be more efficient than MOVDQU for unaligned load of next 16 responses
-      for ( ; j < template_positions - 15; j += 16)
-      {
-        __m128i responses = _mm_lddqu_si128(reinterpret_cast<const __m128i*>(lm_ptr + j));
-        __m128i* dst_ptr_sse = reinterpret_cast<__m128i*>(dst_ptr + j);
-        *dst_ptr_sse = _mm_add_epi8(*dst_ptr_sse, responses);
-      }
-    }
-    else
-#endif
-    if (haveSSE2)
-    {
-      // Fall back to MOVDQU
-      for ( ; j < template_positions - 15; j += 16)
-      {
-        __m128i responses = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lm_ptr + j));
-        __m128i* dst_ptr_sse = reinterpret_cast<__m128i*>(dst_ptr + j);
-        *dst_ptr_sse = _mm_add_epi8(*dst_ptr_sse, responses);
-      }
-    }
-#endif
-    for ( ; j < template_positions; ++j)
-      dst_ptr[j] = uchar(dst_ptr[j] + lm_ptr[j]);
+    // Now we do an unaligned add of dst_ptr and lm_ptr with template_positions elements
+    addLinearMemory(lm_ptr, dst_ptr, template_positions, haveAVX2);
   }
 }
 
@@ -1259,16 +1276,18 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
  * \param      T               Sampling step.
  * \param      center          Center of the local region.
  */
-static void similarityLocal(const std::vector<Mat>& linear_memories, const Template& templ,
+static void similarityLocal(const std::vector<Mat>& linear_memories, const TemplateView& templ,
                      Mat& dst, Size size, int T, Point center)
 {
   // Similar to whole-image similarity() above. This version takes a position 'center'
   // and computes the energy in the 16x16 patch centered on it.
-  CV_Assert(templ.features.size() <= 63);
+  CV_Assert(templ.num_features <= 63);
 
   // Compute the similarity map in a 16x16 patch around center
   int W = size.width / T;
-  dst = Mat::zeros(16, 16, CV_8U);
+  dst.create(16, 16, CV_8U);
+  dst.setTo(Scalar::all(0));
+  uchar* dst_ptr = dst.ptr<uchar>();
 
   // Offset each feature point by the requested center. Further adjust to (-8,-8) from the
   // center to get the top-left corner of the 16x16 patch.
@@ -1276,61 +1295,23 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
   int offset_x = (center.x / T - 8) * T;
   int offset_y = (center.y / T - 8) * T;
 
-#if CV_SSE2
-  volatile bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
-#if CV_SSE3
-  volatile bool haveSSE3 = checkHardwareSupport(CV_CPU_SSE3);
-#endif
-  __m128i* dst_ptr_sse = dst.ptr<__m128i>();
-#endif
-
-  for (int i = 0; i < (int)templ.features.size(); ++i)
+  for (int i = 0; i < templ.num_features; ++i)
   {
-    Feature f = templ.features[i];
-    f.x += offset_x;
-    f.y += offset_y;
+    Feature f(templ.x[i] + offset_x, templ.y[i] + offset_y, templ.label[i]);
     // Discard feature if out of bounds, possibly due to applying the offset
     if (f.x < 0 || f.y < 0 || f.x >= size.width || f.y >= size.height)
       continue;
+    // As in similarity(), skip the features of a corrupted template file
+    if (templ.x[i] > templ.width || templ.y[i] > templ.height || f.label >= 8)
+      continue;
 
     const uchar* lm_ptr = accessLinearMemory(linear_memories, f, T, W);
 
-    // Process whole row at a time if vectorization possible
-#if CV_SSE2
-#if CV_SSE3
-    if (haveSSE3)
-    {
-      // LDDQU may be more efficient than MOVDQU for unaligned load of 16 responses from current row
-      for (int row = 0; row < 16; ++row)
-      {
-        __m128i aligned = _mm_lddqu_si128(reinterpret_cast<const __m128i*>(lm_ptr));
-        dst_ptr_sse[row] = _mm_add_epi8(dst_ptr_sse[row], aligned);
-        lm_ptr += W; // Step to next row
-      }
-    }
-    else
-#endif
-    if (haveSSE2)
+    // Add the 16 responses of each row of the patch, too short for the 32-byte AVX2 loop
+    for (int row = 0; row < 16; ++row)
     {
-      // Fall back to MOVDQU
-      for (int row = 0; row < 16; ++row)
-      {
-        __m128i aligned = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lm_ptr));
-        dst_ptr_sse[row] = _mm_add_epi8(dst_ptr_sse[row], aligned);
-        lm_ptr += W; // Step to next row
-      }
-    }
-    else
-#endif
-    {
-      uchar* dst_ptr = dst.ptr<uchar>();
-      for (int row = 0; row < 16; ++row)
-      {
-        for (int col = 0; col < 16; ++col)
-          dst_ptr[col] = uchar(dst_ptr[col] + lm_ptr[col]);
-        dst_ptr += 16;
-        lm_ptr += W;
-      }
+      addLinearMemory(lm_ptr, dst_ptr + row * 16, 16, false);
+      lm_ptr += W; // Step to next row
     }
   }
 }
@@ -1373,11 +1354,407 @@ static void addSimilarities(const std::vector<Mat>& similarities, Mat& dst)
   }
 }
 
+/****************************************************************************************\
+*                                    Template bank                                       *
+\****************************************************************************************/
+
+/*
+ Binary template file layout (native byte order, checked on load):
+
+   TemplateFileHeader
+   names            modality names then class IDs, each null-terminated
+   class ranges     numClasses x (first pyramid, number of pyramids) ints
+   template info    numLevels x numPyramids x numModalities x (width, height,
+                    first feature, number of features) ints
+   feature x        numFeatures shorts
+   feature y        numFeatures shorts
+   feature label    numFeatures bytes
+
+ Templates are ordered by pyramid level, then by pyramid in class order, then by
+ modality, so that the features of all the templates of a level are contiguous. Every
+ section starts at a multiple of TEMPLATE_FILE_ALIGNMENT bytes, so that the arrays can be
+ used in place from a memory mapping.
+*/
+static const char TEMPLATE_FILE_MAGIC[8] = {'C', 'V', 'L', 'M', 'T', 'P', 'L', 0};
+static const unsigned int TEMPLATE_FILE_VERSION = 1;
+static const unsigned int TEMPLATE_FILE_ENDIAN_CHECK = 0x01020304;
+static const size_t TEMPLATE_FILE_ALIGNMENT = 64;
+
+enum
+{
+  TEMPLATE_SECTION_NAMES = 0,
+  TEMPLATE_SECTION_CLASS_RANGES,
+  TEMPLATE_SECTION_TEMPLATE_INFO,
+  TEMPLATE_SECTION_FEATURE_X,
+  TEMPLATE_SECTION_FEATURE_Y,
+  TEMPLATE_SECTION_FEATURE_LABEL,
+  TEMPLATE_SECTION_COUNT
+};
+
+struct TemplateFileHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int endianCheck;
+  unsigned int headerSize;
+  int numModalities;
+  int numLevels;
+  int numClasses;
+  int numPyramids;
+  int numFeatures;
+  uint64 namesSize;
+  uint64 sectionOffsets[TEMPLATE_SECTION_COUNT];
+  uint64 fileSize;
+};
+
+static inline uint64 alignTemplateOffset(uint64 offset)
+{
+  return (offset + TEMPLATE_FILE_ALIGNMENT - 1) & ~(uint64)(TEMPLATE_FILE_ALIGNMENT - 1);
+}
+
+// computes the section offsets and the file size from the array sizes in the header
+static void layoutTemplateFile(TemplateFileHeader& header)
+{
+  const uint64 sectionSizes[TEMPLATE_SECTION_COUNT] =
+  {
+    header.namesSize,
+    (uint64)header.numClasses * 2 * sizeof(int),
+    (uint64)header.numLevels * header.numPyramids * header.numModalities * 4 * sizeof(int),
+    (uint64)header.numFeatures * sizeof(short),
+    (uint64)header.numFeatures * sizeof(short),
+    (uint64)header.numFeatures * sizeof(uchar)
+  };
+
+  uint64 offset = alignTemplateOffset(sizeof(TemplateFileHeader));
+  for (int i = 0; i < TEMPLATE_SECTION_COUNT; i++)
+  {
+    header.sectionOffsets[i] = offset;
+    offset = alignTemplateOffset(offset + sectionSizes[i]);
+  }
+  header.fileSize = offset;
+}
+
+/**
+ * \brief Templates of all classes as packed arrays, the representation used for matching.
+ *
+ * Template pyramids are numbered in class order. The arrays either own their data or
+ * point into a mapped template file.
+ */
+class TemplateBank
+{
+public:
+  TemplateBank() : num_modalities(0), pyramid_levels(0), num_pyramids(0), num_features(0) {}
+
+  TemplateBank(const std::map<String, std::vector< std::vector<Template> > >& class_templates,
+               int _num_modalities, int _pyramid_levels);
+
+  TemplateView getTemplate(int level, int pyramid, int modality) const
+  {
+    const int* info = template_info.ptr<int>((level * num_pyramids + pyramid) * num_modalities + modality);
+    // a loaded template table is not validated, so its feature ranges are clamped to the features,
+    // and to the 63 features that the 8-bit similarities can sum
+    const int first = std::min(std::max(info[2], 0), num_features);
+    TemplateView templ;
+    templ.width = info[0];
+    templ.height = info[1];
+    templ.num_features = std::min(std::min(std::max(info[3], 0), num_features - first), 63);
+    templ.x = feature_x.ptr<short>() + first;
+    templ.y = feature_y.ptr<short>() + first;
+    templ.label = feature_label.ptr<uchar>() + first;
+    return templ;
+  }
+
+  int num_modalities;
+  int pyramid_levels;
+  int num_pyramids;
+  int num_features;
+  std::vector<String> class_ids;
+  Mat class_ranges;   // numClasses x 2 CV_32S: first pyramid, number of pyramids
+  Mat template_info;  // (levels*pyramids*modalities) x 4 CV_32S: width, height, first feature, number of features
+  Mat feature_x;      // CV_16S
+  Mat feature_y;      // CV_16S
+  Mat feature_label;  // CV_8U
+  Ptr<MappedFile> file;      // template file the arrays point into, if loaded
+};
+
+TemplateBank::TemplateBank(const std::map<String, std::vector< std::vector<Template> > >& class_templates,
+                           int _num_modalities, int _pyramid_levels)
+  : num_modalities(_num_modalities), pyramid_levels(_pyramid_levels), num_pyramids(0), num_features(0)
+{
+  const int templates_per_pyramid = num_modalities * pyramid_levels;
+
+  std::vector<const std::vector<Template>*> pyramids;
+  class_ranges.create(std::max((int)class_templates.size(), 1), 2, CV_32S);
+  std::map<String, std::vector< std::vector<Template> > >::const_iterator it = class_templates.begin();
+  for ( ; it != class_templates.end(); ++it)
+  {
+    int* range = class_ranges.ptr<int>((int)class_ids.size());
+    range[0] = (int)pyramids.size();
+    range[1] = (int)it->second.size();
+    class_ids.push_back(it->first);
+    for (size_t i = 0; i < it->second.size(); ++i)
+    {
+      CV_Assert((int)it->second[i].size() == templates_per_pyramid);
+      pyramids.push_back(&it->second[i]);
+    }
+  }
+  num_pyramids = (int)pyramids.size();
+
+  template_info.create(std::max(num_pyramids * templates_per_pyramid, 1), 4, CV_32S);
+  for (int l = 0; l < pyramid_levels; ++l)
+    for (int p = 0; p < num_pyramids; ++p)
+      for (int m = 0; m < num_modalities; ++m)
+      {
+        const Template& templ = (*pyramids[p])[l * num_modalities + m];
+        int* info = template_info.ptr<int>((l * num_pyramids + p) * num_modalities + m);
+        info[0] = templ.width;
+        info[1] = templ.height;
+        info[2] = num_features;
+        info[3] = (int)templ.features.size();
+        CV_Assert(info[3] <= 63);
+        num_features += info[3];
+      }
+
+  feature_x.create(std::max(num_features, 1), 1, CV_16S);
+  feature_y.create(std::max(num_features, 1), 1, CV_16S);
+  feature_label.create(std::max(num_features, 1), 1, CV_8U);
+  short* x = feature_x.ptr<short>();
+  short* y = feature_y.ptr<short>();
+  uchar* label = feature_label.ptr<uchar>();
+  for (int l = 0; l < pyramid_levels; ++l)
+    for (int p = 0; p < num_pyramids; ++p)
+      for (int m = 0; m < num_modalities; ++m)
+      {
+        const std::vector<Feature>& features = (*pyramids[p])[l * num_modalities + m].features;
+        for (size_t i = 0; i < features.size(); ++i)
+        {
+          const Feature& f = features[i];
+          CV_Assert(f.x >= SHRT_MIN && f.x <= SHRT_MAX && f.y >= SHRT_MIN && f.y <= SHRT_MAX);
+          CV_Assert(f.label >= 0 && f.label < 8);
+          *x++ = (short)f.x;
+          *y++ = (short)f.y;
+          *label++ = (uchar)f.label;
+        }
+      }
+}
+
+/****************************************************************************************\
+*                                  Template matching                                     *
+\****************************************************************************************/
+
+// Used to filter out weak matches
+struct MatchPredicate
+{
+  MatchPredicate(float _threshold) : threshold(_threshold) {}
+  bool operator() (const Match& m) { return m.similarity < threshold; }
+  float threshold;
+};
+
+// Scratch similarity maps, reused from one template to the next
+struct MatchBuffers
+{
+  std::vector<Mat> similarities;
+  Mat total_similarity;
+  std::vector<Mat> similarities2;
+  Mat total_similarity2;
+};
+
+/**
+ * \brief Match a single template pyramid against the linear memory pyramid.
+ *
+ * Matches globally at the lowest pyramid level, then refines each candidate locally
+ * stepping up the pyramid.
+ *
+ * \param[out] candidates Matches of this template, in scan order of the lowest level.
+ */
+static void matchTemplate(const std::vector< std::vector< std::vector<Mat> > >& lm_pyramid,
+                          const std::vector<Size>& sizes, const std::vector<int>& T_at_level,
+                          const TemplateBank& bank, int pyramid, float threshold,
+                          const String& class_id, int template_id,
+                          MatchBuffers& buffers, std::vector<Match>& candidates)
+{
+  const int num_modalities = bank.num_modalities;
+
+  // First match over the whole image at the lowest pyramid level
+  const std::vector< std::vector<Mat> >& lowest_lm = lm_pyramid.back();
+  const int lowest_level = bank.pyramid_levels - 1;
+
+  // Compute similarity maps for each modality at lowest pyramid level
+  std::vector<Mat>& similarities = buffers.similarities;
+  similarities.resize(num_modalities);
+  int lowest_T = T_at_level.back();
+  int num_features = 0;
+  for (int i = 0; i < num_modalities; ++i)
+  {
+    TemplateView templ = bank.getTemplate(lowest_level, pyramid, i);
+    num_features += templ.num_features;
+    similarity(lowest_lm[i], templ, similarities[i], sizes.back(), lowest_T);
+  }
+
+  // Combine into overall similarity
+  /// @todo Support weighting the modalities
+  Mat& total_similarity = buffers.total_similarity;
+  addSimilarities(similarities, total_similarity);
+
+  // Convert user-friendly percentage to raw similarity threshold. The percentage
+  // threshold scales from half the max response (what you would expect from applying
+  // the template to a completely random image) to the max response.
+  // NOTE: This assumes max per-feature response is 4, so we scale between [2*nf, 4*nf].
+  int raw_threshold = static_cast<int>(2*num_features + (threshold / 100.f) * (2*num_features) + 0.5f);
+
+  // Find initial matches
+  candidates.clear();
+  for (int r = 0; r < total_similarity.rows; ++r)
+  {
+    ushort* row = total_similarity.ptr<ushort>(r);
+    for (int c = 0; c < total_similarity.cols; ++c)
+    {
+      int raw_score = row[c];
+      if (raw_score > raw_threshold)
+      {
+        int offset = lowest_T / 2 + (lowest_T % 2 - 1);
+        int x = c * lowest_T + offset;
+        int y = r * lowest_T + offset;
+        float score =(raw_score * 100.f) / (4 * num_features) + 0.5f;
+        candidates.push_back(Match(x, y, score, class_id, template_id));
+      }
+    }
+  }
+
+  // Locally refine each match by marching up the pyramid
+  for (int l = lowest_level - 1; l >= 0; --l)
+  {
+    const std::vector< std::vector<Mat> >& lms = lm_pyramid[l];
+    int T = T_at_level[l];
+    TemplateView first_templ = bank.getTemplate(l, pyramid, 0);
+    Size size = sizes[l];
+    int border = 8 * T;
+    int offset = T / 2 + (T % 2 - 1);
+    int max_x = size.width - first_templ.width - border;
+    int max_y = size.height - first_templ.height - border;
+
+    std::vector<Mat>& similarities2 = buffers.similarities2;
+    similarities2.resize(num_modalities);
+    Mat& total_similarity2 = buffers.total_similarity2;
+    for (int m = 0; m < (int)candidates.size(); ++m)
+    {
+      Match& match2 = candidates[m];
+      int x = match2.x * 2 + 1; /// @todo Support other pyramid distance
+      int y = match2.y * 2 + 1;
+
+      // Require 8 (reduced) row/cols to the up/left
+      x = std::max(x, border);
+      y = std::max(y, border);
+
+      // Require 8 (reduced) row/cols to the down/left, plus the template size
+      x = std::min(x, max_x);
+      y = std::min(y, max_y);
+
+      // Compute local similarity maps for each modality
+      int numFeatures = 0;
+      for (int i = 0; i < num_modalities; ++i)
+      {
+        TemplateView templ = bank.getTemplate(l, pyramid, i);
+        numFeatures += templ.num_features;
+        similarityLocal(lms[i], templ, similarities2[i], size, T, Point(x, y));
+      }
+      addSimilarities(similarities2, total_similarity2);
+
+      // Find best local adjustment
+      int best_score = 0;
+      int best_r = -1, best_c = -1;
+      for (int r = 0; r < total_similarity2.rows; ++r)
+      {
+        ushort* row = total_similarity2.ptr<ushort>(r);
+        for (int c = 0; c < total_similarity2.cols; ++c)
+        {
+          int score = row[c];
+          if (score > best_score)
+          {
+            best_score = score;
+            best_r = r;
+            best_c = c;
+          }
+        }
+      }
+      // Update current match
+      match2.x = (x / T - 8 + best_c) * T + offset;
+      match2.y = (y / T - 8 + best_r) * T + offset;
+      match2.similarity = numFeatures > 0 ? (best_score * 100.f) / (4 * numFeatures) : 0.f;
+    }
+
+    // Filter out any matches that drop below the similarity threshold
+    std::vector<Match>::iterator new_end = std::remove_if(candidates.begin(), candidates.end(),
+                                                          MatchPredicate(threshold));
+    candidates.erase(new_end, candidates.end());
+  }
+}
+
+struct MatchItem
+{
+  const String* class_id;
+  int template_id;
+  int pyramid;
+};
+
+// Matches a range of (class, template) items, each one into its own result vector
+class MatchTemplatesInvoker : public ParallelLoopBody
+{
+public:
+  MatchTemplatesInvoker(const std::vector< std::vector< std::vector<Mat> > >& _lm_pyramid,
+                        const std::vector<Size>& _sizes, const std::vector<int>& _T_at_level,
+                        const TemplateBank& _bank, float _threshold,
+                        const std::vector<MatchItem>& _items,
+                        std::vector< std::vector<Match> >& _item_matches)
+    : lm_pyramid(_lm_pyramid), sizes(_sizes), T_at_level(_T_at_level),
+      bank(_bank), threshold(_threshold),
+      items(_items), item_matches(_item_matches)
+  {
+  }
+
+  virtual void operator()(const Range& range) const
+  {
+    // One set of similarity maps per stripe, shared by all its templates
+    MatchBuffers buffers;
+    for (int i = range.start; i < range.end; ++i)
+    {
+      const MatchItem& item = items[i];
+      matchTemplate(lm_pyramid, sizes, T_at_level, bank, item.pyramid, threshold,
+                    *item.class_id, item.template_id, buffers, item_matches[i]);
+    }
+  }
+
+private:
+  MatchTemplatesInvoker& operator=(const MatchTemplatesInvoker&);
+
+  const std::vector< std::vector< std::vector<Mat> > >& lm_pyramid;
+  const std::vector<Size>& sizes;
+  const std::vector<int>& T_at_level;
+  const TemplateBank& bank;
+  float threshold;
+  const std::vector<MatchItem>& items;
+  std::vector< std::vector<Match> >& item_matches;
+};
+
+static void addMatchItems(const TemplateBank& bank, int class_index, std::vector<MatchItem>& items)
+{
+  const int* range = bank.class_ranges.ptr<int>(class_index);
+  for (int template_id = 0; template_id < range[1]; ++template_id)
+  {
+    MatchItem item;
+    item.class_id = &bank.class_ids[class_index];
+    item.template_id = template_id;
+    item.pyramid = range[0] + template_id;
+    items.push_back(item);
+  }
+}
+
 /****************************************************************************************\
 *                               High-level Detector API                                  *
 \****************************************************************************************/
 
 Detector::Detector()
+  : templates_packed_only(false)
 {
 }
 
@@ -1385,10 +1762,58 @@ Detector::Detector(const std::vector< Ptr<Modality> >& _modalities,
                    const std::vector<int>& T_pyramid)
   : modalities(_modalities),
     pyramid_levels(static_cast<int>(T_pyramid.size())),
-    T_at_level(T_pyramid)
+    T_at_level(T_pyramid),
+    templates_packed_only(false)
 {
 }
 
+Ptr<TemplateBank> Detector::templateBank() const
+{
+  AutoLock lock(templates_mutex);
+  if (!template_bank)
+    template_bank = makePtr<TemplateBank>(class_templates, static_cast<int>(modalities.size()), pyramid_levels);
+  return template_bank;
+}
+
+void Detector::unpackTemplates() const
+{
+  AutoLock lock(templates_mutex);
+  if (!templates_packed_only)
+    return;
+
+  const TemplateBank& bank = *template_bank;
+  class_templates.clear();
+  for (int c = 0; c < (int)bank.class_ids.size(); ++c)
+  {
+    const int* range = bank.class_ranges.ptr<int>(c);
+    std::vector<TemplatePyramid>& tps = class_templates[bank.class_ids[c]];
+    tps.resize(range[1]);
+    for (int p = 0; p < range[1]; ++p)
+    {
+      TemplatePyramid& tp = tps[p];
+      tp.resize(pyramid_levels * bank.num_modalities);
+      for (int l = 0; l < pyramid_levels; ++l)
+        for (int m = 0; m < bank.num_modalities; ++m)
+        {
+          TemplateView view = bank.getTemplate(l, range[0] + p, m);
+          Template& templ = tp[l * bank.num_modalities + m];
+          templ.width = view.width;
+          templ.height = view.height;
+          templ.pyramid_level = l;
+          // features with an invalid label can only come from a corrupted template file
+          templ.features.clear();
+          templ.features.reserve(view.num_features);
+          for (int i = 0; i < view.num_features; ++i)
+          {
+            if (view.label[i] < 8)
+              templ.features.push_back(Feature(view.x[i], view.y[i], view.label[i]));
+          }
+        }
+    }
+  }
+  templates_packed_only = false;
+}
+
 void Detector::match(const std::vector<Mat>& sources, float threshold, std::vector<Match>& matches,
                      const std::vector<String>& class_ids, OutputArrayOfArrays quantized_images,
                      const std::vector<Mat>& masks) const
@@ -1446,162 +1871,69 @@ void Detector::match(const std::vector<Mat>& sources, float threshold, std::vect
     sizes.push_back(quantized.size());
   }
 
+  // The templates are packed once, then shared by all calls until templates are added
+  Ptr<TemplateBank> bank = templateBank();
+
+  // Gather the templates to match over all requested classes, in class order
+  std::vector<MatchItem> items;
   if (class_ids.empty())
   {
     // Match all templates
-    TemplatesMap::const_iterator it = class_templates.begin(), itend = class_templates.end();
-    for ( ; it != itend; ++it)
-      matchClass(lm_pyramid, sizes, threshold, matches, it->first, it->second);
+    for (int c = 0; c < (int)bank->class_ids.size(); ++c)
+      addMatchItems(*bank, c, items);
   }
   else
   {
     // Match only templates for the requested class IDs
     for (int i = 0; i < (int)class_ids.size(); ++i)
     {
-      TemplatesMap::const_iterator it = class_templates.find(class_ids[i]);
-      if (it != class_templates.end())
-        matchClass(lm_pyramid, sizes, threshold, matches, it->first, it->second);
+      std::vector<String>::const_iterator it = std::lower_bound(bank->class_ids.begin(), bank->class_ids.end(), class_ids[i]);
+      if (it != bank->class_ids.end() && *it == class_ids[i])
+        addMatchItems(*bank, static_cast<int>(it - bank->class_ids.begin()), items);
     }
   }
 
+  // Templates are independent, so match them in parallel. Each stripe covers several
+  // templates to amortize its similarity buffers, and each template writes its own
+  // result vector so that the output does not depend on the scheduling.
+  int num_items = static_cast<int>(items.size());
+  std::vector< std::vector<Match> > item_matches(num_items);
+  if (num_items > 0)
+  {
+    int nstripes = std::min(num_items, std::max(1, getNumThreads()) * 4);
+    parallel_for_(Range(0, num_items),
+                  MatchTemplatesInvoker(lm_pyramid, sizes, T_at_level, *bank, threshold, items, item_matches),
+                  nstripes);
+  }
+  for (int i = 0; i < num_items; ++i)
+    matches.insert(matches.end(), item_matches[i].begin(), item_matches[i].end());
+
   // Sort matches by similarity, and prune any duplicates introduced by pyramid refinement
   std::sort(matches.begin(), matches.end());
   std::vector<Match>::iterator new_end = std::unique(matches.begin(), matches.end());
   matches.erase(new_end, matches.end());
 }
 
-// Used to filter out weak matches
-struct MatchPredicate
-{
-  MatchPredicate(float _threshold) : threshold(_threshold) {}
-  bool operator() (const Match& m) { return m.similarity < threshold; }
-  float threshold;
-};
-
 void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
                           const std::vector<Size>& sizes,
                           float threshold, std::vector<Match>& matches,
                           const String& class_id,
                           const std::vector<TemplatePyramid>& template_pyramids) const
 {
+  // The template pyramids of the class are those of the packed templates
+  Ptr<TemplateBank> bank = templateBank();
+  std::vector<String>::const_iterator it = std::lower_bound(bank->class_ids.begin(), bank->class_ids.end(), class_id);
+  CV_Assert(it != bank->class_ids.end() && *it == class_id);
+  const int* range = bank->class_ranges.ptr<int>(static_cast<int>(it - bank->class_ids.begin()));
+  CV_Assert(range[1] == (int)template_pyramids.size());
+
+  MatchBuffers buffers;
+  std::vector<Match> candidates;
   // For each template...
-  for (size_t template_id = 0; template_id < template_pyramids.size(); ++template_id)
+  for (int template_id = 0; template_id < range[1]; ++template_id)
   {
-    const TemplatePyramid& tp = template_pyramids[template_id];
-
-    // First match over the whole image at the lowest pyramid level
-    /// @todo Factor this out into separate function
-    const std::vector<LinearMemories>& lowest_lm = lm_pyramid.back();
-
-    // Compute similarity maps for each modality at lowest pyramid level
-    std::vector<Mat> similarities(modalities.size());
-    int lowest_start = static_cast<int>(tp.size() - modalities.size());
-    int lowest_T = T_at_level.back();
-    int num_features = 0;
-    for (int i = 0; i < (int)modalities.size(); ++i)
-    {
-      const Template& templ = tp[lowest_start + i];
-      num_features += static_cast<int>(templ.features.size());
-      similarity(lowest_lm[i], templ, similarities[i], sizes.back(), lowest_T);
-    }
-
-    // Combine into overall similarity
-    /// @todo Support weighting the modalities
-    Mat total_similarity;
-    addSimilarities(similarities, total_similarity);
-
-    // Convert user-friendly percentage to raw similarity threshold. The percentage
-    // threshold scales from half the max response (what you would expect from applying
-    // the template to a completely random image) to the max response.
-    // NOTE: This assumes max per-feature response is 4, so we scale between [2*nf, 4*nf].
-    int raw_threshold = static_cast<int>(2*num_features + (threshold / 100.f) * (2*num_features) + 0.5f);
-
-    // Find initial matches
-    std::vector<Match> candidates;
-    for (int r = 0; r < total_similarity.rows; ++r)
-    {
-      ushort* row = total_similarity.ptr<ushort>(r);
-      for (int c = 0; c < total_similarity.cols; ++c)
-      {
-        int raw_score = row[c];
-        if (raw_score > raw_threshold)
-        {
-          int offset = lowest_T / 2 + (lowest_T % 2 - 1);
-          int x = c * lowest_T + offset;
-          int y = r * lowest_T + offset;
-          float score =(raw_score * 100.f) / (4 * num_features) + 0.5f;
-          candidates.push_back(Match(x, y, score, class_id, static_cast<int>(template_id)));
-        }
-      }
-    }
-
-    // Locally refine each match by marching up the pyramid
-    for (int l = pyramid_levels - 2; l >= 0; --l)
-    {
-      const std::vector<LinearMemories>& lms = lm_pyramid[l];
-      int T = T_at_level[l];
-      int start = static_cast<int>(l * modalities.size());
-      Size size = sizes[l];
-      int border = 8 * T;
-      int offset = T / 2 + (T % 2 - 1);
-      int max_x = size.width - tp[start].width - border;
-      int max_y = size.height - tp[start].height - border;
-
-      std::vector<Mat> similarities2(modalities.size());
-      Mat total_similarity2;
-      for (int m = 0; m < (int)candidates.size(); ++m)
-      {
-        Match& match2 = candidates[m];
-        int x = match2.x * 2 + 1; /// @todo Support other pyramid distance
-        int y = match2.y * 2 + 1;
-
-        // Require 8 (reduced) row/cols to the up/left
-        x = std::max(x, border);
-        y = std::max(y, border);
-
-        // Require 8 (reduced) row/cols to the down/left, plus the template size
-        x = std::min(x, max_x);
-        y = std::min(y, max_y);
-
-        // Compute local similarity maps for each modality
-        int numFeatures = 0;
-        for (int i = 0; i < (int)modalities.size(); ++i)
-        {
-          const Template& templ = tp[start + i];
-          numFeatures += static_cast<int>(templ.features.size());
-          similarityLocal(lms[i], templ, similarities2[i], size, T, Point(x, y));
-        }
-        addSimilarities(similarities2, total_similarity2);
-
-        // Find best local adjustment
-        int best_score = 0;
-        int best_r = -1, best_c = -1;
-        for (int r = 0; r < total_similarity2.rows; ++r)
-        {
-          ushort* row = total_similarity2.ptr<ushort>(r);
-          for (int c = 0; c < total_similarity2.cols; ++c)
-          {
-            int score = row[c];
-            if (score > best_score)
-            {
-              best_score = score;
-              best_r = r;
-              best_c = c;
-            }
-          }
-        }
-        // Update current match
-        match2.x = (x / T - 8 + best_c) * T + offset;
-        match2.y = (y / T - 8 + best_r) * T + offset;
-        match2.similarity = (best_score * 100.f) / (4 * numFeatures);
-      }
-
-      // Filter out any matches that drop below the similarity threshold
-      std::vector<Match>::iterator new_end = std::remove_if(candidates.begin(), candidates.end(),
-                                                            MatchPredicate(threshold));
-      candidates.erase(new_end, candidates.end());
-    }
-
+    matchTemplate(lm_pyramid, sizes, T_at_level, *bank, range[0] + template_id, threshold,
+                  class_id, template_id, buffers, candidates);
     matches.insert(matches.end(), candidates.begin(), candidates.end());
   }
 }
@@ -1609,6 +1941,8 @@ void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
 int Detector::addTemplate(const std::vector<Mat>& sources, const String& class_id,
                           const Mat& object_mask, Rect* bounding_box)
 {
+  unpackTemplates();
+  template_bank.release();
   int num_modalities = static_cast<int>(modalities.size());
   std::vector<TemplatePyramid>& template_pyramids = class_templates[class_id];
   int template_id = static_cast<int>(template_pyramids.size());
@@ -1644,6 +1978,8 @@ int Detector::addTemplate(const std::vector<Mat>& sources, const String& class_i
 
 int Detector::addSyntheticTemplate(const std::vector<Template>& templates, const String& class_id)
 {
+  unpackTemplates();
+  template_bank.release();
   std::vector<TemplatePyramid>& template_pyramids = class_templates[class_id];
   int template_id = static_cast<int>(template_pyramids.size());
   template_pyramids.push_back(templates);
@@ -1652,6 +1988,7 @@ int Detector::addSyntheticTemplate(const std::vector<Template>& templates, const
 
 const std::vector<Template>& Detector::getTemplates(const String& class_id, int template_id) const
 {
+  unpackTemplates();
   TemplatesMap::const_iterator i = class_templates.find(class_id);
   CV_Assert(i != class_templates.end());
   CV_Assert(i->second.size() > size_t(template_id));
@@ -1660,6 +1997,10 @@ const std::vector<Template>& Detector::getTemplates(const String& class_id, int
 
 int Detector::numTemplates() const
 {
+  AutoLock lock(templates_mutex);
+  if (templates_packed_only)
+    return template_bank->num_pyramids;
+
   int ret = 0;
   TemplatesMap::const_iterator i = class_templates.begin(), iend = class_templates.end();
   for ( ; i != iend; ++i)
@@ -1669,14 +2010,36 @@ int Detector::numTemplates() const
 
 int Detector::numTemplates(const String& class_id) const
 {
+  AutoLock lock(templates_mutex);
+  if (templates_packed_only)
+  {
+    const std::vector<String>& ids = template_bank->class_ids;
+    std::vector<String>::const_iterator it = std::lower_bound(ids.begin(), ids.end(), class_id);
+    if (it == ids.end() || *it != class_id)
+      return 0;
+    return template_bank->class_ranges.at<int>(static_cast<int>(it - ids.begin()), 1);
+  }
+
   TemplatesMap::const_iterator i = class_templates.find(class_id);
   if (i == class_templates.end())
     return 0;
   return static_cast<int>(i->second.size());
 }
 
+int Detector::numClasses() const
+{
+  AutoLock lock(templates_mutex);
+  if (templates_packed_only)
+    return static_cast<int>(template_bank->class_ids.size());
+  return static_cast<int>(class_templates.size());
+}
+
 std::vector<String> Detector::classIds() const
 {
+  AutoLock lock(templates_mutex);
+  if (templates_packed_only)
+    return template_bank->class_ids;
+
   std::vector<String> ids;
   TemplatesMap::const_iterator i = class_templates.begin(), iend = class_templates.end();
   for ( ; i != iend; ++i)
@@ -1690,6 +2053,8 @@ std::vector<String> Detector::classIds() const
 void Detector::read(const FileNode& fn)
 {
   class_templates.clear();
+  template_bank.release();
+  templates_packed_only = false;
   pyramid_levels = fn["pyramid_levels"];
   fn["T"] >> T_at_level;
 
@@ -1719,6 +2084,8 @@ void Detector::write(FileStorage& fs) const
 
   String Detector::readClass(const FileNode& fn, const String &class_id_override)
   {
+  unpackTemplates();
+
   // Verify compatible with Detector settings
   FileNode mod_fn = fn["modalities"];
   CV_Assert(mod_fn.size() == modalities.size());
@@ -1764,11 +2131,13 @@ void Detector::write(FileStorage& fs) const
   }
 
   class_templates.insert(v);
+  template_bank.release();
   return class_id;
 }
 
 void Detector::writeClass(const String& class_id, FileStorage& fs) const
 {
+  unpackTemplates();
   TemplatesMap::const_iterator it = class_templates.find(class_id);
   CV_Assert(it != class_templates.end());
   const std::vector<TemplatePyramid>& tps = it->second;
@@ -1812,6 +2181,7 @@ void Detector::readClasses(const std::vector<String>& class_ids,
 
 void Detector::writeClasses(const String& format) const
 {
+  unpackTemplates();
   TemplatesMap::const_iterator it = class_templates.begin(), it_end = class_templates.end();
   for ( ; it != it_end; ++it)
   {
@@ -1822,6 +2192,188 @@ void Detector::writeClasses(const String& format) const
   }
 }
 
+static void writeTemplateSection(FILE* f, const void* data, size_t size, uint64 offset)
+{
+  // pad up to the section start
+  static const char zeros[TEMPLATE_FILE_ALIGNMENT] = {0};
+  uint64 pos = (uint64)ftell(f);
+  CV_Assert(pos <= offset && offset - pos <= TEMPLATE_FILE_ALIGNMENT);
+  if (offset > pos)
+    fwrite(zeros, 1, (size_t)(offset - pos), f);
+
+  if (size > 0)
+    fwrite(data, 1, size, f);
+}
+
+void Detector::saveTemplates(const String& filename) const
+{
+  Ptr<TemplateBank> bank = templateBank();
+
+  std::vector<char> names;
+  for (size_t i = 0; i < modalities.size(); ++i)
+  {
+    String name = modalities[i]->name();
+    names.insert(names.end(), name.begin(), name.end());
+    names.push_back(0);
+  }
+  for (size_t i = 0; i < bank->class_ids.size(); ++i)
+  {
+    names.insert(names.end(), bank->class_ids[i].begin(), bank->class_ids[i].end());
+    names.push_back(0);
+  }
+
+  const int num_templates = pyramid_levels * bank->num_pyramids * bank->num_modalities;
+  const int num_features = num_templates > 0 ?
+      bank->template_info.at<int>(num_templates - 1, 2) + bank->template_info.at<int>(num_templates - 1, 3) : 0;
+
+  TemplateFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TEMPLATE_FILE_MAGIC, sizeof(header.magic));
+  header.version = TEMPLATE_FILE_VERSION;
+  header.endianCheck = TEMPLATE_FILE_ENDIAN_CHECK;
+  header.headerSize = (unsigned int)sizeof(TemplateFileHeader);
+  header.numModalities = bank->num_modalities;
+  header.numLevels = pyramid_levels;
+  header.numClasses = static_cast<int>(bank->class_ids.size());
+  header.numPyramids = bank->num_pyramids;
+  header.numFeatures = num_features;
+  header.namesSize = names.size();
+  layoutTemplateFile(header);
+
+  FILE* f = fopen(filename.c_str(), "wb");
+  if (!f)
+    CV_Error(Error::StsError, "Cannot open template file " + filename + " for writing");
+
+  fwrite(&header, sizeof(header), 1, f);
+  writeTemplateSection(f, names.empty() ? 0 : &names[0], names.size(),
+                       header.sectionOffsets[TEMPLATE_SECTION_NAMES]);
+  writeTemplateSection(f, bank->class_ranges.data, (size_t)header.numClasses * 2 * sizeof(int),
+                       header.sectionOffsets[TEMPLATE_SECTION_CLASS_RANGES]);
+  writeTemplateSection(f, bank->template_info.data, (size_t)num_templates * 4 * sizeof(int),
+                       header.sectionOffsets[TEMPLATE_SECTION_TEMPLATE_INFO]);
+  writeTemplateSection(f, bank->feature_x.data, (size_t)num_features * sizeof(short),
+                       header.sectionOffsets[TEMPLATE_SECTION_FEATURE_X]);
+  writeTemplateSection(f, bank->feature_y.data, (size_t)num_features * sizeof(short),
+                       header.sectionOffsets[TEMPLATE_SECTION_FEATURE_Y]);
+  writeTemplateSection(f, bank->feature_label.data, (size_t)num_features,
+                       header.sectionOffsets[TEMPLATE_SECTION_FEATURE_LABEL]);
+  writeTemplateSection(f, 0, 0, header.fileSize);
+
+  const bool ok = !ferror(f);
+  fclose(f);
+
+  if (!ok)
+    CV_Error(Error::StsError, "Cannot write template file " + filename);
+}
+
+void Detector::loadTemplates(const String& filename)
+{
+  Ptr<MappedFile> file = makePtr<MappedFile>(filename, String("template file"));
+
+  if (file->size < sizeof(TemplateFileHeader))
+    CV_Error(Error::StsError, "Invalid template file " + filename);
+
+  TemplateFileHeader header;
+  memcpy(&header, file->data, sizeof(header));
+
+  if (memcmp(header.magic, TEMPLATE_FILE_MAGIC, sizeof(header.magic)) != 0)
+    CV_Error(Error::StsError, "Invalid template file " + filename);
+  if (header.endianCheck != TEMPLATE_FILE_ENDIAN_CHECK)
+    CV_Error(Error::StsError, "Template file " + filename + " has been written on a platform with another byte order");
+  if (header.version != TEMPLATE_FILE_VERSION || header.headerSize != sizeof(TemplateFileHeader))
+    CV_Error(Error::StsError, "Unsupported version of template file " + filename);
+
+  // Verify compatible with Detector settings
+  if (header.numModalities != (int)modalities.size() || header.numLevels != pyramid_levels)
+    CV_Error(Error::StsBadArg, "Template file " + filename + " does not match the detector modalities or pyramid levels");
+
+  // recompute the layout from the sizes, so that a corrupted header cannot point outside of the file
+  if (header.numClasses < 0 || header.numPyramids < 0 || header.numFeatures < 0 ||
+      header.namesSize > file->size)
+    CV_Error(Error::StsError, "Invalid template file " + filename);
+  TemplateFileHeader expected = header;
+  layoutTemplateFile(expected);
+  if (memcmp(expected.sectionOffsets, header.sectionOffsets, sizeof(header.sectionOffsets)) != 0 ||
+      expected.fileSize != header.fileSize || header.fileSize > file->size)
+    CV_Error(Error::StsError, "Truncated or corrupted template file " + filename);
+
+  const uchar* base = file->data;
+
+  // modality names, then class IDs
+  std::vector<String> names;
+  const char* name = (const char*)(base + header.sectionOffsets[TEMPLATE_SECTION_NAMES]);
+  const char* names_end = name + header.namesSize;
+  while (name < names_end)
+  {
+    const char* name_end = (const char*)memchr(name, 0, names_end - name);
+    if (!name_end)
+      break;
+    names.push_back(String(name, name_end - name));
+    name = name_end + 1;
+  }
+  if (name != names_end || (int)names.size() != header.numModalities + header.numClasses)
+    CV_Error(Error::StsError, "Corrupted names in template file " + filename);
+  for (int i = 0; i < header.numModalities; ++i)
+  {
+    if (names[i] != modalities[i]->name())
+      CV_Error(Error::StsBadArg, "Template file " + filename + " does not match the detector modalities");
+  }
+
+  Ptr<TemplateBank> bank = makePtr<TemplateBank>();
+  bank->num_modalities = header.numModalities;
+  bank->pyramid_levels = header.numLevels;
+  bank->num_pyramids = header.numPyramids;
+  bank->num_features = header.numFeatures;
+  bank->class_ids.assign(names.begin() + header.numModalities, names.end());
+
+  // the arrays refer to the mapping, empty ones are replaced by a dummy row
+  const int num_templates = header.numLevels * header.numPyramids * header.numModalities;
+  if (header.numClasses > 0)
+    bank->class_ranges = Mat(header.numClasses, 2, CV_32S,
+                             (void*)(base + header.sectionOffsets[TEMPLATE_SECTION_CLASS_RANGES]));
+  else
+    bank->class_ranges = Mat::zeros(1, 2, CV_32S);
+  if (num_templates > 0)
+    bank->template_info = Mat(num_templates, 4, CV_32S,
+                              (void*)(base + header.sectionOffsets[TEMPLATE_SECTION_TEMPLATE_INFO]));
+  else
+    bank->template_info = Mat::zeros(1, 4, CV_32S);
+  if (header.numFeatures > 0)
+  {
+    bank->feature_x = Mat(header.numFeatures, 1, CV_16S, (void*)(base + header.sectionOffsets[TEMPLATE_SECTION_FEATURE_X]));
+    bank->feature_y = Mat(header.numFeatures, 1, CV_16S, (void*)(base + header.sectionOffsets[TEMPLATE_SECTION_FEATURE_Y]));
+    bank->feature_label = Mat(header.numFeatures, 1, CV_8U, (void*)(base + header.sectionOffsets[TEMPLATE_SECTION_FEATURE_LABEL]));
+  }
+  else
+  {
+    bank->feature_x = Mat::zeros(1, 1, CV_16S);
+    bank->feature_y = Mat::zeros(1, 1, CV_16S);
+    bank->feature_label = Mat::zeros(1, 1, CV_8U);
+  }
+  bank->file = file;
+
+  // The class table is read along with the class IDs. The template table and the features are
+  // not read here, so that loading does not depend on the number of templates: getTemplate()
+  // clamps the feature ranges and the matching skips the invalid features.
+  int num_pyramids = 0;
+  for (int c = 0; c < header.numClasses; ++c)
+  {
+    const int* range = bank->class_ranges.ptr<int>(c);
+    if (range[0] != num_pyramids || range[1] < 0 || range[1] > header.numPyramids - num_pyramids ||
+        (c > 0 && !(bank->class_ids[c - 1] < bank->class_ids[c])))
+      CV_Error(Error::StsError, "Corrupted class table in template file " + filename);
+    num_pyramids += range[1];
+  }
+  if (num_pyramids != header.numPyramids)
+    CV_Error(Error::StsError, "Corrupted class table in template file " + filename);
+
+  // The template pyramids are only unpacked when getTemplates(), the FileStorage output
+  // or adding templates needs them
+  class_templates.clear();
+  template_bank = bank;
+  templates_packed_only = true;
+}
+
 static const int T_DEFAULTS[] = {5, 8};
 
 Ptr<Detector> getDefaultLINE()
@@ -0,0 +1,124 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+// Read-only memory mapping of a binary file, used for the LINEMOD template files.
+
+#ifndef __OPENCV_RGBD_MAPPED_FILE_HPP__
+#define __OPENCV_RGBD_MAPPED_FILE_HPP__
+
+#include "opencv2/core.hpp"
+
+#if defined _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cv
+{
+namespace linemod
+{
+
+/**
+ * \brief Maps a whole file read-only. The owner keeps it alive as long as matrices
+ * point into the mapped data.
+ *
+ * \param [in] fileName Path of the file to map
+ * \param [in] what Description of the file used in error messages, e.g. "template file"
+ */
+class MappedFile
+{
+public:
+  MappedFile(const String& fileName, const String& what) : data(0), size(0)
+  {
+#if defined _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+    file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+      CV_Error(Error::StsError, "Cannot open " + what + " " + fileName);
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+      close();
+      CV_Error(Error::StsError, "Cannot read " + what + " " + fileName);
+    }
+    size = (size_t)fileSize.QuadPart;
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL)
+      data = (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      CV_Error(Error::StsError, "Cannot open " + what + " " + fileName);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close();
+      CV_Error(Error::StsError, "Cannot read " + what + " " + fileName);
+    }
+    size = (size_t)st.st_size;
+
+    void* ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED)
+      data = (const uchar*)ptr;
+#endif
+    if (!data)
+    {
+      close();
+      CV_Error(Error::StsError, "Cannot map " + what + " " + fileName);
+    }
+  }
+
+  ~MappedFile()
+  {
+    close();
+  }
+
+  const uchar* data;
+  size_t size;
+
+private:
+  void close()
+  {
+#if defined _WIN32
+    if (data)
+      UnmapViewOfFile(data);
+    if (mapping != NULL)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data)
+      munmap((void*)data, size);
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+#endif
+    data = 0;
+  }
+
+#if defined _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int fd;
+#endif
+
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+};
+
+} // namespace linemod
+} // namespace cv
+
+#endif
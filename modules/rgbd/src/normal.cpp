@@ -34,6 +34,7 @@
  */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -205,6 +206,228 @@ namespace rgbd
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+  /** Compute B = V / r for a row, B being 0 where r is NaN
+   * @return the number of pixels processed, the remaining ones have to be handled by the caller
+   */
+  template<typename T>
+  inline int
+  computeFALSBRow(const T*, const T* const*, T* const*, int)
+  {
+    return 0;
+  }
+
+  /** Compute n = M_inv * B for a row, M_inv being symmetric and stored as 6 planes
+   * @return the number of pixels processed, the remaining ones have to be handled by the caller
+   */
+  template<typename T>
+  inline int
+  computeFALSNormalsRow(const T*, const T* const*, const T* const*, T* const*, int)
+  {
+    return 0;
+  }
+
+  /** Compute the SRI normals of a row from the radial derivatives and the cached R_hat planes
+   * @return the number of pixels processed, the remaining ones have to be handled by the caller
+   */
+  template<typename T>
+  inline int
+  computeSRINormalsRow(const T*, const T*, const T*, const T* const*, T* const*, int)
+  {
+    return 0;
+  }
+
+#if CV_SIMD128
+  inline void
+  v_signNormal(const v_float32x4& r, v_float32x4& a, v_float32x4& b, v_float32x4& c)
+  {
+    v_float32x4 v_zero = v_setzero_f32();
+    v_float32x4 v_scale = v_setall_f32(1.f) / v_sqrt(a * a + b * b + c * c);
+    v_scale = v_select(c > v_zero, v_zero - v_scale, v_scale);
+    // r == r is false for NaN
+    v_float32x4 v_valid = r == r;
+    a = v_select(v_valid, a * v_scale, r);
+    b = v_select(v_valid, b * v_scale, r);
+    c = v_select(v_valid, c * v_scale, r);
+  }
+
+  inline int
+  computeFALSBRow(const float* r, const float* const* V, float* const* B, int cols)
+  {
+    int x = 0;
+    v_float32x4 v_zero = v_setzero_f32(), v_one = v_setall_f32(1.f);
+    for (; x <= cols - 4; x += 4)
+    {
+      v_float32x4 v_r = v_load(r + x);
+      v_float32x4 v_inv = v_select(v_r == v_r, v_one / v_r, v_zero);
+      v_store(B[0] + x, v_load(V[0] + x) * v_inv);
+      v_store(B[1] + x, v_load(V[1] + x) * v_inv);
+      v_store(B[2] + x, v_load(V[2] + x) * v_inv);
+    }
+    return x;
+  }
+
+  inline int
+  computeFALSNormalsRow(const float* r, const float* const* M, const float* const* B, float* const* n, int cols)
+  {
+    int x = 0;
+    for (; x <= cols - 4; x += 4)
+    {
+      v_float32x4 b0 = v_load(B[0] + x), b1 = v_load(B[1] + x), b2 = v_load(B[2] + x);
+      v_float32x4 m00 = v_load(M[0] + x), m01 = v_load(M[1] + x), m02 = v_load(M[2] + x);
+      v_float32x4 m11 = v_load(M[3] + x), m12 = v_load(M[4] + x), m22 = v_load(M[5] + x);
+      v_float32x4 n0 = m00 * b0 + m01 * b1 + m02 * b2;
+      v_float32x4 n1 = m01 * b0 + m11 * b1 + m12 * b2;
+      v_float32x4 n2 = m02 * b0 + m12 * b1 + m22 * b2;
+      v_signNormal(v_load(r + x), n0, n1, n2);
+      v_store(n[0] + x, n0);
+      v_store(n[1] + x, n1);
+      v_store(n[2] + x, n2);
+    }
+    return x;
+  }
+
+  inline int
+  computeSRINormalsRow(const float* r, const float* r_theta, const float* r_phi, const float* const* R,
+                       float* const* n, int cols)
+  {
+    int x = 0;
+    for (; x <= cols - 4; x += 4)
+    {
+      v_float32x4 v_r = v_load(r + x);
+      v_float32x4 r_theta_over_r = v_load(r_theta + x) / v_r;
+      v_float32x4 r_phi_over_r = v_load(r_phi + x) / v_r;
+      v_float32x4 n0 = v_load(R[0] + x) + v_load(R[1] + x) * r_theta_over_r + v_load(R[2] + x) * r_phi_over_r;
+      v_float32x4 n1 = v_load(R[3] + x) + v_load(R[4] + x) * r_phi_over_r;
+      v_float32x4 n2 = v_load(R[5] + x) + v_load(R[6] + x) * r_theta_over_r + v_load(R[7] + x) * r_phi_over_r;
+      v_signNormal(v_r, n0, n1, n2);
+      v_store(n[0] + x, n0);
+      v_store(n[1] + x, n1);
+      v_store(n[2] + x, n2);
+    }
+    return x;
+  }
+#endif
+
+  /** Scalar version of the above, for one pixel
+   */
+  template<typename T>
+  inline void
+  signNormal(T r, T a, T b, T c, T* const* n, int x)
+  {
+    if (cvIsNaN(r))
+    {
+      n[0][x] = n[1][x] = n[2][x] = r;
+      return;
+    }
+    T scale = 1 / std::sqrt(a * a + b * b + c * c);
+    if (c > 0)
+      scale = -scale;
+    n[0][x] = a * scale;
+    n[1][x] = b * scale;
+    n[2][x] = c * scale;
+  }
+
+  /** Interleave a row of normals stored as three planes
+   */
+  template<typename T>
+  inline void
+  mergeNormalsRow(T* const* n, Vec<T, 3>* normal, int cols)
+  {
+    for (int x = 0; x < cols; ++x)
+      normal[x] = Vec<T, 3>(n[0][x], n[1][x], n[2][x]);
+  }
+
+  /** Compute B = V / r for a range of rows
+   */
+  template<typename T>
+  class FALSBInvoker: public ParallelLoopBody
+  {
+  public:
+    FALSBInvoker(const Mat& r, const Mat_<T>* V, Mat_<T>* B)
+        :
+          r_(r),
+          V_(V),
+          B_(B)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      const int cols = r_.cols;
+      for (int y = range.start; y < range.end; ++y)
+      {
+        const T* r = r_.ptr<T>(y);
+        const T* V[3] = { V_[0][y], V_[1][y], V_[2][y] };
+        T* B[3] = { B_[0][y], B_[1][y], B_[2][y] };
+
+        for (int x = computeFALSBRow(r, V, B, cols); x < cols; ++x)
+        {
+          T inv = cvIsNaN(r[x]) ? T(0) : 1 / r[x];
+          B[0][x] = V[0][x] * inv;
+          B[1][x] = V[1][x] * inv;
+          B[2][x] = V[2][x] * inv;
+        }
+      }
+    }
+
+  private:
+    const Mat& r_;
+    const Mat_<T>* V_;
+    Mat_<T>* B_;
+
+    FALSBInvoker& operator=(const FALSBInvoker&);
+  };
+
+  /** Compute the FALS normals M_inv * B for a range of rows
+   */
+  template<typename T>
+  class FALSNormalsInvoker: public ParallelLoopBody
+  {
+  public:
+    FALSNormalsInvoker(const Mat& r, const Mat_<T>* M_inv, const Mat_<T>* B, Mat& normals)
+        :
+          r_(r),
+          M_inv_(M_inv),
+          B_(B),
+          normals_(normals)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      const int cols = r_.cols;
+      AutoBuffer<T> _buffer(cols * 3);
+      T* buffer = _buffer;
+      T* n[3] = { buffer, buffer + cols, buffer + 2 * cols };
+
+      for (int y = range.start; y < range.end; ++y)
+      {
+        const T* r = r_.ptr<T>(y);
+        const T* M[6];
+        for (int i = 0; i < 6; ++i)
+          M[i] = M_inv_[i][y];
+        const T* B[3] = { B_[0][y], B_[1][y], B_[2][y] };
+
+        for (int x = computeFALSNormalsRow(r, M, B, n, cols); x < cols; ++x)
+          signNormal(r[x], M[0][x] * B[0][x] + M[1][x] * B[1][x] + M[2][x] * B[2][x],
+                     M[1][x] * B[0][x] + M[3][x] * B[1][x] + M[4][x] * B[2][x],
+                     M[2][x] * B[0][x] + M[4][x] * B[1][x] + M[5][x] * B[2][x], n, x);
+
+        mergeNormalsRow(n, normals_.ptr<Vec<T, 3> >(y), cols);
+      }
+    }
+
+  private:
+    const Mat& r_;
+    const Mat_<T>* M_inv_;
+    const Mat_<T>* B_;
+    Mat& normals_;
+
+    FALSNormalsInvoker& operator=(const FALSNormalsInvoker&);
+  };
+
   /** Given a set of 3d points in a depth image, compute the normals at each point
    * using the FALS method described in
    * ``Fast and Accurate Computation of Surface Normals from Range Images``
@@ -215,8 +438,6 @@ namespace rgbd
   {
   public:
     typedef Matx<T, 3, 3> Mat33T;
-    typedef Vec<T, 9> Vec9T;
-    typedef Vec<T, 3> Vec3T;
 
     FALS(int rows, int cols, int window_size, int depth, const Mat &K, RgbdNormals::RGBD_NORMALS_METHOD method)
         :
@@ -237,35 +458,34 @@ namespace rgbd
       computeThetaPhi<T>(rows_, cols_, K_, cos_theta, sin_theta, cos_phi, sin_phi);
 
       // Compute all the v_i for every points
-      std::vector<Mat> channels(3);
-      channels[0] = sin_theta.mul(cos_phi);
-      channels[1] = sin_phi;
-      channels[2] = cos_theta.mul(cos_phi);
-      merge(channels, V_);
-
-      // Compute M
-      Mat_<Vec9T> M(rows_, cols_);
-      Mat33T VVt;
-      const Vec3T * vec = V_[0];
-      Vec9T * M_ptr = M[0], *M_ptr_end = M_ptr + rows_ * cols_;
-      for (; M_ptr != M_ptr_end; ++vec, ++M_ptr)
+      V_[0] = sin_theta.mul(cos_phi);
+      V_[1] = sin_phi;
+      V_[2] = cos_theta.mul(cos_phi);
+
+      // Compute M as the sum of the v_i * v_i^t over the window. It is symmetric so only
+      // the upper triangle is kept, one plane per coefficient
+      static const int row_index[6] = { 0, 0, 0, 1, 1, 2 }, col_index[6] = { 0, 1, 2, 1, 2, 2 };
+      Mat_<T> M[6];
+      for (int i = 0; i < 6; ++i)
       {
-        VVt = (*vec) * vec->t();
-        *M_ptr = Vec9T(VVt.val);
+        M[i] = V_[row_index[i]].mul(V_[col_index[i]]);
+        boxFilter(M[i], M[i], M[i].depth(), Size(window_size_, window_size_), Point(-1, -1), false);
       }
 
-      boxFilter(M, M, M.depth(), Size(window_size_, window_size_), Point(-1, -1), false);
-
       // Compute M's inverse
-      Mat33T M_inv;
-      M_inv_.create(rows_, cols_);
-      Vec9T * M_inv_ptr = M_inv_[0];
-      for (M_ptr = &M(0); M_ptr != M_ptr_end; ++M_inv_ptr, ++M_ptr)
-      {
-        // We have a semi-definite matrix
-        invert(Mat33T(M_ptr->val), M_inv, DECOMP_CHOLESKY);
-        *M_inv_ptr = Vec9T(M_inv.val);
-      }
+      Mat33T M_mat, M_inv;
+      for (int i = 0; i < 6; ++i)
+        M_inv_[i].create(rows_, cols_);
+      for (int y = 0; y < rows_; ++y)
+        for (int x = 0; x < cols_; ++x)
+        {
+          for (int i = 0; i < 6; ++i)
+            M_mat(row_index[i], col_index[i]) = M_mat(col_index[i], row_index[i]) = M[i](y, x);
+          // We have a semi-definite matrix
+          invert(M_mat, M_inv, DECOMP_CHOLESKY);
+          for (int i = 0; i < 6; ++i)
+            M_inv_[i](y, x) = M_inv(row_index[i], col_index[i]);
+        }
     }
 
     /** Compute the normals
@@ -276,48 +496,24 @@ namespace rgbd
     compute(const Mat&, const Mat &r, Mat & normals) const
     {
       // Compute B
-      Mat_<Vec3T> B(rows_, cols_);
-
-      const T* row_r = r.ptr < T > (0), *row_r_end = row_r + rows_ * cols_;
-      const Vec3T *row_V = V_[0];
-      Vec3T *row_B = B[0];
-      for (; row_r != row_r_end; ++row_r, ++row_B, ++row_V)
-      {
-        if (cvIsNaN(*row_r))
-          *row_B = Vec3T();
-        else
-          *row_B = (*row_V) / (*row_r);
-      }
+      Mat_<T> B[3];
+      for (int i = 0; i < 3; ++i)
+        B[i].create(rows_, cols_);
+      parallel_for_(Range(0, rows_), FALSBInvoker<T>(r, V_, B));
 
       // Apply a box filter to B
-      boxFilter(B, B, B.depth(), Size(window_size_, window_size_), Point(-1, -1), false);
+      for (int i = 0; i < 3; ++i)
+        boxFilter(B[i], B[i], B[i].depth(), Size(window_size_, window_size_), Point(-1, -1), false);
 
       // compute the Minv*B products
-      row_r = r.ptr < T > (0);
-      const Vec3T * B_vec = B[0];
-      const Mat33T * M_inv = reinterpret_cast<const Mat33T *>(M_inv_.ptr(0));
-      Vec3T *normal = normals.ptr<Vec3T>(0);
-      for (; row_r != row_r_end; ++row_r, ++B_vec, ++normal, ++M_inv)
-        if (cvIsNaN(*row_r))
-        {
-          (*normal)[0] = *row_r;
-          (*normal)[1] = *row_r;
-          (*normal)[2] = *row_r;
-        }
-        else
-        {
-            Mat33T Mr = *M_inv;
-            Vec3T Br = *B_vec;
-            Vec3T MBr(Mr(0, 0) * Br[0] + Mr(0, 1)*Br[1] + Mr(0, 2)*Br[2],
-                      Mr(1, 0) * Br[0] + Mr(1, 1)*Br[1] + Mr(1, 2)*Br[2],
-                      Mr(2, 0) * Br[0] + Mr(2, 1)*Br[1] + Mr(2, 2)*Br[2]);
-           signNormal(MBr, *normal);
-        }
+      parallel_for_(Range(0, rows_), FALSNormalsInvoker<T>(r, M_inv_, B, normals));
     }
 
   private:
-    Mat_<Vec3T> V_;
-    Mat_<Vec9T> M_inv_;
+    /** The v_i, one plane per coordinate */
+    Mat_<T> V_[3];
+    /** The upper triangle of M's inverse, one plane per coefficient */
+    Mat_<T> M_inv_[6];
   };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -492,6 +688,91 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+  /** Compute the SRI normals for a range of rows
+   */
+  template<typename T>
+  class SRINormalsInvoker: public ParallelLoopBody
+  {
+  public:
+    SRINormalsInvoker(const Mat_<T>& r, const Mat_<T>& r_theta, const Mat_<T>& r_phi, const Mat_<T>* R_hat,
+                      Mat& normals)
+        :
+          r_(r),
+          r_theta_(r_theta),
+          r_phi_(r_phi),
+          R_hat_(R_hat),
+          normals_(normals)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      const int cols = r_.cols;
+      AutoBuffer<T> _buffer(cols * 3);
+      T* buffer = _buffer;
+      T* n[3] = { buffer, buffer + cols, buffer + 2 * cols };
+
+      for (int y = range.start; y < range.end; ++y)
+      {
+        const T* r = r_[y], *r_theta = r_theta_[y], *r_phi = r_phi_[y];
+        const T* R[8];
+        for (int i = 0; i < 8; ++i)
+          R[i] = R_hat_[i][y];
+
+        for (int x = computeSRINormalsRow(r, r_theta, r_phi, R, n, cols); x < cols; ++x)
+        {
+          T r_theta_over_r = r_theta[x] / r[x];
+          T r_phi_over_r = r_phi[x] / r[x];
+          // R(1,1) is 0
+          signNormal(r[x], R[0][x] + R[1][x] * r_theta_over_r + R[2][x] * r_phi_over_r,
+                     R[3][x] + R[4][x] * r_phi_over_r,
+                     R[5][x] + R[6][x] * r_theta_over_r + R[7][x] * r_phi_over_r, n, x);
+        }
+
+        mergeNormalsRow(n, normals_.ptr<Vec<T, 3> >(y), cols);
+      }
+    }
+
+  private:
+    const Mat_<T>& r_;
+    const Mat_<T>& r_theta_;
+    const Mat_<T>& r_phi_;
+    const Mat_<T>* R_hat_;
+    Mat& normals_;
+
+    SRINormalsInvoker& operator=(const SRINormalsInvoker&);
+  };
+
+  /** Normalize the normals of a range of rows in place and make them point towards the camera
+   */
+  template<typename T>
+  class SignNormalsInvoker: public ParallelLoopBody
+  {
+  public:
+    SignNormalsInvoker(Mat& normals)
+        :
+          normals_(normals)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      for (int y = range.start; y < range.end; ++y)
+      {
+        Vec<T, 3>* normal = normals_.ptr<Vec<T, 3> >(y), *normal_end = normal + normals_.cols;
+        for (; normal != normal_end; ++normal)
+          signNormal((*normal)[0], (*normal)[1], (*normal)[2], *normal);
+      }
+    }
+
+  private:
+    Mat& normals_;
+
+    SignNormalsInvoker& operator=(const SignNormalsInvoker&);
+  };
+
   /** Given a set of 3d points in a depth image, compute the normals at each point
    * using the SRI method described in
    * ``Fast and Accurate Computation of Surface Normals from Range Images``
@@ -501,8 +782,6 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
   class SRI: public RgbdNormalsImpl
   {
   public:
-    typedef Matx<T, 3, 3> Mat33T;
-    typedef Vec<T, 9> Vec9T;
     typedef Vec<T, 3> Vec3T;
 
     SRI(int rows, int cols, int window_size, int depth, const Mat &K, RgbdNormals::RGBD_NORMALS_METHOD method)
@@ -530,31 +809,34 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
       float min_phi = (float)std::asin(sin_phi(0, cols_/2-1)), max_phi = (float)std::asin(sin_phi(rows_ - 1, cols_/2-1));
 
       std::vector<Point3f> points3d(cols_ * rows_);
-      R_hat_.create(rows_, cols_);
+      for (int i = 0; i < 8; ++i)
+        R_hat_[i].create(rows_, cols_);
       phi_step_ = float(max_phi - min_phi) / (rows_ - 1);
       theta_step_ = float(max_theta - min_theta) / (cols_ - 1);
       for (int phi_int = 0, k = 0; phi_int < rows_; ++phi_int)
       {
         float phi = min_phi + phi_int * phi_step_;
+        T cp = std::cos(phi), sp = std::sin(phi);
         for (int theta_int = 0; theta_int < cols_; ++theta_int, ++k)
         {
           float theta = min_theta + theta_int * theta_step_;
+          T ct = std::cos(theta), st = std::sin(theta);
           // Store the 3d point to project it later
-          points3d[k] = Point3f(std::sin(theta) * std::cos(phi), std::sin(phi), std::cos(theta) * std::cos(phi));
-
-          // Cache the rotation matrix and negate it
-          Mat_<T> mat =
-              (Mat_ < T > (3, 3) << 0, 1, 0, 0, 0, 1, 1, 0, 0) * ((Mat_ < T > (3, 3) << std::cos(theta), -std::sin(
-                  theta), 0, std::sin(theta), std::cos(theta), 0, 0, 0, 1))
-              * ((Mat_ < T > (3, 3) << std::cos(phi), 0, -std::sin(phi), 0, 1, 0, std::sin(phi), 0, std::cos(phi)));
-          for (unsigned char i = 0; i < 3; ++i)
-            mat(i, 1) = mat(i, 1) / std::cos(phi);
-          // The second part of the matrix is never explained in the paper ... but look at the wikipedia normal article
-          mat(0, 0) = mat(0, 0) - 2 * std::cos(phi) * std::sin(theta);
-          mat(1, 0) = mat(1, 0) - 2 * std::sin(phi);
-          mat(2, 0) = mat(2, 0) - 2 * std::cos(phi) * std::cos(theta);
-
-          R_hat_(phi_int, theta_int) = Vec9T((T*) (mat.data));
+          points3d[k] = Point3f((float)(st * cp), (float)sp, (float)(ct * cp));
+
+          // Cache the rotation matrix and negate it: it is
+          // (0, 1, 0; 0, 0, 1; 1, 0, 0) * R_z(theta) * R_y(phi), with its second column divided by cos(phi)
+          // The second part of the matrix is never explained in the paper ... but look at the wikipedia normal article:
+          // 2 * (cos(phi) * sin(theta), sin(phi), cos(phi) * cos(theta)) is removed from its first column
+          // R(1,1) is 0 and is not stored
+          R_hat_[0](phi_int, theta_int) = -st * cp;
+          R_hat_[1](phi_int, theta_int) = ct / cp;
+          R_hat_[2](phi_int, theta_int) = -st * sp;
+          R_hat_[3](phi_int, theta_int) = -sp;
+          R_hat_[4](phi_int, theta_int) = cp;
+          R_hat_[5](phi_int, theta_int) = -ct * cp;
+          R_hat_[6](phi_int, theta_int) = -st / cp;
+          R_hat_[7](phi_int, theta_int) = -ct * sp;
         }
       }
 
@@ -621,41 +903,15 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
       sepFilter2D(r, r_phi, r.depth(), kx_dy_, ky_dy_);
 
       // Fill the result matrix
-      Mat_<Vec3T> normals(rows_, cols_);
-
-      const T* r_theta_ptr = r_theta[0], *r_theta_ptr_end = r_theta_ptr + rows_ * cols_;
-      const T* r_phi_ptr = r_phi[0];
-      const Mat33T * R = reinterpret_cast<const Mat33T *>(R_hat_[0]);
-      const T* r_ptr = r[0];
-      Vec3T * normal = normals[0];
-      for (; r_theta_ptr != r_theta_ptr_end; ++r_theta_ptr, ++r_phi_ptr, ++R, ++r_ptr, ++normal)
-      {
-        if (cvIsNaN(*r_ptr))
-        {
-          (*normal)[0] = *r_ptr;
-          (*normal)[1] = *r_ptr;
-          (*normal)[2] = *r_ptr;
-        }
-        else
-        {
-          T r_theta_over_r = (*r_theta_ptr) / (*r_ptr);
-          T r_phi_over_r = (*r_phi_ptr) / (*r_ptr);
-          // R(1,1) is 0
-          signNormal((*R)(0, 0) + (*R)(0, 1) * r_theta_over_r + (*R)(0, 2) * r_phi_over_r,
-                     (*R)(1, 0) + (*R)(1, 2) * r_phi_over_r,
-                     (*R)(2, 0) + (*R)(2, 1) * r_theta_over_r + (*R)(2, 2) * r_phi_over_r, *normal);
-        }
-      }
+      Mat normals(rows_, cols_, CV_MAKETYPE(depth_, 3));
+      parallel_for_(Range(0, rows_), SRINormalsInvoker<T>(r, r_theta, r_phi, R_hat_, normals));
 
       remap(normals, normals_out, invxy_, invfxy_, INTER_LINEAR);
-      normal = normals_out.ptr<Vec3T>(0);
-      Vec3T * normal_end = normal + rows_ * cols_;
-      for (; normal != normal_end; ++normal)
-        signNormal((*normal)[0], (*normal)[1], (*normal)[2], *normal);
+      parallel_for_(Range(0, rows_), SignNormalsInvoker<T>(normals_out));
     }
   private:
-    /** Stores R */
-    Mat_<Vec9T> R_hat_;
+    /** Stores R, one plane per coefficient */
+    Mat_<T> R_hat_[8];
     float phi_step_, theta_step_;
 
     /** Derivative kernels */
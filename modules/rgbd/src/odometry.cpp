@@ -451,6 +451,86 @@ void computeProjectiveMatrix(const Mat& ksi, Mat& Rt)
 #endif
 }
 
+// Projects the selected pixels of depth1 to frame 0 for a range of rows of depth1.
+// For every pixel, targets gets the linear index of the pixel of frame 0 it corresponds to
+// (or -1 if the projection fails the validity tests) and transformedDepth its depth in frame 0.
+class CorrespsProjectionInvoker : public ParallelLoopBody
+{
+public:
+    CorrespsProjectionInvoker(const float* _KRK_inv0_u1, const float* _KRK_inv1_v1_plus_KRK_inv2,
+                              const float* _KRK_inv3_u1, const float* _KRK_inv4_v1_plus_KRK_inv5,
+                              const float* _KRK_inv6_u1, const float* _KRK_inv7_v1_plus_KRK_inv8,
+                              const double* _Kt_ptr,
+                              const Mat& _depth0, const Mat& _validMask0,
+                              const Mat& _depth1, const Mat& _selectMask1, float _maxDepthDiff,
+                              Mat& _targets, Mat& _transformedDepth) :
+        KRK_inv0_u1(_KRK_inv0_u1), KRK_inv1_v1_plus_KRK_inv2(_KRK_inv1_v1_plus_KRK_inv2),
+        KRK_inv3_u1(_KRK_inv3_u1), KRK_inv4_v1_plus_KRK_inv5(_KRK_inv4_v1_plus_KRK_inv5),
+        KRK_inv6_u1(_KRK_inv6_u1), KRK_inv7_v1_plus_KRK_inv8(_KRK_inv7_v1_plus_KRK_inv8),
+        Kt_ptr(_Kt_ptr),
+        depth0(_depth0), validMask0(_validMask0),
+        depth1(_depth1), selectMask1(_selectMask1), maxDepthDiff(_maxDepthDiff),
+        targets(_targets), transformedDepth(_transformedDepth)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const Rect r(0, 0, depth1.cols, depth1.rows);
+        for(int v1 = range.start; v1 < range.end; v1++)
+        {
+            const float *depth1_row = depth1.ptr<float>(v1);
+            const uchar *mask1_row = selectMask1.ptr<uchar>(v1);
+            int *targets_row = targets.ptr<int>(v1);
+            float *transformed_row = transformedDepth.ptr<float>(v1);
+            for(int u1 = 0; u1 < depth1.cols; u1++)
+            {
+                targets_row[u1] = -1;
+
+                float d1 = depth1_row[u1];
+                if(!mask1_row[u1])
+                    continue;
+
+                CV_DbgAssert(!cvIsNaN(d1));
+                float transformed_d1 = static_cast<float>(d1 * (KRK_inv6_u1[u1] + KRK_inv7_v1_plus_KRK_inv8[v1]) +
+                                                          Kt_ptr[2]);
+                if(transformed_d1 <= 0)
+                    continue;
+
+                float transformed_d1_inv = 1.f / transformed_d1;
+                int u0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv0_u1[u1] + KRK_inv1_v1_plus_KRK_inv2[v1]) +
+                                                       Kt_ptr[0]));
+                int v0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv3_u1[u1] + KRK_inv4_v1_plus_KRK_inv5[v1]) +
+                                                       Kt_ptr[1]));
+                if(!r.contains(Point(u0,v0)))
+                    continue;
+
+                float d0 = depth0.at<float>(v0,u0);
+                if(validMask0.at<uchar>(v0, u0) && std::abs(transformed_d1 - d0) <= maxDepthDiff)
+                {
+                    CV_DbgAssert(!cvIsNaN(d0));
+                    targets_row[u1] = v0 * depth1.cols + u0;
+                    transformed_row[u1] = transformed_d1;
+                }
+            }
+        }
+    }
+
+private:
+    const float *KRK_inv0_u1, *KRK_inv1_v1_plus_KRK_inv2;
+    const float *KRK_inv3_u1, *KRK_inv4_v1_plus_KRK_inv5;
+    const float *KRK_inv6_u1, *KRK_inv7_v1_plus_KRK_inv8;
+    const double *Kt_ptr;
+    const Mat& depth0;
+    const Mat& validMask0;
+    const Mat& depth1;
+    const Mat& selectMask1;
+    float maxDepthDiff;
+    Mat& targets;
+    Mat& transformedDepth;
+
+    CorrespsProjectionInvoker& operator=(const CorrespsProjectionInvoker&);
+};
+
 static
 void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
                      const Mat& depth0, const Mat& validMask0,
@@ -461,9 +541,6 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
     CV_Assert(K_inv.type() == CV_64FC1);
     CV_Assert(Rt.type() == CV_64FC1);
 
-    Mat corresps(depth1.size(), CV_16SC2, Scalar::all(-1));
-
-    Rect r(0, 0, depth1.cols, depth1.rows);
     Mat Kt = Rt(Rect(3,0,1,3)).clone();
     Kt = K * Kt;
     const double * Kt_ptr = Kt.ptr<const double>();
@@ -495,52 +572,44 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
         }
     }
 
+    // Project the selected pixels of depth1 to frame 0
+    Mat targets(depth1.size(), CV_32SC1), transformedDepth(depth1.size(), CV_32FC1);
+    parallel_for_(Range(0, depth1.rows),
+                  CorrespsProjectionInvoker(KRK_inv0_u1, KRK_inv1_v1_plus_KRK_inv2,
+                                            KRK_inv3_u1, KRK_inv4_v1_plus_KRK_inv5,
+                                            KRK_inv6_u1, KRK_inv7_v1_plus_KRK_inv8, Kt_ptr,
+                                            depth0, validMask0, depth1, selectMask1, maxDepthDiff,
+                                            targets, transformedDepth));
+
+    // Every pixel of frame 0 keeps its nearest candidate. The candidates are visited in the scan order
+    // of depth1, so that the ties are broken as in a serial search
+    Mat corresps(depth1.size(), CV_16SC2, Scalar::all(-1));
+    Mat correspsDepth(depth1.size(), CV_32FC1);
+    Vec2s* corresps_ptr0 = corresps.ptr<Vec2s>();
+    float* correspsDepth_ptr = correspsDepth.ptr<float>();
+
     int correspCount = 0;
     for(int v1 = 0; v1 < depth1.rows; v1++)
     {
-        const float *depth1_row = depth1.ptr<float>(v1);
-        const uchar *mask1_row = selectMask1.ptr<uchar>(v1);
+        const int *targets_row = targets.ptr<int>(v1);
+        const float *transformed_row = transformedDepth.ptr<float>(v1);
         for(int u1 = 0; u1 < depth1.cols; u1++)
         {
-            float d1 = depth1_row[u1];
-            if(mask1_row[u1])
-            {
-                CV_DbgAssert(!cvIsNaN(d1));
-                float transformed_d1 = static_cast<float>(d1 * (KRK_inv6_u1[u1] + KRK_inv7_v1_plus_KRK_inv8[v1]) +
-                                                          Kt_ptr[2]);
-                if(transformed_d1 > 0)
-                {
-                    float transformed_d1_inv = 1.f / transformed_d1;
-                    int u0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv0_u1[u1] + KRK_inv1_v1_plus_KRK_inv2[v1]) +
-                                                           Kt_ptr[0]));
-                    int v0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv3_u1[u1] + KRK_inv4_v1_plus_KRK_inv5[v1]) +
-                                                           Kt_ptr[1]));
+            int target = targets_row[u1];
+            if(target < 0)
+                continue;
 
-                    if(r.contains(Point(u0,v0)))
-                    {
-                        float d0 = depth0.at<float>(v0,u0);
-                        if(validMask0.at<uchar>(v0, u0) && std::abs(transformed_d1 - d0) <= maxDepthDiff)
-                        {
-                            CV_DbgAssert(!cvIsNaN(d0));
-                            Vec2s& c = corresps.at<Vec2s>(v0,u0);
-                            if(c[0] != -1)
-                            {
-                                int exist_u1 = c[0], exist_v1 = c[1];
-
-                                float exist_d1 = (float)(depth1.at<float>(exist_v1,exist_u1) *
-                                    (KRK_inv6_u1[exist_u1] + KRK_inv7_v1_plus_KRK_inv8[exist_v1]) + Kt_ptr[2]);
-
-                                if(transformed_d1 > exist_d1)
-                                    continue;
-                            }
-                            else
-                                correspCount++;
-
-                            c = Vec2s((short)u1, (short)v1);
-                        }
-                    }
-                }
+            Vec2s& c = corresps_ptr0[target];
+            if(c[0] != -1)
+            {
+                if(transformed_row[u1] > correspsDepth_ptr[target])
+                    continue;
             }
+            else
+                correspCount++;
+
+            c = Vec2s((short)u1, (short)v1);
+            correspsDepth_ptr[target] = transformed_row[u1];
         }
     }
 
@@ -631,17 +700,178 @@ void calcICPEquationCoeffsTranslation(double* C, const Point3f& /*p0*/, const Ve
 typedef
 void (*CalcICPEquationCoeffsPtr)(double*, const Point3f&, const Vec3f&);
 
+// The normal equations are accumulated over blocks of correspondences of a fixed size. The blocks are
+// processed in parallel and their partial sums are added up in the block order afterwards, so that the
+// result does not depend on the number of threads.
+const int lsmBlockSize = 4096;
+
+static inline
+int getLsmBlockCount(int correspsCount)
+{
+    return (correspsCount + lsmBlockSize - 1) / lsmBlockSize;
+}
+
+// Adds A^t*A and A^t*b of one equation to the sums, A^t*A being stored as its upper triangle, row by row
+static inline
+void accumulateLsmEquation(const double* A, double b, int transformDim, double* AtA, double* AtB)
+{
+    for(int y = 0, i = 0; y < transformDim; y++)
+    {
+        const double Ay = A[y];
+        for(int x = y; x < transformDim; x++, i++)
+            AtA[i] += Ay * A[x];
+
+        AtB[y] += Ay * b;
+    }
+}
+
 static
-void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
-               const Mat& image1, const Mat& dI_dx1, const Mat& dI_dy1,
-               const Mat& corresps, double fx, double fy, double sobelScaleIn,
-               Mat& AtA, Mat& AtB, CalcRgbdEquationCoeffsPtr func, int transformDim)
+void reduceLsmBlocks(const Mat& blockSums, int transformDim, Mat& AtA, Mat& AtB)
 {
     AtA = Mat(transformDim, transformDim, CV_64FC1, Scalar(0));
     AtB = Mat(transformDim, 1, CV_64FC1, Scalar(0));
     double* AtB_ptr = AtB.ptr<double>();
+    const int triangleSize = transformDim * (transformDim + 1) / 2;
+
+    for(int block = 0; block < blockSums.rows; block++)
+    {
+        const double* sums = blockSums.ptr<double>(block);
+        for(int y = 0, i = 0; y < transformDim; y++)
+        {
+            double* AtA_ptr = AtA.ptr<double>(y);
+            for(int x = y; x < transformDim; x++, i++)
+                AtA_ptr[x] += sums[i];
+
+            AtB_ptr[y] += sums[triangleSize + y];
+        }
+    }
+
+    for(int y = 0; y < transformDim; y++)
+        for(int x = y+1; x < transformDim; x++)
+            AtA.at<double>(x,y) = AtA.at<double>(y,x);
+}
+
+static inline
+Point3f transformPoint(const Point3f& p, const double* Rt_ptr)
+{
+    Point3f tp;
+    tp.x = (float)(p.x * Rt_ptr[0] + p.y * Rt_ptr[1] + p.z * Rt_ptr[2] + Rt_ptr[3]);
+    tp.y = (float)(p.x * Rt_ptr[4] + p.y * Rt_ptr[5] + p.z * Rt_ptr[6] + Rt_ptr[7]);
+    tp.z = (float)(p.x * Rt_ptr[8] + p.y * Rt_ptr[9] + p.z * Rt_ptr[10] + Rt_ptr[11]);
+    return tp;
+}
+
+// Computes the intensity differences for a range of blocks of correspondences,
+// and the sum of their squares for every block
+class RgbdResidualsInvoker : public ParallelLoopBody
+{
+public:
+    RgbdResidualsInvoker(const Mat& _image0, const Mat& _image1, const Mat& _corresps,
+                         float* _diffs, double* _blockSigmas) :
+        image0(_image0), image1(_image1), corresps(_corresps),
+        diffs(_diffs), blockSigmas(_blockSigmas)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+        for(int block = range.start; block < range.end; block++)
+        {
+            const int end = std::min((block + 1) * lsmBlockSize, corresps.rows);
+            double sigma = 0;
+            for(int correspIndex = block * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                diffs[correspIndex] = static_cast<float>(static_cast<int>(image0.at<uchar>(v0,u0)) -
+                                                         static_cast<int>(image1.at<uchar>(v1,u1)));
+                sigma += diffs[correspIndex] * diffs[correspIndex];
+            }
+            blockSigmas[block] = sigma;
+        }
+    }
+
+private:
+    const Mat& image0;
+    const Mat& image1;
+    const Mat& corresps;
+    float* diffs;
+    double* blockSigmas;
+
+    RgbdResidualsInvoker& operator=(const RgbdResidualsInvoker&);
+};
+
+// Accumulates the photometric equations of a range of blocks of correspondences
+class RgbdLsmInvoker : public ParallelLoopBody
+{
+public:
+    RgbdLsmInvoker(const Mat& _cloud0, const double* _Rt_ptr, const Mat& _dI_dx1, const Mat& _dI_dy1,
+                   const Mat& _corresps, const float* _diffs, double _sigma,
+                   double _fx, double _fy, double _sobelScale,
+                   CalcRgbdEquationCoeffsPtr _func, int _transformDim, Mat& _blockSums) :
+        cloud0(_cloud0), Rt_ptr(_Rt_ptr), dI_dx1(_dI_dx1), dI_dy1(_dI_dy1),
+        corresps(_corresps), diffs(_diffs), sigma(_sigma),
+        fx(_fx), fy(_fy), sobelScale(_sobelScale),
+        func(_func), transformDim(_transformDim), blockSums(_blockSums)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+        const int triangleSize = transformDim * (transformDim + 1) / 2;
+        double A_ptr[6];
+
+        for(int block = range.start; block < range.end; block++)
+        {
+            double* sums = blockSums.ptr<double>(block);
+            const int end = std::min((block + 1) * lsmBlockSize, corresps.rows);
+            for(int correspIndex = block * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                double w = sigma + std::abs(diffs[correspIndex]);
+                w = w > DBL_EPSILON ? 1./w : 1.;
+
+                double w_sobelScale = w * sobelScale;
+
+                func(A_ptr,
+                     w_sobelScale * dI_dx1.at<short int>(v1,u1),
+                     w_sobelScale * dI_dy1.at<short int>(v1,u1),
+                     transformPoint(cloud0.at<Point3f>(v0,u0), Rt_ptr), fx, fy);
+
+                accumulateLsmEquation(A_ptr, w * diffs[correspIndex], transformDim, sums, sums + triangleSize);
+            }
+        }
+    }
 
+private:
+    const Mat& cloud0;
+    const double* Rt_ptr;
+    const Mat& dI_dx1;
+    const Mat& dI_dy1;
+    const Mat& corresps;
+    const float* diffs;
+    double sigma;
+    double fx, fy, sobelScale;
+    CalcRgbdEquationCoeffsPtr func;
+    int transformDim;
+    Mat& blockSums;
+
+    RgbdLsmInvoker& operator=(const RgbdLsmInvoker&);
+};
+
+static
+void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
+               const Mat& image1, const Mat& dI_dx1, const Mat& dI_dy1,
+               const Mat& corresps, double fx, double fy, double sobelScaleIn,
+               Mat& AtA, Mat& AtB, CalcRgbdEquationCoeffsPtr func, int transformDim)
+{
     const int correspsCount = corresps.rows;
+    const int blockCount = getLsmBlockCount(correspsCount);
 
     CV_Assert(Rt.type() == CV_64FC1);
     const double * Rt_ptr = Rt.ptr<const double>();
@@ -649,60 +879,121 @@ void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
     AutoBuffer<float> diffs(correspsCount);
     float* diffs_ptr = diffs;
 
-    const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+    AutoBuffer<double> blockSigmas(blockCount);
+    double* blockSigmas_ptr = blockSigmas;
 
-    double sigma = 0;
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-         const Vec4i& c = corresps_ptr[correspIndex];
-         int u0 = c[0], v0 = c[1];
-         int u1 = c[2], v1 = c[3];
+    parallel_for_(Range(0, blockCount), RgbdResidualsInvoker(image0, image1, corresps, diffs_ptr, blockSigmas_ptr));
 
-         diffs_ptr[correspIndex] = static_cast<float>(static_cast<int>(image0.at<uchar>(v0,u0)) -
-                                                      static_cast<int>(image1.at<uchar>(v1,u1)));
-         sigma += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
-    }
+    double sigma = 0;
+    for(int block = 0; block < blockCount; block++)
+        sigma += blockSigmas_ptr[block];
     sigma = std::sqrt(sigma/correspsCount);
 
-    std::vector<double> A_buf(transformDim);
-    double* A_ptr = &A_buf[0];
+    Mat blockSums(blockCount, transformDim * (transformDim + 3) / 2, CV_64FC1, Scalar(0));
+    parallel_for_(Range(0, blockCount),
+                  RgbdLsmInvoker(cloud0, Rt_ptr, dI_dx1, dI_dy1, corresps, diffs_ptr, sigma,
+                                 fx, fy, sobelScaleIn, func, transformDim, blockSums));
+
+    reduceLsmBlocks(blockSums, transformDim, AtA, AtB);
+}
 
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
+// Computes the point-to-plane distances for a range of blocks of correspondences,
+// and the sum of their squares for every block
+class ICPResidualsInvoker : public ParallelLoopBody
+{
+public:
+    ICPResidualsInvoker(const Mat& _cloud0, const double* _Rt_ptr, const Mat& _cloud1, const Mat& _normals1,
+                        const Mat& _corresps, Point3f* _tps0, float* _diffs, double* _blockSigmas) :
+        cloud0(_cloud0), Rt_ptr(_Rt_ptr), cloud1(_cloud1), normals1(_normals1),
+        corresps(_corresps), tps0(_tps0), diffs(_diffs), blockSigmas(_blockSigmas)
+    {}
+
+    virtual void operator()(const Range& range) const
     {
-         const Vec4i& c = corresps_ptr[correspIndex];
-         int u0 = c[0], v0 = c[1];
-         int u1 = c[2], v1 = c[3];
+        const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+        for(int block = range.start; block < range.end; block++)
+        {
+            const int end = std::min((block + 1) * lsmBlockSize, corresps.rows);
+            double sigma = 0;
+            for(int correspIndex = block * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                Point3f tp0 = transformPoint(cloud0.at<Point3f>(v0,u0), Rt_ptr);
 
-         double w = sigma + std::abs(diffs_ptr[correspIndex]);
-         w = w > DBL_EPSILON ? 1./w : 1.;
+                Vec3f n1 = normals1.at<Vec3f>(v1, u1);
+                Point3f v = cloud1.at<Point3f>(v1,u1) - tp0;
 
-         double w_sobelScale = w * sobelScaleIn;
+                tps0[correspIndex] = tp0;
+                diffs[correspIndex] = n1[0] * v.x + n1[1] * v.y + n1[2] * v.z;
+                sigma += diffs[correspIndex] * diffs[correspIndex];
+            }
+            blockSigmas[block] = sigma;
+        }
+    }
 
-         const Point3f& p0 = cloud0.at<Point3f>(v0,u0);
-         Point3f tp0;
-         tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
-         tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
-         tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
+private:
+    const Mat& cloud0;
+    const double* Rt_ptr;
+    const Mat& cloud1;
+    const Mat& normals1;
+    const Mat& corresps;
+    Point3f* tps0;
+    float* diffs;
+    double* blockSigmas;
+
+    ICPResidualsInvoker& operator=(const ICPResidualsInvoker&);
+};
 
-         func(A_ptr,
-              w_sobelScale * dI_dx1.at<short int>(v1,u1),
-              w_sobelScale * dI_dy1.at<short int>(v1,u1),
-              tp0, fx, fy);
+// Accumulates the point-to-plane equations of a range of blocks of correspondences
+class ICPLsmInvoker : public ParallelLoopBody
+{
+public:
+    ICPLsmInvoker(const Mat& _normals1, const Mat& _corresps, const Point3f* _tps0, const float* _diffs,
+                  double _sigma, CalcICPEquationCoeffsPtr _func, int _transformDim, Mat& _blockSums) :
+        normals1(_normals1), corresps(_corresps), tps0(_tps0), diffs(_diffs),
+        sigma(_sigma), func(_func), transformDim(_transformDim), blockSums(_blockSums)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+        const int triangleSize = transformDim * (transformDim + 1) / 2;
+        double A_ptr[6];
 
-        for(int y = 0; y < transformDim; y++)
+        for(int block = range.start; block < range.end; block++)
         {
-            double* AtA_ptr = AtA.ptr<double>(y);
-            for(int x = y; x < transformDim; x++)
-                AtA_ptr[x] += A_ptr[y] * A_ptr[x];
+            double* sums = blockSums.ptr<double>(block);
+            const int end = std::min((block + 1) * lsmBlockSize, corresps.rows);
+            for(int correspIndex = block * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u1 = c[2], v1 = c[3];
+
+                double w = sigma + std::abs(diffs[correspIndex]);
+                w = w > DBL_EPSILON ? 1./w : 1.;
 
-            AtB_ptr[y] += A_ptr[y] * w * diffs_ptr[correspIndex];
+                func(A_ptr, tps0[correspIndex], normals1.at<Vec3f>(v1, u1) * w);
+
+                accumulateLsmEquation(A_ptr, w * diffs[correspIndex], transformDim, sums, sums + triangleSize);
+            }
         }
     }
 
-    for(int y = 0; y < transformDim; y++)
-        for(int x = y+1; x < transformDim; x++)
-            AtA.at<double>(x,y) = AtA.at<double>(y,x);
-}
+private:
+    const Mat& normals1;
+    const Mat& corresps;
+    const Point3f* tps0;
+    const float* diffs;
+    double sigma;
+    CalcICPEquationCoeffsPtr func;
+    int transformDim;
+    Mat& blockSums;
+
+    ICPLsmInvoker& operator=(const ICPLsmInvoker&);
+};
 
 static
 void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
@@ -710,11 +1001,8 @@ void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
                         const Mat& corresps,
                         Mat& AtA, Mat& AtB, CalcICPEquationCoeffsPtr func, int transformDim)
 {
-    AtA = Mat(transformDim, transformDim, CV_64FC1, Scalar(0));
-    AtB = Mat(transformDim, 1, CV_64FC1, Scalar(0));
-    double* AtB_ptr = AtB.ptr<double>();
-
     const int correspsCount = corresps.rows;
+    const int blockCount = getLsmBlockCount(correspsCount);
 
     CV_Assert(Rt.type() == CV_64FC1);
     const double * Rt_ptr = Rt.ptr<const double>();
@@ -725,56 +1013,22 @@ void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
     AutoBuffer<Point3f> transformedPoints0(correspsCount);
     Point3f * tps0_ptr = transformedPoints0;
 
-    const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
+    AutoBuffer<double> blockSigmas(blockCount);
+    double* blockSigmas_ptr = blockSigmas;
 
-    double sigma = 0;
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-        const Vec4i& c = corresps_ptr[correspIndex];
-        int u0 = c[0], v0 = c[1];
-        int u1 = c[2], v1 = c[3];
-
-        const Point3f& p0 = cloud0.at<Point3f>(v0,u0);
-        Point3f tp0;
-        tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
-        tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
-        tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
-
-        Vec3f n1 = normals1.at<Vec3f>(v1, u1);
-        Point3f v = cloud1.at<Point3f>(v1,u1) - tp0;
-
-        tps0_ptr[correspIndex] = tp0;
-        diffs_ptr[correspIndex] = n1[0] * v.x + n1[1] * v.y + n1[2] * v.z;
-        sigma += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
-    }
+    parallel_for_(Range(0, blockCount),
+                  ICPResidualsInvoker(cloud0, Rt_ptr, cloud1, normals1, corresps, tps0_ptr, diffs_ptr, blockSigmas_ptr));
 
+    double sigma = 0;
+    for(int block = 0; block < blockCount; block++)
+        sigma += blockSigmas_ptr[block];
     sigma = std::sqrt(sigma/correspsCount);
 
-    std::vector<double> A_buf(transformDim);
-    double* A_ptr = &A_buf[0];
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-        const Vec4i& c = corresps_ptr[correspIndex];
-        int u1 = c[2], v1 = c[3];
-
-        double w = sigma + std::abs(diffs_ptr[correspIndex]);
-        w = w > DBL_EPSILON ? 1./w : 1.;
-
-        func(A_ptr, tps0_ptr[correspIndex], normals1.at<Vec3f>(v1, u1) * w);
+    Mat blockSums(blockCount, transformDim * (transformDim + 3) / 2, CV_64FC1, Scalar(0));
+    parallel_for_(Range(0, blockCount),
+                  ICPLsmInvoker(normals1, corresps, tps0_ptr, diffs_ptr, sigma, func, transformDim, blockSums));
 
-        for(int y = 0; y < transformDim; y++)
-        {
-            double* AtA_ptr = AtA.ptr<double>(y);
-            for(int x = y; x < transformDim; x++)
-                AtA_ptr[x] += A_ptr[y] * A_ptr[x];
-
-            AtB_ptr[y] += A_ptr[y] * w * diffs_ptr[correspIndex];
-        }
-    }
-
-    for(int y = 0; y < transformDim; y++)
-        for(int x = y+1; x < transformDim; x++)
-            AtA.at<double>(x,y) = AtA.at<double>(y,x);
+    reduceLsmBlocks(blockSums, transformDim, AtA, AtB);
 }
 
 static
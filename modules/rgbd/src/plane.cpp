@@ -222,6 +222,17 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/** Outer product p * p.t() of a point, the per-point term of the second order moments
+ */
+static inline Matx33f
+pointOuterProduct(const Vec3f & p)
+{
+  float xy = p[0] * p[1], xz = p[0] * p[2], yz = p[1] * p[2];
+  return Matx33f(p[0] * p[0], xy, xz,
+                 xy, p[1] * p[1], yz,
+                 xz, yz, p[2] * p[2]);
+}
+
 /** The PlaneGrid contains statistic about the individual tiles
  */
 class PlaneGrid
@@ -240,71 +251,84 @@ public:
     if (points3d.cols % block_size != 0)
       ++mini_cols;
 
-    // Compute all the interesting quantities
+    // Compute all the interesting quantities, the tiles are independent
     m_.create(mini_rows, mini_cols);
     n_.create(mini_rows, mini_cols);
-    Q_.create(points3d.rows, points3d.cols);
     mse_.create(mini_rows, mini_cols);
-    for (int y = 0; y < mini_rows; ++y)
-      for (int x = 0; x < mini_cols; ++x)
-      {
-        // Update the tiles
-        Matx33f Q = Matx33f::zeros();
-        Vec3f m = Vec3f(0, 0, 0);
-        int K = 0;
-        for (int j = y * block_size; j < std::min((y + 1) * block_size, points3d.rows); ++j)
-        {
-          const Vec3f * vec = points3d.ptr < Vec3f > (j, x * block_size), *vec_end;
-          float * pointpointt = reinterpret_cast<float*>(Q_.ptr < Vec<float, 9> > (j, x * block_size));
-          if (x == mini_cols - 1)
-            vec_end = points3d.ptr < Vec3f > (j, points3d.cols - 1) + 1;
-          else
-            vec_end = vec + block_size;
-          for (; vec != vec_end; ++vec, pointpointt += 9)
-          {
-            if (cvIsNaN(vec->val[0]))
-              continue;
-            // Fill point*point.t()
-            *pointpointt = vec->val[0] * vec->val[0];
-            *(pointpointt + 1) = vec->val[0] * vec->val[1];
-            *(pointpointt + 2) = vec->val[0] * vec->val[2];
-            *(pointpointt + 3) = *(pointpointt + 1);
-            *(pointpointt + 4) = vec->val[1] * vec->val[1];
-            *(pointpointt + 5) = vec->val[1] * vec->val[2];
-            *(pointpointt + 6) = *(pointpointt + 2);
-            *(pointpointt + 7) = *(pointpointt + 5);
-            *(pointpointt + 8) = vec->val[2] * vec->val[2];
-
-            Q += *reinterpret_cast<Matx33f*>(pointpointt);
-            m += (*vec);
-            ++K;
-          }
-        }
-        if (K == 0)
-        {
-          mse_(y, x) = std::numeric_limits<float>::max();
-          continue;
-        }
-
-        m /= K;
-        m_(y, x) = m;
-
-        // Compute C
-        Matx33f C = Q - K * m * m.t();
-
-        // Compute n
-        SVD svd(C);
-        n_(y, x) = Vec3f(svd.vt.at<float>(2, 0), svd.vt.at<float>(2, 1), svd.vt.at<float>(2, 2));
-        mse_(y, x) = svd.w.at<float>(2) / K;
-      }
+    parallel_for_(Range(0, mini_rows), TileInvoker(points3d, *this));
   }
 
   /** The size of the block */
   int block_size_;
   Mat_<Vec3f> m_;
   Mat_<Vec3f> n_;
-  Mat_<Vec<float, 9> > Q_;
   Mat_<float> mse_;
+
+private:
+  /** Fits a plane to each tile of a range of tile rows */
+  class TileInvoker : public ParallelLoopBody
+  {
+  public:
+    TileInvoker(const Mat_<Vec3f> & points3d, PlaneGrid & grid)
+        :
+          points3d_(points3d),
+          grid_(grid)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      const int block_size = grid_.block_size_;
+      const int mini_cols = grid_.mse_.cols;
+      for (int y = range.start; y < range.end; ++y)
+        for (int x = 0; x < mini_cols; ++x)
+        {
+          // Update the tiles
+          Matx33f Q = Matx33f::zeros();
+          Vec3f m = Vec3f(0, 0, 0);
+          int K = 0;
+          for (int j = y * block_size; j < std::min((y + 1) * block_size, points3d_.rows); ++j)
+          {
+            const Vec3f * vec = points3d_.ptr < Vec3f > (j, x * block_size), *vec_end;
+            if (x == mini_cols - 1)
+              vec_end = points3d_.ptr < Vec3f > (j, points3d_.cols - 1) + 1;
+            else
+              vec_end = vec + block_size;
+            for (; vec != vec_end; ++vec)
+            {
+              if (cvIsNaN(vec->val[0]))
+                continue;
+              Q += pointOuterProduct(*vec);
+              m += (*vec);
+              ++K;
+            }
+          }
+          if (K == 0)
+          {
+            grid_.mse_(y, x) = std::numeric_limits<float>::max();
+            continue;
+          }
+
+          m /= K;
+          grid_.m_(y, x) = m;
+
+          // Compute C
+          Matx33f C = Q - K * m * m.t();
+
+          // Compute n
+          SVD svd(C);
+          grid_.n_(y, x) = Vec3f(svd.vt.at<float>(2, 0), svd.vt.at<float>(2, 1), svd.vt.at<float>(2, 2));
+          grid_.mse_(y, x) = svd.w.at<float>(2) / K;
+        }
+    }
+
+  private:
+    const Mat_<Vec3f> & points3d_;
+    PlaneGrid & grid_;
+
+    TileInvoker & operator=(const TileInvoker &);
+  };
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -421,14 +445,12 @@ public:
     {
       uchar* data = overall_mask.ptr(yy, range_x.start), *data_end = data + range_x.size();
       const Vec3f* point = points3d_.ptr < Vec3f > (yy, range_x.start);
-      const Matx33f* Q_local = reinterpret_cast<const Matx33f *>(plane_grid.Q_.ptr < Vec<float, 9>
-          > (yy, range_x.start));
 
       // Depending on whether you have a normal, check it
       if (!normals_.empty())
       {
         const Vec3f* normal = normals_.ptr < Vec3f > (yy, range_x.start);
-        for (; data != data_end; ++data, ++point, ++normal, ++Q_local)
+        for (; data != data_end; ++data, ++point, ++normal)
         {
           // Don't do anything if the point already belongs to another plane
           if (cvIsNaN(point->val[0]) || ((*data) != 255))
@@ -441,7 +463,7 @@ public:
             if (std::abs(plane->n().dot(*normal)) > 0.3)
             {
               // The point now belongs to the plane
-              plane->UpdateStatistics(*point, *Q_local);
+              plane->UpdateStatistics(*point, pointOuterProduct(*point));
               *data = plane_index_;
               ++n_valid_points;
             }
@@ -450,7 +472,7 @@ public:
       }
       else
       {
-        for (; data != data_end; ++data, ++point, ++Q_local)
+        for (; data != data_end; ++data, ++point)
         {
           // Don't do anything if the point already belongs to another plane
           if (cvIsNaN(point->val[0]) || ((*data) != 255))
@@ -460,7 +482,7 @@ public:
           if (plane->distance(*point) < err_)
           {
             // The point now belongs to the plane
-            plane->UpdateStatistics(*point, *Q_local);
+            plane->UpdateStatistics(*point, pointOuterProduct(*point));
             *data = plane_index_;
             ++n_valid_points;
           }
@@ -528,6 +550,411 @@ private:
   const InlierFinder & operator = (const InlierFinder &);
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Number of points, sum of the points and sum of their outer products for a set of points, from which the plane
+ * fitting the set follows. Moments of disjoint sets simply add up.
+ */
+struct PlaneMoments
+{
+  PlaneMoments()
+      :
+        K(0),
+        sum(0, 0, 0),
+        Q(Matx33d::zeros())
+  {
+  }
+
+  void
+  add(const Vec3f & p)
+  {
+    Vec3d pd(p[0], p[1], p[2]);
+    sum += pd;
+    Q += pd * pd.t();
+    ++K;
+  }
+
+  void
+  add(const PlaneMoments & other)
+  {
+    K += other.K;
+    sum += other.sum;
+    Q += other.Q;
+  }
+
+  /** Fit a plane to the points
+   * @param m the mean of the points
+   * @param n the normal of the plane
+   * @param mse the variance of the points along the normal
+   */
+  void
+  fit(Vec3f & m, Vec3f & n, float & mse) const
+  {
+    Vec3d mean = sum * (1. / K);
+    Matx33d C = Q * (1. / K) - mean * mean.t();
+    Matx31d w;
+    Matx33d u, vt;
+    SVD::compute(C, w, u, vt);
+    m = Vec3f((float)mean[0], (float)mean[1], (float)mean[2]);
+    n = Vec3f((float)vt(2, 0), (float)vt(2, 1), (float)vt(2, 2));
+    mse = (float)std::max(w(2), 0.);
+  }
+
+  int K;
+  Vec3d sum;
+  Matx33d Q;
+};
+
+/** A tile, or when it is the root of a union-find set, the region of the merged tiles */
+struct PlaneRegion
+{
+  PlaneMoments moments;
+  Vec3f m;
+  Vec3f n;
+  float mse;
+  /** Whether the tile is planar enough to be part of a plane */
+  bool planar;
+  /** Index of the previous plane the region lies on, or -1 */
+  int seed;
+};
+
+/** Minimal |cos| of the angle between the normals of two regions to merge them */
+static const float PLANE_MERGE_MIN_NORMAL_DOT = 0.966f;
+
+/** Fits a plane to each tile of a range of tile rows */
+class BlockFitInvoker : public ParallelLoopBody
+{
+public:
+  BlockFitInvoker(const Mat_<Vec3f> & points3d, int block_size, float mse_max, std::vector<PlaneRegion> & regions)
+      :
+        points3d_(points3d),
+        block_size_(block_size),
+        mini_cols_((points3d.cols + block_size - 1) / block_size),
+        mse_max_(mse_max),
+        regions_(regions)
+  {
+  }
+
+  virtual void
+  operator()(const Range& range) const
+  {
+    for (int ty = range.start; ty < range.end; ++ty)
+      for (int tx = 0; tx < mini_cols_; ++tx)
+      {
+        PlaneRegion & region = regions_[ty * mini_cols_ + tx];
+        region.moments = PlaneMoments();
+        region.planar = false;
+        region.seed = -1;
+
+        int y_end = std::min((ty + 1) * block_size_, points3d_.rows);
+        int x_end = std::min((tx + 1) * block_size_, points3d_.cols);
+        for (int y = ty * block_size_; y < y_end; ++y)
+        {
+          const Vec3f * point = points3d_[y];
+          for (int x = tx * block_size_; x < x_end; ++x)
+            if (!cvIsNaN(point[x][0]))
+              region.moments.add(point[x]);
+        }
+
+        // Require the tile to be mostly valid for its plane to be meaningful
+        int area = (y_end - ty * block_size_) * (x_end - tx * block_size_);
+        if (region.moments.K < 3 || 2 * region.moments.K < area)
+          continue;
+        region.moments.fit(region.m, region.n, region.mse);
+        region.planar = region.mse <= mse_max_;
+      }
+  }
+
+private:
+  const Mat_<Vec3f> & points3d_;
+  int block_size_;
+  int mini_cols_;
+  float mse_max_;
+  std::vector<PlaneRegion> & regions_;
+
+  BlockFitInvoker & operator=(const BlockFitInvoker &);
+};
+
+/** Labels the pixels of a range of tile rows with the closest plane among the ones of their tile and of the
+ * 4 neighboring tiles, and accumulates the moments of the labeled points per tile row
+ */
+class BlockLabelInvoker : public ParallelLoopBody
+{
+public:
+  BlockLabelInvoker(const Mat_<Vec3f> & points3d, const Mat_<Vec3f> & normals, int block_size,
+                    const std::vector<int> & tile_planes, const std::vector<Ptr<PlaneBase> > & planes, float err,
+                    Mat_<unsigned char> & mask, std::vector<std::vector<PlaneMoments> > & row_moments)
+      :
+        points3d_(points3d),
+        normals_(normals),
+        block_size_(block_size),
+        mini_rows_((points3d.rows + block_size - 1) / block_size),
+        mini_cols_((points3d.cols + block_size - 1) / block_size),
+        tile_planes_(tile_planes),
+        planes_(planes),
+        err_(err),
+        mask_(mask),
+        row_moments_(row_moments)
+  {
+  }
+
+  virtual void
+  operator()(const Range& range) const
+  {
+    for (int ty = range.start; ty < range.end; ++ty)
+    {
+      std::vector<PlaneMoments> & moments = row_moments_[ty];
+      moments.assign(planes_.size(), PlaneMoments());
+
+      for (int tx = 0; tx < mini_cols_; ++tx)
+      {
+        // Candidate planes of the tile
+        int candidates[5], n_candidates = 0;
+        const int neighbors[5][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (int k = 0; k < 5; ++k)
+        {
+          int nx = tx + neighbors[k][0], ny = ty + neighbors[k][1];
+          if (nx < 0 || nx >= mini_cols_ || ny < 0 || ny >= mini_rows_)
+            continue;
+          int plane = tile_planes_[ny * mini_cols_ + nx];
+          if (plane >= 0 && std::find(candidates, candidates + n_candidates, plane) == candidates + n_candidates)
+            candidates[n_candidates++] = plane;
+        }
+
+        int y_end = std::min((ty + 1) * block_size_, points3d_.rows);
+        int x_end = std::min((tx + 1) * block_size_, points3d_.cols);
+        for (int y = ty * block_size_; y < y_end; ++y)
+        {
+          const Vec3f * point = points3d_[y];
+          const Vec3f * normal = normals_.empty() ? 0 : normals_[y];
+          unsigned char * data = mask_[y];
+          for (int x = tx * block_size_; x < x_end; ++x)
+          {
+            data[x] = 255;
+            if (cvIsNaN(point[x][0]))
+              continue;
+
+            int best = -1;
+            float best_distance = err_;
+            for (int k = 0; k < n_candidates; ++k)
+            {
+              const PlaneBase & plane = *planes_[candidates[k]];
+              float distance = plane.distance(point[x]);
+              // make sure the normals are similar to the plane
+              if (distance < best_distance && (!normal || std::abs(plane.n().dot(normal[x])) > 0.3))
+              {
+                best = candidates[k];
+                best_distance = distance;
+              }
+            }
+            if (best < 0)
+              continue;
+            data[x] = (unsigned char)best;
+            moments[best].add(point[x]);
+          }
+        }
+      }
+    }
+  }
+
+private:
+  const Mat_<Vec3f> & points3d_;
+  const Mat_<Vec3f> & normals_;
+  int block_size_;
+  int mini_rows_;
+  int mini_cols_;
+  const std::vector<int> & tile_planes_;
+  const std::vector<Ptr<PlaneBase> > & planes_;
+  float err_;
+  Mat_<unsigned char> & mask_;
+  std::vector<std::vector<PlaneMoments> > & row_moments_;
+
+  BlockLabelInvoker & operator=(const BlockLabelInvoker &);
+};
+
+static int
+findRegion(std::vector<int> & parents, int i)
+{
+  while (parents[i] != i)
+  {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+/** Merges two regions if they fit a common plane. The root is the region with the smallest index, so that the
+ * order of the roots follows the raster order of the tiles.
+ */
+static void
+mergeRegions(std::vector<PlaneRegion> & regions, std::vector<int> & parents, int a, int b, float mse_max,
+             bool force)
+{
+  a = findRegion(parents, a);
+  b = findRegion(parents, b);
+  if (a == b)
+    return;
+  if (a > b)
+    std::swap(a, b);
+  PlaneRegion & ra = regions[a], & rb = regions[b];
+
+  PlaneMoments moments = ra.moments;
+  moments.add(rb.moments);
+  Vec3f m, n;
+  float mse;
+  moments.fit(m, n, mse);
+  if (!force)
+  {
+    // Regions lying on two different previous planes stay apart
+    if (ra.seed >= 0 && rb.seed >= 0 && ra.seed != rb.seed)
+      return;
+    if (std::abs(ra.n.dot(rb.n)) < PLANE_MERGE_MIN_NORMAL_DOT || mse > mse_max)
+      return;
+  }
+
+  parents[b] = a;
+  ra.moments = moments;
+  ra.m = m;
+  ra.n = n;
+  ra.mse = mse;
+  ra.seed = std::max(ra.seed, rb.seed);
+}
+
+/** Find the planes by merging the planar tiles with a union-find and then labeling the pixels
+ * @param previous_planes the planes of the previous frame to seed the regions with, if not empty
+ */
+static void
+findPlanesBlockMerge(const Mat_<Vec3f> & points3d, const Mat_<Vec3f> & normals, int block_size, int min_size,
+                     float err, float sensor_error_a, float sensor_error_b, float sensor_error_c,
+                     const std::vector<Vec4f> & previous_planes, Mat_<unsigned char> & mask,
+                     std::vector<Vec4f> & plane_coefficients)
+{
+  const int mini_rows = (points3d.rows + block_size - 1) / block_size;
+  const int mini_cols = (points3d.cols + block_size - 1) / block_size;
+  const int n_tiles = mini_rows * mini_cols;
+  const float mse_max = err * err;
+
+  // Fit a plane to every tile
+  std::vector<PlaneRegion> regions(n_tiles);
+  parallel_for_(Range(0, mini_rows), BlockFitInvoker(points3d, block_size, mse_max, regions));
+
+  std::vector<int> parents(n_tiles);
+  for (int i = 0; i < n_tiles; ++i)
+    parents[i] = i;
+
+  // Seed the regions with the previous planes: the tiles lying on a previous plane form one region
+  std::vector<int> seed_roots(previous_planes.size(), -1);
+  for (int i = 0; i < n_tiles; ++i)
+  {
+    PlaneRegion & region = regions[i];
+    if (!region.planar)
+      continue;
+    float best_distance = err;
+    for (int k = 0; k < (int)previous_planes.size(); ++k)
+    {
+      const Vec4f & plane = previous_planes[k];
+      Vec3f n(plane[0], plane[1], plane[2]);
+      float distance = std::abs(n.dot(region.m) + plane[3]);
+      if (std::abs(n.dot(region.n)) >= PLANE_MERGE_MIN_NORMAL_DOT && distance < best_distance)
+      {
+        region.seed = k;
+        best_distance = distance;
+      }
+    }
+    if (region.seed < 0)
+      continue;
+    if (seed_roots[region.seed] < 0)
+      seed_roots[region.seed] = i;
+    else
+      mergeRegions(regions, parents, seed_roots[region.seed], i, mse_max, true);
+  }
+
+  // Merge the neighboring planar tiles that fit a common plane
+  for (int ty = 0; ty < mini_rows; ++ty)
+    for (int tx = 0; tx < mini_cols; ++tx)
+    {
+      int i = ty * mini_cols + tx;
+      if (!regions[i].planar)
+        continue;
+      if (tx + 1 < mini_cols && regions[i + 1].planar)
+        mergeRegions(regions, parents, i, i + 1, mse_max, false);
+      if (ty + 1 < mini_rows && regions[i + mini_cols].planar)
+        mergeRegions(regions, parents, i, i + mini_cols, mse_max, false);
+    }
+
+  // Number the planes: the seeded ones first, in the order of the previous planes, then the new ones in the
+  // raster order of their first tile
+  std::vector<int> region_planes(n_tiles, -1);
+  std::vector<int> plane_regions;
+  for (size_t k = 0; k < seed_roots.size(); ++k)
+    if (seed_roots[k] >= 0)
+    {
+      int root = findRegion(parents, seed_roots[k]);
+      if (region_planes[root] < 0)
+      {
+        region_planes[root] = (int)plane_regions.size();
+        plane_regions.push_back(root);
+      }
+    }
+  for (int i = 0; i < n_tiles; ++i)
+    if (regions[i].planar && parents[i] == i && region_planes[i] < 0)
+    {
+      region_planes[i] = (int)plane_regions.size();
+      plane_regions.push_back(i);
+    }
+  // 255 is the label of the pixels without a plane
+  if (plane_regions.size() > 255)
+  {
+    for (size_t k = 255; k < plane_regions.size(); ++k)
+      region_planes[plane_regions[k]] = -1;
+    plane_regions.resize(255);
+  }
+
+  std::vector<int> tile_planes(n_tiles, -1);
+  for (int i = 0; i < n_tiles; ++i)
+    if (regions[i].planar)
+      tile_planes[i] = region_planes[findRegion(parents, i)];
+
+  std::vector<Ptr<PlaneBase> > planes(plane_regions.size());
+  for (size_t k = 0; k < plane_regions.size(); ++k)
+  {
+    const PlaneRegion & region = regions[plane_regions[k]];
+    if ((sensor_error_a == 0) && (sensor_error_b == 0) && (sensor_error_c == 0))
+      planes[k] = Ptr<PlaneBase>(new Plane(region.m, region.n, (int)k));
+    else
+      planes[k] = Ptr<PlaneBase>(new PlaneABC(region.m, region.n, (int)k, sensor_error_a, sensor_error_b,
+                                              sensor_error_c));
+  }
+
+  // Label the pixels, and refit the planes to their pixels. The moments are reduced in the order of the tile rows
+  // to keep the result independent of the number of threads
+  std::vector<std::vector<PlaneMoments> > row_moments(mini_rows);
+  parallel_for_(Range(0, mini_rows),
+                BlockLabelInvoker(points3d, normals, block_size, tile_planes, planes, err, mask, row_moments));
+
+  Mat_<unsigned char> lut(1, 256, (unsigned char)255);
+  plane_coefficients.clear();
+  for (size_t k = 0; k < planes.size(); ++k)
+  {
+    PlaneMoments moments;
+    for (int ty = 0; ty < mini_rows; ++ty)
+      moments.add(row_moments[ty][k]);
+    // Don't record the plane if it's smaller than asked
+    if (moments.K < std::max(min_size, 3))
+      continue;
+
+    Vec3f m, n;
+    float mse;
+    moments.fit(m, n, mse);
+    lut(0, (int)k) = (unsigned char)plane_coefficients.size();
+    Vec4f coeffs(n[0], n[1], n[2], -m.dot(n));
+    if (coeffs(2) > 0)
+      coeffs = -coeffs;
+    plane_coefficients.push_back(coeffs);
+  }
+  LUT(mask, lut, mask);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   void
@@ -557,77 +984,94 @@ private:
     mask_out.create(points3d.size(), CV_8U);
     Mat mask_out_mat = mask_out.getMat();
     Mat_<unsigned char> mask_out_uc = (Mat_<unsigned char>&) mask_out_mat;
-    mask_out_uc.setTo(255);
-    PlaneGrid plane_grid(points3d, block_size_);
-    TileQueue plane_queue(plane_grid);
-    size_t index_plane = 0;
-
     std::vector<Vec4f> plane_coefficients;
-    float mse_min = (float)(threshold_ * threshold_);
 
-    while (!plane_queue.empty())
+    if (method_ == RGBD_PLANE_METHOD_BLOCK_MERGE)
     {
-      // Get the first tile if it's good enough
-      const TileQueue::PlaneTile front_tile = plane_queue.front();
-      if (front_tile.mse_ > mse_min)
-        break;
+      std::vector<Vec4f> previous_planes;
+      if (temporal_ && !previous_planes_.empty())
+        previous_planes_.copyTo(previous_planes);
 
-      InlierFinder inlier_finder((float)threshold_, points3d, normals, (unsigned char)index_plane, block_size_);
+      findPlanesBlockMerge(points3d, normals, block_size_, min_size_, (float)threshold_, (float)sensor_error_a_,
+                           (float)sensor_error_b_, (float)sensor_error_c_, previous_planes, mask_out_uc,
+                           plane_coefficients);
 
-      // Construct the plane for the first tile
-      int x = front_tile.x_, y = front_tile.y_;
-      const Vec3f & n = plane_grid.n_(y, x);
-      Ptr<PlaneBase> plane;
-      if ((sensor_error_a_ == 0) && (sensor_error_b_ == 0) && (sensor_error_c_ == 0))
-        plane = Ptr<PlaneBase>(new Plane(plane_grid.m_(y, x), n, (int)index_plane));
-      else
-        plane = Ptr<PlaneBase>(new PlaneABC(plane_grid.m_(y, x), n, (int)index_plane,
-			(float)sensor_error_a_, (float)sensor_error_b_, (float)sensor_error_c_));
+      if (temporal_)
+        previous_planes_ = Mat(plane_coefficients, true);
+    }
+    else
+    {
+      mask_out_uc.setTo(255);
+      PlaneGrid plane_grid(points3d, block_size_);
+      TileQueue plane_queue(plane_grid);
+      size_t index_plane = 0;
+
+      float mse_min = (float)(threshold_ * threshold_);
 
-      Mat_<unsigned char> plane_mask = Mat_<unsigned char>::zeros(points3d.rows / block_size_,
-                                                                          points3d.cols / block_size_);
-      std::set<TileQueue::PlaneTile> neighboring_tiles;
-      neighboring_tiles.insert(front_tile);
-      plane_queue.remove(front_tile.y_, front_tile.x_);
+      while (!plane_queue.empty())
+      {
+        // Get the first tile if it's good enough
+        const TileQueue::PlaneTile front_tile = plane_queue.front();
+        if (front_tile.mse_ > mse_min)
+          break;
 
-      // Process all the neighboring tiles
-      while (!neighboring_tiles.empty())
-        inlier_finder.Find(plane_grid, plane, plane_queue, neighboring_tiles, mask_out_uc, plane_mask);
+        InlierFinder inlier_finder((float)threshold_, points3d, normals, (unsigned char)index_plane, block_size_);
 
-      // Don't record the plane if it's empty
-      if (plane->empty())
-        continue;
-      // Don't record the plane if it's smaller than asked
-      if (plane->K() < min_size_) {
-        // Reset the plane index in the mask
-        for (y = 0; y < plane_mask.rows; ++y)
-          for (x = 0; x < plane_mask.cols; ++x) {
-            if (!plane_mask(y, x))
-              continue;
-            // Go over the tile
-            for (int yy = y * block_size_;
-                yy < std::min((y + 1) * block_size_, mask_out_uc.rows); ++yy) {
-              uchar* data = mask_out_uc.ptr(yy, x * block_size_);
-              uchar* data_end = data
-                  + std::min(block_size_,
-                      mask_out_uc.cols - x * block_size_);
-              for (; data != data_end; ++data) {
-                if (*data == index_plane)
-                  *data = 255;
+        // Construct the plane for the first tile
+        int x = front_tile.x_, y = front_tile.y_;
+        const Vec3f & n = plane_grid.n_(y, x);
+        Ptr<PlaneBase> plane;
+        if ((sensor_error_a_ == 0) && (sensor_error_b_ == 0) && (sensor_error_c_ == 0))
+          plane = Ptr<PlaneBase>(new Plane(plane_grid.m_(y, x), n, (int)index_plane));
+        else
+          plane = Ptr<PlaneBase>(new PlaneABC(plane_grid.m_(y, x), n, (int)index_plane,
+                                              (float)sensor_error_a_, (float)sensor_error_b_, (float)sensor_error_c_));
+
+        Mat_<unsigned char> plane_mask = Mat_<unsigned char>::zeros(points3d.rows / block_size_,
+                                                                            points3d.cols / block_size_);
+        std::set<TileQueue::PlaneTile> neighboring_tiles;
+        neighboring_tiles.insert(front_tile);
+        plane_queue.remove(front_tile.y_, front_tile.x_);
+
+        // Process all the neighboring tiles
+        while (!neighboring_tiles.empty())
+          inlier_finder.Find(plane_grid, plane, plane_queue, neighboring_tiles, mask_out_uc, plane_mask);
+
+        // Don't record the plane if it's empty
+        if (plane->empty())
+          continue;
+        // Don't record the plane if it's smaller than asked
+        if (plane->K() < min_size_) {
+          // Reset the plane index in the mask
+          for (y = 0; y < plane_mask.rows; ++y)
+            for (x = 0; x < plane_mask.cols; ++x) {
+              if (!plane_mask(y, x))
+                continue;
+              // Go over the tile
+              for (int yy = y * block_size_;
+                  yy < std::min((y + 1) * block_size_, mask_out_uc.rows); ++yy) {
+                uchar* data = mask_out_uc.ptr(yy, x * block_size_);
+                uchar* data_end = data
+                    + std::min(block_size_,
+                        mask_out_uc.cols - x * block_size_);
+                for (; data != data_end; ++data) {
+                  if (*data == index_plane)
+                    *data = 255;
+                }
               }
             }
-          }
-        continue;
-      }
+          continue;
+        }
 
-      ++index_plane;
-      if (index_plane >= 255)
-        break;
-      Vec4f coeffs(plane->n()[0], plane->n()[1], plane->n()[2], plane->d());
-      if (coeffs(2) > 0)
-        coeffs = -coeffs;
-      plane_coefficients.push_back(coeffs);
-    };
+        ++index_plane;
+        if (index_plane >= 255)
+          break;
+        Vec4f coeffs(plane->n()[0], plane->n()[1], plane->n()[2], plane->d());
+        if (coeffs(2) > 0)
+          coeffs = -coeffs;
+        plane_coefficients.push_back(coeffs);
+      };
+    }
 
     // Fill the plane coefficients
     if (plane_coefficients.empty())
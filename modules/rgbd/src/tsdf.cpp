@@ -0,0 +1,754 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+
+namespace cv
+{
+namespace rgbd
+{
+
+// A voxel stores the signed distance to the surface divided by the truncation distance, and the weight
+// of that value. Voxels that have never been observed have a weight of 0.
+typedef Vec2f TsdfVoxel;
+
+struct TsdfIntrinsics
+{
+    float fx, fy, cx, cy;
+};
+
+static
+TsdfIntrinsics getTsdfIntrinsics(const Mat& cameraMatrix)
+{
+    CV_Assert(cameraMatrix.size() == Size(3, 3));
+    CV_Assert(cameraMatrix.type() == CV_32FC1 || cameraMatrix.type() == CV_64FC1);
+
+    Mat K;
+    cameraMatrix.convertTo(K, CV_32FC1);
+
+    TsdfIntrinsics intr;
+    intr.fx = K.at<float>(0, 0);
+    intr.fy = K.at<float>(1, 1);
+    intr.cx = K.at<float>(0, 2);
+    intr.cy = K.at<float>(1, 2);
+    return intr;
+}
+
+static
+Matx44f getTsdfPose(const Mat& pose)
+{
+    CV_Assert(pose.size() == Size(4, 4));
+    CV_Assert(pose.type() == CV_32FC1 || pose.type() == CV_64FC1);
+
+    Mat pose32f;
+    pose.convertTo(pose32f, CV_32FC1);
+    return Matx44f(pose32f.ptr<float>());
+}
+
+static inline
+Matx44f invertRigidPose(const Matx44f& pose)
+{
+    Matx44f inv = Matx44f::eye();
+    for(int y = 0; y < 3; y++)
+    {
+        for(int x = 0; x < 3; x++)
+            inv(y, x) = pose(x, y);
+        inv(y, 3) = -(pose(0, y) * pose(0, 3) + pose(1, y) * pose(1, 3) + pose(2, y) * pose(2, 3));
+    }
+    return inv;
+}
+
+static inline
+Point3f transformPoint(const Matx44f& pose, const Point3f& p)
+{
+    return Point3f(pose(0, 0) * p.x + pose(0, 1) * p.y + pose(0, 2) * p.z + pose(0, 3),
+                   pose(1, 0) * p.x + pose(1, 1) * p.y + pose(1, 2) * p.z + pose(1, 3),
+                   pose(2, 0) * p.x + pose(2, 1) * p.y + pose(2, 2) * p.z + pose(2, 3));
+}
+
+static inline
+Point3f rotateVector(const Matx44f& pose, const Point3f& v)
+{
+    return Point3f(pose(0, 0) * v.x + pose(0, 1) * v.y + pose(0, 2) * v.z,
+                   pose(1, 0) * v.x + pose(1, 1) * v.y + pose(1, 2) * v.z,
+                   pose(2, 0) * v.x + pose(2, 1) * v.y + pose(2, 2) * v.z);
+}
+
+// Returns the depth in meters as CV_32FC1, with NaN for the invalid and masked out pixels
+static
+Mat prepareTsdfDepth(const Mat& depth_in, const Mat& mask)
+{
+    CV_Assert(!depth_in.empty());
+    CV_Assert(depth_in.type() == CV_32FC1 || depth_in.type() == CV_16UC1);
+
+    Mat depth;
+    if(depth_in.type() == CV_16UC1)
+        rescaleDepth(depth_in, CV_32F, depth);
+    else
+        depth = depth_in;
+
+    if(!mask.empty())
+    {
+        CV_Assert(mask.type() == CV_8UC1 && mask.size() == depth.size());
+        if(depth.data == depth_in.data)
+            depth = depth.clone();
+        depth.setTo(std::numeric_limits<float>::quiet_NaN(), mask == 0);
+    }
+    return depth;
+}
+
+static inline
+void updateVoxel(TsdfVoxel& voxel, int u, int v, float z, const Mat& depth,
+                 float truncationDistance, float maxWeight)
+{
+    if(z <= 0 || (unsigned)u >= (unsigned)depth.cols || (unsigned)v >= (unsigned)depth.rows)
+        return;
+
+    // false for NaN
+    float d = depth.at<float>(v, u);
+    if(!(d > 0))
+        return;
+
+    float sdf = d - z;
+    if(sdf < -truncationDistance)
+        return;
+
+    float tsdf = std::min(1.f, sdf / truncationDistance);
+    float weight = voxel[1];
+    voxel[0] = (voxel[0] * weight + tsdf) / (weight + 1.f);
+    voxel[1] = std::min(weight + 1.f, maxWeight);
+}
+
+// Fuses the depth into a run of voxels, whose centers are p + i*step in the camera frame
+static
+void integrateVoxels(TsdfVoxel* voxels, int count, const Point3f& p, const Point3f& step,
+                     const TsdfIntrinsics& intr, const Mat& depth, float truncationDistance, float maxWeight)
+{
+    int i = 0;
+#if CV_SIMD128
+    v_float32x4 v_px = v_setall_f32(p.x), v_py = v_setall_f32(p.y), v_pz = v_setall_f32(p.z);
+    v_float32x4 v_sx = v_setall_f32(step.x), v_sy = v_setall_f32(step.y), v_sz = v_setall_f32(step.z);
+    v_float32x4 v_fx = v_setall_f32(intr.fx), v_fy = v_setall_f32(intr.fy);
+    v_float32x4 v_cx = v_setall_f32(intr.cx), v_cy = v_setall_f32(intr.cy);
+    v_float32x4 v_one = v_setall_f32(1.f), v_four = v_setall_f32(4.f);
+    v_float32x4 v_i(0.f, 1.f, 2.f, 3.f);
+
+    int CV_DECL_ALIGNED(16) u_buf[4];
+    int CV_DECL_ALIGNED(16) v_buf[4];
+    float CV_DECL_ALIGNED(16) z_buf[4];
+    for(; i <= count - 4; i += 4, v_i += v_four)
+    {
+        // The projection of the voxels behind the camera is garbage, updateVoxel() skips them
+        v_float32x4 x = v_px + v_i * v_sx, y = v_py + v_i * v_sy, z = v_pz + v_i * v_sz;
+        v_float32x4 inv_z = v_one / z;
+        v_store(u_buf, v_round(x * inv_z * v_fx + v_cx));
+        v_store(v_buf, v_round(y * inv_z * v_fy + v_cy));
+        v_store(z_buf, z);
+
+        for(int k = 0; k < 4; k++)
+            updateVoxel(voxels[i + k], u_buf[k], v_buf[k], z_buf[k], depth, truncationDistance, maxWeight);
+    }
+#endif
+    for(; i < count; i++)
+    {
+        float x = p.x + i * step.x, y = p.y + i * step.y, z = p.z + i * step.z;
+        if(z <= 0)
+            continue;
+        updateVoxel(voxels[i], cvRound(x * intr.fx / z + intr.cx), cvRound(y * intr.fy / z + intr.cy), z,
+                    depth, truncationDistance, maxWeight);
+    }
+}
+
+// Trilinear interpolation of the TSDF at a point given in voxel coordinates (voxel centers are at integer
+// coordinates). Fails if any of the neighbour voxels has not been observed.
+template<typename Volume>
+static inline
+bool interpolateTsdf(const Volume& volume, const Point3f& p, float& value)
+{
+    int x0 = cvFloor(p.x), y0 = cvFloor(p.y), z0 = cvFloor(p.z);
+    float tx = p.x - x0, ty = p.y - y0, tz = p.z - z0;
+
+    float v[8];
+    for(int i = 0; i < 8; i++)
+        if(!volume.getVoxel(x0 + (i >> 2), y0 + ((i >> 1) & 1), z0 + (i & 1), v[i]))
+            return false;
+
+    float v00 = v[0] + (v[1] - v[0]) * tz, v01 = v[2] + (v[3] - v[2]) * tz;
+    float v10 = v[4] + (v[5] - v[4]) * tz, v11 = v[6] + (v[7] - v[6]) * tz;
+    float v0 = v00 + (v01 - v00) * ty, v1 = v10 + (v11 - v10) * ty;
+    value = v0 + (v1 - v0) * tx;
+    return true;
+}
+
+// Casts the rays of a range of rows of the rendered image through the volume
+template<typename Volume>
+class TsdfRaycastInvoker : public ParallelLoopBody
+{
+public:
+    TsdfRaycastInvoker(const Volume& _volume, const Matx44f& _cameraPose, const TsdfIntrinsics& _intr,
+                       Mat& _depth, Mat& _normals) :
+        volume(_volume), cameraPose(_cameraPose), intr(_intr), depth(_depth), normals(_normals)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float voxelSize = volume.getVoxelSize();
+        const float invVoxelSize = 1.f / voxelSize;
+        const float truncationDistance = volume.getTruncationDistance();
+        const Point3f origin = volume.getOrigin();
+
+        Point3f boxMin, boxMax;
+        const bool isEmpty = !volume.getBounds(boxMin, boxMax);
+
+        // camera center in voxel coordinates
+        Point3f center(cameraPose(0, 3), cameraPose(1, 3), cameraPose(2, 3));
+        center = (center - origin) * invVoxelSize - Point3f(0.5f, 0.5f, 0.5f);
+
+        for(int y = range.start; y < range.end; y++)
+        {
+            float* depth_row = depth.ptr<float>(y);
+            Vec3f* normals_row = normals.empty() ? 0 : normals.ptr<Vec3f>(y);
+
+            for(int x = 0; x < depth.cols; x++)
+            {
+                depth_row[x] = nan;
+                if(normals_row)
+                    normals_row[x] = Vec3f(nan, nan, nan);
+                if(isEmpty)
+                    continue;
+
+                // The ray is parametrized by the depth t: the point is center + t*dir
+                Point3f dirCamera((x - intr.cx) / intr.fx, (y - intr.cy) / intr.fy, 1.f);
+                Point3f dir = rotateVector(cameraPose, dirCamera) * invVoxelSize;
+
+                float tMin = 0.f, tMax = std::numeric_limits<float>::max();
+                if(!clipRay(center, dir, boxMin, boxMax, tMin, tMax))
+                    continue;
+
+                // steps of at most 0.8 truncation distance along the ray, so that no surface is missed
+                const float dirLength = (float)norm(dirCamera);
+                const float maxStep = 0.8f * truncationDistance / dirLength;
+                const float minStep = 0.5f * voxelSize / dirLength;
+
+                float t = tMin, tPrev = 0.f, fPrev = 0.f;
+                bool hasPrev = false;
+                float tHit = -1.f;
+                while(t < tMax)
+                {
+                    float f;
+                    if(!interpolateTsdf(volume, center + dir * t, f))
+                    {
+                        hasPrev = false;
+                        t += maxStep;
+                        continue;
+                    }
+
+                    if(hasPrev && fPrev > 0 && f <= 0)
+                    {
+                        tHit = tPrev + (t - tPrev) * fPrev / (fPrev - f);
+                        break;
+                    }
+                    // the ray starts behind a surface
+                    if(!hasPrev && f < 0 && t == tMin)
+                        break;
+
+                    hasPrev = true;
+                    tPrev = t;
+                    fPrev = f;
+                    t += std::max(std::min(f * maxStep, maxStep), minStep);
+                }
+
+                if(tHit <= 0)
+                    continue;
+
+                depth_row[x] = tHit;
+                if(!normals_row)
+                    continue;
+
+                const Point3f p = center + dir * tHit;
+                float fx0, fx1, fy0, fy1, fz0, fz1;
+                if(!interpolateTsdf(volume, p - Point3f(1.f, 0.f, 0.f), fx0) ||
+                   !interpolateTsdf(volume, p + Point3f(1.f, 0.f, 0.f), fx1) ||
+                   !interpolateTsdf(volume, p - Point3f(0.f, 1.f, 0.f), fy0) ||
+                   !interpolateTsdf(volume, p + Point3f(0.f, 1.f, 0.f), fy1) ||
+                   !interpolateTsdf(volume, p - Point3f(0.f, 0.f, 1.f), fz0) ||
+                   !interpolateTsdf(volume, p + Point3f(0.f, 0.f, 1.f), fz1))
+                    continue;
+
+                Point3f gradient(fx1 - fx0, fy1 - fy0, fz1 - fz0);
+                float gradientNorm = (float)norm(gradient);
+                if(gradientNorm < FLT_EPSILON)
+                    continue;
+
+                // the gradient points to the free space, i.e. towards the camera; rotate it to the camera frame
+                gradient *= 1.f / gradientNorm;
+                normals_row[x] = Vec3f(cameraPose(0, 0) * gradient.x + cameraPose(1, 0) * gradient.y + cameraPose(2, 0) * gradient.z,
+                                       cameraPose(0, 1) * gradient.x + cameraPose(1, 1) * gradient.y + cameraPose(2, 1) * gradient.z,
+                                       cameraPose(0, 2) * gradient.x + cameraPose(1, 2) * gradient.y + cameraPose(2, 2) * gradient.z);
+            }
+        }
+    }
+
+private:
+    // Intersects the ray with the box, in voxel coordinates
+    static bool clipRay(const Point3f& center, const Point3f& dir, const Point3f& boxMin, const Point3f& boxMax,
+                        float& tMin, float& tMax)
+    {
+        const float c[3] = { center.x, center.y, center.z }, d[3] = { dir.x, dir.y, dir.z };
+        const float bMin[3] = { boxMin.x, boxMin.y, boxMin.z }, bMax[3] = { boxMax.x, boxMax.y, boxMax.z };
+        for(int i = 0; i < 3; i++)
+        {
+            if(std::abs(d[i]) < FLT_EPSILON)
+            {
+                if(c[i] < bMin[i] || c[i] > bMax[i])
+                    return false;
+                continue;
+            }
+            float t0 = (bMin[i] - c[i]) / d[i], t1 = (bMax[i] - c[i]) / d[i];
+            if(t0 > t1)
+                std::swap(t0, t1);
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+        }
+        return tMin < tMax;
+    }
+
+    const Volume& volume;
+    Matx44f cameraPose;
+    TsdfIntrinsics intr;
+    Mat& depth;
+    Mat& normals;
+
+    TsdfRaycastInvoker& operator=(const TsdfRaycastInvoker&);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+class TSDFVolumeImpl : public TSDFVolume
+{
+public:
+    TSDFVolumeImpl(float _voxelSize) :
+        voxelSize(_voxelSize),
+        truncationDistance(_voxelSize * DEFAULT_TRUNCATION_DISTANCE_VOXELS()),
+        maxWeight(DEFAULT_MAX_WEIGHT())
+    {
+        CV_Assert(voxelSize > 0);
+    }
+
+    virtual void integrate(const Mat& depth, const Mat& cameraMatrix, const Mat& cameraPose, const Mat& mask)
+    {
+        integrateImpl(prepareTsdfDepth(depth, mask), getTsdfIntrinsics(cameraMatrix),
+                      invertRigidPose(getTsdfPose(cameraPose)));
+    }
+
+    virtual float getVoxelSize() const
+    {
+        return voxelSize;
+    }
+    virtual float getTruncationDistance() const
+    {
+        return truncationDistance;
+    }
+    virtual void setTruncationDistance(float val)
+    {
+        CV_Assert(val > 0);
+        truncationDistance = val;
+    }
+    virtual int getMaxWeight() const
+    {
+        return maxWeight;
+    }
+    virtual void setMaxWeight(int val)
+    {
+        CV_Assert(val > 0);
+        maxWeight = val;
+    }
+
+protected:
+    virtual void integrateImpl(const Mat& depth, const TsdfIntrinsics& intr, const Matx44f& worldToCamera) = 0;
+
+    template<typename Volume>
+    static void raycastVolume(const Volume& volume, const Mat& cameraPose, const Mat& cameraMatrix,
+                              const Size& size, OutputArray _depth, OutputArray _normals)
+    {
+        CV_Assert(size.width > 0 && size.height > 0);
+
+        _depth.create(size, CV_32FC1);
+        Mat depth = _depth.getMat(), normals;
+        if(_normals.needed())
+        {
+            _normals.create(size, CV_32FC3);
+            normals = _normals.getMat();
+        }
+
+        parallel_for_(Range(0, size.height),
+                      TsdfRaycastInvoker<Volume>(volume, getTsdfPose(cameraPose), getTsdfIntrinsics(cameraMatrix),
+                                                 depth, normals));
+    }
+
+    float voxelSize;
+    float truncationDistance;
+    int maxWeight;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+class DenseTSDFVolume : public TSDFVolumeImpl
+{
+public:
+    DenseTSDFVolume(float _voxelSize, const Vec3i& _resolution, const Point3f& _origin) :
+        TSDFVolumeImpl(_voxelSize), resolution(_resolution), origin(_origin)
+    {
+        CV_Assert(resolution[0] > 0 && resolution[1] > 0 && resolution[2] > 0);
+        reset();
+    }
+
+    virtual void reset()
+    {
+        // one row per (x, y) column of voxels, so that z is contiguous
+        volume.create(resolution[0] * resolution[1], resolution[2], CV_32FC2);
+        volume.setTo(Scalar::all(0));
+    }
+
+    virtual void raycast(const Mat& cameraPose, const Mat& cameraMatrix, const Size& size,
+                         OutputArray depth, OutputArray normals) const
+    {
+        raycastVolume(*this, cameraPose, cameraMatrix, size, depth, normals);
+    }
+
+    inline bool getVoxel(int x, int y, int z, float& tsdf) const
+    {
+        if((unsigned)x >= (unsigned)resolution[0] || (unsigned)y >= (unsigned)resolution[1] ||
+           (unsigned)z >= (unsigned)resolution[2])
+            return false;
+
+        const TsdfVoxel& voxel = volume.ptr<TsdfVoxel>(x * resolution[1] + y)[z];
+        tsdf = voxel[0];
+        return voxel[1] > 0;
+    }
+
+    bool getBounds(Point3f& boxMin, Point3f& boxMax) const
+    {
+        // in voxel coordinates, the centers of the border voxels
+        boxMin = Point3f(0.f, 0.f, 0.f);
+        boxMax = Point3f((float)resolution[0] - 1, (float)resolution[1] - 1, (float)resolution[2] - 1);
+        return true;
+    }
+
+    Point3f getOrigin() const
+    {
+        return origin;
+    }
+
+protected:
+    class IntegrateInvoker : public ParallelLoopBody
+    {
+    public:
+        IntegrateInvoker(DenseTSDFVolume& _volume, const Mat& _depth, const TsdfIntrinsics& _intr,
+                         const Matx44f& _worldToCamera) :
+            volume(_volume), depth(_depth), intr(_intr), worldToCamera(_worldToCamera)
+        {}
+
+        virtual void operator()(const Range& range) const
+        {
+            const float voxelSize = volume.voxelSize;
+            const float maxWeight = (float)volume.maxWeight;
+            const Point3f step = rotateVector(worldToCamera, Point3f(0.f, 0.f, voxelSize));
+
+            for(int x = range.start; x < range.end; x++)
+                for(int y = 0; y < volume.resolution[1]; y++)
+                {
+                    Point3f p = volume.origin + Point3f((x + 0.5f) * voxelSize, (y + 0.5f) * voxelSize, 0.5f * voxelSize);
+                    integrateVoxels(volume.volume.ptr<TsdfVoxel>(x * volume.resolution[1] + y), volume.resolution[2],
+                                    transformPoint(worldToCamera, p), step, intr, depth,
+                                    volume.truncationDistance, maxWeight);
+                }
+        }
+
+    private:
+        DenseTSDFVolume& volume;
+        const Mat& depth;
+        TsdfIntrinsics intr;
+        Matx44f worldToCamera;
+
+        IntegrateInvoker& operator=(const IntegrateInvoker&);
+    };
+
+    virtual void integrateImpl(const Mat& depth, const TsdfIntrinsics& intr, const Matx44f& worldToCamera)
+    {
+        parallel_for_(Range(0, resolution[0]), IntegrateInvoker(*this, depth, intr, worldToCamera));
+    }
+
+    Vec3i resolution;
+    Point3f origin;
+    Mat volume;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// Number of voxels along each side of a block of the hashed volume
+const int tsdfBlockSizeLog2 = 3;
+const int tsdfBlockSize = 1 << tsdfBlockSizeLog2;
+const int tsdfBlockVoxels = tsdfBlockSize * tsdfBlockSize * tsdfBlockSize;
+
+class HashTSDFVolume : public TSDFVolumeImpl
+{
+public:
+    HashTSDFVolume(float _voxelSize) :
+        TSDFVolumeImpl(_voxelSize)
+    {
+        reset();
+    }
+
+    virtual void reset()
+    {
+        blocks.release();
+        blockCoords.clear();
+        table.assign(1024, -1);
+    }
+
+    virtual void raycast(const Mat& cameraPose, const Mat& cameraMatrix, const Size& size,
+                         OutputArray depth, OutputArray normals) const
+    {
+        raycastVolume(*this, cameraPose, cameraMatrix, size, depth, normals);
+    }
+
+    inline bool getVoxel(int x, int y, int z, float& tsdf) const
+    {
+        // arithmetic shifts round towards minus infinity, also for negative coordinates
+        int block = findBlock(Vec3i(x >> tsdfBlockSizeLog2, y >> tsdfBlockSizeLog2, z >> tsdfBlockSizeLog2));
+        if(block < 0)
+            return false;
+
+        const int mask = tsdfBlockSize - 1;
+        const TsdfVoxel& voxel = blocks.ptr<TsdfVoxel>(block)[voxelIndex(x & mask, y & mask, z & mask)];
+        tsdf = voxel[0];
+        return voxel[1] > 0;
+    }
+
+    bool getBounds(Point3f& boxMin, Point3f& boxMax) const
+    {
+        if(blockCoords.empty())
+            return false;
+        boxMin = Point3f((float)(minBlock[0] * tsdfBlockSize), (float)(minBlock[1] * tsdfBlockSize),
+                         (float)(minBlock[2] * tsdfBlockSize));
+        boxMax = Point3f((float)((maxBlock[0] + 1) * tsdfBlockSize - 1), (float)((maxBlock[1] + 1) * tsdfBlockSize - 1),
+                         (float)((maxBlock[2] + 1) * tsdfBlockSize - 1));
+        return true;
+    }
+
+    Point3f getOrigin() const
+    {
+        return Point3f(0.f, 0.f, 0.f);
+    }
+
+protected:
+    static inline int voxelIndex(int x, int y, int z)
+    {
+        return (((x << tsdfBlockSizeLog2) + y) << tsdfBlockSizeLog2) + z;
+    }
+
+    static inline size_t hashBlock(const Vec3i& b)
+    {
+        return (size_t)(((unsigned)b[0] * 73856093u) ^ ((unsigned)b[1] * 19349669u) ^ ((unsigned)b[2] * 83492791u));
+    }
+
+    int findBlock(const Vec3i& b) const
+    {
+        const size_t mask = table.size() - 1;
+        for(size_t i = hashBlock(b) & mask; ; i = (i + 1) & mask)
+        {
+            int block = table[i];
+            if(block < 0 || blockCoords[block] == b)
+                return block;
+        }
+    }
+
+    void allocateBlock(const Vec3i& b)
+    {
+        if(findBlock(b) >= 0)
+            return;
+
+        // keep the load of the table under 1/2
+        if(2 * (blockCoords.size() + 1) > table.size())
+        {
+            table.assign(table.size() * 2, -1);
+            for(size_t block = 0; block < blockCoords.size(); block++)
+                insertBlock(blockCoords[block], (int)block);
+        }
+
+        if(blockCoords.empty())
+            minBlock = maxBlock = b;
+        for(int i = 0; i < 3; i++)
+        {
+            minBlock[i] = std::min(minBlock[i], b[i]);
+            maxBlock[i] = std::max(maxBlock[i], b[i]);
+        }
+
+        insertBlock(b, (int)blockCoords.size());
+        blockCoords.push_back(b);
+        blocks.push_back(Mat(1, tsdfBlockVoxels, CV_32FC2, Scalar::all(0)));
+    }
+
+    void insertBlock(const Vec3i& b, int block)
+    {
+        const size_t mask = table.size() - 1;
+        size_t i = hashBlock(b) & mask;
+        while(table[i] >= 0)
+            i = (i + 1) & mask;
+        table[i] = block;
+    }
+
+    // Finds the blocks around the points of a range of rows of the depth: the blocks of the points at the
+    // surface and at the truncation distance in front and behind it along the ray
+    class AllocationInvoker : public ParallelLoopBody
+    {
+    public:
+        AllocationInvoker(const HashTSDFVolume& _volume, const Mat& _depth, const TsdfIntrinsics& _intr,
+                          const Matx44f& _cameraToWorld, std::vector<std::vector<Vec3i> >& _rowBlocks) :
+            volume(_volume), depth(_depth), intr(_intr), cameraToWorld(_cameraToWorld), rowBlocks(_rowBlocks)
+        {}
+
+        virtual void operator()(const Range& range) const
+        {
+            const float blockScale = 1.f / (volume.voxelSize * tsdfBlockSize);
+            const float truncationDistance = volume.truncationDistance;
+
+            for(int y = range.start; y < range.end; y++)
+            {
+                const float* depth_row = depth.ptr<float>(y);
+                std::vector<Vec3i>& blocks = rowBlocks[y];
+                blocks.clear();
+
+                for(int x = 0; x < depth.cols; x++)
+                {
+                    float d = depth_row[x];
+                    if(!(d > 0))
+                        continue;
+
+                    Point3f dir((x - intr.cx) / intr.fx, (y - intr.cy) / intr.fy, 1.f);
+                    for(int k = -1; k <= 1; k++)
+                    {
+                        float t = d + k * truncationDistance;
+                        if(t <= 0)
+                            continue;
+                        Point3f p = transformPoint(cameraToWorld, dir * t) * blockScale;
+                        Vec3i b(cvFloor(p.x), cvFloor(p.y), cvFloor(p.z));
+                        if(blocks.empty() || blocks.back() != b)
+                            blocks.push_back(b);
+                    }
+                }
+            }
+        }
+
+    private:
+        const HashTSDFVolume& volume;
+        const Mat& depth;
+        TsdfIntrinsics intr;
+        Matx44f cameraToWorld;
+        std::vector<std::vector<Vec3i> >& rowBlocks;
+
+        AllocationInvoker& operator=(const AllocationInvoker&);
+    };
+
+    class IntegrateInvoker : public ParallelLoopBody
+    {
+    public:
+        IntegrateInvoker(HashTSDFVolume& _volume, const Mat& _depth, const TsdfIntrinsics& _intr,
+                         const Matx44f& _worldToCamera) :
+            volume(_volume), depth(_depth), intr(_intr), worldToCamera(_worldToCamera)
+        {}
+
+        virtual void operator()(const Range& range) const
+        {
+            const float voxelSize = volume.voxelSize;
+            const float maxWeight = (float)volume.maxWeight;
+            const float blockSide = voxelSize * tsdfBlockSize;
+            const float blockRadius = 0.87f * blockSide + volume.truncationDistance;
+            const Point3f step = rotateVector(worldToCamera, Point3f(0.f, 0.f, voxelSize));
+
+            for(int block = range.start; block < range.end; block++)
+            {
+                const Vec3i& b = volume.blockCoords[block];
+                const Point3f corner(b[0] * blockSide, b[1] * blockSide, b[2] * blockSide);
+
+                // skip the blocks out of the view frustum
+                Point3f c = transformPoint(worldToCamera, corner + Point3f(0.5f, 0.5f, 0.5f) * blockSide);
+                if(c.z <= -blockRadius)
+                    continue;
+                if(c.z > blockRadius)
+                {
+                    float u = c.x * intr.fx / c.z + intr.cx, v = c.y * intr.fy / c.z + intr.cy;
+                    float margin = blockRadius * std::max(intr.fx, intr.fy) / (c.z - blockRadius);
+                    if(u < -margin || u > depth.cols + margin || v < -margin || v > depth.rows + margin)
+                        continue;
+                }
+
+                TsdfVoxel* voxels = volume.blocks.ptr<TsdfVoxel>(block);
+                for(int x = 0; x < tsdfBlockSize; x++)
+                    for(int y = 0; y < tsdfBlockSize; y++)
+                    {
+                        Point3f p = corner + Point3f((x + 0.5f) * voxelSize, (y + 0.5f) * voxelSize, 0.5f * voxelSize);
+                        integrateVoxels(voxels + voxelIndex(x, y, 0), tsdfBlockSize, transformPoint(worldToCamera, p),
+                                        step, intr, depth, volume.truncationDistance, maxWeight);
+                    }
+            }
+        }
+
+    private:
+        HashTSDFVolume& volume;
+        const Mat& depth;
+        TsdfIntrinsics intr;
+        Matx44f worldToCamera;
+
+        IntegrateInvoker& operator=(const IntegrateInvoker&);
+    };
+
+    virtual void integrateImpl(const Mat& depth, const TsdfIntrinsics& intr, const Matx44f& worldToCamera)
+    {
+        // The blocks are found in parallel, but allocated serially
+        std::vector<std::vector<Vec3i> > rowBlocks(depth.rows);
+        parallel_for_(Range(0, depth.rows),
+                      AllocationInvoker(*this, depth, intr, invertRigidPose(worldToCamera), rowBlocks));
+        for(size_t y = 0; y < rowBlocks.size(); y++)
+            for(size_t i = 0; i < rowBlocks[y].size(); i++)
+                allocateBlock(rowBlocks[y][i]);
+
+        parallel_for_(Range(0, (int)blockCoords.size()), IntegrateInvoker(*this, depth, intr, worldToCamera));
+    }
+
+    // one row of voxels per block
+    Mat blocks;
+    std::vector<Vec3i> blockCoords;
+    // open addressing hash table of the block indices, -1 for the empty slots
+    std::vector<int> table;
+    Vec3i minBlock, maxBlock;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+Ptr<TSDFVolume> TSDFVolume::create(int volumeType, float voxelSize, const Vec3i& resolution, const Point3f& origin)
+{
+    switch(volumeType)
+    {
+    case TSDF_VOLUME_DENSE:
+        return makePtr<DenseTSDFVolume>(voxelSize, resolution, origin);
+    case TSDF_VOLUME_HASHED:
+        return makePtr<HashTSDFVolume>(voxelSize);
+    default:
+        CV_Error(Error::StsBadArg, "Unknown TSDF volume type");
+    }
+    return Ptr<TSDFVolume>();
+}
+
+void TSDFVolume::integrate(const Ptr<RgbdFrame>& frame, const Mat& cameraMatrix, const Mat& cameraPose)
+{
+    CV_Assert(!frame.empty());
+    integrate(frame->depth, cameraMatrix, cameraPose, frame->mask);
+}
+
+} // namespace rgbd
+} // namespace cv
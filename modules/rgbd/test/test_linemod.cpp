@@ -0,0 +1,181 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+#include <opencv2/imgproc.hpp>
+#include <fstream>
+
+namespace cv
+{
+namespace linemod
+{
+
+// A few colored shapes on a dark background, and the masks of the shapes
+static
+void makeScene(Mat& image, std::vector<Mat>& masks)
+{
+  image.create(480, 640, CV_8UC3);
+  image.setTo(Scalar::all(30));
+  rectangle(image, Rect(100, 120, 120, 90), Scalar(200, 180, 160), FILLED);
+  circle(image, Point(420, 260), 60, Scalar(90, 200, 120), FILLED);
+  rectangle(image, Rect(260, 340, 70, 100), Scalar(60, 80, 220), FILLED);
+
+  masks.assign(3, Mat());
+  for (int i = 0; i < 3; i++)
+    masks[i] = Mat::zeros(image.size(), CV_8U);
+  rectangle(masks[0], Rect(90, 110, 140, 110), Scalar::all(255), FILLED);
+  circle(masks[1], Point(420, 260), 70, Scalar::all(255), FILLED);
+  rectangle(masks[2], Rect(250, 330, 90, 120), Scalar::all(255), FILLED);
+}
+
+static
+void expectEqualTemplates(const std::vector<Template>& a, const std::vector<Template>& b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    EXPECT_EQ(a[i].width, b[i].width);
+    EXPECT_EQ(a[i].height, b[i].height);
+    EXPECT_EQ(a[i].pyramid_level, b[i].pyramid_level);
+    ASSERT_EQ(a[i].features.size(), b[i].features.size());
+    for (size_t j = 0; j < a[i].features.size(); j++)
+    {
+      EXPECT_EQ(a[i].features[j].x, b[i].features[j].x);
+      EXPECT_EQ(a[i].features[j].y, b[i].features[j].y);
+      EXPECT_EQ(a[i].features[j].label, b[i].features[j].label);
+    }
+  }
+}
+
+TEST(Rgbd_Linemod, template_file)
+{
+  Mat image;
+  std::vector<Mat> masks;
+  makeScene(image, masks);
+  std::vector<Mat> sources(1, image);
+
+  Ptr<Detector> detector = getDefaultLINE();
+  const char* class_ids[] = {"rect", "circle", "rect"};
+  for (int i = 0; i < 3; i++)
+    ASSERT_GE(detector->addTemplate(sources, class_ids[i], masks[i]), 0);
+
+  std::vector<Match> matches;
+  detector->match(sources, 80.f, matches);
+  ASSERT_FALSE(matches.empty());
+
+  String filename = tempfile(".bin");
+  detector->saveTemplates(filename);
+
+  Ptr<Detector> loaded = getDefaultLINE();
+  loaded->loadTemplates(filename);
+
+  ASSERT_EQ(detector->numTemplates(), loaded->numTemplates());
+  ASSERT_EQ(detector->classIds(), loaded->classIds());
+  for (int i = 0; i < detector->numTemplates("rect"); i++)
+    expectEqualTemplates(detector->getTemplates("rect", i), loaded->getTemplates("rect", i));
+  expectEqualTemplates(detector->getTemplates("circle", 0), loaded->getTemplates("circle", 0));
+
+  // Matching from the mapped file gives the same results
+  std::vector<Match> loaded_matches;
+  loaded->match(sources, 80.f, loaded_matches);
+  ASSERT_EQ(matches.size(), loaded_matches.size());
+  for (size_t i = 0; i < matches.size(); i++)
+  {
+    EXPECT_EQ(matches[i].x, loaded_matches[i].x);
+    EXPECT_EQ(matches[i].y, loaded_matches[i].y);
+    EXPECT_EQ(matches[i].similarity, loaded_matches[i].similarity);
+    EXPECT_EQ(matches[i].class_id, loaded_matches[i].class_id);
+    EXPECT_EQ(matches[i].template_id, loaded_matches[i].template_id);
+  }
+
+  // and so does a class filter
+  std::vector<String> circle(1, "circle");
+  loaded->match(sources, 80.f, loaded_matches, circle);
+  for (size_t i = 0; i < loaded_matches.size(); i++)
+    EXPECT_EQ("circle", loaded_matches[i].class_id);
+
+  loaded.release();
+  remove(filename.c_str());
+}
+
+TEST(Rgbd_Linemod, corrupted_template_file)
+{
+  Mat image;
+  std::vector<Mat> masks;
+  makeScene(image, masks);
+  std::vector<Mat> sources(1, image);
+
+  Ptr<Detector> detector = getDefaultLINE();
+  for (int i = 0; i < 3; i++)
+    ASSERT_GE(detector->addTemplate(sources, "shape", masks[i]), 0);
+
+  String filename = tempfile(".bin");
+  detector->saveTemplates(filename);
+  std::vector<char> bytes;
+  {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  ASSERT_GT(bytes.size(), 104u);
+
+  // the header is followed by the names size and the offsets of the sections: names, class
+  // ranges, template info, feature x, feature y and feature label, then the file size
+  const uint64* offsets = (const uint64*)&bytes[48];
+  const size_t info_begin = (size_t)offsets[2], info_end = (size_t)offsets[3];
+  const size_t x_begin = (size_t)offsets[3], label_begin = (size_t)offsets[5];
+  ASSERT_LT(label_begin, bytes.size());
+
+  // the template table and the features are not checked on load
+  for (int corruption = 0; corruption < 3; corruption++)
+  {
+    SCOPED_TRACE(corruption);
+    std::vector<char> corrupted(bytes);
+    RNG rng(corruption);
+    if (corruption == 0) // template sizes and feature ranges
+    {
+      for (size_t i = info_begin; i + sizeof(int) <= info_end; i += sizeof(int))
+        *(int*)&corrupted[i] = rng.uniform(-100000, 100000);
+    }
+    else if (corruption == 1) // feature positions
+    {
+      for (size_t i = x_begin; i + sizeof(short) <= label_begin; i += sizeof(short))
+        *(short*)&corrupted[i] = (short)rng.uniform(SHRT_MIN, SHRT_MAX);
+    }
+    else // feature labels
+    {
+      for (size_t i = label_begin; i < corrupted.size(); i++)
+        corrupted[i] = (char)rng.uniform(0, 256);
+    }
+    {
+      std::ofstream out(filename.c_str(), std::ios::binary);
+      out.write(&corrupted[0], corrupted.size());
+    }
+
+    Ptr<Detector> loaded = getDefaultLINE();
+    ASSERT_NO_THROW(loaded->loadTemplates(filename));
+    std::vector<Match> matches;
+    EXPECT_NO_THROW(loaded->match(sources, 50.f, matches));
+    for (int i = 0; i < loaded->numTemplates("shape"); i++)
+    {
+      const std::vector<Template>& templates = loaded->getTemplates("shape", i);
+      for (size_t t = 0; t < templates.size(); t++)
+        for (size_t j = 0; j < templates[t].features.size(); j++)
+          EXPECT_LT(templates[t].features[j].label, 8);
+    }
+  }
+
+  // a file too short for its sections is rejected
+  {
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out.write(&bytes[0], label_begin);
+  }
+  Ptr<Detector> truncated = getDefaultLINE();
+  EXPECT_THROW(truncated->loadTemplates(filename), cv::Exception);
+
+  remove(filename.c_str());
+}
+
+}
+}
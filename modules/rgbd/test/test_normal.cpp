@@ -411,7 +411,9 @@ protected:
 class CV_RgbdPlaneTest: public cvtest::BaseTest
 {
 public:
-  CV_RgbdPlaneTest()
+  CV_RgbdPlaneTest(RgbdPlane::RGBD_PLANE_METHOD method = RgbdPlane::RGBD_PLANE_METHOD_DEFAULT)
+      :
+        method_(method)
   {
   }
   ~CV_RgbdPlaneTest()
@@ -423,7 +425,7 @@ protected:
   {
     try
     {
-      RgbdPlane plane_computer;
+      RgbdPlane plane_computer(method_);
 
       std::vector<Plane> planes;
       Mat points3d, ground_normals;
@@ -506,6 +508,8 @@ protected:
       std::cout << "plane " << tm2.getTimeMilli() << " ms " << std::endl;
     }
   }
+
+  RgbdPlane::RGBD_PLANE_METHOD method_;
 };
 
 }
@@ -524,3 +528,32 @@ TEST(Rgbd_Plane, compute)
   cv::rgbd::CV_RgbdPlaneTest test;
   test.safe_run();
 }
+
+TEST(Rgbd_Plane, compute_block_merge)
+{
+  cv::rgbd::CV_RgbdPlaneTest test(cv::rgbd::RgbdPlane::RGBD_PLANE_METHOD_BLOCK_MERGE);
+  test.safe_run();
+}
+
+TEST(Rgbd_Plane, temporal_block_merge)
+{
+  std::vector<cv::rgbd::Plane> planes;
+  cv::Mat points3d, ground_normals;
+  cv::Mat_<unsigned char> plane_mask;
+  cv::rgbd::gen_points_3d(planes, plane_mask, points3d, ground_normals, 3);
+
+  cv::rgbd::RgbdPlane plane_computer(cv::rgbd::RgbdPlane::RGBD_PLANE_METHOD_BLOCK_MERGE);
+  plane_computer.setTemporal(true);
+
+  cv::Mat mask, temporal_mask;
+  std::vector<cv::Vec4f> plane_coefficients, temporal_coefficients;
+  plane_computer(points3d, mask, plane_coefficients);
+  ASSERT_FALSE(plane_coefficients.empty());
+
+  // Seeding from the planes of the same frame finds them again, in the same order
+  plane_computer(points3d, temporal_mask, temporal_coefficients);
+  ASSERT_EQ(plane_coefficients.size(), temporal_coefficients.size());
+  for (size_t i = 0; i < plane_coefficients.size(); ++i)
+    EXPECT_LE(cv::norm(plane_coefficients[i] - temporal_coefficients[i]), 1e-3);
+  EXPECT_LE(cv::countNonZero(mask != temporal_mask), (int)mask.total() / 1000);
+}
@@ -158,3 +158,96 @@ TEST(Rgbd_DepthRegistration, compute)
   cv::rgbd::CV_RgbdDepthRegistrationTest test;
   test.safe_run();
 }
+
+TEST(Rgbd_DepthPreprocessor, chained)
+{
+  using namespace cv;
+  using namespace cv::rgbd;
+
+  // K from a VGA Kinect, and the baseline between its cameras
+  Mat K = (Mat_<float>(3, 3) << 525., 0., 319.5, 0., 525., 239.5, 0., 0., 1.);
+  Matx44f Rt = Matx44f::eye();
+  Rt(0, 3) = 0.025f;
+  const Size size(640, 480);
+
+  // A slanted wall with a box in front of it, in millimeters
+  Mat_<unsigned short> depth(size);
+  for (int y = 0; y < size.height; ++y)
+    for (int x = 0; x < size.width; ++x)
+      depth(y, x) = (unsigned short)(1500 + x / 2 - ((Rect(200, 150, 160, 120).contains(Point(x, y))) ? 600 : 0));
+
+  // Without cleaning, the registration and the 3d points are those of the chained calls
+  {
+    Mat depth_m;
+    depth.convertTo(depth_m, CV_32F, 0.001);
+
+    DepthPreprocessor preprocessor(K, K, Mat(), Rt, size, true, false);
+    Mat registered, points3d;
+    preprocessor(depth_m, registered, points3d);
+    ASSERT_EQ(CV_32FC1, registered.type());
+    ASSERT_EQ(CV_32FC3, points3d.type());
+
+    Mat registered_chained, points3d_chained;
+    registerDepth(K, K, Mat(), Rt, depth_m, size, registered_chained, true);
+    depthTo3d(registered_chained, K, points3d_chained);
+
+    int valid = 0, mismatches = 0;
+    for (int y = 0; y < size.height; ++y)
+      for (int x = 0; x < size.width; ++x)
+      {
+        const float z = registered.at<float>(y, x), z_chained = registered_chained.at<float>(y, x);
+        if (cvIsNaN(z) || cvIsNaN(z_chained))
+        {
+          mismatches += cvIsNaN(z) != cvIsNaN(z_chained);
+          continue;
+        }
+        ++valid;
+        // a projection rounded differently moves the pixel by one
+        if (std::abs(z - z_chained) > 1e-5f)
+        {
+          ++mismatches;
+          continue;
+        }
+        ASSERT_LE(norm(points3d.at<Vec3f>(y, x) - points3d_chained.at<Vec3f>(y, x)), 1e-5);
+      }
+    EXPECT_GT(valid, size.area() * 9 / 10);
+    EXPECT_LT(mismatches, size.area() / 100);
+  }
+
+  // With cleaning, the depth is that of DepthCleaner inside of the image
+  {
+    DepthPreprocessor preprocessor(K, K, Mat(), Rt, size);
+    Mat registered;
+    preprocessor(depth, registered);
+
+    Mat_<unsigned short> registered_chained;
+    registerDepth(K, K, Mat(), Rt, depth, size, registered_chained);
+    DepthCleaner cleaner(CV_16U, 3, DepthCleaner::DEPTH_CLEANER_NIL);
+    Mat_<unsigned short> cleaned;
+    cleaner(registered_chained, cleaned);
+
+    // DepthCleaner does not average all the neighbors of the pixels close to the borders
+    int valid = 0;
+    for (int y = 1; y < size.height - 1; ++y)
+      for (int x = 2; x < size.width - 2; ++x)
+      {
+        const float z = registered.at<float>(y, x);
+        if (registered_chained(y, x) == 0 || cvIsNaN(z))
+          continue;
+        ++valid;
+        // the chained calls round the depth to millimeters twice
+        ASSERT_NEAR(cleaned(y, x), z * 1000, 1.5);
+      }
+    EXPECT_GT(valid, size.area() * 8 / 10);
+  }
+
+  // The outputs are reused
+  {
+    DepthPreprocessor preprocessor(K, K, Mat(), Rt, size);
+    Mat registered, points3d;
+    preprocessor(depth, registered, points3d);
+    const uchar* data = registered.data;
+    preprocessor(depth, registered, points3d);
+    EXPECT_EQ(data, registered.data);
+  }
+}
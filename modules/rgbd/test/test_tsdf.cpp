@@ -0,0 +1,84 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+
+namespace cv
+{
+namespace rgbd
+{
+
+// Depth of a slanted wall seen from the origin, and its normal in the camera frame
+static
+void makeWall(const Size& size, const Mat& K, Mat& depth, Vec3f& normal)
+{
+  const float fx = K.at<float>(0, 0), cx = K.at<float>(0, 2);
+
+  // z = 1.5 + 0.2 x
+  depth.create(size, CV_32FC1);
+  for (int y = 0; y < size.height; y++)
+    for (int x = 0; x < size.width; x++)
+      depth.at<float>(y, x) = 1.5f / (1.f - 0.2f * (x - cx) / fx);
+
+  normal = Vec3f(0.2f, 0.f, -1.f);
+  normal *= 1.f / (float)norm(normal);
+}
+
+static
+void testRaycastOfIntegratedDepth(int volumeType)
+{
+  const Size size(160, 120);
+  Mat K = (Mat_<float>(3, 3) << 130.f, 0.f, 79.5f,
+                                0.f, 130.f, 59.5f,
+                                0.f, 0.f, 1.f);
+  Mat depth;
+  Vec3f normal;
+  makeWall(size, K, depth, normal);
+
+  const float voxelSize = 0.01f;
+  Ptr<TSDFVolume> volume = TSDFVolume::create(volumeType, voxelSize, Vec3i(256, 256, 256), Point3f(-1.28f, -1.28f, 0.5f));
+  ASSERT_FALSE(volume.empty());
+
+  Mat pose = Mat::eye(4, 4, CV_64FC1);
+  for (int i = 0; i < 3; i++)
+    volume->integrate(depth, K, pose);
+
+  Mat modelDepth, modelNormals;
+  volume->raycast(pose, K, size, modelDepth, modelNormals);
+  ASSERT_EQ(CV_32FC1, modelDepth.type());
+  ASSERT_EQ(CV_32FC3, modelNormals.type());
+
+  // the border of the rendering may miss the surface, the center has to be close to it
+  int count = 0;
+  for (int y = size.height / 4; y < 3 * size.height / 4; y++)
+    for (int x = size.width / 4; x < 3 * size.width / 4; x++)
+    {
+      float d = modelDepth.at<float>(y, x);
+      ASSERT_FALSE(cvIsNaN(d)) << "at " << x << ", " << y;
+      EXPECT_LE(std::abs(d - depth.at<float>(y, x)), voxelSize);
+
+      Vec3f n = modelNormals.at<Vec3f>(y, x);
+      EXPECT_GE(n.dot(normal), 0.98f);
+      count++;
+    }
+  EXPECT_GT(count, 0);
+
+  // nothing is left after a reset
+  volume->reset();
+  volume->raycast(pose, K, size, modelDepth);
+  EXPECT_EQ(0, countNonZero(modelDepth == modelDepth));
+}
+
+}
+}
+
+TEST(Rgbd_TSDFVolume, raycast_dense)
+{
+  cv::rgbd::testRaycastOfIntegratedDepth(cv::rgbd::TSDFVolume::TSDF_VOLUME_DENSE);
+}
+
+TEST(Rgbd_TSDFVolume, raycast_hashed)
+{
+  cv::rgbd::testRaycastOfIntegratedDepth(cv::rgbd::TSDFVolume::TSDF_VOLUME_HASHED);
+}
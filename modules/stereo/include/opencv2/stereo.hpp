@@ -203,7 +203,9 @@ namespace cv
             enum
             {
                 MODE_SGBM = 0,
-                MODE_HH   = 1
+                MODE_HH   = 1,
+                //! same directions as MODE_SGBM without the cost volume, see StereoBinarySGBM::create
+                MODE_SGBM_LEAN = 2
             };
 
             virtual int getPreFilterCap() const = 0;
@@ -230,6 +232,28 @@ namespace cv
             virtual int getSubPixelInterpolationMethod() const = 0;
             virtual void setSubPixelInterpolationMethod(int value) = 0;
 
+            /** @brief Temporal prior for video: number of disparities searched around the disparity of the
+            previous frame.
+
+            When it is positive, compute keeps its last disparity map and searches, for each pixel of the
+            next frame, only that many disparities centered on the previous disparity at the same place. The
+            cost volume and the aggregation shrink by numDisparities / temporalNumDisparities. The full range
+            is searched for the first frame, when the previous disparity has too many holes, and again for
+            the current frame when too many disparities are found at the border of their search window.
+            It must be a multiple of 16, smaller than numDisparities. 0, the default, disables the prior.
+            */
+            virtual int getTemporalNumDisparities() const = 0;
+            virtual void setTemporalNumDisparities(int numDisparities) = 0;
+
+            /** @brief Sets the image motion from the previous frame to the next one given to compute, as a
+            3x3 homography applied to the previous disparity map (e.g. the rotation of the camera). It is
+            only used by the next call of compute.
+            */
+            virtual void setTemporalMotion(InputArray H) = 0;
+
+            //! true if the last call of compute used the temporal prior
+            virtual bool getTemporalPriorUsed() const = 0;
+
             /** @brief Creates StereoSGBM object
 
             @param minDisparity Minimum possible disparity value. Normally, it is zero but sometimes
@@ -260,8 +284,11 @@ namespace cv
             filtering, set the parameter to a positive value, it will be implicitly multiplied by 16.
             Normally, 1 or 2 is good enough.
             @param mode Set it to StereoSGBM::MODE_HH to run the full-scale two-pass dynamic programming
-            algorithm. It will consume O(W\*H\*numDisparities) bytes, which is large for 640x480 stereo and
-            huge for HD-size pictures. By default, it is set to false .
+            algorithm. MODE_SGBM and MODE_HH aggregate each direction in parallel over the whole cost volume,
+            they consume O(W\*H\*numDisparities) bytes, which is large for 640x480 stereo and huge for HD-size
+            pictures. MODE_SGBM_LEAN aggregates the directions of MODE_SGBM in parallel horizontal stripes of
+            the image, keeping only O(W\*numDisparities) bytes per stripe; the disparity can slightly differ
+            from MODE_SGBM at the borders of the stripes. By default, it is set to MODE_SGBM .
 
             The first constructor initializes StereoSGBM with all the default parameters. So, you only have to
             set StereoSGBM::numDisparities at minimum. The second constructor enables you to set each parameter
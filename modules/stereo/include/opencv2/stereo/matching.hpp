@@ -153,9 +153,15 @@ namespace cv
                 int v,kernelSize, width;
                 int MASK;
                 int *hammLut;
+                bool usePopcnt;
             public :
                 hammingDistance(const Mat &leftImage, const Mat &rightImage, short *cost, int maxDisp, int kerSize, int *hammingLUT):
-                    left((int *)leftImage.data), right((int *)rightImage.data), c(cost), v(maxDisp),kernelSize(kerSize),width(leftImage.cols), MASK(65535), hammLut(hammingLUT){}
+                    left((int *)leftImage.data), right((int *)rightImage.data), c(cost), v(maxDisp),kernelSize(kerSize),width(leftImage.cols), MASK(65535), hammLut(hammingLUT), usePopcnt(false)
+                {
+#if CV_POPCNT
+                    usePopcnt = checkHardwareSupport(CV_CPU_POPCNT);
+#endif
+                }
                 void operator()(const cv::Range &r) const {
                     for (int i = r.start; i <= r.end ; i++)
                     {
@@ -171,7 +177,7 @@ namespace cv
                                 j2 = (0 > j - d) ? (0) : (j - d);
                                 xorul = left[(iwj)] ^ right[(iw + j2)];
 #if CV_POPCNT
-                                if (checkHardwareSupport(CV_CPU_POPCNT))
+                                if (usePopcnt)
                                 {
                                     c[(iwj)* (v + 1) + d] = (short)_mm_popcnt_u32(xorul);
                                 }
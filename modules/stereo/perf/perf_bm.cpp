@@ -116,3 +116,71 @@ PERF_TEST_P( s_bm, bm_perf,
     }
     SANITY_CHECK(out1);
 }
+
+typedef std::tr1::tuple<Size, int, int> s_sgbm_mode_test_t;
+typedef perf::TestBaseWithParam<s_sgbm_mode_test_t> s_sgbm_mode;
+
+PERF_TEST_P( s_sgbm_mode, sgbm_mode_perf,
+            testing::Combine(
+            testing::Values( cv::Size(640, 480), cv::Size(1280, 960) ),
+            testing::Values( (int)StereoBinarySGBM::MODE_SGBM, (int)StereoBinarySGBM::MODE_HH,
+                             (int)StereoBinarySGBM::MODE_SGBM_LEAN ),
+            testing::Values( 64, 128 )
+            )
+            )
+{
+    Size sz = std::tr1::get<0>(GetParam());
+    int mode = std::tr1::get<1>(GetParam());
+    int numDisparities = std::tr1::get<2>(GetParam());
+
+    Mat left(sz, CV_8UC1);
+    Mat right(sz, CV_8UC1);
+    Mat out1(sz, CV_16S);
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, numDisparities, 5);
+    sgbm->setBinaryKernelType(CV_DENSE_CENSUS);
+    sgbm->setMode(mode);
+    declare.in(left, right, WARMUP_RNG)
+        .out(out1)
+        .time(0.5)
+        .iterations(10);
+    TEST_CYCLE()
+    {
+        sgbm->compute(left, right, out1);
+    }
+    SANITY_CHECK_NOTHING();
+}
+
+typedef std::tr1::tuple<Size, int> s_sgbm_temporal_test_t;
+typedef perf::TestBaseWithParam<s_sgbm_temporal_test_t> s_sgbm_temporal;
+
+PERF_TEST_P( s_sgbm_temporal, sgbm_temporal_perf,
+            testing::Combine(
+            testing::Values( cv::Size(640, 480), cv::Size(1280, 960) ),
+            testing::Values( 0, 16, 32 )
+            )
+            )
+{
+    Size sz = std::tr1::get<0>(GetParam());
+    int temporalNumDisparities = std::tr1::get<1>(GetParam());
+
+    // a textured scene at disparity 24, for the disparities of each frame to be a valid prior
+    Mat scene(sz.height, sz.width + 24, CV_8UC1);
+    randu(scene, 0, 256);
+    GaussianBlur(scene, scene, Size(3, 3), 0);
+    Mat left = scene(Rect(0, 0, sz.width, sz.height)).clone();
+    Mat right = scene(Rect(24, 0, sz.width, sz.height)).clone();
+    Mat out1(sz, CV_16S);
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, 64, 5);
+    sgbm->setBinaryKernelType(CV_DENSE_CENSUS);
+    sgbm->setTemporalNumDisparities(temporalNumDisparities);
+    sgbm->compute(left, right, out1);
+    declare.in(left, right)
+        .out(out1)
+        .time(0.5)
+        .iterations(10);
+    TEST_CYCLE()
+    {
+        sgbm->compute(left, right, out1);
+    }
+    SANITY_CHECK_NOTHING();
+}
@@ -141,3 +141,91 @@ PERF_TEST_P( descript_params, center_symetric_census,
     }
     SANITY_CHECK(out1);
 }
+
+typedef std::tr1::tuple<Size, int> descript_kernel_params_t;
+typedef perf::TestBaseWithParam<descript_kernel_params_t> descript_kernel_params;
+
+PERF_TEST_P( descript_kernel_params, census_dense_kernel_size,
+            testing::Combine(
+            testing::Values( szVGA, sz720p ),
+            testing::Values( 3, 5 )
+            )
+            )
+{
+    Size sz = std::tr1::get<0>(GetParam());
+    int kernelSize = std::tr1::get<1>(GetParam());
+
+    Mat left(sz, CV_8UC1);
+    Mat out1(sz, CV_32S, Scalar::all(0));
+
+    declare.in(left, WARMUP_RNG)
+        .out(out1);
+    TEST_CYCLE()
+    {
+        censusTransform(left,kernelSize,out1,CV_DENSE_CENSUS);
+    }
+    SANITY_CHECK_NOTHING();
+}
+PERF_TEST_P( descript_kernel_params, census_sparse_kernel_size,
+            testing::Combine(
+            testing::Values( szVGA, sz720p ),
+            testing::Values( 5, 7, 9, 11 )
+            )
+            )
+{
+    Size sz = std::tr1::get<0>(GetParam());
+    int kernelSize = std::tr1::get<1>(GetParam());
+
+    Mat left(sz, CV_8UC1), right(sz, CV_8UC1);
+    Mat out1(sz, CV_32S, Scalar::all(0)), out2(sz, CV_32S, Scalar::all(0));
+
+    declare.in(left, right, WARMUP_RNG)
+        .out(out1, out2);
+    TEST_CYCLE()
+    {
+        censusTransform(left,right,kernelSize,out1,out2,CV_SPARSE_CENSUS);
+    }
+    SANITY_CHECK_NOTHING();
+}
+PERF_TEST_P( descript_kernel_params, modified_census_kernel_size,
+            testing::Combine(
+            testing::Values( szVGA, sz720p ),
+            testing::Values( 3, 5, 7, 9 )
+            )
+            )
+{
+    Size sz = std::tr1::get<0>(GetParam());
+    int kernelSize = std::tr1::get<1>(GetParam());
+
+    Mat left(sz, CV_8UC1);
+    Mat out1(sz, CV_32S, Scalar::all(0));
+
+    declare.in(left, WARMUP_RNG)
+        .out(out1);
+    TEST_CYCLE()
+    {
+        modifiedCensusTransform(left,kernelSize,out1,CV_MODIFIED_CENSUS_TRANSFORM,4);
+    }
+    SANITY_CHECK_NOTHING();
+}
+PERF_TEST_P( descript_kernel_params, center_symetric_census_kernel_size,
+            testing::Combine(
+            testing::Values( szVGA, sz720p ),
+            testing::Values( 3, 5, 7 )
+            )
+            )
+{
+    Size sz = std::tr1::get<0>(GetParam());
+    int kernelSize = std::tr1::get<1>(GetParam());
+
+    Mat left(sz, CV_8UC1);
+    Mat out1(sz, CV_32S, Scalar::all(0));
+
+    declare.in(left, WARMUP_RNG)
+        .out(out1);
+    TEST_CYCLE()
+    {
+        symetricCensusTransform(left,kernelSize,out1,CV_CS_CENSUS);
+    }
+    SANITY_CHECK_NOTHING();
+}
@@ -44,11 +44,177 @@
 *                             The file contains the implemented descriptors                                       *
 \******************************************************************************************************************/
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include <vector>
 
 namespace cv
 {
     namespace stereo
     {
+        //Computes descriptors given as a list of comparisons image[center + a] > image[center + b] - t, each one
+        //adding one bit (census like descriptors) or two bits (MCT) to the 32 bits of the pixel, the first
+        //comparisons being shifted out if there are too many of them.
+        //16 pixels of a row are compared at once, the bits of 8 consecutive comparisons (4 for MCT) are gathered
+        //in one byte which is then shifted at its place in the descriptor.
+        class PackedDescriptorInvoker : public ParallelLoopBody
+        {
+        public:
+            PackedDescriptorInvoker(const Mat *images, int **distance, int nrImages, const std::vector<Point> &a,
+                                    const std::vector<Point> &b, int bitsPerComparison, int threshold, int colStart, int colEnd)
+                : nrImages_(nrImages), stride_((int)images[0].step), bits_(bitsPerComparison), t_(threshold),
+                  colStart_(colStart), colEnd_(colEnd)
+            {
+                CV_Assert(nrImages <= 2 && a.size() == b.size());
+                CV_Assert(bitsPerComparison == 1 || bitsPerComparison == 2);
+                for(int i = 0; i < nrImages; i++)
+                {
+                    image_[i] = images[i].data;
+                    dst_[i] = distance[i];
+                }
+                nr_ = (int)a.size();
+                //only the last comparisons are left in the 32 bits
+                first_ = std::max(nr_ - (bits_ == 1 ? 31 : 16), 0);
+                for(int k = 0; k < nr_; k++)
+                {
+                    offsetA_.push_back(a[k].y * stride_ + a[k].x);
+                    offsetB_.push_back(b[k].y * stride_ + b[k].x);
+                }
+            }
+            void operator()(const Range &r) const
+            {
+                for (int i = r.start; i < r.end; i++)
+                {
+                    for(int d = 0; d < nrImages_; d++)
+                    {
+                        const uint8_t *row = image_[d] + i * stride_;
+                        int *out = dst_[d] + i * stride_;
+                        int j = colStart_;
+#if CV_SIMD128
+                        for (; j <= colEnd_ - 16; j += 16)
+                            computeBlock(row + j, out + j);
+#endif
+                        for (; j < colEnd_; j++)
+                            out[j] = computePixel(row + j);
+                    }
+                }
+            }
+        private:
+            int computePixel(const uint8_t *p) const
+            {
+                unsigned c = 0;
+                if (bits_ == 1)
+                {
+                    for (int k = first_; k < nr_; k++)
+                    {
+                        if (p[offsetA_[k]] > p[offsetB_[k]] - t_)
+                            c += 1;
+                        c <<= 1;
+                    }
+                }
+                else
+                {
+                    for (int k = first_; k < nr_; k++)
+                    {
+                        c <<= 2;
+                        if (p[offsetA_[k]] > p[offsetB_[k]] - t_)
+                            c += 3;
+                    }
+                }
+                return (int)c;
+            }
+#if CV_SIMD128
+            void computeBlock(const uint8_t *p, int *out) const
+            {
+                const int perByte = 8 / bits_;
+                //a > b - t is computed with saturated differences
+                const v_uint8x16 vt = v_setall_u8((uchar)std::min(std::abs(t_), 255));
+                const v_uint8x16 vforce = v_setall_u8((uchar)(t_ > 255 ? 255 : 0));
+                v_uint8x16 vbit[8];
+                for (int q = 0; q < perByte; q++)
+                    vbit[q] = v_setall_u8((uchar)(bits_ == 1 ? 1 << (7 - q) : 3 << (2 * (3 - q))));
+                v_uint32x4 c0 = v_setzero_u32(), c1 = v_setzero_u32(), c2 = v_setzero_u32(), c3 = v_setzero_u32();
+                for (int k0 = first_; k0 < nr_; k0 += perByte)
+                {
+                    const int kEnd = std::min(k0 + perByte, nr_);
+                    v_uint8x16 byte = v_setzero_u8();
+                    for (int k = k0; k < kEnd; k++)
+                    {
+                        v_uint8x16 va = v_load(p + offsetA_[k]), vb = v_load(p + offsetB_[k]);
+                        v_uint8x16 mask = t_ > 0 ? ((vb - va) < vt) | vforce : (va - vb) > vt;
+                        byte = byte | (mask & vbit[k - k0]);
+                    }
+                    //position of the lowest bit of the byte in the descriptor
+                    const int shift = bits_ == 1 ? nr_ - k0 - 7 : 2 * (nr_ - k0 - 4);
+                    v_uint16x8 w0, w1;
+                    v_uint32x4 d0, d1, d2, d3;
+                    v_expand(byte, w0, w1);
+                    v_expand(w0, d0, d1);
+                    v_expand(w1, d2, d3);
+                    if (shift >= 0)
+                    {
+                        c0 = c0 | (d0 << shift);
+                        c1 = c1 | (d1 << shift);
+                        c2 = c2 | (d2 << shift);
+                        c3 = c3 | (d3 << shift);
+                    }
+                    else
+                    {
+                        c0 = c0 | (d0 >> -shift);
+                        c1 = c1 | (d1 >> -shift);
+                        c2 = c2 | (d2 >> -shift);
+                        c3 = c3 | (d3 >> -shift);
+                    }
+                }
+                v_store(out, v_reinterpret_as_s32(c0));
+                v_store(out + 4, v_reinterpret_as_s32(c1));
+                v_store(out + 8, v_reinterpret_as_s32(c2));
+                v_store(out + 12, v_reinterpret_as_s32(c3));
+            }
+#endif
+            const uint8_t *image_[2];
+            int *dst_[2];
+            int nrImages_, stride_, bits_, t_, colStart_, colEnd_;
+            int nr_, first_;
+            std::vector<int> offsetA_, offsetB_;
+        };
+        //comparisons of the window pixels with the center, in the order of CombinedDescriptor
+        static void windowComparisons(int n2, int stepStart, int stepEnd, int stepInc, std::vector<Point> &a, std::vector<Point> &b)
+        {
+            for(int step = stepStart; step <= stepEnd; step += stepInc)
+            {
+                for (int ii = -n2; ii <= n2; ii += step)
+                {
+                    for (int jj = -n2; jj <= n2; jj += step)
+                    {
+                        a.push_back(Point(jj, ii));
+                        b.push_back(Point(0, 0));
+                    }
+                }
+            }
+        }
+        //comparisons of the pixels of the upper half of the window with their symetric, in the order of SymetricCensus
+        static void symetricComparisons(int n2, std::vector<Point> &a, std::vector<Point> &b)
+        {
+            for (int ii = -n2; ii <= 0; ii++)
+            {
+                for (int jj = -n2; jj <= n2; jj++)
+                {
+                    a.push_back(Point(jj, ii));
+                    b.push_back(Point(-jj, -ii));
+                    if(ii == 0 && jj < 0)
+                    {
+                        a.push_back(Point(jj, ii));
+                        b.push_back(Point(-jj, -ii));
+                    }
+                }
+            }
+        }
+        static void packedDescriptor(const Mat *images, int **distance, int nrImages, int n2, const std::vector<Point> &a,
+                                     const std::vector<Point> &b, int bitsPerComparison, int threshold, int colStart, int colEnd)
+        {
+            parallel_for_(Range(n2, images[0].rows - n2),
+                PackedDescriptorInvoker(images, distance, nrImages, a, b, bitsPerComparison, threshold, colStart, colEnd));
+        }
         //function that performs the census transform on two images.
         //Two variants of census are offered a sparse version whcih takes every second pixel as well as dense version
         CV_EXPORTS void censusTransform(const Mat &image1, const Mat &image2, int kernelSize, Mat &dist1, Mat &dist2, const int type)
@@ -59,18 +225,18 @@ namespace cv
             CV_Assert(type != CV_DENSE_CENSUS || type != CV_SPARSE_CENSUS);
             CV_Assert(kernelSize <= ((type == 0) ? 5 : 11));
             int n2 = (kernelSize) / 2;
-            uint8_t *images[] = {image1.data, image2.data};
+            Mat images[] = {image1, image2};
             int *costs[] = {(int *)dist1.data,(int *)dist2.data};
-            int stride = (int)image1.step;
+            std::vector<Point> a, b;
             if(type == CV_DENSE_CENSUS)
             {
-                parallel_for_(  Range(n2, image1.rows - n2),
-                    CombinedDescriptor<1,1,1,2,CensusKernel<2> >(image1.cols, image1.rows,stride,n2,costs,CensusKernel<2>(images),n2));
+                windowComparisons(n2, 1, 1, 1, a, b);
+                packedDescriptor(images, costs, 2, n2, a, b, 1, 0, n2 + 2, image1.cols - n2 - 1);
             }
             else if(type == CV_SPARSE_CENSUS)
             {
-                parallel_for_( Range(n2, image1.rows - n2),
-                    CombinedDescriptor<2,2,1,2,CensusKernel<2> >(image1.cols, image1.rows, stride,n2,costs,CensusKernel<2>(images),n2));
+                windowComparisons(n2, 2, 2, 1, a, b);
+                packedDescriptor(images, costs, 2, n2, a, b, 1, 0, n2 + 2, image1.cols - n2 - 1);
             }
         }
         //function that performs census on one image
@@ -82,18 +248,18 @@ namespace cv
             CV_Assert(type != CV_DENSE_CENSUS || type != CV_SPARSE_CENSUS);
             CV_Assert(kernelSize <= ((type == 0) ? 5 : 11));
             int n2 = (kernelSize) / 2;
-            uint8_t *images[] = {image1.data};
+            Mat images[] = {image1};
             int *costs[] = {(int *)dist1.data};
-            int stride = (int)image1.step;
+            std::vector<Point> a, b;
             if(type == CV_DENSE_CENSUS)
             {
-                parallel_for_( Range(n2, image1.rows - n2),
-                    CombinedDescriptor<1,1,1,1,CensusKernel<1> >(image1.cols, image1.rows,stride,n2,costs,CensusKernel<1>(images),n2));
+                windowComparisons(n2, 1, 1, 1, a, b);
+                packedDescriptor(images, costs, 1, n2, a, b, 1, 0, n2 + 2, image1.cols - n2 - 1);
             }
             else if(type == CV_SPARSE_CENSUS)
             {
-                parallel_for_( Range(n2, image1.rows - n2),
-                    CombinedDescriptor<2,2,1,1,CensusKernel<1> >(image1.cols, image1.rows,stride,n2,costs,CensusKernel<1>(images),n2));
+                windowComparisons(n2, 2, 2, 1, a, b);
+                packedDescriptor(images, costs, 1, n2, a, b, 1, 0, n2 + 2, image1.cols - n2 - 1);
             }
         }
         //in a 9x9 kernel only certain positions are choosen for comparison
@@ -139,8 +305,10 @@ namespace cv
             if(type == CV_MODIFIED_CENSUS_TRANSFORM)
             {
                 //MCT
-                parallel_for_(  Range(n2, img1.rows - n2),
-                    CombinedDescriptor<2,4,2, 2,MCTKernel<2> >(img1.cols, img1.rows,stride,n2,date,MCTKernel<2>(images,t),n2));
+                Mat imag[] = {img1, img2};
+                std::vector<Point> a, b;
+                windowComparisons(n2, 2, 4, 2, a, b);
+                packedDescriptor(imag, date, 2, n2, a, b, 2, t, n2 + 2, img1.cols - n2 - 1);
             }
             else if(type == CV_MEAN_VARIATION)
             {
@@ -166,8 +334,10 @@ namespace cv
             if(type == CV_MODIFIED_CENSUS_TRANSFORM)
             {
                 //MCT
-                parallel_for_(Range(n2, img1.rows - n2),
-                    CombinedDescriptor<2,4,2, 1,MCTKernel<1> >(img1.cols, img1.rows,stride,n2,date,MCTKernel<1>(images,t),n2));
+                Mat imag[] = {img1};
+                std::vector<Point> a, b;
+                windowComparisons(n2, 2, 4, 2, a, b);
+                packedDescriptor(imag, date, 1, n2, a, b, 2, t, n2 + 2, img1.cols - n2 - 1);
             }
             else if(type == CV_MEAN_VARIATION)
             {
@@ -193,7 +363,9 @@ namespace cv
             int stride = (int)img1.step;
             if(type == CV_CS_CENSUS)
             {
-                parallel_for_(Range(n2, img1.rows - n2), SymetricCensus<2>(imag, n2,date));
+                std::vector<Point> a, b;
+                symetricComparisons(n2, a, b);
+                packedDescriptor(imag, date, 2, n2, a, b, 1, 0, n2, img1.cols - n2);
             }
             else if(type == CV_MODIFIED_CS_CENSUS)
             {
@@ -215,7 +387,9 @@ namespace cv
             int stride = (int)img1.step;
             if(type == CV_CS_CENSUS)
             {
-                parallel_for_( Range(n2, img1.rows - n2), SymetricCensus<1>(imag, n2,date));
+                std::vector<Point> a, b;
+                symetricComparisons(n2, a, b);
+                packedDescriptor(imag, date, 1, n2, a, b, 1, 0, n2, img1.cols - n2);
             }
             else if(type == CV_MODIFIED_CS_CENSUS)
             {
@@ -49,6 +49,7 @@ SGBM (Semi-global block matching)
 */
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <limits.h>
 
 namespace cv
@@ -58,7 +59,6 @@ namespace cv
         typedef uchar PixType;
         typedef short CostType;
         typedef short DispType;
-        enum { NR = 16, NR2 = NR/2 };
 
         struct StereoBinarySGBMParams
         {
@@ -73,6 +73,7 @@ namespace cv
                 speckleWindowSize = 0;
                 speckleRange = 0;
                 mode = StereoBinarySGBM::MODE_SGBM;
+                temporalNumDisparities = 0;
             }
             StereoBinarySGBMParams( int _minDisparity, int _numDisparities, int _SADWindowSize,
                 int _P1, int _P2, int _disp12MaxDiff, int _preFilterCap,
@@ -93,6 +94,7 @@ namespace cv
                 regionRemoval = 1;
                 kernelType = CV_MODIFIED_CENSUS_TRANSFORM;
                 subpixelInterpolationMethod = CV_QUADRATIC_INTERPOLATION;
+                temporalNumDisparities = 0;
             }
             int minDisparity;
             int numDisparities;
@@ -108,522 +110,822 @@ namespace cv
             int regionRemoval;
             int kernelType;
             int subpixelInterpolationMethod;
+            int temporalNumDisparities;
         };
 
         /*
-        computes disparity for "roi" in img1 w.r.t. img2 and write it to disp1buf.
-        that is, disp1buf(x, y)=d means that img1(x+roi.x, y+roi.y) ~ img2(x+roi.x-d, y+roi.y).
-        minD <= d < maxD.
-        disp2full is the reverse disparity map, that is:
-        disp2full(x+roi.x,y+roi.y)=d means that img2(x+roi.x, y+roi.y) ~ img1(x+roi.x+d, y+roi.y)
-        note that disp1buf will have the same size as the roi and
-        disp2full will have the same size as img1 (or img2).
-        On exit disp2buf is not the final disparity, it is an intermediate result that becomes
-        final after all the tiles are processed.
-        the disparity in disp1buf is written with sub-pixel accuracy
-        (4 fractional bits, see StereoSGBM::DISP_SCALE),
-        using quadratic interpolation, while the disparity in disp2buf
-        is written as is, without interpolation.
-        disp2cost also has the same size as img1 (or img2).
-        It contains the minimum current cost, used to find the best disparity, corresponding to the minimal cost.
+        The matching cost is the Hamming distance between the census descriptors of img1(x, y) and
+        img2(x-d, y), summed over a kernelSize x kernelSize block. It is aggregated along several
+        directions r as in [formula 13 in the paper]:
+
+        L_r(p, d) = C(p, d) +
+        min(L_r(p-r, d),
+        L_r(p-r, d-1) + P1,
+        L_r(p-r, d+1) + P1,
+        min_k L_r(p-r, k) + P2) - min_k L_r(p-r, k)
+
+        and the disparity of p minimizes S(p, d) = sum_r L_r(p, d).
+        MODE_SGBM uses the 5 directions from the left, the upper left, the top, the upper right and
+        the right, MODE_HH adds the 3 directions from below.
+
+        MODE_SGBM and MODE_HH store C and S for the whole image and run each direction in parallel:
+        the horizontal directions over the rows, the other ones over tiles of the paths parallel to
+        the direction. MODE_SGBM_LEAN runs the 5 directions of MODE_SGBM in a single sweep over the
+        rows, only keeping the rows of C, S and L_r that the sweep needs, in parallel over horizontal
+        stripes of the image. The paths from the top start a few rows above each stripe, so the
+        disparity can slightly differ from MODE_SGBM at the stripe borders.
+
+        With the temporal prior, C, S and L_r only keep a window of costD < D disparities per pixel,
+        starting at the disparity base(p) (relative to minD) given by the disparity of the previous
+        frame. base varies along the paths, L_r(p-r, .) is then shifted by base(p) - base(p-r) to be
+        indexed by the disparities of the window of p, the disparities outside of the window of p-r
+        costing MAX_COST.
+
+        disp1(x, y)=d means that img1(x, y) ~ img2(x-d, y), minD <= d < maxD.
+        It is written with sub-pixel accuracy (4 fractional bits, see StereoMatcher::DISP_SCALE).
+        The left-right check uses the reverse disparity of each row, disp2(x, y)=d meaning that
+        img2(x, y) ~ img1(x+d, y), and the minimum cost of disp2.
         */
-        static void computeDisparityBinarySGBM( const Mat& img1, const Mat& img2,
-            Mat& disp1, const StereoBinarySGBMParams& params,
-            Mat& buffer,const Mat& hamDist)
+        static const CostType MAX_COST = SHRT_MAX;
+
+        // the Hamming distances are only computed away from the image borders, as
+        // Matching::hammingDistanceBlockMatching does with its default 9x9 kernel
+        static const int HAMMING_BORDER = 4;
+
+        // number of rows above each stripe of MODE_SGBM_LEAN that the paths from the top start from
+        static const int LEAN_STRIPE_OVERLAP = 16;
+
+        // the temporal prior is not used if the previous disparity has more holes than this, and the
+        // full range is searched again if more disparities than this are at the border of their window
+        static const double TEMPORAL_MAX_HOLES_RATIO = 0.3;
+        static const double TEMPORAL_MAX_BORDER_RATIO = 0.05;
+
+        static inline int hammingWeight(unsigned v)
         {
-#if CV_SSE2
-            static const uchar LSBTab[] =
-            {
-                0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
-                5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
-            };
-
-            volatile bool useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+            v = v - ((v >> 1) & 0x55555555);
+            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+            return (int)((((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+        }
+
+        struct SGBMGeometry
+        {
+            SGBMGeometry(const StereoBinarySGBMParams& params, const Size& size)
+            {
+                minD = params.minDisparity;
+                maxD = minD + params.numDisparities;
+                D = maxD - minD;
+                width = size.width;
+                height = size.height;
+                minX1 = std::max(-maxD, 0);
+                maxX1 = width + std::min(minD, 0);
+                width1 = maxX1 - minX1;
+                int kernelSize = params.kernelSize > 0 ? params.kernelSize : 5;
+                SW2 = SH2 = kernelSize/2;
+                uniquenessRatio = params.uniquenessRatio >= 0 ? params.uniquenessRatio : 10;
+                disp12MaxDiff = params.disp12MaxDiff > 0 ? params.disp12MaxDiff : 1;
+                P1 = params.P1 > 0 ? params.P1 : 2;
+                P2 = std::max(params.P2 > 0 ? params.P2 : 5, P1+1);
+                subpixelInterpolationMethod = params.subpixelInterpolationMethod;
+                costD = D;
+            }
+            int minD, maxD, D;
+            // number of disparities per pixel in C, S and L_r: D, or the window size of the temporal prior
+            int costD;
+            int width, height, minX1, maxX1, width1;
+            int SW2, SH2;
+            int uniquenessRatio, disp12MaxDiff;
+            int P1, P2;
+            int subpixelInterpolationMethod;
+        };
+
+        /*
+        Computes the rows of C, plus P2 (it saves a few operations in the aggregation), the image being
+        extended by replicating its border rows and columns. The sums of the Hamming distances over the
+        kernel width are kept for the last SH2*2 + 2 rows, so that C can be updated from one row to the next.
+        */
+        class BlockCostRows
+        {
+        public:
+            BlockCostRows(const Mat& census1, const Mat& census2, const SGBMGeometry& g)
+                : left((const int*)census1.data), right((const int*)census2.data), geom(g)
+            {
+                const int rowSize = g.width1*g.D;
+                nrows = g.SH2*2 + 2;
+                pixDiff.resize(rowSize);
+                hsumBuf.resize(rowSize*nrows);
+                hsumRow.assign(nrows, -1);
+#if CV_POPCNT
+                usePopcnt = checkHardwareSupport(CV_CPU_POPCNT);
 #endif
+            }
 
-            const int ALIGN = 16;
-            const int DISP_SHIFT = StereoMatcher::DISP_SHIFT;
-            const int DISP_SCALE = (1 << DISP_SHIFT);
-            const CostType MAX_COST = SHRT_MAX;
-            int minD = params.minDisparity, maxD = minD + params.numDisparities;
-            Size kernelSize;
-            kernelSize.width = kernelSize.height = params.kernelSize > 0 ? params.kernelSize : 5;
-            int uniquenessRatio = params.uniquenessRatio >= 0 ? params.uniquenessRatio : 10;
-            int disp12MaxDiff = params.disp12MaxDiff > 0 ? params.disp12MaxDiff : 1;
-            int P1 = params.P1 > 0 ? params.P1 : 2, P2 = std::max(params.P2 > 0 ? params.P2 : 5, P1+1);
-            int k, width = disp1.cols, height = disp1.rows;
-            int minX1 = std::max(-maxD, 0), maxX1 = width + std::min(minD, 0);
-            int D = maxD - minD, width1 = maxX1 - minX1;
-            int INVALID_DISP = minD - 1, INVALID_DISP_SCALED = INVALID_DISP*DISP_SCALE;
-            int SW2 = kernelSize.width/2, SH2 = kernelSize.height/2;
-            bool fullDP = params.mode == StereoBinarySGBM::MODE_HH;
-            int npasses = fullDP ? 2 : 1;
-
-            if( minX1 >= maxX1 )
-            {
-                disp1 = Scalar::all(INVALID_DISP_SCALED);
-                return;
+            // Computes the row y of C, from the row y-1 in Cprev if it is not null (Cprev can be equal to C)
+            void compute(int y, const CostType* Cprev, CostType* C)
+            {
+                const int rowSize = geom.width1*geom.D;
+                if( !Cprev )
+                {
+                    for( int k = 0; k < rowSize; k++ )
+                        C[k] = (CostType)geom.P2;
+                    for( int k = y - geom.SH2; k <= y + geom.SH2; k++ )
+                    {
+                        const CostType* hsum = hsumRowPtr(k);
+                        for( int x = 0; x < rowSize; x++ )
+                            C[x] = (CostType)(C[x] + hsum[x]);
+                    }
+                    return;
+                }
+
+                const CostType* hsumAdd = hsumRowPtr(y + geom.SH2);
+                const CostType* hsumSub = hsumRowPtr(y - geom.SH2 - 1);
+                int x = 0;
+#if CV_SIMD128
+                for( ; x <= rowSize - 8; x += 8 )
+                    v_store(C + x, (v_load(Cprev + x) - v_load(hsumSub + x)) + v_load(hsumAdd + x));
+#endif
+                for( ; x < rowSize; x++ )
+                    C[x] = (CostType)(Cprev[x] + hsumAdd[x] - hsumSub[x]);
             }
-            CV_Assert( D % 16 == 0 );
-            // NR - the number of directions. the loop on x below that computes Lr assumes that NR == 8.
-            // if you change NR, please, modify the loop as well.
-            int D2 = D+16, NRD2 = NR2*D2;
-            // the number of L_r(.,.) and min_k L_r(.,.) lines in the buffer:
-            // for 8-way dynamic programming we need the current row and
-            // the previous row, i.e. 2 rows in total
-            const int NLR = 2;
-            const int LrBorder = NLR - 1;
-            int ww = img2.cols;
-            short *ham;
-            ham = (short *)hamDist.data;
-            // for each possible stereo match (img1(x,y) <=> img2(x-d,y))
-            // we keep pixel difference cost (C) and the summary cost over NR directions (S).
-            // we also keep all the partial costs for the previous line L_r(x,d) and also min_k L_r(x, k)
-            size_t costBufSize = width1*D;
-            size_t CSBufSize = costBufSize*(fullDP ? height : 1);
-            size_t minLrSize = (width1 + LrBorder*2)*NR2, LrSize = minLrSize*D2;
-            int hsumBufNRows = SH2*2 + 2;
-            size_t totalBufSize = (LrSize + minLrSize)*NLR*sizeof(CostType) + // minLr[] and Lr[]
-                costBufSize*(hsumBufNRows + 1)*sizeof(CostType) + // hsumBuf, pixdiff
-                CSBufSize*2*sizeof(CostType) + // C, S
-                width*16*img1.channels()*sizeof(PixType) + // temp buffer for computing per-pixel cost
-                width*(sizeof(CostType) + sizeof(DispType)) + 1024; // disp2cost + disp2
-            if( buffer.empty() || !buffer.isContinuous() ||
-                buffer.cols*buffer.rows*buffer.elemSize() < totalBufSize )
-                buffer.create(1, (int)totalBufSize, CV_8U);
-            // summary cost over different (nDirs) directions
-            CostType* Cbuf = (CostType*)alignPtr(buffer.ptr(), ALIGN);
-            CostType* Sbuf = Cbuf + CSBufSize;
-            CostType* hsumBuf = Sbuf + CSBufSize;
-            CostType* pixDiff = hsumBuf + costBufSize*hsumBufNRows;
-            CostType* disp2cost = pixDiff + costBufSize + (LrSize + minLrSize)*NLR;
-            DispType* disp2ptr = (DispType*)(disp2cost + width);
-            //            PixType* tempBuf = (PixType*)(disp2ptr + width);
-            // add P2 to every C(x,y). it saves a few operations in the inner loops
-            for( k = 0; k < width1*D; k++ )
-                Cbuf[k] = (CostType)P2;
-            for( int pass = 1; pass <= npasses; pass++ )
-            {
-                int x1, y1, x2, y2, dx, dy;
-                if( pass == 1 )
+
+        private:
+            // the sum over the kernel width of the row k, replicated outside of the image
+            const CostType* hsumRowPtr(int k)
+            {
+                k = std::min(std::max(k, 0), geom.height - 1);
+                const int D = geom.D, width1 = geom.width1, SW2 = geom.SW2;
+                CostType* hsum = &hsumBuf[(k % nrows)*width1*D];
+                if( hsumRow[k % nrows] == k )
+                    return hsum;
+                hsumRow[k % nrows] = k;
+
+                computeHammingRow(k);
+                memset(hsum, 0, D*sizeof(CostType));
+                for( int x = -SW2; x <= SW2; x++ )
                 {
-                    y1 = 0; y2 = height; dy = 1;
-                    x1 = 0; x2 = width1; dx = 1;
+                    const CostType* pix = &pixDiff[std::min(std::max(x, 0), width1 - 1)*D];
+                    for( int d = 0; d < D; d++ )
+                        hsum[d] = (CostType)(hsum[d] + pix[d]);
                 }
-                else
+                for( int x = 1; x < width1; x++ )
+                {
+                    const CostType* pixAdd = &pixDiff[std::min(x + SW2, width1 - 1)*D];
+                    const CostType* pixSub = &pixDiff[std::max(x - SW2 - 1, 0)*D];
+                    CostType* h = hsum + x*D;
+                    for( int d = 0; d < D; d++ )
+                        h[d] = (CostType)(h[d - D] + pixAdd[d] - pixSub[d]);
+                }
+                return hsum;
+            }
+
+            void computeHammingRow(int y)
+            {
+                const int D = geom.D, width = geom.width;
+                memset(&pixDiff[0], 0, pixDiff.size()*sizeof(CostType));
+                if( y < HAMMING_BORDER || y > geom.height - HAMMING_BORDER )
+                    return;
+                const int* l = left + y*width;
+                const int* r = right + y*width;
+                const int xEnd = std::min(width - HAMMING_BORDER, geom.maxX1);
+                for( int x = std::max(HAMMING_BORDER, geom.minX1); x < xEnd; x++ )
                 {
-                    y1 = height-1; y2 = -1; dy = -1;
-                    x1 = width1-1; x2 = -1; dx = -1;
+                    CostType* pix = &pixDiff[(x - geom.minX1)*D];
+                    const unsigned lx = (unsigned)l[x];
+#if CV_POPCNT
+                    if( usePopcnt )
+                    {
+                        for( int d = 0; d < D; d++ )
+                            pix[d] = (CostType)_mm_popcnt_u32(lx ^ (unsigned)r[std::max(x - d, 0)]);
+                        continue;
+                    }
+#endif
+                    for( int d = 0; d < D; d++ )
+                        pix[d] = (CostType)hammingWeight(lx ^ (unsigned)r[std::max(x - d, 0)]);
                 }
-                CostType *Lr[NLR]={0}, *minLr[NLR]={0};
-                for( k = 0; k < NLR; k++ )
+            }
+
+            const int* left;
+            const int* right;
+            SGBMGeometry geom;
+            int nrows;
+            std::vector<CostType> pixDiff;
+            std::vector<CostType> hsumBuf;
+            std::vector<int> hsumRow;
+#if CV_POPCNT
+            bool usePopcnt;
+#endif
+        };
+
+        /*
+        One step along a path: computes L_r(p, .) from Lprev = L_r(p-r, .), which must be MAX_COST at
+        the indices -1 and D, and from minLprev = min_k L_r(p-r, k). L_r(p, .) is stored in Lp and added
+        to Sp. The path starts with Lprev = 0 and minLprev = 0. Returns min_k L_r(p, k).
+        */
+        static inline int aggregateStep(const CostType* Cp, const CostType* Lprev, int minLprev,
+                                        CostType* Lp, CostType* Sp, int D, int P1, int P2)
+        {
+            const int delta = minLprev + P2;
+            int d = 0, minL = MAX_COST;
+#if CV_SIMD128
+            v_int16x8 _P1 = v_setall_s16((short)P1), _delta = v_setall_s16((short)delta);
+            v_int16x8 _minL = v_setall_s16((short)MAX_COST);
+            for( ; d <= D - 8; d += 8 )
+            {
+                v_int16x8 L = v_load(Lprev + d);
+                L = v_min(L, v_load(Lprev + d - 1) + _P1);
+                L = v_min(L, v_load(Lprev + d + 1) + _P1);
+                L = v_min(L, _delta);
+                L = (L - _delta) + v_load(Cp + d);
+                v_store(Lp + d, L);
+                _minL = v_min(_minL, L);
+                v_store(Sp + d, v_load(Sp + d) + L);
+            }
+            minL = v_reduce_min(_minL);
+#endif
+            for( ; d < D; d++ )
+            {
+                int L = Cp[d] + std::min((int)Lprev[d], std::min(Lprev[d-1] + P1, std::min(Lprev[d+1] + P1, delta))) - delta;
+                Lp[d] = (CostType)L;
+                minL = std::min(minL, L);
+                Sp[d] = saturate_cast<CostType>(Sp[d] + L);
+            }
+            return minL;
+        }
+
+        /*
+        Buffer of the L_r of n paths, each one with MAX_COST before and after its D values,
+        and of their minimum. The values of the paths are initialized to 0.
+        With shifted = true, there are D + 8 MAX_COST values on each side, for the shifts of windowShift.
+        */
+        class PathStates
+        {
+        public:
+            PathStates(int n, int D, bool shifted = false) : pad(shifted ? D + 8 : 8), D2(D + pad*2)
+            {
+                // L_r(., d) is at index pad + d: the vectors of 8 costs stay aligned, and index pad - 1 is d=-1
+                buf.assign((size_t)n*D2, MAX_COST);
+                minL.assign(n, 0);
+                for( int i = 0; i < n; i++ )
+                    memset(L(i), 0, D*sizeof(CostType));
+            }
+            CostType* L(int i) { return &buf[i*D2 + pad]; }
+            int pad, D2;
+            std::vector<CostType> buf;
+            std::vector<int> minL;
+        };
+
+        /*
+        Offset of L_r(p-r, .) for it to be indexed by the disparities of the window of p, from the bases
+        of the windows of p and p-r. basePrev < 0 is the initial state of a path, which is 0 everywhere.
+        Beyond D + 1, all the values read are MAX_COST.
+        */
+        static inline int windowShift(int base, int basePrev, int D)
+        {
+            return basePrev < 0 ? 0 : std::min(std::max(base - basePrev, -D - 1), D + 1);
+        }
+
+        // aggregation of a row from the left (dx = 1) or from the right (dx = -1), B being the bases of
+        // the windows of the temporal prior or null
+        static void aggregateRow(const CostType* C, const short* B, CostType* S, PathStates& states,
+                                 const SGBMGeometry& g, int dx)
+        {
+            const int D = g.costD, width1 = g.width1;
+            int prev = 0, minL = 0, basePrev = -1;
+            memset(states.L(prev), 0, D*sizeof(CostType));
+            for( int i = 0; i < width1; i++ )
+            {
+                int x = dx > 0 ? i : width1 - 1 - i;
+                int shift = 0;
+                if( B )
                 {
-                    // shift Lr[k] and minLr[k] pointers, because we allocated them with the borders,
-                    // and will occasionally use negative indices with the arrays
-                    // we need to shift Lr[k] pointers by 1, to give the space for d=-1.
-                    // however, then the alignment will be imperfect, i.e. bad for SSE,
-                    // thus we shift the pointers by 8 (8*sizeof(short) == 16 - ideal alignment)
-                    Lr[k] = pixDiff + costBufSize + LrSize*k + NRD2*LrBorder + 8;
-                    memset( Lr[k] - LrBorder*NRD2 - 8, 0, LrSize*sizeof(CostType) );
-                    minLr[k] = pixDiff + costBufSize + LrSize*NLR + minLrSize*k + NR2*LrBorder;
-                    memset( minLr[k] - LrBorder*NR2, 0, minLrSize*sizeof(CostType) );
+                    shift = windowShift(B[x], basePrev, D);
+                    basePrev = B[x];
                 }
-                for( int y = y1; y != y2; y += dy )
+                minL = aggregateStep(C + x*D, states.L(prev) + shift, minL, states.L(1 - prev), S + x*D,
+                                     D, g.P1, g.P2);
+                prev = 1 - prev;
+            }
+        }
+
+        // aggregation along the rows, from the left (dx = 1) or from the right (dx = -1)
+        class HorizontalPathInvoker : public ParallelLoopBody
+        {
+        public:
+            HorizontalPathInvoker(const CostType* C, const short* B, CostType* S, const SGBMGeometry& g, int dx)
+                : Cbuf(C), Bbuf(B), Sbuf(S), geom(g), dx_(dx) {}
+
+            void operator()(const Range& range) const
+            {
+                const int D = geom.costD, width1 = geom.width1;
+                PathStates states(2, D, Bbuf != 0);
+                for( int y = range.start; y < range.end; y++ )
+                    aggregateRow(Cbuf + (size_t)y*width1*D, Bbuf ? Bbuf + (size_t)y*width1 : 0,
+                                 Sbuf + (size_t)y*width1*D, states, geom, dx_);
+            }
+
+        private:
+            const CostType* Cbuf;
+            const short* Bbuf;
+            CostType* Sbuf;
+            SGBMGeometry geom;
+            int dx_;
+        };
+
+        /*
+        aggregation from the row above (dy = 1) or below (dy = -1), with a predecessor at (x - dx, y - dy).
+        The paths are the lines x - dx*dy*y = c, the range is a tile of consecutive c values.
+        */
+        class SlopedPathInvoker : public ParallelLoopBody
+        {
+        public:
+            SlopedPathInvoker(const CostType* C, const short* B, CostType* S, const SGBMGeometry& g, int dx, int dy)
+                : Cbuf(C), Bbuf(B), Sbuf(S), geom(g), dx_(dx), dy_(dy) {}
+
+            void operator()(const Range& range) const
+            {
+                const int D = geom.costD, width1 = geom.width1, height = geom.height;
+                const int slope = dx_*dy_, n = range.end - range.start;
+                PathStates states[2] = { PathStates(n, D, Bbuf != 0), PathStates(n, D, Bbuf != 0) };
+                // the base of the window of the last point of each path
+                std::vector<int> basePrev(Bbuf ? n : 0, -1);
+                int prev = 0;
+                for( int i = 0; i < height; i++ )
                 {
-                    int x, d;
-                    DispType* disp1ptr = disp1.ptr<DispType>(y);
-                    CostType* C = Cbuf + (!fullDP ? 0 : y*costBufSize);
-                    CostType* S = Sbuf + (!fullDP ? 0 : y*costBufSize);
-                    if( pass == 1 ) // compute C on the first pass, and reuse it on the second pass, if any.
+                    const int y = dy_ > 0 ? i : height - 1 - i;
+                    const CostType* C = Cbuf + (size_t)y*width1*D;
+                    const short* B = Bbuf ? Bbuf + (size_t)y*width1 : 0;
+                    CostType* S = Sbuf + (size_t)y*width1*D;
+                    const int xStart = std::max(range.start + slope*y, 0);
+                    const int xEnd = std::min(range.end + slope*y, width1);
+                    PathStates& Lprev = states[prev];
+                    PathStates& Lcur = states[1 - prev];
+                    for( int x = xStart; x < xEnd; x++ )
                     {
-                        int dy1 = y == 0 ? 0 : y + SH2, dy2 = y == 0 ? SH2 : dy1;
-                        for( k = dy1; k <= dy2; k++ )
+                        const int c = x - slope*y - range.start;
+                        int shift = 0;
+                        if( B )
                         {
-                            CostType* hsumAdd = hsumBuf + (std::min(k, height-1) % hsumBufNRows)*costBufSize;
-                            if( k < height )
-                            {
-                                for(int ii = 0; ii <= ww; ii++)
-                                {
-                                    for(int dd = 0; dd <= params.numDisparities; dd++)
-                                    {
-                                        pixDiff[ii * (params.numDisparities)+ dd] = (CostType)(ham[(k * (ww) + ii) * (params.numDisparities +1) + dd]);
-                                    }
-                                }
-                                memset(hsumAdd, 0, D*sizeof(CostType));
-                                for( x = 0; x <= SW2*D; x += D )
-                                {
-                                    int scale = x == 0 ? SW2 + 1 : 1;
-                                    for( d = 0; d < D; d++ )
-                                        hsumAdd[d] = (CostType)(hsumAdd[d] + pixDiff[x + d]*scale);
-                                }
-
-                                if( y > 0 )
-                                {
-                                    const CostType* hsumSub = hsumBuf + (std::max(y - SH2 - 1, 0) % hsumBufNRows)*costBufSize;
-                                    const CostType* Cprev = !fullDP || y == 0 ? C : C - costBufSize;
-
-                                    for( x = D; x < width1*D; x += D )
-                                    {
-                                        const CostType* pixAdd = pixDiff + std::min(x + SW2*D, (width1-1)*D);
-                                        const CostType* pixSub = pixDiff + std::max(x - (SW2+1)*D, 0);
-
-#if CV_SSE2
-                                        if( useSIMD )
-                                        {
-                                            for( d = 0; d < D; d += 8 )
-                                            {
-                                                __m128i hv = _mm_load_si128((const __m128i*)(hsumAdd + x - D + d));
-                                                __m128i Cx = _mm_load_si128((__m128i*)(Cprev + x + d));
-                                                hv = _mm_adds_epi16(_mm_subs_epi16(hv,
-                                                    _mm_load_si128((const __m128i*)(pixSub + d))),
-                                                    _mm_load_si128((const __m128i*)(pixAdd + d)));
-                                                Cx = _mm_adds_epi16(_mm_subs_epi16(Cx,
-                                                    _mm_load_si128((const __m128i*)(hsumSub + x + d))),
-                                                    hv);
-                                                _mm_store_si128((__m128i*)(hsumAdd + x + d), hv);
-                                                _mm_store_si128((__m128i*)(C + x + d), Cx);
-                                            }
-                                        }
-                                        else
-#endif
-                                        {
-                                            for( d = 0; d < D; d++ )
-                                            {
-                                                int hv = hsumAdd[x + d] = (CostType)(hsumAdd[x - D + d] + pixAdd[d] - pixSub[d]);
-                                                C[x + d] = (CostType)(Cprev[x + d] + hv - hsumSub[x + d]);
-                                            }
-                                        }
-                                    }
-                                }
-                                else
-                                {
-                                    for( x = D; x < width1*D; x += D )
-                                    {
-                                        const CostType* pixAdd = pixDiff + std::min(x + SW2*D, (width1-1)*D);
-                                        const CostType* pixSub = pixDiff + std::max(x - (SW2+1)*D, 0);
-                                        for( d = 0; d < D; d++ )
-                                            hsumAdd[x + d] = (CostType)(hsumAdd[x - D + d] + pixAdd[d] - pixSub[d]);
-                                    }
-                                }
-                            }
-                            if( y == 0 )
-                            {
-                                int scale = k == 0 ? SH2 + 1 : 1;
-                                for( x = 0; x < width1*D; x++ )
-                                    C[x] = (CostType)(C[x] + hsumAdd[x]*scale);
-                            }
+                            shift = windowShift(B[x], basePrev[c], D);
+                            basePrev[c] = B[x];
                         }
-                        // also, clear the S buffer
-                        for( k = 0; k < width1*D; k++ )
-                            S[k] = 0;
+                        Lcur.minL[c] = aggregateStep(C + x*D, Lprev.L(c) + shift, Lprev.minL[c], Lcur.L(c), S + x*D,
+                                                     D, geom.P1, geom.P2);
                     }
-                    // clear the left and the right borders
-                    memset( Lr[0] - NRD2*LrBorder - 8, 0, NRD2*LrBorder*sizeof(CostType) );
-                    memset( Lr[0] + width1*NRD2 - 8, 0, NRD2*LrBorder*sizeof(CostType) );
-                    memset( minLr[0] - NR2*LrBorder, 0, NR2*LrBorder*sizeof(CostType) );
-                    memset( minLr[0] + width1*NR2, 0, NR2*LrBorder*sizeof(CostType) );
-                    /*
-                    [formula 13 in the paper]
-                    compute L_r(p, d) = C(p, d) +
-                    min(L_r(p-r, d),
-                    L_r(p-r, d-1) + P1,
-                    L_r(p-r, d+1) + P1,
-                    min_k L_r(p-r, k) + P2) - min_k L_r(p-r, k)
-                    where p = (x,y), r is one of the directions.
-                    we process all the directions at once:
-                    0: r=(-dx, 0)
-                    1: r=(-1, -dy)
-                    2: r=(0, -dy)
-                    3: r=(1, -dy)
-                    4: r=(-2, -dy)
-                    5: r=(-1, -dy*2)
-                    6: r=(1, -dy*2)
-                    7: r=(2, -dy)
-                    */
-                    for( x = x1; x != x2; x += dx )
+                    prev = 1 - prev;
+                }
+            }
+
+            // the range of c for the whole image
+            static Range paths(const SGBMGeometry& g, int dx, int dy)
+            {
+                const int slope = dx*dy;
+                return Range(std::min(0, -slope*(g.height - 1)), g.width1 + std::max(0, -slope*(g.height - 1)));
+            }
+
+        private:
+            const CostType* Cbuf;
+            const short* Bbuf;
+            CostType* Sbuf;
+            SGBMGeometry geom;
+            int dx_, dy_;
+        };
+
+        /*
+        Picks the disparity of each pixel of a row from S, with the uniqueness check, the sub-pixel
+        interpolation and the left-right check. B is the row of bases of the windows of the temporal
+        prior, or null. disp2cost and disp2ptr are width-long buffers.
+        */
+        static void selectDisparityRow( const CostType* S, const short* B, const SGBMGeometry& g, DispType* disp1ptr,
+                                        CostType* disp2cost, DispType* disp2ptr )
+        {
+            const int DISP_SHIFT = StereoMatcher::DISP_SHIFT;
+            const int DISP_SCALE = (1 << DISP_SHIFT);
+            const int D = g.costD, minD = g.minD, minX1 = g.minX1;
+            const int INVALID_DISP_SCALED = (minD - 1)*DISP_SCALE;
+            int x, d;
+            for( x = 0; x < g.width; x++ )
+            {
+                disp1ptr[x] = disp2ptr[x] = (DispType)INVALID_DISP_SCALED;
+                disp2cost[x] = MAX_COST;
+            }
+
+            for( x = g.width1 - 1; x >= 0; x-- )
+            {
+                const CostType* Sp = S + x*D;
+                const int base = B ? B[x] : 0;
+                int minS = MAX_COST, bestDisp = -1;
+                for( d = 0; d < D; d++ )
+                {
+                    int Sval = Sp[d];
+                    if( Sval < minS )
+                    {
+                        minS = Sval;
+                        bestDisp = d;
+                    }
+                }
+                for( d = 0; d < D; d++ )
+                {
+                    if( Sp[d]*(100 - g.uniquenessRatio) < minS*100 && std::abs(bestDisp - d) > 1 )
+                        break;
+                }
+                if( d < D )
+                    continue;
+                d = bestDisp;
+                int _x2 = x + minX1 - d - base - minD;
+                if( _x2 >= 0 && disp2cost[_x2] > minS )
+                {
+                    disp2cost[_x2] = (CostType)minS;
+                    disp2ptr[_x2] = (DispType)(d + base + minD);
+                }
+                if( 0 < d && d < D-1 )
+                {
+                    if(g.subpixelInterpolationMethod == CV_SIMETRICV_INTERPOLATION)
                     {
-                        int xm = x*NR2, xd = xm*D2;
-                        int delta0 = minLr[0][xm - dx*NR2] + P2, delta1 = minLr[1][xm - NR2 + 1] + P2;
-                        int delta2 = minLr[1][xm + 2] + P2, delta3 = minLr[1][xm + NR2 + 3] + P2;
-                        CostType* Lr_p0 = Lr[0] + xd - dx*NRD2;
-                        CostType* Lr_p1 = Lr[1] + xd - NRD2 + D2;
-                        CostType* Lr_p2 = Lr[1] + xd + D2*2;
-                        CostType* Lr_p3 = Lr[1] + xd + NRD2 + D2*3;
-                        Lr_p0[-1] = Lr_p0[D] = Lr_p1[-1] = Lr_p1[D] =
-                            Lr_p2[-1] = Lr_p2[D] = Lr_p3[-1] = Lr_p3[D] = MAX_COST;
-                        CostType* Lr_p = Lr[0] + xd;
-                        const CostType* Cp = C + x*D;
-                        CostType* Sp = S + x*D;
-#if CV_SSE2
-                        if( useSIMD )
+                        double m2m1, m3m1, m3, m2, m1;
+                        m2 = Sp[d - 1];
+                        m3 = Sp[d + 1];
+                        m1 = Sp[d];
+                        m2m1 = m2 - m1;
+                        m3m1 = m3 - m1;
+                        if (!(m2m1 == 0 || m3m1 == 0))
                         {
-                            __m128i _P1 = _mm_set1_epi16((short)P1);
-                            __m128i _delta0 = _mm_set1_epi16((short)delta0);
-                            __m128i _delta1 = _mm_set1_epi16((short)delta1);
-                            __m128i _delta2 = _mm_set1_epi16((short)delta2);
-                            __m128i _delta3 = _mm_set1_epi16((short)delta3);
-                            __m128i _minL0 = _mm_set1_epi16((short)MAX_COST);
-                            for( d = 0; d < D; d += 8 )
+                            double p;
+                            p = 0;
+                            if (m2 > m3)
                             {
-                                __m128i Cpd = _mm_load_si128((const __m128i*)(Cp + d));
-                                __m128i L0, L1, L2, L3;
-                                L0 = _mm_load_si128((const __m128i*)(Lr_p0 + d));
-                                L1 = _mm_load_si128((const __m128i*)(Lr_p1 + d));
-                                L2 = _mm_load_si128((const __m128i*)(Lr_p2 + d));
-                                L3 = _mm_load_si128((const __m128i*)(Lr_p3 + d));
-                                L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d - 1)), _P1));
-                                L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d + 1)), _P1));
-                                L1 = _mm_min_epi16(L1, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p1 + d - 1)), _P1));
-                                L1 = _mm_min_epi16(L1, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p1 + d + 1)), _P1));
-                                L2 = _mm_min_epi16(L2, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p2 + d - 1)), _P1));
-                                L2 = _mm_min_epi16(L2, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p2 + d + 1)), _P1));
-                                L3 = _mm_min_epi16(L3, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p3 + d - 1)), _P1));
-                                L3 = _mm_min_epi16(L3, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p3 + d + 1)), _P1));
-                                L0 = _mm_min_epi16(L0, _delta0);
-                                L0 = _mm_adds_epi16(_mm_subs_epi16(L0, _delta0), Cpd);
-                                L1 = _mm_min_epi16(L1, _delta1);
-                                L1 = _mm_adds_epi16(_mm_subs_epi16(L1, _delta1), Cpd);
-                                L2 = _mm_min_epi16(L2, _delta2);
-                                L2 = _mm_adds_epi16(_mm_subs_epi16(L2, _delta2), Cpd);
-                                L3 = _mm_min_epi16(L3, _delta3);
-                                L3 = _mm_adds_epi16(_mm_subs_epi16(L3, _delta3), Cpd);
-                                _mm_store_si128( (__m128i*)(Lr_p + d), L0);
-                                _mm_store_si128( (__m128i*)(Lr_p + d + D2), L1);
-                                _mm_store_si128( (__m128i*)(Lr_p + d + D2*2), L2);
-                                _mm_store_si128( (__m128i*)(Lr_p + d + D2*3), L3);
-                                __m128i t0 = _mm_min_epi16(_mm_unpacklo_epi16(L0, L2), _mm_unpackhi_epi16(L0, L2));
-                                __m128i t1 = _mm_min_epi16(_mm_unpacklo_epi16(L1, L3), _mm_unpackhi_epi16(L1, L3));
-                                t0 = _mm_min_epi16(_mm_unpacklo_epi16(t0, t1), _mm_unpackhi_epi16(t0, t1));
-                                _minL0 = _mm_min_epi16(_minL0, t0);
-                                __m128i Sval = _mm_load_si128((const __m128i*)(Sp + d));
-                                L0 = _mm_adds_epi16(L0, L1);
-                                L2 = _mm_adds_epi16(L2, L3);
-                                Sval = _mm_adds_epi16(Sval, L0);
-                                Sval = _mm_adds_epi16(Sval, L2);
-                                _mm_store_si128((__m128i*)(Sp + d), Sval);
+                                p = (0.5 - 0.25 * ((m3m1 * m3m1) / (m2m1 * m2m1) + (m3m1 / m2m1)));
                             }
-                            _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 8));
-                            _mm_storel_epi64((__m128i*)&minLr[0][xm], _minL0);
+                            else
+                            {
+                                p = -1 * (0.5 - 0.25 * ((m2m1 * m2m1) / (m3m1 * m3m1) + (m2m1 / m3m1)));
+                            }
+                            if (p >= -0.5 && p <= 0.5)
+                                d = (int)(d * DISP_SCALE + p * DISP_SCALE );
                         }
                         else
-#endif
                         {
-                            int minL0 = MAX_COST, minL1 = MAX_COST, minL2 = MAX_COST, minL3 = MAX_COST;
+                            d *= DISP_SCALE;
+                        }
+                    }
+                    else if(g.subpixelInterpolationMethod == CV_QUADRATIC_INTERPOLATION)
+                    {
+                        // do subpixel quadratic interpolation:
+                        //   fit parabola into (x1=d-1, y1=Sp[d-1]), (x2=d, y2=Sp[d]), (x3=d+1, y3=Sp[d+1])
+                        //   then find minimum of the parabola.
+                        int denom2 = std::max(Sp[d-1] + Sp[d+1] - 2*Sp[d], 1);
+                        d = d*DISP_SCALE + ((Sp[d-1] - Sp[d+1])*DISP_SCALE + denom2)/(denom2*2);
+                    }
+                }
+                else
+                    d *= DISP_SCALE;
+                disp1ptr[x + minX1] = (DispType)(d + (minD + base)*DISP_SCALE);
+            }
+            for( x = minX1; x < g.maxX1; x++ )
+            {
+                // we round the computed disparity both towards -inf and +inf and check
+                // if either of the corresponding disparities in disp2 is consistent.
+                // This is to give the computed disparity a chance to look valid if it is.
+                int d1 = disp1ptr[x];
+                if( d1 == INVALID_DISP_SCALED )
+                    continue;
+                int _d = d1 >> DISP_SHIFT;
+                int d_ = (d1 + DISP_SCALE-1) >> DISP_SHIFT;
+                int _x = x - _d, x_ = x - d_;
+                if( 0 <= _x && _x < g.width && disp2ptr[_x] >= minD && std::abs(disp2ptr[_x] - _d) > g.disp12MaxDiff &&
+                    0 <= x_ && x_ < g.width && disp2ptr[x_] >= minD && std::abs(disp2ptr[x_] - d_) > g.disp12MaxDiff )
+                    disp1ptr[x] = (DispType)INVALID_DISP_SCALED;
+            }
+        }
 
-                            for( d = 0; d < D; d++ )
-                            {
-                                int Cpd = Cp[d], L0, L1, L2, L3;
+        /*
+        Computes the rows of C with the windows of the temporal prior: the rows of C for all the
+        disparities are computed in a buffer, then the window of each pixel is copied.
+        */
+        class WindowCostRows
+        {
+        public:
+            WindowCostRows(const Mat& census1, const Mat& census2, const SGBMGeometry& g, const short* B)
+                : costRows(census1, census2, g), Bbuf(B), geom(g), lastRow(0)
+            {
+                if( B )
+                    fullRow.resize(g.width1*g.D);
+            }
 
-                                L0 = Cpd + std::min((int)Lr_p0[d], std::min(Lr_p0[d-1] + P1, std::min(Lr_p0[d+1] + P1, delta0))) - delta0;
-                                L1 = Cpd + std::min((int)Lr_p1[d], std::min(Lr_p1[d-1] + P1, std::min(Lr_p1[d+1] + P1, delta1))) - delta1;
-                                L2 = Cpd + std::min((int)Lr_p2[d], std::min(Lr_p2[d-1] + P1, std::min(Lr_p2[d+1] + P1, delta2))) - delta2;
-                                L3 = Cpd + std::min((int)Lr_p3[d], std::min(Lr_p3[d-1] + P1, std::min(Lr_p3[d+1] + P1, delta3))) - delta3;
+            // Computes the row y of C from the previous computed row, or from the sums over the kernel
+            // if restart is true
+            void compute(int y, bool restart, CostType* C)
+            {
+                if( !Bbuf )
+                {
+                    costRows.compute(y, restart ? 0 : lastRow, C);
+                    lastRow = C;
+                    return;
+                }
+                const int D = geom.D, costD = geom.costD, width1 = geom.width1;
+                CostType* full = &fullRow[0];
+                costRows.compute(y, restart ? 0 : full, full);
+                const short* B = Bbuf + (size_t)y*width1;
+                for( int x = 0; x < width1; x++ )
+                    memcpy(C + x*costD, full + x*D + B[x], costD*sizeof(CostType));
+            }
 
-                                Lr_p[d] = (CostType)L0;
-                                minL0 = std::min(minL0, L0);
+        private:
+            BlockCostRows costRows;
+            const short* Bbuf;
+            SGBMGeometry geom;
+            std::vector<CostType> fullRow;
+            CostType* lastRow;
+        };
 
-                                Lr_p[d + D2] = (CostType)L1;
-                                minL1 = std::min(minL1, L1);
+        class CostVolumeInvoker : public ParallelLoopBody
+        {
+        public:
+            CostVolumeInvoker(const Mat& census1, const Mat& census2, const SGBMGeometry& g, const short* B,
+                              CostType* C, CostType* S)
+                : census1_(census1), census2_(census2), geom(g), Bbuf(B), Cbuf(C), Sbuf(S) {}
 
-                                Lr_p[d + D2*2] = (CostType)L2;
-                                minL2 = std::min(minL2, L2);
+            void operator()(const Range& range) const
+            {
+                const size_t rowSize = (size_t)geom.width1*geom.costD;
+                WindowCostRows costRows(census1_, census2_, geom, Bbuf);
+                for( int y = range.start; y < range.end; y++ )
+                {
+                    costRows.compute(y, y == range.start, Cbuf + y*rowSize);
+                    memset(Sbuf + y*rowSize, 0, rowSize*sizeof(CostType));
+                }
+            }
 
-                                Lr_p[d + D2*3] = (CostType)L3;
-                                minL3 = std::min(minL3, L3);
+        private:
+            const Mat& census1_;
+            const Mat& census2_;
+            SGBMGeometry geom;
+            const short* Bbuf;
+            CostType* Cbuf;
+            CostType* Sbuf;
 
-                                Sp[d] = saturate_cast<CostType>(Sp[d] + L0 + L1 + L2 + L3);
-                            }
-                            minLr[0][xm] = (CostType)minL0;
-                            minLr[0][xm+1] = (CostType)minL1;
-                            minLr[0][xm+2] = (CostType)minL2;
-                            minLr[0][xm+3] = (CostType)minL3;
-                        }
-                    }
+            CostVolumeInvoker& operator=(const CostVolumeInvoker&);
+        };
 
-                    if( pass == npasses )
-                    {
-                        for( x = 0; x < width; x++ )
-                        {
-                            disp1ptr[x] = disp2ptr[x] = (DispType)INVALID_DISP_SCALED;
-                            disp2cost[x] = MAX_COST;
-                        }
+        class SelectDisparityInvoker : public ParallelLoopBody
+        {
+        public:
+            SelectDisparityInvoker(const CostType* S, const short* B, const SGBMGeometry& g, Mat& disp1)
+                : Sbuf(S), Bbuf(B), geom(g), disp1_(disp1) {}
 
-                        for( x = width1 - 1; x >= 0; x-- )
-                        {
-                            CostType* Sp = S + x*D;
-                            int minS = MAX_COST, bestDisp = -1;
+            void operator()(const Range& range) const
+            {
+                std::vector<CostType> disp2cost(geom.width);
+                std::vector<DispType> disp2(geom.width);
+                for( int y = range.start; y < range.end; y++ )
+                    selectDisparityRow(Sbuf + (size_t)y*geom.width1*geom.costD, Bbuf ? Bbuf + (size_t)y*geom.width1 : 0,
+                                       geom, disp1_.ptr<DispType>(y), &disp2cost[0], &disp2[0]);
+            }
 
-                            if( npasses == 1 )
-                            {
-                                int xm = x*NR2, xd = xm*D2;
-
-                                int minL0 = MAX_COST;
-                                int delta0 = minLr[0][xm + NR2] + P2;
-                                CostType* Lr_p0 = Lr[0] + xd + NRD2;
-                                Lr_p0[-1] = Lr_p0[D] = MAX_COST;
-                                CostType* Lr_p = Lr[0] + xd;
-                                const CostType* Cp = C + x*D;
-#if CV_SSE2
-                                if( useSIMD )
-                                {
-                                    __m128i _P1 = _mm_set1_epi16((short)P1);
-                                    __m128i _delta0 = _mm_set1_epi16((short)delta0);
-                                    __m128i _minL0 = _mm_set1_epi16((short)minL0);
-                                    __m128i _minS = _mm_set1_epi16(MAX_COST), _bestDisp = _mm_set1_epi16(-1);
-                                    __m128i _d8 = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), _8 = _mm_set1_epi16(8);
-                                    for( d = 0; d < D; d += 8 )
-                                    {
-                                        __m128i Cpd = _mm_load_si128((const __m128i*)(Cp + d)), L0;
-                                        L0 = _mm_load_si128((const __m128i*)(Lr_p0 + d));
-                                        L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d - 1)), _P1));
-                                        L0 = _mm_min_epi16(L0, _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(Lr_p0 + d + 1)), _P1));
-                                        L0 = _mm_min_epi16(L0, _delta0);
-                                        L0 = _mm_adds_epi16(_mm_subs_epi16(L0, _delta0), Cpd);
-                                        _mm_store_si128((__m128i*)(Lr_p + d), L0);
-                                        _minL0 = _mm_min_epi16(_minL0, L0);
-                                        L0 = _mm_adds_epi16(L0, *(__m128i*)(Sp + d));
-                                        _mm_store_si128((__m128i*)(Sp + d), L0);
-                                        __m128i mask = _mm_cmpgt_epi16(_minS, L0);
-                                        _minS = _mm_min_epi16(_minS, L0);
-                                        _bestDisp = _mm_xor_si128(_bestDisp, _mm_and_si128(_mm_xor_si128(_bestDisp,_d8), mask));
-                                        _d8 = _mm_adds_epi16(_d8, _8);
-                                    }
-                                    short CV_DECL_ALIGNED(16) bestDispBuf[8];
-                                    _mm_store_si128((__m128i*)bestDispBuf, _bestDisp);
-                                    _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 8));
-                                    _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 4));
-                                    _minL0 = _mm_min_epi16(_minL0, _mm_srli_si128(_minL0, 2));
-                                    __m128i qS = _mm_min_epi16(_minS, _mm_srli_si128(_minS, 8));
-                                    qS = _mm_min_epi16(qS, _mm_srli_si128(qS, 4));
-                                    qS = _mm_min_epi16(qS, _mm_srli_si128(qS, 2));
-                                    minLr[0][xm] = (CostType)_mm_cvtsi128_si32(_minL0);
-                                    minS = (CostType)_mm_cvtsi128_si32(qS);
-                                    qS = _mm_shuffle_epi32(_mm_unpacklo_epi16(qS, qS), 0);
-                                    qS = _mm_cmpeq_epi16(_minS, qS);
-                                    int idx = _mm_movemask_epi8(_mm_packs_epi16(qS, qS)) & 255;
-                                    bestDisp = bestDispBuf[LSBTab[idx]];
-                                }
-                                else
-#endif
-                                {
-                                    for( d = 0; d < D; d++ )
-                                    {
-                                        int L0 = Cp[d] + std::min((int)Lr_p0[d], std::min(Lr_p0[d-1] + P1, std::min(Lr_p0[d+1] + P1, delta0))) - delta0;
-                                        Lr_p[d] = (CostType)L0;
-                                        minL0 = std::min(minL0, L0);
-                                        int Sval = Sp[d] = saturate_cast<CostType>(Sp[d] + L0);
-                                        if( Sval < minS )
-                                        {
-                                            minS = Sval;
-                                            bestDisp = d;
-                                        }
-                                    }
-                                    minLr[0][xm] = (CostType)minL0;
-                                }
-                            }
-                            else
-                            {
-                                for( d = 0; d < D; d++ )
-                                {
-                                    int Sval = Sp[d];
-                                    if( Sval < minS )
-                                    {
-                                        minS = Sval;
-                                        bestDisp = d;
-                                    }
-                                }
-                            }
-                            for( d = 0; d < D; d++ )
-                            {
-                                if( Sp[d]*(100 - uniquenessRatio) < minS*100 && std::abs(bestDisp - d) > 1 )
-                                    break;
-                            }
-                            if( d < D )
-                                continue;
-                            d = bestDisp;
-                            int _x2 = x + minX1 - d - minD;
-                            if( disp2cost[_x2] > minS )
-                            {
-                                disp2cost[_x2] = (CostType)minS;
-                                disp2ptr[_x2] = (DispType)(d + minD);
-                            }
-                            if( 0 < d && d < D-1 )
+        private:
+            const CostType* Sbuf;
+            const short* Bbuf;
+            SGBMGeometry geom;
+            Mat& disp1_;
+
+            SelectDisparityInvoker& operator=(const SelectDisparityInvoker&);
+        };
+
+        /*
+        The geometry of the computation, with the windows of the temporal prior if windows (CV_16S,
+        height x width1 bases) is not empty.
+        */
+        static SGBMGeometry sgbmGeometry( const StereoBinarySGBMParams& params, const Size& size,
+                                          const Mat& windows, int windowSize )
+        {
+            SGBMGeometry g(params, size);
+            if( !windows.empty() )
+            {
+                CV_Assert( windows.type() == CV_16S && windows.isContinuous() &&
+                           windows.rows == g.height && windows.cols == g.width1 );
+                CV_Assert( windowSize % 16 == 0 && 0 < windowSize && windowSize < g.D );
+                g.costD = windowSize;
+            }
+            return g;
+        }
+
+        /*
+        MODE_SGBM and MODE_HH: C and S of the whole image are kept in buffer, and each direction is
+        aggregated in parallel.
+        */
+        static void computeDisparityBinarySGBM( const Mat& census1, const Mat& census2,
+            Mat& disp1, const StereoBinarySGBMParams& params, Mat& buffer,
+            const Mat& windows = Mat(), int windowSize = 0 )
+        {
+            const int ALIGN = 16;
+            SGBMGeometry g = sgbmGeometry(params, disp1.size(), windows, windowSize);
+            if( g.minX1 >= g.maxX1 )
+            {
+                disp1 = Scalar::all((g.minD - 1)*StereoMatcher::DISP_SCALE);
+                return;
+            }
+            CV_Assert( g.D % 16 == 0 );
+            const short* B = windows.empty() ? 0 : windows.ptr<short>();
+
+            size_t volumeSize = (size_t)g.width1*g.height*g.costD;
+            size_t totalBufSize = volumeSize*2*sizeof(CostType) + ALIGN;
+            if( buffer.empty() || !buffer.isContinuous() ||
+                buffer.cols*buffer.rows*buffer.elemSize() < totalBufSize )
+                buffer.create(1, (int)totalBufSize, CV_8U);
+            CostType* Cbuf = (CostType*)alignPtr(buffer.ptr(), ALIGN);
+            CostType* Sbuf = Cbuf + volumeSize;
+
+            // each stripe starts with a full sum over the kernel, hence stripes of at least a few kernels
+            parallel_for_(Range(0, g.height), CostVolumeInvoker(census1, census2, g, B, Cbuf, Sbuf),
+                          std::max(g.height/std::max(g.SH2*8, 16), 1));
+
+            // the directions r, as the offset from the predecessor to p
+            static const int dirs[][2] = { {1, 0}, {-1, 0}, {1, 1}, {0, 1}, {-1, 1}, {1, -1}, {0, -1}, {-1, -1} };
+            const int ndirs = params.mode == StereoBinarySGBM::MODE_HH ? 8 : 5;
+            for( int i = 0; i < ndirs; i++ )
+            {
+                const int dx = dirs[i][0], dy = dirs[i][1];
+                if( dy == 0 )
+                    parallel_for_(Range(0, g.height), HorizontalPathInvoker(Cbuf, B, Sbuf, g, dx));
+                else
+                {
+                    Range paths = SlopedPathInvoker::paths(g, dx, dy);
+                    // tiles of 32 paths: each step of a tile reads and writes contiguous costs
+                    parallel_for_(paths, SlopedPathInvoker(Cbuf, B, Sbuf, g, dx, dy),
+                                  std::max((paths.end - paths.start)/32, 1));
+                }
+            }
+
+            parallel_for_(Range(0, g.height), SelectDisparityInvoker(Sbuf, B, g, disp1));
+        }
+
+        /*
+        MODE_SGBM_LEAN: a sweep over the rows of a stripe with the 5 directions of MODE_SGBM. Only the
+        L_r of the previous row are kept for the paths from the top, and C and S are single rows.
+        */
+        class LeanStripeInvoker : public ParallelLoopBody
+        {
+        public:
+            LeanStripeInvoker(const Mat& census1, const Mat& census2, const SGBMGeometry& g, const short* B, Mat& disp1)
+                : census1_(census1), census2_(census2), geom(g), Bbuf(B), disp1_(disp1) {}
+
+            void operator()(const Range& range) const
+            {
+                const int D = geom.costD, width1 = geom.width1, P1 = geom.P1, P2 = geom.P2;
+                const bool shifted = Bbuf != 0;
+                WindowCostRows costRows(census1_, census2_, geom, Bbuf);
+                std::vector<CostType> Cbuf(width1*D), Sbuf(width1*D);
+                CostType* C = &Cbuf[0];
+                CostType* S = &Sbuf[0];
+                std::vector<CostType> disp2cost(geom.width);
+                std::vector<DispType> disp2(geom.width);
+
+                // the paths from the upper left, the top and the upper right, with a path state on
+                // each side of the row so that the paths entering the row start from 0
+                PathStates top[2][3] =
+                {
+                    { PathStates(width1 + 2, D, shifted), PathStates(width1 + 2, D, shifted), PathStates(width1 + 2, D, shifted) },
+                    { PathStates(width1 + 2, D, shifted), PathStates(width1 + 2, D, shifted), PathStates(width1 + 2, D, shifted) }
+                };
+                PathStates horizontal(2, D, shifted);
+                int prev = 0;
+
+                const int yStart = std::max(range.start - LEAN_STRIPE_OVERLAP, 0);
+                for( int y = yStart; y < range.end; y++ )
+                {
+                    const short* B = shifted ? Bbuf + (size_t)y*width1 : 0;
+                    const short* Bprev = shifted && y > yStart ? B - width1 : 0;
+                    costRows.compute(y, y == yStart, C);
+                    memset(S, 0, width1*D*sizeof(CostType));
+
+                    for( int dir = 0; dir < 3; dir++ )
+                    {
+                        PathStates& Lprev = top[prev][dir];
+                        PathStates& Lcur = top[1 - prev][dir];
+                        // the predecessor of x is at x - 1 + dir on the previous row, i.e. path index x + dir
+                        for( int x = 0; x < width1; x++ )
+                        {
+                            int shift = 0;
+                            if( shifted )
                             {
-                                if(params.subpixelInterpolationMethod == CV_SIMETRICV_INTERPOLATION)
-                                {
-                                    double m2m1, m3m1, m3, m2, m1;
-                                    m2 = Sp[d - 1];
-                                    m3 = Sp[d + 1];
-                                    m1 = Sp[d];
-                                    m2m1 = m2 - m1;
-                                    m3m1 = m3 - m1;
-                                    if (!(m2m1 == 0 || m3m1 == 0))
-                                    {
-                                        double p;
-                                        p = 0;
-                                        if (m2 > m3)
-                                        {
-                                            p = (0.5 - 0.25 * ((m3m1 * m3m1) / (m2m1 * m2m1) + (m3m1 / m2m1)));
-                                        }
-                                        else
-                                        {
-                                            p = -1 * (0.5 - 0.25 * ((m2m1 * m2m1) / (m3m1 * m3m1) + (m2m1 / m3m1)));
-                                        }
-                                        if (p >= -0.5 && p <= 0.5)
-                                            d = (int)(d * DISP_SCALE + p * DISP_SCALE );
-                                    }
-                                    else
-                                    {
-                                        d *= DISP_SCALE;
-                                    }
-                                }
-                                else if(params.subpixelInterpolationMethod == CV_QUADRATIC_INTERPOLATION)
-                                {
-                                    // do subpixel quadratic interpolation:
-                                    //   fit parabola into (x1=d-1, y1=Sp[d-1]), (x2=d, y2=Sp[d]), (x3=d+1, y3=Sp[d+1])
-                                    //   then find minimum of the parabola.
-                                    int denom2 = std::max(Sp[d-1] + Sp[d+1] - 2*Sp[d], 1);
-                                    d = d*DISP_SCALE + ((Sp[d-1] - Sp[d+1])*DISP_SCALE + denom2)/(denom2*2);
-                                }
+                                const int xp = x - 1 + dir;
+                                shift = windowShift(B[x], Bprev && 0 <= xp && xp < width1 ? Bprev[xp] : -1, D);
                             }
-                            else
-                                d *= DISP_SCALE;
-                            disp1ptr[x + minX1] = (DispType)(d + minD*DISP_SCALE);
-                        }
-                        for( x = minX1; x < maxX1; x++ )
-                        {
-                            // we round the computed disparity both towards -inf and +inf and check
-                            // if either of the corresponding disparities in disp2 is consistent.
-                            // This is to give the computed disparity a chance to look valid if it is.
-                            int d1 = disp1ptr[x];
-                            if( d1 == INVALID_DISP_SCALED )
-                                continue;
-                            int _d = d1 >> DISP_SHIFT;
-                            int d_ = (d1 + DISP_SCALE-1) >> DISP_SHIFT;
-                            int _x = x - _d, x_ = x - d_;
-                            if( 0 <= _x && _x < width && disp2ptr[_x] >= minD && std::abs(disp2ptr[_x] - _d) > disp12MaxDiff &&
-                                0 <= x_ && x_ < width && disp2ptr[x_] >= minD && std::abs(disp2ptr[x_] - d_) > disp12MaxDiff )
-                                disp1ptr[x] = (DispType)INVALID_DISP_SCALED;
+                            Lcur.minL[x + 1] = aggregateStep(C + x*D, Lprev.L(x + dir) + shift, Lprev.minL[x + dir],
+                                                             Lcur.L(x + 1), S + x*D, D, P1, P2);
                         }
                     }
-                    // now shift the cyclic buffers
-                    std::swap( Lr[0], Lr[1] );
-                    std::swap( minLr[0], minLr[1] );
+                    prev = 1 - prev;
+
+                    aggregateRow(C, B, S, horizontal, geom, 1);
+                    aggregateRow(C, B, S, horizontal, geom, -1);
+
+                    if( y >= range.start )
+                        selectDisparityRow(S, B, geom, disp1_.ptr<DispType>(y), &disp2cost[0], &disp2[0]);
+                }
+            }
+
+        private:
+            const Mat& census1_;
+            const Mat& census2_;
+            SGBMGeometry geom;
+            const short* Bbuf;
+            Mat& disp1_;
+
+            LeanStripeInvoker& operator=(const LeanStripeInvoker&);
+        };
+
+        static void computeDisparityBinarySGBMLean( const Mat& census1, const Mat& census2,
+            Mat& disp1, const StereoBinarySGBMParams& params,
+            const Mat& windows = Mat(), int windowSize = 0 )
+        {
+            SGBMGeometry g = sgbmGeometry(params, disp1.size(), windows, windowSize);
+            if( g.minX1 >= g.maxX1 )
+            {
+                disp1 = Scalar::all((g.minD - 1)*StereoMatcher::DISP_SCALE);
+                return;
+            }
+            CV_Assert( g.D % 16 == 0 );
+
+            // one stripe per thread: the overlap of the stripes is computed twice
+            parallel_for_(Range(0, g.height),
+                          LeanStripeInvoker(census1, census2, g, windows.empty() ? 0 : windows.ptr<short>(), disp1),
+                          std::max(std::min(getNumThreads(), g.height/(LEAN_STRIPE_OVERLAP*2)), 1));
+        }
+
+        /*
+        Windows of the temporal prior: the base (from minD) of the window of each pixel of C, centered
+        on the disparity of the previous frame. The holes of the previous disparity are filled along the
+        rows with the smallest of the nearest valid disparities on each side, occluded pixels being
+        usually at the depth of the background. Returns false if there are too many holes.
+        */
+        static bool temporalWindows( const Mat& prevDisp, const SGBMGeometry& g, int windowSize, Mat& windows )
+        {
+            const int DISP_SHIFT = StereoMatcher::DISP_SHIFT;
+            const int minValid = g.minD*StereoMatcher::DISP_SCALE;
+            const int maxBase = g.D - windowSize;
+            windows.create(g.height, g.width1, CV_16S);
+            std::vector<int> prior(g.width1);
+            int holes = 0;
+            for( int y = 0; y < g.height; y++ )
+            {
+                const DispType* d = prevDisp.ptr<DispType>(y) + g.minX1;
+                short* B = windows.ptr<short>(y);
+                // the disparities of the prior are from minD, and -1 where there is none yet
+                int last = -1;
+                for( int x = 0; x < g.width1; x++ )
+                {
+                    if( d[x] >= minValid )
+                        last = ((d[x] + (1 << (DISP_SHIFT - 1))) >> DISP_SHIFT) - g.minD;
+                    else
+                        holes++;
+                    prior[x] = last;
+                }
+                last = -1;
+                for( int x = g.width1 - 1; x >= 0; x-- )
+                {
+                    if( d[x] >= minValid )
+                        last = ((d[x] + (1 << (DISP_SHIFT - 1))) >> DISP_SHIFT) - g.minD;
+                    else if( last >= 0 && (prior[x] < 0 || last < prior[x]) )
+                        prior[x] = last;
+                    // a row without any disparity is centered on the middle of the range
+                    const int center = prior[x] < 0 ? g.D/2 : prior[x];
+                    B[x] = (short)std::min(std::max(center - windowSize/2, 0), maxBase);
                 }
             }
+            return holes <= g.height*g.width1*TEMPORAL_MAX_HOLES_RATIO;
         }
+
+        /*
+        Number of disparities at the border of their window (but not of the whole range), where the cost
+        may still decrease outside of the window.
+        */
+        static int countWindowBorders( const Mat& disp, const Mat& windows, const SGBMGeometry& g, int windowSize )
+        {
+            const int maxBase = g.D - windowSize;
+            int count = 0;
+            for( int y = 0; y < g.height; y++ )
+            {
+                const DispType* d = disp.ptr<DispType>(y) + g.minX1;
+                const short* B = windows.ptr<short>(y);
+                for( int x = 0; x < g.width1; x++ )
+                {
+                    if( d[x] < g.minD*StereoMatcher::DISP_SCALE )
+                        continue;
+                    const int k = (d[x] >> StereoMatcher::DISP_SHIFT) - g.minD - B[x];
+                    if( (k <= 0 && B[x] > 0) || (k >= windowSize - 1 && B[x] < maxBase) )
+                        count++;
+                }
+            }
+            return count;
+        }
+
         class StereoBinarySGBMImpl : public StereoBinarySGBM, public Matching
         {
         public:
             StereoBinarySGBMImpl():Matching()
             {
                 params = StereoBinarySGBMParams();
+                priorUsed = false;
+                prevMinDisparity = prevNumDisparities = 0;
             }
             StereoBinarySGBMImpl( int _minDisparity, int _numDisparities, int _SADWindowSize,
                 int _P1, int _P2, int _disp12MaxDiff, int _preFilterCap,
@@ -634,6 +936,8 @@ namespace cv
                     _P1, _P2, _disp12MaxDiff, _preFilterCap,
                     _uniquenessRatio, _speckleWindowSize, _speckleRange,
                     _mode );
+                priorUsed = false;
+                prevMinDisparity = prevNumDisparities = 0;
             }
             void compute( InputArray leftarr, InputArray rightarr, OutputArray disparr )
             {
@@ -645,8 +949,6 @@ namespace cv
                 censusImageLeft.create(left.rows,left.cols,CV_32SC4);
                 censusImageRight.create(left.rows,left.cols,CV_32SC4);
 
-                hamDist.create(left.rows, left.cols * (params.numDisparities + 1),CV_16S);
-
                 if(params.kernelType == CV_SPARSE_CENSUS)
                 {
                     censusTransform(left,right,params.kernelSize,censusImageLeft,censusImageRight,CV_SPARSE_CENSUS);
@@ -684,9 +986,8 @@ namespace cv
                     starCensusTransform(left,right,params.kernelSize,censusImageLeft,censusImageRight);
                 }
 
-                hammingDistanceBlockMatching(censusImageLeft, censusImageRight, hamDist);
-
-                computeDisparityBinarySGBM( left, right, disp, params, buffer,hamDist);
+                // the Hamming distances of the descriptors are computed along with the matching cost
+                computeDisparity(disp);
 
                 if(params.regionRemoval == CV_SPECKLE_REMOVAL_AVG_ALGORITHM)
                 {
@@ -717,6 +1018,48 @@ namespace cv
                         filterSpeckles(disp, (params.minDisparity - 1) * StereoMatcher::DISP_SCALE, params.speckleWindowSize,
                         StereoMatcher::DISP_SCALE * params.speckleRange, buffer);
                 }
+
+                if( params.temporalNumDisparities > 0 )
+                {
+                    disp.copyTo(prevDisp);
+                    prevMinDisparity = params.minDisparity;
+                    prevNumDisparities = params.numDisparities;
+                }
+                else
+                    prevDisp.release();
+            }
+
+            // computes the disparity of the census images, with the temporal prior if it can be used
+            void computeDisparity( Mat& disp )
+            {
+                const int windowSize = params.temporalNumDisparities;
+                priorUsed = false;
+                if( windowSize > 0 && windowSize < params.numDisparities && prevDisp.size() == disp.size() &&
+                    prevMinDisparity == params.minDisparity && prevNumDisparities == params.numDisparities )
+                {
+                    SGBMGeometry g(params, disp.size());
+                    Mat prior = prevDisp;
+                    if( !temporalMotion.empty() )
+                        warpPerspective(prevDisp, prior, temporalMotion, disp.size(), INTER_NEAREST, BORDER_CONSTANT,
+                                        Scalar::all((params.minDisparity - 1)*StereoMatcher::DISP_SCALE));
+                    if( g.minX1 < g.maxX1 && temporalWindows(prior, g, windowSize, windows) )
+                    {
+                        computeDisparity(disp, windows, windowSize);
+                        priorUsed = countWindowBorders(disp, windows, g, windowSize) <=
+                                    g.height*g.width1*TEMPORAL_MAX_BORDER_RATIO;
+                    }
+                }
+                temporalMotion.release();
+                if( !priorUsed )
+                    computeDisparity(disp, Mat(), 0);
+            }
+
+            void computeDisparity( Mat& disp, const Mat& _windows, int windowSize )
+            {
+                if( params.mode == StereoBinarySGBM::MODE_SGBM_LEAN )
+                    computeDisparityBinarySGBMLean( censusImageLeft, censusImageRight, disp, params, _windows, windowSize );
+                else
+                    computeDisparityBinarySGBM( censusImageLeft, censusImageRight, disp, params, buffer, _windows, windowSize );
             }
             int getSubPixelInterpolationMethod() const { return params.subpixelInterpolationMethod;}
             void setSubPixelInterpolationMethod(int value = CV_QUADRATIC_INTERPOLATION) { CV_Assert(value < 2); params.subpixelInterpolationMethod = value;}
@@ -760,6 +1103,26 @@ namespace cv
             int getMode() const { return params.mode; }
             void setMode(int mode) { params.mode = mode; }
 
+            int getTemporalNumDisparities() const { return params.temporalNumDisparities; }
+            void setTemporalNumDisparities(int numDisparities)
+            {
+                CV_Assert(numDisparities >= 0 && numDisparities % 16 == 0);
+                params.temporalNumDisparities = numDisparities;
+            }
+
+            void setTemporalMotion(InputArray H)
+            {
+                if( H.empty() )
+                {
+                    temporalMotion.release();
+                    return;
+                }
+                CV_Assert(H.size() == Size(3, 3));
+                H.getMat().convertTo(temporalMotion, CV_64F);
+            }
+
+            bool getTemporalPriorUsed() const { return priorUsed; }
+
             void write(FileStorage& fs) const
             {
                 fs << "name" << name_
@@ -773,7 +1136,8 @@ namespace cv
                     << "uniquenessRatio" << params.uniquenessRatio
                     << "P1" << params.P1
                     << "P2" << params.P2
-                    << "mode" << params.mode;
+                    << "mode" << params.mode
+                    << "temporalNumDisparities" << params.temporalNumDisparities;
             }
 
             void read(const FileNode& fn)
@@ -791,6 +1155,7 @@ namespace cv
                 params.P1 = (int)fn["P1"];
                 params.P2 = (int)fn["P2"];
                 params.mode = (int)fn["mode"];
+                params.temporalNumDisparities = (int)fn["temporalNumDisparities"];
             }
 
             StereoBinarySGBMParams params;
@@ -800,9 +1165,14 @@ namespace cv
             Mat censusImageRight;
             Mat partialSumsLR;
             Mat agregatedHammingLRCost;
-            Mat hamDist;
             Mat parSumsIntensityImage[2];
             Mat Integral[2];
+            // the temporal prior: the last disparity and the parameters it was computed with
+            Mat prevDisp;
+            int prevMinDisparity, prevNumDisparities;
+            Mat temporalMotion;
+            Mat windows;
+            bool priorUsed;
         };
 
         const char* StereoBinarySGBMImpl::name_ = "StereoBinaryMatcher.SGBM";
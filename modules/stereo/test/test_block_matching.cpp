@@ -237,5 +237,71 @@ void CV_SGBlockMatchingTest::run(int )
         return;
     }
 }
+
+TEST(SG_block_matching_lean_test, accuracy)
+{
+    Mat image1 = imread(cvtest::TS::ptr()->get_data_path() + "testdata/imL2l.bmp", CV_8UC1);
+    Mat image2 = imread(cvtest::TS::ptr()->get_data_path() + "testdata/imL2.bmp", CV_8UC1);
+    ASSERT_FALSE(image1.empty() || image2.empty());
+
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, 16, 9);
+    sgbm->setP1(10);
+    sgbm->setP2(100);
+    sgbm->setBinaryKernelType(CV_DENSE_CENSUS);
+    Mat disp, dispLean;
+    sgbm->compute(image1, image2, disp);
+    sgbm->setMode(StereoBinarySGBM::MODE_SGBM_LEAN);
+    sgbm->compute(image1, image2, dispLean);
+
+    // the stripes of the lean mode only change the disparity close to their borders
+    EXPECT_LE(countNonZero(disp != dispLean), (int)disp.total() / 50);
+}
+
+// a textured background at disparity 20 and a square at disparity 40, moved by dx
+static void temporalPair(int dx, Mat& left, Mat& right)
+{
+    RNG rng(17);
+    Mat background(240, 400, CV_8UC1), square(80, 80, CV_8UC1);
+    rng.fill(background, RNG::UNIFORM, 0, 256);
+    rng.fill(square, RNG::UNIFORM, 0, 256);
+    GaussianBlur(background, background, Size(3, 3), 0);
+    GaussianBlur(square, square, Size(3, 3), 0);
+
+    left = background(Rect(40, 0, 320, 240)).clone();
+    right = background(Rect(60, 0, 320, 240)).clone();
+    square.copyTo(left(Rect(150 + dx, 80, 80, 80)));
+    square.copyTo(right(Rect(110 + dx, 80, 80, 80)));
+}
+
+TEST(SG_block_matching_temporal_test, accuracy)
+{
+    Ptr<StereoBinarySGBM> sgbm = StereoBinarySGBM::create(0, 64, 9);
+    sgbm->setP1(10);
+    sgbm->setP2(100);
+    sgbm->setBinaryKernelType(CV_DENSE_CENSUS);
+    Ptr<StereoBinarySGBM> sgbmTemporal = StereoBinarySGBM::create(0, 64, 9);
+    sgbmTemporal->setP1(10);
+    sgbmTemporal->setP2(100);
+    sgbmTemporal->setBinaryKernelType(CV_DENSE_CENSUS);
+    sgbmTemporal->setTemporalNumDisparities(32);
+
+    for( int frame = 0; frame < 4; frame++ )
+    {
+        Mat left, right, disp, dispTemporal;
+        temporalPair(frame*4, left, right);
+        if( frame > 0 )
+        {
+            Mat H = (Mat_<double>(3, 3) << 1, 0, 4, 0, 1, 0, 0, 0, 1);
+            sgbmTemporal->setTemporalMotion(H);
+        }
+        sgbm->compute(left, right, disp);
+        sgbmTemporal->compute(left, right, dispTemporal);
+
+        // the first frame has no prior
+        EXPECT_EQ(frame > 0, sgbmTemporal->getTemporalPriorUsed());
+        Mat valid = disp >= 0;
+        EXPECT_LE(countNonZero(abs(disp - dispTemporal) > StereoMatcher::DISP_SCALE & valid), (int)disp.total() / 50);
+    }
+}
 TEST(block_matching_simple_test, accuracy) { CV_BlockMatchingTest test; test.safe_run(); }
 TEST(SG_block_matching_simple_test, accuracy) { CV_SGBlockMatchingTest test; test.safe_run(); }
@@ -467,3 +467,85 @@ TEST(census_transform_testing, accuracy) { CV_CensusTransformTest test; test.saf
 TEST(symetric_census_testing, accuracy) { CV_SymetricCensusTest test; test.safe_run(); }
 TEST(modified_census_testing, accuracy) { CV_ModifiedCensusTransformTest test; test.safe_run(); }
 TEST(star_kernel_testing, accuracy) { CV_StarKernelCensusTest test; test.safe_run(); }
+
+//the descriptors are compared with a direct computation, on a width which is not a multiple of the vector size
+static int referenceDescriptor(const Mat &img, int i, int j, const vector<Point> &a, const vector<Point> &b, int bits, int t)
+{
+    unsigned c = 0;
+    for(size_t k = 0; k < a.size(); k++)
+    {
+        bool greater = img.at<uchar>(i + a[k].y, j + a[k].x) > img.at<uchar>(i + b[k].y, j + b[k].x) - t;
+        if(bits == 1)
+            c = (c + (greater ? 1 : 0)) << 1;
+        else
+            c = (c << 2) + (greater ? 3 : 0);
+    }
+    return (int)c;
+}
+TEST(descriptors_testing, reference)
+{
+    RNG rng(17);
+    Mat img(53, 101, CV_8UC1);
+    rng.fill(img, RNG::UNIFORM, 0, 256);
+    const int kernelSizes[] = {3, 5, 7, 9, 11};
+    for(int q = 0; q < 5; q++)
+    {
+        const int kernelSize = kernelSizes[q], n2 = kernelSize / 2;
+        for(int type = 0; type < 4; type++)
+        {
+            vector<Point> a, b;
+            int bits = 1, t = 0, colStart = n2 + 2, colEnd = img.cols - n2 - 1;
+            Mat dist(img.size(), CV_32S, Scalar::all(0));
+            if(type == 0 && kernelSize <= 5)
+            {
+                for(int ii = -n2; ii <= n2; ii++)
+                    for(int jj = -n2; jj <= n2; jj++)
+                        a.push_back(Point(jj, ii));
+                censusTransform(img, kernelSize, dist, CV_DENSE_CENSUS);
+            }
+            else if(type == 1)
+            {
+                for(int ii = -n2; ii <= n2; ii += 2)
+                    for(int jj = -n2; jj <= n2; jj += 2)
+                        a.push_back(Point(jj, ii));
+                censusTransform(img, kernelSize, dist, CV_SPARSE_CENSUS);
+            }
+            else if(type == 2 && kernelSize <= 9)
+            {
+                for(int step = 2; step <= 4; step += 2)
+                    for(int ii = -n2; ii <= n2; ii += step)
+                        for(int jj = -n2; jj <= n2; jj += step)
+                            a.push_back(Point(jj, ii));
+                bits = 2;
+                t = 6;
+                modifiedCensusTransform(img, kernelSize, dist, CV_MODIFIED_CENSUS_TRANSFORM, t);
+            }
+            else if(type == 3 && kernelSize <= 7)
+            {
+                for(int ii = -n2; ii <= 0; ii++)
+                {
+                    for(int jj = -n2; jj <= n2; jj++)
+                    {
+                        a.push_back(Point(jj, ii));
+                        b.push_back(Point(-jj, -ii));
+                        if(ii == 0 && jj < 0)
+                        {
+                            a.push_back(Point(jj, ii));
+                            b.push_back(Point(-jj, -ii));
+                        }
+                    }
+                }
+                colStart = n2;
+                colEnd = img.cols - n2;
+                symetricCensusTransform(img, kernelSize, dist, CV_CS_CENSUS);
+            }
+            else
+                continue;
+            b.resize(a.size(), Point(0, 0));
+            for(int i = n2; i < img.rows - n2; i++)
+                for(int j = colStart; j < colEnd; j++)
+                    ASSERT_EQ(referenceDescriptor(img, i, j, a, b, bits, t), dist.at<int>(i, j))
+                        << "type " << type << " kernel " << kernelSize << " at " << i << "," << j;
+        }
+    }
+}
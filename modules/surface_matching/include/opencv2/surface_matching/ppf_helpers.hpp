@@ -98,10 +98,10 @@ CV_EXPORTS Mat samplePCByQuantization(Mat pc, float xrange[2], float yrange[2],
 
 void computeBboxStd(Mat pc, float xRange[2], float yRange[2], float zRange[2]);
 
-void* indexPCFlann(Mat pc);
-void destroyFlann(void* flannIndex);
-void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances);
-void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances, const int numNeighbors);
+CV_EXPORTS void* indexPCFlann(Mat pc);
+CV_EXPORTS void destroyFlann(void* flannIndex);
+CV_EXPORTS void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances);
+CV_EXPORTS void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances, const int numNeighbors);
 
 /**
  *  Mostly for visualization purposes. Normalizes the point cloud in a Hartley-Zissermann
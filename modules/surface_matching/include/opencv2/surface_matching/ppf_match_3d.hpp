@@ -140,17 +140,60 @@ public:
     */
   void match(const Mat& scene, std::vector<Pose3DPtr> &results, const double relativeSceneSampleStep=1.0/5.0, const double relativeSceneDistance=0.03);
 
+  /**
+    *  \brief Loads a trained model (parameters, sampled model and PPF index)
+    *
+    *  @param [in] fn File node previously written by write()
+    */
   void read(const FileNode& fn);
+
+  /**
+    *  \brief Stores a trained model (parameters, sampled model and PPF index)
+    *
+    *  @param [in] fs Output file storage
+    */
   void write(FileStorage& fs) const;
 
+  /**
+    *  \brief Saves a trained model to a binary, versioned file that can be memory mapped by loadModel()
+    *
+    *  @param [in] fileName Output file name
+    */
+  void saveModel(const String& fileName) const;
+
+  /**
+    *  \brief Loads a model saved by saveModel()
+    *
+    *  @param [in] fileName Input file name
+    *
+    *  \details The file is memory mapped and the sampled model and PPF index are used in place,
+    *  so that loading does not depend on the model size, and processes loading the same file
+    *  share its pages. The file must not be modified while the model is in use. Only the header
+    *  and the layout of the file are checked, match() ignores index entries that are out of range.
+    */
+  void loadModel(const String& fileName);
+
 protected:
 
   double angle_step, angle_step_radians, distance_step;
   double sampling_step_relative, angle_step_relative, distance_step_relative;
-  Mat sampled_pc, ppf;
+  Mat sampled_pc;
   int num_ref_points;
-  hashtable_int* hash_table;
-  THash* hash_nodes;
+
+  /*
+   * Flat PPF index. Point pair features are grouped into buckets by their quantized
+   * hash key (bucket = key & (numBuckets-1)). Entries of bucket b are stored contiguously
+   * in [hash_offsets[b], hash_offsets[b+1]) of the entry arrays, which hold the key,
+   * the model reference point and the model angle alpha of each pair.
+   */
+  Mat hash_offsets; // (numBuckets+1) x 1, CV_32S
+  Mat hash_keys; // numEntries x 1, CV_32S (bit pattern of KeyType)
+  Mat hash_ref_inds; // numEntries x 1, CV_32S
+  Mat hash_alphas; // numEntries x 1, CV_32F
+
+  // memory mapped file backing the model data, if loaded by loadModel()
+  class MappedModelFile;
+  Ptr<MappedModelFile> mapped_model;
 
   double position_threshold, rotation_threshold;
   bool use_weighted_avg;
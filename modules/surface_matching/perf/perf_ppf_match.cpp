@@ -0,0 +1,146 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::ppf_match_3d;
+using namespace perf;
+
+namespace
+{
+
+// Synthetic object: points with normals on an ellipsoid, so that sampling and
+// normals are well defined without test data.
+Mat makeModel(int numPoints)
+{
+  Mat pc(numPoints, 6, CV_32F);
+  RNG rng(0x1234);
+  const float axes[3] = {1.f, 0.6f, 0.3f};
+  for (int i = 0; i < numPoints; i++)
+  {
+    const double theta = rng.uniform(0., CV_PI), phi = rng.uniform(0., 2*CV_PI);
+    const double u[3] = {sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta)};
+    float* row = pc.ptr<float>(i);
+    double n[3], nn = 0;
+    for (int k = 0; k < 3; k++)
+    {
+      row[k] = (float)(axes[k]*u[k]);
+      n[k] = u[k] / axes[k];
+      nn += n[k]*n[k];
+    }
+    nn = sqrt(nn);
+    for (int k = 0; k < 3; k++)
+      row[3+k] = (float)(n[k] / nn);
+  }
+  return pc;
+}
+
+// Scene: the model in a random pose, surrounded by planar clutter up to numPoints.
+Mat makeScene(const Mat& model, int numPoints)
+{
+  double pose[16];
+  getRandomPose(pose);
+  Mat scene = transformPCPose(model, pose);
+
+  RNG rng(0x4321);
+  Mat clutter(std::max(numPoints - scene.rows, 0), 6, CV_32F);
+  for (int i = 0; i < clutter.rows; i++)
+  {
+    float* row = clutter.ptr<float>(i);
+    row[0] = rng.uniform(-3.f, 3.f);
+    row[1] = rng.uniform(-3.f, 3.f);
+    row[2] = -1.5f;
+    row[3] = 0.f;
+    row[4] = 0.f;
+    row[5] = 1.f;
+  }
+  scene.push_back(clutter);
+  return scene;
+}
+
+}
+
+typedef TestBaseWithParam<double> PPFTrain;
+
+PERF_TEST_P(PPFTrain, trainModel, testing::Values(0.05, 0.035, 0.025)) // relative sampling step
+{
+  const double samplingStep = GetParam();
+
+  Mat model = makeModel(20000);
+  PPF3DDetector detector(samplingStep, 0.05);
+
+  TEST_CYCLE()
+  {
+    detector.trainModel(model);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef std::tr1::tuple<int, int> PPFMatchParams;
+typedef TestBaseWithParam<PPFMatchParams> PPFMatch;
+
+PERF_TEST_P(PPFMatch, match,
+            testing::Combine(
+              testing::Values(10000, 50000), // scene size
+              testing::Values(1, 2, 4, 8)    // threads
+            ))
+{
+  const int sceneSize = std::tr1::get<0>(GetParam());
+  const int numThreads = std::tr1::get<1>(GetParam());
+
+  Mat model = makeModel(5000);
+  Mat scene = makeScene(model, sceneSize);
+
+  PPF3DDetector detector(0.05, 0.05);
+  detector.trainModel(model);
+
+  vector<Pose3DPtr> results;
+  const int savedThreads = getNumThreads();
+  setNumThreads(numThreads);
+
+  TEST_CYCLE()
+  {
+    detector.match(scene, results, 1.0/10.0, 0.05);
+  }
+
+  setNumThreads(savedThreads);
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef TestBaseWithParam<int> ICPRefine;
+
+PERF_TEST_P(ICPRefine, registerModelToScene, testing::Values(1, 16, 64)) // number of hypotheses
+{
+  const int numPoses = GetParam();
+
+  Mat model = makeModel(5000);
+  Mat scene = makeScene(model, 20000);
+
+  vector<Pose3DPtr> initialPoses;
+  for (int i = 0; i < numPoses; i++)
+  {
+    double pose[16];
+    getRandomPose(pose);
+    Pose3DPtr hypothesis(new Pose3D());
+    hypothesis->updatePose(pose);
+    initialPoses.push_back(hypothesis);
+  }
+
+  ICP icp(100, 0.005f, 2.5f, 8);
+  vector<Pose3DPtr> poses;
+
+  TEST_CYCLE()
+  {
+    poses.clear();
+    for (size_t i = 0; i < initialPoses.size(); i++)
+      poses.push_back(initialPoses[i]->clone());
+    icp.registerModelToScene(model, scene, poses);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
@@ -107,6 +107,22 @@ static double computeDistToOrigin(Mat srcPC)
   return dist;
 }
 
+// compute the total distance of the points to a given center
+static double computeDistToPoint(Mat srcPC, const double center[3])
+{
+  int height = srcPC.rows;
+  double dist = 0;
+
+  for (int i=0; i<height; i++)
+  {
+    const float *row = srcPC.ptr<float>(i);
+    const double d[3] = {row[0]-center[0], row[1]-center[1], row[2]-center[2]};
+    dist += sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+  }
+
+  return dist;
+}
+
 // From numerical receipes: Finds the median of an array
 static float medianF(float arr[], int n)
 {
@@ -171,7 +187,7 @@ static float medianF(float arr[], int n)
   }
 }
 
-static float getRejectionThreshold(float* r, int m, float outlierScale)
+static float getRejectionThreshold(const float* r, int m, float outlierScale)
 {
   float* t=(float*)calloc(m, sizeof(float));
   int i=0;
@@ -276,79 +292,96 @@ static void getTransformMat(Mat X, double Pose[16])
   Pose[15]=1;
 }
 
-/* Fast way to look up the duplicates
-duplicates is pre-allocated
-make sure that the max element in array will not exceed maxElement
+// sampling step of a pyramid level. It only depends on the number of model points.
+static int getLevelSampleStep(int numModelPoints, int level)
+{
+  const double impact = 2;
+  double div = pow((double)impact, (double)level);
+  const int numSamples = cvRound((double)(numModelPoints/(div)));
+  return cvRound((double)numModelPoints/(double)numSamples);
+}
+
+/* Sampled scene and its search index for every pyramid level. The index is built
+ in scene coordinates once and shared by all registrations of models with the same
+ number of points; the queries are mapped back from the normalized frame of each
+ registration. Nearest neighbours are invariant to that similarity transform.
 */
-static hashtable_int* getHashtable(int* data, size_t length, int numMaxElement)
+class ICPSceneIndex
 {
-  hashtable_int* hashtable = hashtableCreate(static_cast<size_t>(numMaxElement*2), 0);
-  for (size_t i = 0; i < length; i++)
+public:
+  ICPSceneIndex(const Mat& dstPC, int numModelPoints, int numLevels) :
+    sampled(numLevels), indices(numLevels, (void*)0)
   {
-    const KeyType key = (KeyType)data[i];
-    hashtableInsertHashed(hashtable, key+1, reinterpret_cast<void*>(i+1));
+    for (int level = 0; level < numLevels; level++)
+    {
+      sampled[level] = samplePCUniform(dstPC, getLevelSampleStep(numModelPoints, level));
+      indices[level] = indexPCFlann(sampled[level]);
+    }
   }
 
-  return hashtable;
-}
+  ~ICPSceneIndex()
+  {
+    for (size_t level = 0; level < indices.size(); level++)
+      destroyFlann(indices[level]);
+  }
+
+  std::vector<Mat> sampled;
+  std::vector<void*> indices;
+
+private:
+  ICPSceneIndex(const ICPSceneIndex&);
+  ICPSceneIndex& operator=(const ICPSceneIndex&);
+};
 
 // source point clouds are assumed to contain their normals
-int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residual, Matx44d& pose)
+static void registerModelToSceneIndex(const Mat& srcPC, const Mat& dstPC, const ICPSceneIndex& sceneIndex,
+                                      const float tolerance, const int maxIterations, const float rejectionScale,
+                                      const int numLevels, double& residual, Matx44d& pose)
 {
   int n = srcPC.rows;
 
-  const bool useRobustReject = m_rejectionScale>0;
+  const bool useRobustReject = rejectionScale>0;
 
   Mat srcTemp = srcPC.clone();
-  Mat dstTemp = dstPC.clone();
   double meanSrc[3], meanDst[3];
   computeMeanCols(srcTemp, meanSrc);
-  computeMeanCols(dstTemp, meanDst);
+  computeMeanCols(dstPC, meanDst);
   double meanAvg[3]={0.5*(meanSrc[0]+meanDst[0]), 0.5*(meanSrc[1]+meanDst[1]), 0.5*(meanSrc[2]+meanDst[2])};
   subtractColumns(srcTemp, meanAvg);
-  subtractColumns(dstTemp, meanAvg);
 
   double distSrc = computeDistToOrigin(srcTemp);
-  double distDst = computeDistToOrigin(dstTemp);
+  double distDst = computeDistToPoint(dstPC, meanAvg);
 
   double scale = (double)n / ((distSrc + distDst)*0.5);
 
   srcTemp(cv::Range(0, srcTemp.rows), cv::Range(0,3)) *= scale;
-  dstTemp(cv::Range(0, dstTemp.rows), cv::Range(0,3)) *= scale;
 
   Mat srcPC0 = srcTemp;
-  Mat dstPC0 = dstTemp;
 
   // initialize pose
   matrixIdentity(4, pose.val);
 
-  Mat M = Mat::eye(4,4,CV_64F);
-
   double tempResidual = 0;
 
 
   // walk the pyramid
-  for (int level = m_numLevels-1; level >=0; level--)
+  for (int level = numLevels-1; level >=0; level--)
   {
-    const double impact = 2;
-    double div = pow((double)impact, (double)level);
-    //double div2 = div*div;
-    const int numSamples = cvRound((double)(n/(div)));
-    const double TolP = m_tolerance*(double)(level+1)*(level+1);
-    const int MaxIterationsPyr = cvRound((double)m_maxIterations/(level+1));
+    const double TolP = tolerance*(double)(level+1)*(level+1);
+    const int MaxIterationsPyr = cvRound((double)maxIterations/(level+1));
 
     // Obtain the sampled point clouds for this level: Also rotates the normals
     Mat srcPCT = transformPCPose(srcPC0, pose.val);
 
-    const int sampleStep = cvRound((double)n/(double)numSamples);
+    const int sampleStep = getLevelSampleStep(n, level);
 
     srcPCT = samplePCUniform(srcPCT, sampleStep);
     /*
     Tolga Birdal thinks that downsampling the scene points might decrease the accuracy.
     Hamdi Sahloul, however, noticed that accuracy increased (pose residual decreased slightly).
     */
-    Mat dstPCS = samplePCUniform(dstPC0, sampleStep);
-    void* flann = indexPCFlann(dstPCS);
+    const Mat& dstPCS = sceneIndex.sampled[level];
+    void* flann = sceneIndex.indices[level];
 
     double fval_old=9999999999;
     double fval_perc=0;
@@ -357,29 +390,38 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
     int i=0;
 
-    size_t numElSrc = (size_t)Src_Moved.rows;
-    int sizesResult[2] = {(int)numElSrc, 1};
-    float* distances = new float[numElSrc];
-    int* indices = new int[numElSrc];
-
-    Mat Indices(2, sizesResult, CV_32S, indices, 0);
-    Mat Distances(2, sizesResult, CV_32F, distances, 0);
+    const int numElSrc = Src_Moved.rows;
+    Mat Src_Query(numElSrc, 3, CV_32F);
+    Mat Indices(numElSrc, 1, CV_32S);
+    Mat Distances(numElSrc, 1, CV_32F);
+    const int* indices = Indices.ptr<int>();
+    const float* distances = Distances.ptr<float>();
 
     // use robust weighting for outlier treatment
-    int* indicesModel = new int[numElSrc];
-    int* indicesScene = new int[numElSrc];
+    std::vector<int> indicesModel(numElSrc), indicesScene(numElSrc);
+    std::vector<int> newI(numElSrc), newJ(numElSrc);
 
-    int* newI = new int[numElSrc];
-    int* newJ = new int[numElSrc];
+    // closest correspondence of every scene point, -1 if none
+    std::vector<int> sceneCorr(dstPCS.rows, -1);
 
     double PoseX[16]={0};
     matrixIdentity(4, PoseX);
 
     while ( (!(fval_perc<(1+TolP) && fval_perc>(1-TolP))) && i<MaxIterationsPyr)
     {
-      uint di=0, selInd = 0;
+      int di=0, selInd = 0, numCorr = numElSrc;
 
-      queryPCFlann(flann, Src_Moved, Indices, Distances);
+      // search in scene coordinates
+      for (di=0; di<numElSrc; di++)
+      {
+        const float* movedPt = Src_Moved.ptr<float>(di);
+        float* queryPt = Src_Query.ptr<float>(di);
+        queryPt[0] = (float)(movedPt[0]/scale + meanAvg[0]);
+        queryPt[1] = (float)(movedPt[1]/scale + meanAvg[1]);
+        queryPt[2] = (float)(movedPt[2]/scale + meanAvg[2]);
+      }
+
+      queryPCFlann(flann, Src_Query, Indices, Distances);
 
       for (di=0; di<numElSrc; di++)
       {
@@ -390,20 +432,18 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
       if (useRobustReject)
       {
         int numInliers = 0;
-        float threshold = getRejectionThreshold(distances, Distances.rows, m_rejectionScale);
-        Mat acceptInd = Distances<threshold;
+        float threshold = getRejectionThreshold(distances, Distances.rows, rejectionScale);
 
-        uchar *accPtr = (uchar*)acceptInd.data;
-        for (int l=0; l<acceptInd.rows; l++)
+        for (int l=0; l<numElSrc; l++)
         {
-          if (accPtr[l])
+          if (distances[l] < threshold)
           {
             newI[numInliers] = l;
             newJ[numInliers] = indices[l];
             numInliers++;
           }
         }
-        numElSrc=numInliers;
+        numCorr=numInliers;
       }
 
       // Step 2: Picky ICP
@@ -411,42 +451,25 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
       // is assigned to the same model point m_j, then select p_i that corresponds
       // to the minimum distance
 
-      hashtable_int* duplicateTable = getHashtable(newJ, numElSrc, dstPCS.rows);
-
-      for (di=0; di<duplicateTable->size; di++)
+      for (di=0; di<numCorr; di++)
       {
-        hashnode_i *node = duplicateTable->nodes[di];
+        const int dup = newJ[di];
+        const int best = sceneCorr[dup];
+        if (best < 0 || distances[newI[di]] <= distances[newI[best]])
+          sceneCorr[dup] = di;
+      }
 
-        if (node)
+      for (int j=0; j<dstPCS.rows; j++)
+      {
+        if (sceneCorr[j] >= 0)
         {
-          // select the first node
-          size_t idx = reinterpret_cast<size_t>(node->data)-1, dn=0;
-          int dup = (int)node->key-1;
-          size_t minIdxD = idx;
-          float minDist = distances[idx];
-
-          while ( node )
-          {
-            idx = reinterpret_cast<size_t>(node->data)-1;
-
-            if (distances[idx] < minDist)
-            {
-              minDist = distances[idx];
-              minIdxD = idx;
-            }
-
-            node = node->next;
-            dn++;
-          }
-
-          indicesModel[ selInd ] = newI[ minIdxD ];
-          indicesScene[ selInd ] = dup ;
+          indicesModel[ selInd ] = newI[ sceneCorr[j] ];
+          indicesScene[ selInd ] = j ;
           selInd++;
+          sceneCorr[j] = -1;
         }
       }
 
-      hashtableDestroy(duplicateTable);
-
       if (selInd >= 6)
       {
 
@@ -464,10 +487,13 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
           int ci=0;
 
           for (ci=0; ci<srcPCT.cols; ci++)
-          {
             srcMatchPt[ci] = (double)srcPt[ci];
+
+          // scene points are normalized like the model, normals are unchanged
+          for (ci=0; ci<3; ci++)
+            dstMatchPt[ci] = ((double)dstPt[ci] - meanAvg[ci])*scale;
+          for (; ci<srcPCT.cols; ci++)
             dstMatchPt[ci] = (double)dstPt[ci];
-          }
         }
 
         Mat X;
@@ -503,15 +529,7 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
     residual = tempResidual;
 
-    delete[] newI;
-    delete[] newJ;
-    delete[] indicesModel;
-    delete[] indicesScene;
-    delete[] distances;
-    delete[] indices;
-
     tempResidual = fval_min;
-    destroyFlann(flann);
   }
 
   // Pose(1:3, 4) = Pose(1:3, 4)./scale;
@@ -528,23 +546,62 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
   pose.val[11] -= Cpose[2];
 
   residual = tempResidual;
+}
 
+// source point clouds are assumed to contain their normals
+int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residual, Matx44d& pose)
+{
+  ICPSceneIndex sceneIndex(dstPC, srcPC.rows, m_numLevels);
+  registerModelToSceneIndex(srcPC, dstPC, sceneIndex, m_tolerance, m_maxIterations, m_rejectionScale, m_numLevels, residual, pose);
   return 0;
 }
 
-// source point clouds are assumed to contain their normals
-int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses)
+// refines a range of hypotheses against a shared scene index
+class ICPRegistrationInvoker : public ParallelLoopBody
 {
-  #if defined _OPENMP
-  #pragma omp parallel for
-  #endif
-  for (int i=0; i<(int)poses.size(); i++)
+public:
+  ICPRegistrationInvoker(const Mat& srcPC, const Mat& dstPC, const ICPSceneIndex& sceneIndex,
+                         float tolerance, int maxIterations, float rejectionScale, int numLevels,
+                         std::vector<Pose3DPtr>& poses) :
+    srcPC_(srcPC), dstPC_(dstPC), sceneIndex_(sceneIndex),
+    tolerance_(tolerance), maxIterations_(maxIterations), rejectionScale_(rejectionScale), numLevels_(numLevels),
+    poses_(poses)
+  {
+  }
+
+  void operator()(const Range& range) const
   {
-    Matx44d poseICP = Matx44d::eye();
-    Mat srcTemp = transformPCPose(srcPC, poses[i]->pose);
-    registerModelToScene(srcTemp, dstPC, poses[i]->residual, poseICP);
-    poses[i]->appendPose(poseICP.val);
+    for (int i = range.start; i < range.end; i++)
+    {
+      Matx44d poseICP = Matx44d::eye();
+      Mat srcTemp = transformPCPose(srcPC_, poses_[i]->pose);
+      registerModelToSceneIndex(srcTemp, dstPC_, sceneIndex_, tolerance_, maxIterations_, rejectionScale_, numLevels_,
+                                poses_[i]->residual, poseICP);
+      poses_[i]->appendPose(poseICP.val);
+    }
   }
+
+private:
+  const Mat& srcPC_;
+  const Mat& dstPC_;
+  const ICPSceneIndex& sceneIndex_;
+  float tolerance_;
+  int maxIterations_;
+  float rejectionScale_;
+  int numLevels_;
+  std::vector<Pose3DPtr>& poses_;
+
+  ICPRegistrationInvoker& operator=(const ICPRegistrationInvoker&);
+};
+
+// source point clouds are assumed to contain their normals
+int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses)
+{
+  // all hypotheses transform the same model, so that they share the scene levels
+  ICPSceneIndex sceneIndex(dstPC, srcPC.rows, m_numLevels);
+
+  parallel_for_(Range(0, (int)poses.size()),
+                ICPRegistrationInvoker(srcPC, dstPC, sceneIndex, m_tolerance, m_maxIterations, m_rejectionScale, m_numLevels, poses));
   return 0;
 }
 
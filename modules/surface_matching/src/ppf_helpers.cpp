@@ -259,11 +259,44 @@ void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances)
   queryPCFlann(flannIndex, pc, indices, distances, 1);
 }
 
+// The searches of different query points are independent: each stripe searches a row range
+class FlannQueryInvoker : public ParallelLoopBody
+{
+public:
+  FlannQueryInvoker(FlannIndex* index, const Mat& queries, Mat& indices, Mat& distances, int numNeighbors) :
+    index_(index), queries_(queries), indices_(indices), distances_(distances), numNeighbors_(numNeighbors)
+  {
+  }
+
+  void operator()(const Range& range) const
+  {
+    Mat indicesRange = indices_.rowRange(range);
+    Mat distancesRange = distances_.rowRange(range);
+    index_->knnSearch(queries_.rowRange(range), indicesRange, distancesRange, numNeighbors_, cvflann::SearchParams(32));
+  }
+
+private:
+  FlannIndex* index_;
+  const Mat& queries_;
+  Mat& indices_;
+  Mat& distances_;
+  int numNeighbors_;
+
+  FlannQueryInvoker& operator=(const FlannQueryInvoker&);
+};
+
 void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances, const int numNeighbors)
 {
   Mat obj_32f;
   pc.colRange(0, 3).copyTo(obj_32f);
-  ((FlannIndex*)flannIndex)->knnSearch(obj_32f, indices, distances, numNeighbors, cvflann::SearchParams(32));
+
+  // the stripes write into row ranges of the outputs, which must not be reallocated there
+  indices.create(obj_32f.rows, numNeighbors, CV_32S);
+  distances.create(obj_32f.rows, numNeighbors, CV_32F);
+
+  // a few hundred queries per stripe amortize the scheduling cost
+  const double nstripes = std::max(1, obj_32f.rows / 512);
+  parallel_for_(Range(0, obj_32f.rows), FlannQueryInvoker((FlannIndex*)flannIndex, obj_32f, indices, distances, numNeighbors), nstripes);
 }
 
 // uses a volume instead of an octree
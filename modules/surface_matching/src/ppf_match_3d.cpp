@@ -46,8 +46,6 @@ namespace cv
 namespace ppf_match_3d
 {
 
-static const size_t PPF_LENGTH = 5;
-
 // routines for assisting sort
 static bool pose3DPtrCompare(const Pose3DPtr& a, const Pose3DPtr& b)
 {
@@ -128,9 +126,8 @@ PPF3DDetector::PPF3DDetector()
   angle_step_radians = (360.0/angle_step_relative)*M_PI/180.0;
   angle_step = angle_step_radians;
   trained = false;
-
-  hash_table = NULL;
-  hash_nodes = NULL;
+  num_ref_points = 0;
+  distance_step = 0;
 
   setSearchParams();
 }
@@ -144,9 +141,8 @@ PPF3DDetector::PPF3DDetector(const double RelativeSamplingStep, const double Rel
   //SceneSampleStep = 1.0/RelativeSceneSampleStep;
   angle_step = angle_step_radians;
   trained = false;
-
-  hash_table = NULL;
-  hash_nodes = NULL;
+  num_ref_points = 0;
+  distance_step = 0;
 
   setSearchParams();
 }
@@ -167,9 +163,9 @@ void PPF3DDetector::setSearchParams(const double positionThreshold, const double
 }
 
 // compute per point PPF as in paper
-void PPF3DDetector::computePPFFeatures(const double p1[4], const double n1[4],
-                                       const double p2[4], const double n2[4],
-                                       double f[4])
+static void computePPF(const double p1[4], const double n1[4],
+                       const double p2[4], const double n2[4],
+                       double f[4])
 {
   /*
   Vectors will be defined as of length 4 instead of 3, because of:
@@ -202,24 +198,85 @@ void PPF3DDetector::computePPFFeatures(const double p1[4], const double n1[4],
   f[2] = TAngle3Normalized(n1, n2);
 }
 
+void PPF3DDetector::computePPFFeatures(const double p1[4], const double n1[4],
+                                       const double p2[4], const double n2[4],
+                                       double f[4])
+{
+  computePPF(p1, n1, p2, n2, f);
+}
+
 void PPF3DDetector::clearTrainingModels()
 {
-  if (this->hash_nodes)
+  hash_offsets.release();
+  hash_keys.release();
+  hash_ref_inds.release();
+  hash_alphas.release();
+  sampled_pc.release();
+  mapped_model.release();
+  num_ref_points = 0;
+  trained = false;
+}
+
+PPF3DDetector::~PPF3DDetector()
+{
+  clearTrainingModels();
+}
+
+// Computes the key and the model angle of the pairs of the reference points in range, pair
+// (i, j) being stored at i*(n-1) + j, minus one when j > i.
+class PPFTrainInvoker : public ParallelLoopBody
+{
+public:
+  PPFTrainInvoker(const Mat& sampledModel, double angleStep, float distanceStep,
+                  std::vector<KeyType>& pairKeys, std::vector<float>& pairAlphas) :
+    sampled(sampledModel), angle_step(angleStep), distance_step(distanceStep),
+    pair_keys(pairKeys), pair_alphas(pairAlphas)
   {
-    free(this->hash_nodes);
-    this->hash_nodes=0;
   }
 
-  if (this->hash_table)
+  void operator()(const Range& range) const
   {
-    hashtableDestroy(this->hash_table);
-    this->hash_table=0;
+    const int numRefPoints = sampled.rows;
+    for (int i=range.start; i<range.end; i++)
+    {
+      const float* f1 = sampled.ptr<float>(i);
+      const double p1[4] = {f1[0], f1[1], f1[2], 0};
+      const double n1[4] = {f1[3], f1[4], f1[5], 0};
+
+      int pairInd = i*(numRefPoints-1);
+      for (int j=0; j<numRefPoints; j++)
+      {
+        // cannnot compute the ppf with myself
+        if (i==j)
+          continue;
+
+        const float* f2 = sampled.ptr<float>(j);
+        const double p2[4] = {f2[0], f2[1], f2[2], 0};
+        const double n2[4] = {f2[3], f2[4], f2[5], 0};
+
+        double f[4]={0};
+        computePPF(p1, n1, p2, n2, f);
+        pair_keys[pairInd] = hashPPF(f, angle_step, distance_step);
+        pair_alphas[pairInd] = (float)computeAlpha(p1, n1, p2);
+        pairInd++;
+      }
+    }
   }
-}
 
-PPF3DDetector::~PPF3DDetector()
+private:
+  const Mat& sampled;
+  double angle_step;
+  float distance_step;
+  std::vector<KeyType>& pair_keys;
+  std::vector<float>& pair_alphas;
+
+  PPFTrainInvoker& operator=(const PPFTrainInvoker&);
+};
+
+// bucket of a PPF key in the flat index. numBuckets is a power of two.
+static inline unsigned int ppfBucket(KeyType key, unsigned int numBuckets)
 {
-  clearTrainingModels();
+  return key & (numBuckets - 1);
 }
 
 // TODO: Check all step sizes to be positive
@@ -227,6 +284,8 @@ void PPF3DDetector::trainModel(const Mat &PC)
 {
   CV_Assert(PC.type() == CV_32F || PC.type() == CV_32FC1);
 
+  clearTrainingModels();
+
   // compute bbox
   float xRange[2], yRange[2], zRange[2];
   computeBboxStd(PC, xRange, yRange, zRange);
@@ -241,71 +300,109 @@ void PPF3DDetector::trainModel(const Mat &PC)
 
   Mat sampled = samplePCByQuantization(PC, xRange, yRange, zRange, (float)sampling_step_relative,0);
 
-  int size = sampled.rows*sampled.rows;
+  // TODO: Maybe I could sample 1/5th of them here. Check the performance later.
+  int numRefPoints = sampled.rows;
+  int numPPF = numRefPoints*(numRefPoints-1);
 
-  hashtable_int* hashTable = hashtableCreate(size, NULL);
+  // the index is built in two passes (counting sort by bucket), so that all pairs
+  // end up in a few contiguous arrays instead of one heap node per pair
+  unsigned int numBuckets = numPPF < 16 ? 16 : next_power_of_two((unsigned int)numPPF);
+  std::vector<KeyType> pairKeys(numPPF);
+  std::vector<float> pairAlphas(numPPF);
 
-  int numPPF = sampled.rows*sampled.rows;
-  ppf = Mat(numPPF, PPF_LENGTH, CV_32FC1);
+  hash_offsets = Mat::zeros(numBuckets+1, 1, CV_32S);
+  int* offsets = hash_offsets.ptr<int>();
 
-  // TODO: Maybe I could sample 1/5th of them here. Check the performance later.
-  int numRefPoints = sampled.rows;
+  // every pair writes its own slot, so the features are computed in parallel over the reference points
+  parallel_for_(Range(0, numRefPoints), PPFTrainInvoker(sampled, angle_step_radians, distanceStep, pairKeys, pairAlphas));
 
-  // pre-allocate the hash nodes
-  hash_nodes = (THash*)calloc(numRefPoints*numRefPoints, sizeof(THash));
+  for (int p=0; p<numPPF; p++)
+    offsets[ppfBucket(pairKeys[p], numBuckets)+1]++;
 
-  // TODO : This can easily be parallelized. But we have to lock hashtable_insert.
-  // I realized that performance drops when this loop is parallelized (unordered
-  // inserts into the hashtable
-  // But it is still there to be investigated. For now, I leave this unparallelized
-  // since this is just a training part.
-  for (int i=0; i<numRefPoints; i++)
-  {
-    float* f1 = sampled.ptr<float>(i);
-    const double p1[4] = {f1[0], f1[1], f1[2], 0};
-    const double n1[4] = {f1[3], f1[4], f1[5], 0};
+  // prefix sum of the bucket sizes gives the start of every bucket
+  for (unsigned int b=0; b<numBuckets; b++)
+    offsets[b+1] += offsets[b];
 
-    //printf("///////////////////// NEW REFERENCE ////////////////////////\n");
-    for (int j=0; j<numRefPoints; j++)
-    {
-      // cannnot compute the ppf with myself
-      if (i!=j)
-      {
-        float* f2 = sampled.ptr<float>(j);
-        const double p2[4] = {f2[0], f2[1], f2[2], 0};
-        const double n2[4] = {f2[3], f2[4], f2[5], 0};
+  hash_keys.create(numPPF, 1, CV_32S);
+  hash_ref_inds.create(numPPF, 1, CV_32S);
+  hash_alphas.create(numPPF, 1, CV_32F);
+  KeyType* keys = reinterpret_cast<KeyType*>(hash_keys.ptr<int>());
+  int* refInds = hash_ref_inds.ptr<int>();
+  float* alphas = hash_alphas.ptr<float>();
 
-        double f[4]={0};
-        computePPFFeatures(p1, n1, p2, n2, f);
-        KeyType hashValue = hashPPF(f, angle_step_radians, distanceStep);
-        double alpha = computeAlpha(p1, n1, p2);
-        unsigned int ppfInd = i*numRefPoints+j;
-
-        THash* hashNode = &hash_nodes[i*numRefPoints+j];
-        hashNode->id = hashValue;
-        hashNode->i = i;
-        hashNode->ppfInd = ppfInd;
-
-        hashtableInsertHashed(hashTable, hashValue, (void*)hashNode);
-
-        float* ppfRow = ppf.ptr<float>(ppfInd);
-        ppfRow[0] = (float)f[0];
-        ppfRow[1] = (float)f[1];
-        ppfRow[2] = (float)f[2];
-        ppfRow[3] = (float)f[3];
-        ppfRow[4] = (float)alpha;
-      }
-    }
+  // scatter pairs into their buckets. Pairs keep their training order within a bucket.
+  std::vector<int> bucketFill(offsets, offsets + numBuckets);
+  for (int p=0; p<numPPF; p++)
+  {
+    const KeyType key = pairKeys[p];
+    const int dst = bucketFill[ppfBucket(key, numBuckets)]++;
+    keys[dst] = key;
+    refInds[dst] = p / (numRefPoints-1);
+    alphas[dst] = pairAlphas[p];
   }
 
   angle_step = angle_step_radians;
   distance_step = distanceStep;
-  hash_table = hashTable;
   num_ref_points = numRefPoints;
   sampled_pc = sampled;
   trained = true;
 }
 
+void PPF3DDetector::write(FileStorage& fs) const
+{
+  fs << "sampling_step_relative" << sampling_step_relative;
+  fs << "distance_step_relative" << distance_step_relative;
+  fs << "angle_step_relative" << angle_step_relative;
+  fs << "angle_step_radians" << angle_step_radians;
+  fs << "angle_step" << angle_step;
+  fs << "distance_step" << distance_step;
+  fs << "position_threshold" << position_threshold;
+  fs << "rotation_threshold" << rotation_threshold;
+  fs << "use_weighted_avg" << (int)use_weighted_avg;
+  fs << "trained" << (int)trained;
+
+  if (trained)
+  {
+    fs << "num_ref_points" << num_ref_points;
+    fs << "sampled_pc" << sampled_pc;
+    fs << "hash_offsets" << hash_offsets;
+    fs << "hash_keys" << hash_keys;
+    fs << "hash_ref_inds" << hash_ref_inds;
+    fs << "hash_alphas" << hash_alphas;
+  }
+}
+
+void PPF3DDetector::read(const FileNode& fn)
+{
+  clearTrainingModels();
+
+  sampling_step_relative = (double)fn["sampling_step_relative"];
+  distance_step_relative = (double)fn["distance_step_relative"];
+  angle_step_relative = (double)fn["angle_step_relative"];
+  angle_step_radians = (double)fn["angle_step_radians"];
+  angle_step = (double)fn["angle_step"];
+  distance_step = (double)fn["distance_step"];
+  position_threshold = (double)fn["position_threshold"];
+  rotation_threshold = (double)fn["rotation_threshold"];
+  use_weighted_avg = (int)fn["use_weighted_avg"] != 0;
+
+  if ((int)fn["trained"] != 0)
+  {
+    num_ref_points = (int)fn["num_ref_points"];
+    fn["sampled_pc"] >> sampled_pc;
+    fn["hash_offsets"] >> hash_offsets;
+    fn["hash_keys"] >> hash_keys;
+    fn["hash_ref_inds"] >> hash_ref_inds;
+    fn["hash_alphas"] >> hash_alphas;
+
+    CV_Assert(sampled_pc.rows == num_ref_points);
+    CV_Assert(hash_offsets.rows > 1 && (((hash_offsets.rows-1) & (hash_offsets.rows-2)) == 0));
+    CV_Assert(hash_keys.rows == hash_ref_inds.rows && hash_keys.rows == hash_alphas.rows);
+    CV_Assert(hash_offsets.at<int>(hash_offsets.rows-1) == hash_keys.rows);
+    trained = true;
+  }
+}
+
 
 
 ///////////////////////// MATCHING ////////////////////////////////////////
@@ -329,7 +426,7 @@ void PPF3DDetector::clusterPoses(std::vector<Pose3DPtr>& poseList, int numPoses,
   finalPoses.clear();
 
   // sort the poses for stability
-  std::sort(poseList.begin(), poseList.end(), pose3DPtrCompare);
+  std::stable_sort(poseList.begin(), poseList.end(), pose3DPtrCompare);
 
   for (int i=0; i<numPoses; i++)
   {
@@ -458,6 +555,204 @@ void PPF3DDetector::clusterPoses(std::vector<Pose3DPtr>& poseList, int numPoses,
   poseClusters.clear();
 }
 
+// Votes for the scene reference points of a range of the sampled scene. Every
+// invocation owns its accumulator, which is reused for all reference points of
+// the range. Poses are written to fixed slots, so that the result does not
+// depend on the scheduling of the ranges.
+class PPFVotingInvoker : public ParallelLoopBody
+{
+public:
+  PPFVotingInvoker(const Mat& sampledScene, const Mat& sampledModel, int sceneSamplingStep,
+                   int numAngles, double angleStep, float distanceStep,
+                   const Mat& hashOffsets, const Mat& hashKeys, const Mat& hashRefInds, const Mat& hashAlphas,
+                   std::vector<Pose3DPtr>& poseList) :
+    sampled(sampledScene), sampled_pc(sampledModel), scene_sampling_step(sceneSamplingStep),
+    num_angles(numAngles), angle_step(angleStep), distance_step(distanceStep),
+    hash_offsets(hashOffsets), hash_keys(hashKeys), hash_ref_inds(hashRefInds), hash_alphas(hashAlphas),
+    pose_list(poseList)
+  {
+  }
+
+  void operator()(const Range& range) const
+  {
+    const int numAngles = num_angles;
+    const unsigned int n = (unsigned int)sampled_pc.rows;
+    const unsigned int numBuckets = (unsigned int)(hash_offsets.rows - 1);
+    const int* hashOffsets = hash_offsets.ptr<int>();
+    const KeyType* hashKeys = reinterpret_cast<const KeyType*>(hash_keys.ptr<int>());
+    const int* hashRefInds = hash_ref_inds.ptr<int>();
+    const float* hashAlphas = hash_alphas.ptr<float>();
+    const int numEntries = hash_keys.rows;
+
+    // zeroed once, then cleared while searching for the maximum
+    std::vector<unsigned int> accumulatorBuf(numAngles*n, 0);
+    unsigned int* accumulator = &accumulatorBuf[0];
+
+    for (int poseInd = range.start; poseInd < range.end; poseInd++)
+    {
+      const int i = poseInd * scene_sampling_step;
+      unsigned int refIndMax = 0, alphaIndMax = 0;
+      unsigned int maxVotes = 0;
+
+      const float* f1 = sampled.ptr<float>(i);
+      const double p1[4] = {f1[0], f1[1], f1[2], 0};
+      const double n1[4] = {f1[3], f1[4], f1[5], 0};
+      double *row2, *row3, tsg[3]={0}, Rsg[9]={0}, RInv[9]={0};
+
+      computeTransformRT(p1, n1, Rsg, tsg);
+      row2=&Rsg[3];
+      row3=&Rsg[6];
+
+      // Tolga Birdal's notice:
+      // As a later update, we might want to look into a local neighborhood only
+      // To do this, simply search the local neighborhood by radius look up
+      // and collect the neighbors to compute the relative pose
+
+      for (int j = 0; j < sampled.rows; j ++)
+      {
+        if (i!=j)
+        {
+          const float* f2 = sampled.ptr<float>(j);
+          const double p2[4] = {f2[0], f2[1], f2[2], 0};
+          const double n2[4] = {f2[3], f2[4], f2[5], 0};
+          double p2t[4], alpha_scene;
+
+          double f[4]={0};
+          computePPF(p1, n1, p2, n2, f);
+          KeyType hashValue = hashPPF(f, angle_step, distance_step);
+
+          // we don't need to call this here, as we already estimate the tsg from scene reference point
+          // double alpha = computeAlpha(p1, n1, p2);
+          p2t[1] = tsg[1] + row2[0] * p2[0] + row2[1] * p2[1] + row2[2] * p2[2];
+          p2t[2] = tsg[2] + row3[0] * p2[0] + row3[1] * p2[1] + row3[2] * p2[2];
+
+          alpha_scene=atan2(-p2t[2], p2t[1]);
+
+          if ( alpha_scene != alpha_scene)
+          {
+            continue;
+          }
+
+          if (sin(alpha_scene)*p2t[2]<0.0)
+            alpha_scene=-alpha_scene;
+
+          alpha_scene=-alpha_scene;
+
+          // the index of a model loaded by loadModel() is not validated, so the bucket
+          // ranges are clamped to the entries and invalid entries are skipped
+          const unsigned int bucket = ppfBucket(hashValue, numBuckets);
+          const int entryBegin = std::max(hashOffsets[bucket], 0);
+          const int entryEnd = std::min(hashOffsets[bucket+1], numEntries);
+
+          for (int e = entryBegin; e < entryEnd; e++)
+          {
+            if (hashKeys[e] != hashValue)
+              continue;
+
+            const unsigned int corrI = (unsigned int)hashRefInds[e];
+            if (corrI >= n)
+              continue;
+            double alpha_model = (double)hashAlphas[e];
+            double alpha = alpha_model - alpha_scene;
+
+            /*  Tolga Birdal's note: Map alpha to the indices:
+                    atan2 generates results in (-pi pi]
+                    That's why alpha should be in range [-2pi 2pi]
+                    So the quantization would be :
+                    numAngles * (alpha+2pi)/(4pi)
+                    */
+
+            //printf("%f\n", alpha);
+            const double alpha_pos = numAngles*(alpha + 2*M_PI) / (4*M_PI);
+            if (alpha_pos != alpha_pos)
+              continue;
+            const int alpha_index = alpha_pos <= 0 ? 0 : alpha_pos >= numAngles ? numAngles - 1 : (int)alpha_pos;
+
+            unsigned int accIndex = corrI * numAngles + alpha_index;
+
+            accumulator[accIndex]++;
+          }
+        }
+      }
+
+      // Maximize the accumulator
+      for (unsigned int k = 0; k < n; k++)
+      {
+        for (int j = 0; j < numAngles; j++)
+        {
+          const unsigned int accInd = k*numAngles + j;
+          const unsigned int accVal = accumulator[ accInd ];
+          if (accVal > maxVotes)
+          {
+            maxVotes = accVal;
+            refIndMax = k;
+            alphaIndMax = j;
+          }
+
+          accumulator[accInd ] = 0;
+        }
+      }
+
+      // invert Tsg : Luckily rotation is orthogonal: Inverse = Transpose.
+      // We are not required to invert.
+      double tInv[3], tmg[3], Rmg[9];
+      matrixTranspose33(Rsg, RInv);
+      matrixProduct331(RInv, tsg, tInv);
+
+      double TsgInv[16] = { RInv[0], RInv[1], RInv[2], -tInv[0],
+                            RInv[3], RInv[4], RInv[5], -tInv[1],
+                            RInv[6], RInv[7], RInv[8], -tInv[2],
+                            0, 0, 0, 1
+                          };
+
+      // TODO : Compute pose
+      const float* fMax = sampled_pc.ptr<float>(refIndMax);
+      const double pMax[4] = {fMax[0], fMax[1], fMax[2], 1};
+      const double nMax[4] = {fMax[3], fMax[4], fMax[5], 1};
+
+      computeTransformRT(pMax, nMax, Rmg, tmg);
+
+      double Tmg[16] = { Rmg[0], Rmg[1], Rmg[2], tmg[0],
+                         Rmg[3], Rmg[4], Rmg[5], tmg[1],
+                         Rmg[6], Rmg[7], Rmg[8], tmg[2],
+                         0, 0, 0, 1
+                       };
+
+      // convert alpha_index to alpha
+      int alpha_index = alphaIndMax;
+      double alpha = (alpha_index*(4*M_PI))/numAngles-2*M_PI;
+
+      // Equation 2:
+      double Talpha[16]={0};
+      getUnitXRotation_44(alpha, Talpha);
+
+      double Temp[16]={0};
+      double rawPose[16]={0};
+      matrixProduct44(Talpha, Tmg, Temp);
+      matrixProduct44(TsgInv, Temp, rawPose);
+
+      Pose3DPtr pose(new Pose3D(alpha, refIndMax, maxVotes));
+      pose->updatePose(rawPose);
+      pose_list[poseInd] = pose;
+    }
+  }
+
+private:
+  const Mat& sampled;
+  const Mat& sampled_pc;
+  int scene_sampling_step;
+  int num_angles;
+  double angle_step;
+  float distance_step;
+  const Mat& hash_offsets;
+  const Mat& hash_keys;
+  const Mat& hash_ref_inds;
+  const Mat& hash_alphas;
+  std::vector<Pose3DPtr>& pose_list;
+
+  PPFVotingInvoker& operator=(const PPFVotingInvoker&);
+};
+
 void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const double relativeSceneSampleStep, const double relativeSceneDistance)
 {
   if (!trained)
@@ -473,8 +768,6 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
   //int numNeighbors = 10;
   int numAngles = (int) (floor (2 * M_PI / angle_step));
   float distanceStep = (float)distance_step;
-  unsigned int n = num_ref_points;
-  std::vector<Pose3DPtr> poseList;
   int sceneSamplingStep = scene_sample_step;
 
   // compute bbox
@@ -489,168 +782,17 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
   float distanceSampleStep = diameter * RelativeSceneDistance;*/
   Mat sampled = samplePCByQuantization(pc, xRange, yRange, zRange, (float)relativeSceneDistance, 0);
 
-  // allocate the accumulator : Moved this to the inside of the loop
-  /*#if !defined (_OPENMP)
-     unsigned int* accumulator = (unsigned int*)calloc(numAngles*n, sizeof(unsigned int));
-  #endif*/
-
-  poseList.reserve((sampled.rows/sceneSamplingStep)+4);
-
-#if defined _OPENMP
-#pragma omp parallel for
-#endif
-  for (int i = 0; i < sampled.rows; i += sceneSamplingStep)
-  {
-    unsigned int refIndMax = 0, alphaIndMax = 0;
-    unsigned int maxVotes = 0;
-
-    float* f1 = sampled.ptr<float>(i);
-    const double p1[4] = {f1[0], f1[1], f1[2], 0};
-    const double n1[4] = {f1[3], f1[4], f1[5], 0};
-    double *row2, *row3, tsg[3]={0}, Rsg[9]={0}, RInv[9]={0};
-
-    unsigned int* accumulator = (unsigned int*)calloc(numAngles*n, sizeof(unsigned int));
-    computeTransformRT(p1, n1, Rsg, tsg);
-    row2=&Rsg[3];
-    row3=&Rsg[6];
-
-    // Tolga Birdal's notice:
-    // As a later update, we might want to look into a local neighborhood only
-    // To do this, simply search the local neighborhood by radius look up
-    // and collect the neighbors to compute the relative pose
-
-    for (int j = 0; j < sampled.rows; j ++)
-    {
-      if (i!=j)
-      {
-        float* f2 = sampled.ptr<float>(j);
-        const double p2[4] = {f2[0], f2[1], f2[2], 0};
-        const double n2[4] = {f2[3], f2[4], f2[5], 0};
-        double p2t[4], alpha_scene;
-
-        double f[4]={0};
-        computePPFFeatures(p1, n1, p2, n2, f);
-        KeyType hashValue = hashPPF(f, angle_step, distanceStep);
-
-        // we don't need to call this here, as we already estimate the tsg from scene reference point
-        // double alpha = computeAlpha(p1, n1, p2);
-        p2t[1] = tsg[1] + row2[0] * p2[0] + row2[1] * p2[1] + row2[2] * p2[2];
-        p2t[2] = tsg[2] + row3[0] * p2[0] + row3[1] * p2[1] + row3[2] * p2[2];
-
-        alpha_scene=atan2(-p2t[2], p2t[1]);
-
-        if ( alpha_scene != alpha_scene)
-        {
-          continue;
-        }
-
-        if (sin(alpha_scene)*p2t[2]<0.0)
-          alpha_scene=-alpha_scene;
-
-        alpha_scene=-alpha_scene;
-
-        hashnode_i* node = hashtableGetBucketHashed(hash_table, (hashValue));
-
-        while (node)
-        {
-          THash* tData = (THash*) node->data;
-          int corrI = (int)tData->i;
-          int ppfInd = (int)tData->ppfInd;
-          float* ppfCorrScene = ppf.ptr<float>(ppfInd);
-          double alpha_model = (double)ppfCorrScene[PPF_LENGTH-1];
-          double alpha = alpha_model - alpha_scene;
-
-          /*  Tolga Birdal's note: Map alpha to the indices:
-                  atan2 generates results in (-pi pi]
-                  That's why alpha should be in range [-2pi 2pi]
-                  So the quantization would be :
-                  numAngles * (alpha+2pi)/(4pi)
-                  */
-
-          //printf("%f\n", alpha);
-          int alpha_index = (int)(numAngles*(alpha + 2*M_PI) / (4*M_PI));
-
-          unsigned int accIndex = corrI * numAngles + alpha_index;
-
-          accumulator[accIndex]++;
-          node = node->next;
-        }
-      }
-    }
-
-    // Maximize the accumulator
-    for (unsigned int k = 0; k < n; k++)
-    {
-      for (int j = 0; j < numAngles; j++)
-      {
-        const unsigned int accInd = k*numAngles + j;
-        const unsigned int accVal = accumulator[ accInd ];
-        if (accVal > maxVotes)
-        {
-          maxVotes = accVal;
-          refIndMax = k;
-          alphaIndMax = j;
-        }
-
-#if !defined (_OPENMP)
-        accumulator[accInd ] = 0;
-#endif
-      }
-    }
-
-    // invert Tsg : Luckily rotation is orthogonal: Inverse = Transpose.
-    // We are not required to invert.
-    double tInv[3], tmg[3], Rmg[9];
-    matrixTranspose33(Rsg, RInv);
-    matrixProduct331(RInv, tsg, tInv);
-
-    double TsgInv[16] = { RInv[0], RInv[1], RInv[2], -tInv[0],
-                          RInv[3], RInv[4], RInv[5], -tInv[1],
-                          RInv[6], RInv[7], RInv[8], -tInv[2],
-                          0, 0, 0, 1
-                        };
-
-    // TODO : Compute pose
-    const float* fMax = sampled_pc.ptr<float>(refIndMax);
-    const double pMax[4] = {fMax[0], fMax[1], fMax[2], 1};
-    const double nMax[4] = {fMax[3], fMax[4], fMax[5], 1};
-
-    computeTransformRT(pMax, nMax, Rmg, tmg);
-    row2=&Rsg[3];
-    row3=&Rsg[6];
-
-    double Tmg[16] = { Rmg[0], Rmg[1], Rmg[2], tmg[0],
-                       Rmg[3], Rmg[4], Rmg[5], tmg[1],
-                       Rmg[6], Rmg[7], Rmg[8], tmg[2],
-                       0, 0, 0, 1
-                     };
-
-    // convert alpha_index to alpha
-    int alpha_index = alphaIndMax;
-    double alpha = (alpha_index*(4*M_PI))/numAngles-2*M_PI;
-
-    // Equation 2:
-    double Talpha[16]={0};
-    getUnitXRotation_44(alpha, Talpha);
-
-    double Temp[16]={0};
-    double rawPose[16]={0};
-    matrixProduct44(Talpha, Tmg, Temp);
-    matrixProduct44(TsgInv, Temp, rawPose);
-
-    Pose3DPtr pose(new Pose3D(alpha, refIndMax, maxVotes));
-    pose->updatePose(rawPose);
-    #if defined (_OPENMP)
-    #pragma omp critical
-    #endif
-    {
-      poseList.push_back(pose);
-    }
-
-#if defined (_OPENMP)
-    free(accumulator);
-#endif
-  }
+  // one pose per scene reference point, in scene order
+  const int numRefPoints = (sampled.rows + sceneSamplingStep - 1) / sceneSamplingStep;
+  std::vector<Pose3DPtr> poseList(numRefPoints);
+
+  // a stripe per group of reference points keeps accumulator allocations per thread,
+  // not per reference point
+  const double nstripes = std::min(numRefPoints, getNumThreads() * 4);
+  parallel_for_(Range(0, numRefPoints),
+                PPFVotingInvoker(sampled, sampled_pc, sceneSamplingStep, numAngles, angle_step, distanceStep,
+                                 hash_offsets, hash_keys, hash_ref_inds, hash_alphas, poseList),
+                nstripes);
 
   // TODO : Make the parameters relative if not arguments.
   //double MinMatchScore = 0.5;
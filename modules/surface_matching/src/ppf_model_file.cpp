@@ -0,0 +1,216 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+#include "mapped_file.hpp"
+
+namespace cv
+{
+namespace ppf_match_3d
+{
+
+/*
+ Binary model file layout (native byte order, checked on load):
+
+   PPFModelFileHeader
+   sampled model       numRefPoints x sampledCols floats
+   bucket offsets      numBuckets+1 ints
+   entry keys          numEntries ints
+   entry reference     numEntries ints
+   entry alphas        numEntries floats
+
+ Every section starts at a multiple of PPF_MODEL_ALIGNMENT bytes, so that the
+ arrays can be used in place from a memory mapping.
+*/
+static const char PPF_MODEL_MAGIC[8] = {'C', 'V', 'P', 'P', 'F', '3', 'D', 0};
+static const unsigned int PPF_MODEL_VERSION = 1;
+static const unsigned int PPF_MODEL_ENDIAN_CHECK = 0x01020304;
+static const size_t PPF_MODEL_ALIGNMENT = 64;
+
+enum
+{
+  PPF_SECTION_SAMPLED = 0,
+  PPF_SECTION_OFFSETS,
+  PPF_SECTION_KEYS,
+  PPF_SECTION_REF_INDS,
+  PPF_SECTION_ALPHAS,
+  PPF_SECTION_COUNT
+};
+
+struct PPFModelFileHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int endianCheck;
+  unsigned int headerSize;
+  int numRefPoints;
+  int sampledCols;
+  int numBuckets;
+  int numEntries;
+  int useWeightedAvg;
+  double samplingStepRelative;
+  double distanceStepRelative;
+  double angleStepRelative;
+  double angleStepRadians;
+  double angleStep;
+  double distanceStep;
+  double positionThreshold;
+  double rotationThreshold;
+  uint64 sectionOffsets[PPF_SECTION_COUNT];
+  uint64 fileSize;
+};
+
+static inline uint64 alignModelOffset(uint64 offset)
+{
+  return (offset + PPF_MODEL_ALIGNMENT - 1) & ~(uint64)(PPF_MODEL_ALIGNMENT - 1);
+}
+
+// computes the section offsets and the file size from the array sizes in the header
+static void layoutModelFile(PPFModelFileHeader& header)
+{
+  const uint64 sectionSizes[PPF_SECTION_COUNT] =
+  {
+    (uint64)header.numRefPoints * header.sampledCols * sizeof(float),
+    ((uint64)header.numBuckets + 1) * sizeof(int),
+    (uint64)header.numEntries * sizeof(int),
+    (uint64)header.numEntries * sizeof(int),
+    (uint64)header.numEntries * sizeof(float)
+  };
+
+  uint64 offset = alignModelOffset(sizeof(PPFModelFileHeader));
+  for (int i = 0; i < PPF_SECTION_COUNT; i++)
+  {
+    header.sectionOffsets[i] = offset;
+    offset = alignModelOffset(offset + sectionSizes[i]);
+  }
+  header.fileSize = offset;
+}
+
+// Read-only memory mapping of a model file. It is kept alive by the detector,
+// whose model matrices point into it.
+class PPF3DDetector::MappedModelFile : public internal::MappedFile
+{
+public:
+  MappedModelFile(const String& fileName) : MappedFile(fileName, "PPF model file") {}
+};
+
+static void writeModelSection(FILE* f, const Mat& m, uint64 offset)
+{
+  CV_Assert(m.empty() || m.isContinuous());
+
+  // pad up to the section start
+  static const char zeros[PPF_MODEL_ALIGNMENT] = {0};
+  uint64 pos = (uint64)ftell(f);
+  CV_Assert(pos <= offset && offset - pos <= PPF_MODEL_ALIGNMENT);
+  if (offset > pos)
+    fwrite(zeros, 1, (size_t)(offset - pos), f);
+
+  if (!m.empty())
+    fwrite(m.data, m.elemSize(), m.total(), f);
+}
+
+void PPF3DDetector::saveModel(const String& fileName) const
+{
+  if (!trained)
+    CV_Error(Error::StsError, "The model is not trained. Cannot save it");
+
+  CV_Assert(sampled_pc.type() == CV_32F && sampled_pc.isContinuous());
+
+  PPFModelFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PPF_MODEL_MAGIC, sizeof(header.magic));
+  header.version = PPF_MODEL_VERSION;
+  header.endianCheck = PPF_MODEL_ENDIAN_CHECK;
+  header.headerSize = (unsigned int)sizeof(PPFModelFileHeader);
+  header.numRefPoints = num_ref_points;
+  header.sampledCols = sampled_pc.cols;
+  header.numBuckets = hash_offsets.rows - 1;
+  header.numEntries = hash_keys.rows;
+  header.useWeightedAvg = use_weighted_avg ? 1 : 0;
+  header.samplingStepRelative = sampling_step_relative;
+  header.distanceStepRelative = distance_step_relative;
+  header.angleStepRelative = angle_step_relative;
+  header.angleStepRadians = angle_step_radians;
+  header.angleStep = angle_step;
+  header.distanceStep = distance_step;
+  header.positionThreshold = position_threshold;
+  header.rotationThreshold = rotation_threshold;
+  layoutModelFile(header);
+
+  FILE* f = fopen(fileName.c_str(), "wb");
+  if (!f)
+    CV_Error(Error::StsError, "Cannot open PPF model file " + fileName + " for writing");
+
+  fwrite(&header, sizeof(header), 1, f);
+  writeModelSection(f, sampled_pc, header.sectionOffsets[PPF_SECTION_SAMPLED]);
+  writeModelSection(f, hash_offsets, header.sectionOffsets[PPF_SECTION_OFFSETS]);
+  writeModelSection(f, hash_keys, header.sectionOffsets[PPF_SECTION_KEYS]);
+  writeModelSection(f, hash_ref_inds, header.sectionOffsets[PPF_SECTION_REF_INDS]);
+  writeModelSection(f, hash_alphas, header.sectionOffsets[PPF_SECTION_ALPHAS]);
+  writeModelSection(f, Mat(), header.fileSize);
+
+  const bool ok = !ferror(f);
+  fclose(f);
+
+  if (!ok)
+    CV_Error(Error::StsError, "Cannot write PPF model file " + fileName);
+}
+
+void PPF3DDetector::loadModel(const String& fileName)
+{
+  Ptr<MappedModelFile> file(new MappedModelFile(fileName));
+
+  if (file->size < sizeof(PPFModelFileHeader))
+    CV_Error(Error::StsError, "Invalid PPF model file " + fileName);
+
+  PPFModelFileHeader header;
+  memcpy(&header, file->data, sizeof(header));
+
+  if (memcmp(header.magic, PPF_MODEL_MAGIC, sizeof(header.magic)) != 0)
+    CV_Error(Error::StsError, "Invalid PPF model file " + fileName);
+  if (header.endianCheck != PPF_MODEL_ENDIAN_CHECK)
+    CV_Error(Error::StsError, "PPF model file " + fileName + " has been written on a platform with another byte order");
+  if (header.version != PPF_MODEL_VERSION || header.headerSize != sizeof(PPFModelFileHeader))
+    CV_Error(Error::StsError, "Unsupported version of PPF model file " + fileName);
+
+  // recompute the layout from the sizes, so that a corrupted header cannot point outside of the file
+  PPFModelFileHeader expected = header;
+  if (header.numRefPoints <= 0 || header.sampledCols < 6 || header.numEntries < 0 || header.numBuckets <= 0 ||
+      (header.numBuckets & (header.numBuckets - 1)) != 0)
+    CV_Error(Error::StsError, "Invalid PPF model file " + fileName);
+  layoutModelFile(expected);
+  if (memcmp(expected.sectionOffsets, header.sectionOffsets, sizeof(header.sectionOffsets)) != 0 ||
+      expected.fileSize != header.fileSize || header.fileSize > file->size)
+    CV_Error(Error::StsError, "Truncated or corrupted PPF model file " + fileName);
+
+  // Only the header and the layout are checked, so that loading does not read the arrays.
+  // match() clamps the bucket ranges and skips the entries that are out of range.
+
+  clearTrainingModels();
+
+  sampling_step_relative = header.samplingStepRelative;
+  distance_step_relative = header.distanceStepRelative;
+  angle_step_relative = header.angleStepRelative;
+  angle_step_radians = header.angleStepRadians;
+  angle_step = header.angleStep;
+  distance_step = header.distanceStep;
+  position_threshold = header.positionThreshold;
+  rotation_threshold = header.rotationThreshold;
+  use_weighted_avg = header.useWeightedAvg != 0;
+
+  // the matrices refer to the mapping and are only read by match()
+  const uchar* base = file->data;
+  num_ref_points = header.numRefPoints;
+  sampled_pc = Mat(header.numRefPoints, header.sampledCols, CV_32F, (void*)(base + header.sectionOffsets[PPF_SECTION_SAMPLED]));
+  hash_offsets = Mat(header.numBuckets + 1, 1, CV_32S, (void*)(base + header.sectionOffsets[PPF_SECTION_OFFSETS]));
+  hash_keys = Mat(header.numEntries, 1, CV_32S, (void*)(base + header.sectionOffsets[PPF_SECTION_KEYS]));
+  hash_ref_inds = Mat(header.numEntries, 1, CV_32S, (void*)(base + header.sectionOffsets[PPF_SECTION_REF_INDS]));
+  hash_alphas = Mat(header.numEntries, 1, CV_32F, (void*)(base + header.sectionOffsets[PPF_SECTION_ALPHAS]));
+  mapped_model = file;
+  trained = true;
+}
+
+} // namespace ppf_match_3d
+
+} // namespace cv
@@ -0,0 +1,54 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+#include <cfloat>
+
+using namespace cv;
+using namespace cv::ppf_match_3d;
+
+TEST(PPFHelpers, queryPCFlannAllocatesOutputs)
+{
+  RNG rng(0x1234);
+  Mat pc(2000, 3, CV_32F), queries(1500, 6, CV_32F);
+  rng.fill(pc, RNG::UNIFORM, -1.f, 1.f);
+  rng.fill(queries, RNG::UNIFORM, -1.f, 1.f);
+
+  void* index = indexPCFlann(pc);
+
+  Mat indices, distances;
+  queryPCFlann(index, queries, indices, distances, 2);
+  ASSERT_EQ(queries.rows, indices.rows);
+  ASSERT_EQ(2, indices.cols);
+  ASSERT_EQ(CV_32S, indices.type());
+  ASSERT_EQ(queries.rows, distances.rows);
+  ASSERT_EQ(2, distances.cols);
+  ASSERT_EQ(CV_32F, distances.type());
+
+  // the single kd-tree search is exact
+  for (int q = 0; q < queries.rows; q++)
+  {
+    const float* qp = queries.ptr<float>(q);
+    float best = FLT_MAX;
+    for (int i = 0; i < pc.rows; i++)
+    {
+      const float* p = pc.ptr<float>(i);
+      const float dx = qp[0]-p[0], dy = qp[1]-p[1], dz = qp[2]-p[2];
+      best = std::min(best, dx*dx + dy*dy + dz*dz);
+    }
+    const float* nearest = pc.ptr<float>(indices.at<int>(q, 0));
+    const float dx = qp[0]-nearest[0], dy = qp[1]-nearest[1], dz = qp[2]-nearest[2];
+    EXPECT_NEAR(best, distances.at<float>(q, 0), 1e-6);
+    EXPECT_NEAR(dx*dx + dy*dy + dz*dz, distances.at<float>(q, 0), 1e-6);
+    EXPECT_LE(distances.at<float>(q, 0), distances.at<float>(q, 1));
+  }
+
+  // outputs of another size or type are replaced before the parallel search
+  Mat indicesOther(10, 1, CV_64F), distancesOther(10, 5, CV_8U);
+  queryPCFlann(index, queries, indicesOther, distancesOther, 2);
+  EXPECT_EQ(0, cvtest::norm(indices, indicesOther, NORM_INF));
+  EXPECT_EQ(0, cvtest::norm(distances, distancesOther, NORM_INF));
+
+  destroyFlann(index);
+}
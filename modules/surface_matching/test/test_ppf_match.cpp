@@ -0,0 +1,317 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "test_precomp.hpp"
+#include <map>
+#include <limits>
+
+using namespace cv;
+using namespace cv::ppf_match_3d;
+
+namespace
+{
+
+// Synthetic object: points with normals on an ellipsoid, as in the performance tests.
+Mat makeModel(int numPoints)
+{
+  Mat pc(numPoints, 6, CV_32F);
+  RNG rng(0x1234);
+  const float axes[3] = {1.f, 0.6f, 0.3f};
+  for (int i = 0; i < numPoints; i++)
+  {
+    const double theta = rng.uniform(0., CV_PI), phi = rng.uniform(0., 2*CV_PI);
+    const double u[3] = {sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta)};
+    float* row = pc.ptr<float>(i);
+    double n[3], nn = 0;
+    for (int k = 0; k < 3; k++)
+    {
+      row[k] = (float)(axes[k]*u[k]);
+      n[k] = u[k] / axes[k];
+      nn += n[k]*n[k];
+    }
+    nn = sqrt(nn);
+    for (int k = 0; k < 3; k++)
+      row[3+k] = (float)(n[k] / nn);
+  }
+  return pc;
+}
+
+// Gives access to the trained index of the detector.
+class PPF3DDetectorIndex : public PPF3DDetector
+{
+public:
+  PPF3DDetectorIndex() : PPF3DDetector(0.05, 0.05) {}
+
+  const Mat& sampledModel() const { return sampled_pc; }
+  double distanceStep() const { return distance_step; }
+  const Mat& offsets() const { return hash_offsets; }
+  const Mat& keys() const { return hash_keys; }
+  const Mat& refInds() const { return hash_ref_inds; }
+  const Mat& alphas() const { return hash_alphas; }
+
+  // (model reference point, alpha) of the pairs with the given key, as scanned by match()
+  std::vector<std::pair<int, float> > candidates(KeyType key) const
+  {
+    std::vector<std::pair<int, float> > result;
+    const unsigned int bucket = key & (unsigned int)(hash_offsets.rows - 2);
+    for (int e = hash_offsets.at<int>(bucket); e < hash_offsets.at<int>(bucket + 1); e++)
+      if ((KeyType)hash_keys.at<int>(e) == key)
+        result.push_back(std::make_pair(hash_ref_inds.at<int>(e), hash_alphas.at<float>(e)));
+    return result;
+  }
+};
+
+void expectSameCandidates(std::vector<std::pair<int, float> > expected, std::vector<std::pair<int, float> > actual)
+{
+  std::sort(expected.begin(), expected.end());
+  std::sort(actual.begin(), actual.end());
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t k = 0; k < expected.size(); k++)
+  {
+    EXPECT_EQ(expected[k].first, actual[k].first);
+    EXPECT_NEAR(expected[k].second, actual[k].second, 1e-5);
+  }
+}
+
+}
+
+TEST(PPF3DDetector, flatIndexMatchesBruteForceScan)
+{
+  PPF3DDetectorIndex detector;
+  detector.trainModel(makeModel(2000));
+
+  const Mat& sampled = detector.sampledModel();
+  const Mat& offsets = detector.offsets();
+  const int n = sampled.rows, numBuckets = offsets.rows - 1, numEntries = detector.keys().rows;
+  ASSERT_GT(n, 10);
+  ASSERT_EQ(n*(n-1), numEntries);
+  ASSERT_EQ(0, offsets.at<int>(0));
+  ASSERT_EQ(numEntries, offsets.at<int>(numBuckets));
+
+  // every entry lies in the bucket of its key, and every reference point is paired with all the others
+  std::vector<int> pairsPerRef(n, 0);
+  for (int b = 0; b < numBuckets; b++)
+  {
+    ASSERT_LE(offsets.at<int>(b), offsets.at<int>(b + 1));
+    for (int e = offsets.at<int>(b); e < offsets.at<int>(b + 1); e++)
+    {
+      ASSERT_EQ((unsigned int)b, (KeyType)detector.keys().at<int>(e) & (unsigned int)(numBuckets - 1));
+      const int refInd = detector.refInds().at<int>(e);
+      ASSERT_GE(refInd, 0);
+      ASSERT_LT(refInd, n);
+      pairsPerRef[refInd]++;
+      EXPECT_LE(std::abs(detector.alphas().at<float>(e)), (float)CV_PI);
+    }
+  }
+  for (int i = 0; i < n; i++)
+    EXPECT_EQ(n - 1, pairsPerRef[i]);
+
+  // the pairs of each key found by scanning all the entries are those of its bucket
+  std::map<KeyType, std::vector<std::pair<int, float> > > scanned;
+  for (int e = 0; e < numEntries; e++)
+    scanned[(KeyType)detector.keys().at<int>(e)].push_back(
+      std::make_pair(detector.refInds().at<int>(e), detector.alphas().at<float>(e)));
+  for (std::map<KeyType, std::vector<std::pair<int, float> > >::const_iterator it = scanned.begin(); it != scanned.end(); ++it)
+    expectSameCandidates(it->second, detector.candidates(it->first));
+}
+
+TEST(PPF3DDetector, flatIndexWriteRead)
+{
+  Mat model = makeModel(2000);
+  PPF3DDetectorIndex detector;
+  detector.trainModel(model);
+
+  FileStorage fs(".yml", FileStorage::WRITE + FileStorage::MEMORY);
+  detector.write(fs);
+  String buf = fs.releaseAndGetString();
+
+  PPF3DDetectorIndex loaded;
+  FileStorage fsRead(buf, FileStorage::READ + FileStorage::MEMORY);
+  loaded.read(fsRead.root());
+
+  EXPECT_EQ(0, cvtest::norm(detector.sampledModel(), loaded.sampledModel(), NORM_INF));
+  EXPECT_EQ(0, cvtest::norm(detector.offsets(), loaded.offsets(), NORM_INF));
+  EXPECT_EQ(0, cvtest::norm(detector.keys(), loaded.keys(), NORM_INF));
+  EXPECT_EQ(0, cvtest::norm(detector.refInds(), loaded.refInds(), NORM_INF));
+  EXPECT_EQ(0, cvtest::norm(detector.alphas(), loaded.alphas(), NORM_INF));
+  EXPECT_EQ(detector.distanceStep(), loaded.distanceStep());
+
+  for (int e = 0; e < detector.keys().rows; e += 101)
+  {
+    const KeyType key = (KeyType)detector.keys().at<int>(e);
+    expectSameCandidates(detector.candidates(key), loaded.candidates(key));
+  }
+
+  double pose[16];
+  getRandomPose(pose);
+  Mat scene = transformPCPose(model, pose);
+  std::vector<Pose3DPtr> expected, actual;
+  detector.match(scene, expected, 1.0/5.0, 0.05);
+  loaded.match(scene, actual, 1.0/5.0, 0.05);
+  ASSERT_EQ(expected.size(), actual.size());
+  ASSERT_FALSE(expected.empty());
+  for (size_t k = 0; k < expected.size(); k++)
+  {
+    EXPECT_EQ(expected[k]->numVotes, actual[k]->numVotes);
+    for (int m = 0; m < 16; m++)
+      EXPECT_EQ(expected[k]->pose[m], actual[k]->pose[m]);
+  }
+}
+
+namespace
+{
+
+std::vector<uchar> readFileBytes(const String& fileName)
+{
+  std::vector<uchar> bytes;
+  FILE* f = fopen(fileName.c_str(), "rb");
+  if (!f)
+    return bytes;
+  fseek(f, 0, SEEK_END);
+  bytes.resize((size_t)ftell(f));
+  fseek(f, 0, SEEK_SET);
+  if (!bytes.empty() && fread(&bytes[0], 1, bytes.size(), f) != bytes.size())
+    bytes.clear();
+  fclose(f);
+  return bytes;
+}
+
+void writeFileBytes(const String& fileName, const std::vector<uchar>& bytes, size_t size)
+{
+  FILE* f = fopen(fileName.c_str(), "wb");
+  ASSERT_TRUE(f != NULL);
+  if (size > 0)
+    fwrite(&bytes[0], 1, size, f);
+  fclose(f);
+}
+
+// position of the data of a model array in the file
+size_t findSection(const std::vector<uchar>& bytes, const Mat& m)
+{
+  const uchar* data = m.ptr();
+  const size_t size = m.total() * m.elemSize();
+  return (size_t)(std::search(bytes.begin(), bytes.end(), data, data + size) - bytes.begin());
+}
+
+}
+
+TEST(PPF3DDetector, saveLoadModelMatchesTrainedModel)
+{
+  Mat model = makeModel(2000);
+  PPF3DDetector trained(0.05, 0.05);
+  trained.trainModel(model);
+
+  double pose[16];
+  getRandomPose(pose);
+  Mat scene = transformPCPose(model, pose);
+  std::vector<Pose3DPtr> expected, actual;
+  trained.match(scene, expected, 1.0/5.0, 0.05);
+
+  const String fileName = cv::tempfile(".ppf");
+  trained.saveModel(fileName);
+  {
+    // the file stays mapped while the detector exists
+    PPF3DDetector loaded;
+    loaded.loadModel(fileName);
+    loaded.match(scene, actual, 1.0/5.0, 0.05);
+  }
+  remove(fileName.c_str());
+
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t k = 0; k < expected.size(); k++)
+  {
+    EXPECT_EQ(expected[k]->numVotes, actual[k]->numVotes);
+    EXPECT_EQ(expected[k]->modelIndex, actual[k]->modelIndex);
+    for (int m = 0; m < 16; m++)
+      EXPECT_EQ(expected[k]->pose[m], actual[k]->pose[m]);
+  }
+}
+
+TEST(PPF3DDetector, loadModelChecksLayoutAndMatchSkipsCorruptedEntries)
+{
+  Mat model = makeModel(2000);
+  PPF3DDetectorIndex detector;
+  detector.trainModel(model);
+
+  double pose[16];
+  getRandomPose(pose);
+  Mat scene = transformPCPose(model, pose);
+
+  const String fileName = cv::tempfile(".ppf");
+  detector.saveModel(fileName);
+  const std::vector<uchar> bytes = readFileBytes(fileName);
+  ASSERT_FALSE(bytes.empty());
+
+  const Mat& offsets = detector.offsets();
+  const int numBuckets = offsets.rows - 1;
+  const int numEntries = detector.keys().rows;
+  const size_t offsetsPos = findSection(bytes, offsets);
+  const size_t refIndsPos = findSection(bytes, detector.refInds());
+  const size_t alphasPos = findSection(bytes, detector.alphas());
+  ASSERT_LT(offsetsPos, bytes.size());
+  ASSERT_LT(refIndsPos, bytes.size());
+  ASSERT_LT(alphasPos, bytes.size());
+
+  int decreasing = 1;
+  while (decreasing < numBuckets && offsets.at<int>(decreasing - 1) == 0)
+    decreasing++;
+  ASSERT_LT(decreasing, numBuckets);
+
+  // a file that does not hold its sections is rejected
+  for (int corruption = 0; corruption < 2; corruption++)
+  {
+    SCOPED_TRACE(corruption);
+    std::vector<uchar> corrupted(bytes);
+    size_t size = corrupted.size();
+    if (corruption == 0) // truncated
+      size /= 2;
+    else // entry count of the header not matching the section offsets
+      ((int*)&corrupted[0])[8] += 1; // numEntries, the sixth field after the magic
+    writeFileBytes(fileName, corrupted, size);
+
+    PPF3DDetector loaded;
+    EXPECT_THROW(loaded.loadModel(fileName), cv::Exception);
+  }
+
+  // the index itself is not read on load, match() stays within the index and the accumulator
+  for (int corruption = 0; corruption < 5; corruption++)
+  {
+    SCOPED_TRACE(corruption);
+    std::vector<uchar> corrupted(bytes);
+    int* offsetsData = (int*)&corrupted[offsetsPos];
+    int* refIndsData = (int*)&corrupted[refIndsPos];
+    float* alphasData = (float*)&corrupted[alphasPos];
+    for (int e = corruption; e < numEntries; e += 97)
+    {
+      switch (corruption)
+      {
+      case 0: // buckets past the entries
+        offsetsData[e % numBuckets + 1] = numEntries + 1000;
+        break;
+      case 1: // decreasing and negative bucket offsets
+        offsetsData[decreasing] = offsetsData[decreasing - 1] - 1;
+        offsetsData[e % numBuckets] = -1000;
+        break;
+      case 2: // model reference points out of the model
+        refIndsData[e] = (e & 1) ? detector.sampledModel().rows : -1;
+        break;
+      case 3: // angles out of the accumulator
+        alphasData[e] = (e & 1) ? 100.f : -100.f;
+        break;
+      case 4: // invalid angles
+        alphasData[e] = std::numeric_limits<float>::quiet_NaN();
+        break;
+      }
+    }
+    writeFileBytes(fileName, corrupted, corrupted.size());
+
+    PPF3DDetector loaded;
+    ASSERT_NO_THROW(loaded.loadModel(fileName));
+    std::vector<Pose3DPtr> results;
+    EXPECT_NO_THROW(loaded.match(scene, results, 1.0/5.0, 0.05));
+  }
+
+  remove(fileName.c_str());
+}
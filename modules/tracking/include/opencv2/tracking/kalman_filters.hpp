@@ -91,6 +91,45 @@ public:
     virtual Mat getState() const = 0;
 };
 
+/** @brief The interface for a set of independent Unscented Kalman filters sharing the same model and parameters.
+* The filters are stored as structures of arrays: the rows of the matrices hold a component of the vectors or
+* of the matrices of all the filters, for their steps to be computed by loops over contiguous memory.
+*/
+class CV_EXPORTS UnscentedKalmanFilterBatch
+{
+public:
+
+    virtual ~UnscentedKalmanFilterBatch(){}
+
+    /** The function performs prediction step of the algorithm for all the filters
+    * @param control - the current control vectors, CP x N,
+    * @return the predicted estimates of the states, DP x N.
+    */
+    virtual Mat predict( InputArray control = noArray() ) = 0;
+
+    /** The function performs correction step of the algorithm for all the filters
+    * @param measurement - the current measurement vectors, MP x N,
+    * @return the corrected estimates of the states, DP x N.
+    */
+    virtual Mat correct( InputArray measurement ) = 0;
+
+    /**
+    * @param idx - index of the filter,
+    * @return the error cross-covariance matrix of the filter.
+    */
+    virtual Mat getErrorCov( int idx ) const = 0;
+
+    /**
+    * @return the current estimates of the states, DP x N.
+    */
+    virtual Mat getState() const = 0;
+
+    /**
+    * @return the number of filters N.
+    */
+    virtual int getNumFilters() const = 0;
+};
+
 /** @brief Model of dynamical system for Unscented Kalman filter.
 * The interface for dynamical system model. It contains functions for computing the next state and the measurement.
 * It must be inherited for using UKF.
@@ -114,6 +153,21 @@ public:
     * @param z_k - measurement vector.
     */
     virtual void measurementFunction( const Mat& x_k, const Mat& n_k, Mat& z_k ) = 0;
+
+    /** The function for computing the next states of many states at once, used by UnscentedKalmanFilterBatch.
+    * The default implementation calls stateConversionFunction for each column with a zero noise vector,
+    * it can be overridden to process the rows of the matrices, each one holding a component of all the states.
+    * @param X_k - previous state vectors, one per column,
+    * @param U_k - control vectors, one per column, or an empty matrix,
+    * @param X_kplus1 - next state vectors, one per column, allocated by the caller.
+    */
+    virtual void batchStateConversionFunction( const Mat& X_k, const Mat& U_k, Mat& X_kplus1 );
+    /** The function for computing the measurements of many states at once, used by UnscentedKalmanFilterBatch.
+    * The default implementation calls measurementFunction for each column with a zero noise vector.
+    * @param X_k - state vectors, one per column,
+    * @param Z_k - measurement vectors, one per column, allocated by the caller.
+    */
+    virtual void batchMeasurementFunction( const Mat& X_k, Mat& Z_k );
 };
 
 
@@ -221,6 +275,16 @@ CV_EXPORTS Ptr<UnscentedKalmanFilter> createUnscentedKalmanFilter( const Unscent
 * @return pointer to the object of the AugmentedUnscentedKalmanFilterImpl class implementing UnscentedKalmanFilter.
 */
 CV_EXPORTS Ptr<UnscentedKalmanFilter> createAugmentedUnscentedKalmanFilter( const AugmentedUnscentedKalmanFilterParams &params );
+/** @brief Factory method of a set of independent Unscented Kalman filters
+
+* The filters give the same estimates as the ones created by createUnscentedKalmanFilter, except that the measurement
+* noise cross-covariance matrix must be positive definite.
+* @param params - an object of the UnscentedKalmanFilterParams class containing the parameters of all the filters,
+* the initial state being either DP x 1 for all of them or DP x N,
+* @param numFilters - the number of filters N.
+* @return pointer to the object implementing UnscentedKalmanFilterBatch.
+*/
+CV_EXPORTS Ptr<UnscentedKalmanFilterBatch> createUnscentedKalmanFilterBatch( const UnscentedKalmanFilterParams &params, int numFilters );
 
 } // tracking
 } // cv
@@ -1299,8 +1299,9 @@ public:
 
 /************************************ MultiTracker Class ---By Laksono Kurnianggoro---) ************************************/
 /** @brief This class is used to track multiple objects using the specified tracker algorithm.
-* The MultiTracker is naive implementation of multiple object tracking.
-* It process the tracked objects independently without any optimization accross the tracked objects.
+* The trackers of the objects are updated in parallel on each frame. The KCF trackers are updated together,
+* the kernel correlations of their targets being computed in batches, and the GOTURN trackers run a single
+* forward of the network for all their targets. The other trackers are updated independently.
 */
 class CV_EXPORTS_W MultiTracker : public Algorithm
 {
@@ -1336,6 +1337,7 @@ public:
   /**
   * \brief Update the current tracking status.
   * The result will be saved in the internal storage.
+  * The trackers are updated in parallel, hence each object must be given its own tracker instance.
   * @param image input image
   */
   bool update(InputArray image);
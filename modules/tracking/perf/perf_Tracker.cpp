@@ -40,6 +40,7 @@
  //M*/
 
 #include "perf_precomp.hpp"
+#include "opencv2/tracking/kalman_filters.hpp"
 #include <fstream>
 
 using namespace std;
@@ -413,3 +414,386 @@ PERF_TEST_P(tracking, GOTURN, testing::Combine(TESTSET_NAMES, SEGMENTS))
   SANITY_CHECK(bbs_mat, 15, ERROR_RELATIVE);
 
 }
+
+// the first frames of the david sequence, for the tests measuring a few updates
+static void loadDavidFrames( vector<Mat>& frames, int n )
+{
+  VideoCapture c;
+  c.open( getDataPath( TRACKING_DIR + "/david/" + FOLDER_IMG + "/david.webm" ) );
+  frames.clear();
+  for ( int i = 0; i < n; i++ )
+  {
+    Mat frame;
+    c >> frame;
+    if( frame.empty() )
+      break;
+    frames.push_back( frame );
+  }
+  ASSERT_FALSE( frames.empty() );
+}
+
+// the i-th of a grid of overlapping 40x40 boxes covering the frame, wrapping around when the grid is full
+static Rect2d gridBox( const Size& frameSize, int i )
+{
+  const Size box( 40, 40 );
+  const int perRow = ( frameSize.width - box.width - 10 ) / 20, perCol = ( frameSize.height - box.height - 10 ) / 20;
+  return Rect2d( 10 + ( i % perRow ) * 20, 10 + ( i / perRow ) % perCol * 20, box.width, box.height );
+}
+
+typedef perf::TestBaseWithParam<tr1::tuple<string, int, int> > multiTracking;
+
+PERF_TEST_P(multiTracking, update, testing::Combine(testing::Values("KCF", "MEDIANFLOW"),
+                                                    testing::Values(10, 50, 200), // targets
+                                                    testing::Values(1, 4)))       // threads
+{
+  string algorithm = get<0>( GetParam() );
+  int numTargets = get<1>( GetParam() );
+  int numThreads = get<2>( GetParam() );
+
+  // a few frames of a sequence, the targets being on a grid of small boxes
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  Ptr<MultiTracker> multiTracker = MultiTracker::create();
+  for ( int i = 0; i < numTargets; i++ )
+  {
+    Rect2d bb = gridBox( frames[0].size(), i );
+    Ptr<Tracker> tracker = algorithm == "KCF" ? Ptr<Tracker>( TrackerKCF::create() ) : Ptr<Tracker>( TrackerMedianFlow::create() );
+    ASSERT_TRUE( multiTracker->add( tracker, frames[0], bb ) );
+  }
+
+  const int savedThreads = getNumThreads();
+  setNumThreads( numThreads );
+
+  size_t frameIdx = 1;
+  TEST_CYCLE()
+  {
+    multiTracker->update( frames[frameIdx % frames.size()] );
+    frameIdx++;
+  }
+
+  setNumThreads( savedThreads );
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<int> kcfUpdate;
+
+PERF_TEST_P(kcfUpdate, latency, testing::Values(40, 100)) // target size, 100 being resized
+{
+  int targetSize = GetParam();
+
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  Rect2d bb( ( frames[0].cols - targetSize ) / 2, ( frames[0].rows - targetSize ) / 2, targetSize, targetSize );
+  Ptr<Tracker> tracker = TrackerKCF::create();
+  ASSERT_TRUE( tracker->init( frames[0], bb ) );
+  // the first updates allocate the buffers of the tracker, the steady state is measured
+  for ( size_t i = 1; i < frames.size(); i++ )
+    tracker->update( frames[i], bb );
+
+  size_t frameIdx = 0;
+  TEST_CYCLE()
+  {
+    tracker->update( frames[frameIdx % frames.size()], bb );
+    frameIdx++;
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<tr1::tuple<string, int> > kcfBatch;
+
+PERF_TEST_P(kcfBatch, update, testing::Combine(testing::Values("independent", "batched"),
+                                               testing::Values(10, 50, 200))) // targets
+{
+  string mode = get<0>( GetParam() );
+  int numTargets = get<1>( GetParam() );
+
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  // the same grid of boxes as multiTracking_update, all the targets having the same window size
+  Ptr<MultiTracker> multiTracker = MultiTracker::create();
+  vector<Ptr<Tracker> > trackers;
+  vector<Rect2d> boxes;
+  for ( int i = 0; i < numTargets; i++ )
+  {
+    Rect2d bb = gridBox( frames[0].size(), i );
+    if( mode == "batched" )
+      ASSERT_TRUE( multiTracker->add( TrackerKCF::create(), frames[0], bb ) );
+    else
+    {
+      trackers.push_back( TrackerKCF::create() );
+      boxes.push_back( bb );
+      ASSERT_TRUE( trackers.back()->init( frames[0], bb ) );
+    }
+  }
+
+  // the batches are compared to the updates of independent trackers, without threads
+  const int savedThreads = getNumThreads();
+  setNumThreads( 1 );
+
+  size_t frameIdx = 1;
+  TEST_CYCLE()
+  {
+    const Mat& frame = frames[frameIdx % frames.size()];
+    if( mode == "batched" )
+      multiTracker->update( frame );
+    else
+      for ( size_t i = 0; i < trackers.size(); i++ )
+        trackers[i]->update( frame, boxes[i] );
+    frameIdx++;
+  }
+
+  setNumThreads( savedThreads );
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<int> kcfColorNames;
+
+PERF_TEST_P(kcfColorNames, update, testing::Values(40, 100)) // target size, 100 being resized
+{
+  int targetSize = GetParam();
+
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  // the features are only the Color Names, without compression, so that their extraction dominates the update
+  TrackerKCF::Params params;
+  params.desc_npca = TrackerKCF::CN;
+  params.desc_pca = 0;
+  Rect2d bb( ( frames[0].cols - targetSize ) / 2, ( frames[0].rows - targetSize ) / 2, targetSize, targetSize );
+  Ptr<Tracker> tracker = TrackerKCF::create( params );
+  ASSERT_TRUE( tracker->init( frames[0], bb ) );
+
+  size_t frameIdx = 1;
+  TEST_CYCLE()
+  {
+    tracker->update( frames[frameIdx % frames.size()], bb );
+    frameIdx++;
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<int> multiTrackerTLD;
+
+PERF_TEST_P(multiTrackerTLD, update_opt, testing::Values(1, 5, 10)) // targets
+{
+  int numTargets = GetParam();
+
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  // the detector cascade scans the same windows for all the targets, which have the same size
+  MultiTrackerTLD multiTracker;
+  for ( int i = 0; i < numTargets; i++ )
+  {
+    Rect2d bb( 100 + ( i % 5 ) * 50, 60 + ( i / 5 ) * 50, 40, 40 );
+    ASSERT_TRUE( multiTracker.addTarget( frames[0], bb, TrackerTLD::create() ) );
+  }
+
+  size_t frameIdx = 1;
+  TEST_CYCLE()
+  {
+    multiTracker.update_opt( frames[frameIdx % frames.size()] );
+    frameIdx++;
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<int> medianFlowUpdate;
+
+PERF_TEST_P(medianFlowUpdate, latency, testing::Values(10, 20)) // points in grid
+{
+  int pointsInGrid = GetParam();
+
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  TrackerMedianFlow::Params params;
+  params.pointsInGrid = pointsInGrid;
+  Rect2d bb( ( frames[0].cols - 80 ) / 2, ( frames[0].rows - 80 ) / 2, 80, 80 );
+  Ptr<Tracker> tracker = TrackerMedianFlow::create( params );
+  ASSERT_TRUE( tracker->init( frames[0], bb ) );
+
+  // the tracker is re-initialized when it loses the target, for every cycle to be a full update
+  size_t frameIdx = 1;
+  TEST_CYCLE()
+  {
+    const Mat& frame = frames[frameIdx % frames.size()];
+    if( !tracker->update( frame, bb ) )
+    {
+      bb = Rect2d( ( frame.cols - 80 ) / 2, ( frame.rows - 80 ) / 2, 80, 80 );
+      tracker = TrackerMedianFlow::create( params );
+      tracker->init( frame, bb );
+    }
+    frameIdx++;
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<tr1::tuple<int, int> > haarFeatures;
+
+PERF_TEST_P(haarFeatures, compute, testing::Combine(testing::Values(100, 500, 1000), // samples
+                                                    testing::Values(50, 250)))        // features
+{
+  int numSamples = get<0>(GetParam());
+  int numFeatures = get<1>(GetParam());
+
+  // the samples of TrackerMIL: views of the integral image of the frame around the target
+  Mat image( 480, 640, CV_8UC1 ), sum;
+  declare.in( image, WARMUP_RNG );
+  integral( image, sum, CV_32F );
+
+  TrackerFeatureHAAR::Params params;
+  params.numFeatures = numFeatures;
+  params.rectSize = Size( 40, 40 );
+  params.isIntegral = true;
+  TrackerFeatureHAAR haar( params );
+
+  RNG rng( 1 );
+  vector<Mat> samples;
+  for ( int i = 0; i < numSamples; i++ )
+    samples.push_back( sum( Rect( Point( rng.uniform( 200, 400 ), rng.uniform( 150, 300 ) ), params.rectSize ) ) );
+
+  Mat response;
+  TEST_CYCLE()
+  {
+    haar.compute( samples, response );
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+// a target moving on a plane observed by its range and bearing, the batched functions processing the rows
+class RangeBearingModel : public tracking::UkfSystemModel
+{
+ public:
+  void stateConversionFunction( const Mat& x_k, const Mat& /*u_k*/, const Mat& v_k, Mat& x_kplus1 )
+  {
+    x_kplus1.at<double>( 0, 0 ) = x_k.at<double>( 0, 0 ) + 0.1 * x_k.at<double>( 2, 0 ) + v_k.at<double>( 0, 0 );
+    x_kplus1.at<double>( 1, 0 ) = x_k.at<double>( 1, 0 ) + 0.1 * x_k.at<double>( 3, 0 ) + v_k.at<double>( 1, 0 );
+    x_kplus1.at<double>( 2, 0 ) = x_k.at<double>( 2, 0 ) + v_k.at<double>( 2, 0 );
+    x_kplus1.at<double>( 3, 0 ) = x_k.at<double>( 3, 0 ) + v_k.at<double>( 3, 0 );
+  }
+  void measurementFunction( const Mat& x_k, const Mat& n_k, Mat& z_k )
+  {
+    double x = x_k.at<double>( 0, 0 ), y = x_k.at<double>( 1, 0 );
+    z_k.at<double>( 0, 0 ) = sqrt( x * x + y * y ) + n_k.at<double>( 0, 0 );
+    z_k.at<double>( 1, 0 ) = atan2( y, x ) + n_k.at<double>( 1, 0 );
+  }
+  void batchStateConversionFunction( const Mat& X_k, const Mat& /*U_k*/, Mat& X_kplus1 )
+  {
+    Mat position = X_kplus1.rowRange( 0, 2 ), velocity = X_kplus1.rowRange( 2, 4 );
+    scaleAdd( X_k.rowRange( 2, 4 ), 0.1, X_k.rowRange( 0, 2 ), position );
+    X_k.rowRange( 2, 4 ).copyTo( velocity );
+  }
+  void batchMeasurementFunction( const Mat& X_k, Mat& Z_k )
+  {
+    Mat range = Z_k.row( 0 ), bearing = Z_k.row( 1 );
+    cartToPolar( X_k.row( 0 ), X_k.row( 1 ), range, bearing );
+  }
+};
+
+typedef perf::TestBaseWithParam<tr1::tuple<string, int> > ukfBatch;
+
+PERF_TEST_P(ukfBatch, update, testing::Combine(testing::Values("independent", "batched"),
+                                               testing::Values(100, 1000, 5000))) // filters
+{
+  bool batched = get<0>(GetParam()) == "batched";
+  int numFilters = get<1>(GetParam());
+
+  // the targets stay in the first quadrant, where the bearings of cartToPolar and atan2 are the same
+  Mat states( 4, numFilters, CV_64F ), measurements( 2, numFilters, CV_64F );
+  RNG rng( 3 );
+  rng.fill( states, RNG::UNIFORM, Scalar::all( 10 ), Scalar::all( 20 ) );
+  Mat range = measurements.row( 0 ), bearing = measurements.row( 1 );
+  cartToPolar( states.row( 0 ), states.row( 1 ), range, bearing );
+
+  Ptr<RangeBearingModel> model = makePtr<RangeBearingModel>();
+  tracking::UnscentedKalmanFilterParams params( 4, 2, 0, 1e-3, 1e-2, model );
+  params.alpha = 1;
+  params.k = -1.0;
+  params.stateInit = states;
+
+  Ptr<tracking::UnscentedKalmanFilterBatch> batch;
+  vector<Ptr<tracking::UnscentedKalmanFilter> > filters;
+  if( batched )
+    batch = tracking::createUnscentedKalmanFilterBatch( params, numFilters );
+  else
+  {
+    for ( int i = 0; i < numFilters; i++ )
+    {
+      params.stateInit = states.col( i ).clone();
+      filters.push_back( tracking::createUnscentedKalmanFilter( params ) );
+    }
+  }
+
+  TEST_CYCLE()
+  {
+    if( batched )
+    {
+      batch->predict();
+      batch->correct( measurements );
+    }
+    else
+    {
+      for ( int i = 0; i < numFilters; i++ )
+      {
+        filters[i]->predict();
+        filters[i]->correct( measurements.col( i ) );
+      }
+    }
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<tr1::tuple<string, int> > goturnBatch;
+
+PERF_TEST_P(goturnBatch, update, testing::Combine(testing::Values("independent", "batched"),
+                                                  testing::Values(1, 4, 16))) // targets
+{
+  string mode = get<0>( GetParam() );
+  int numTargets = get<1>( GetParam() );
+
+  vector<Mat> frames;
+  ASSERT_NO_FATAL_FAILURE( loadDavidFrames( frames, 10 ) );
+
+  // the batches run one forward of the network per frame for all the targets
+  Ptr<MultiTracker> multiTracker = MultiTracker::create();
+  vector<Ptr<Tracker> > trackers;
+  vector<Rect2d> boxes;
+  for ( int i = 0; i < numTargets; i++ )
+  {
+    Rect2d bb( 40 + ( i % 4 ) * 60, 40 + ( i / 4 ) * 40, 50, 50 );
+    if( mode == "batched" )
+      ASSERT_TRUE( multiTracker->add( TrackerGOTURN::create(), frames[0], bb ) );
+    else
+    {
+      trackers.push_back( TrackerGOTURN::create() );
+      boxes.push_back( bb );
+      ASSERT_TRUE( trackers.back()->init( frames[0], bb ) );
+    }
+  }
+
+  size_t frameIdx = 1;
+  TEST_CYCLE()
+  {
+    const Mat& frame = frames[frameIdx % frames.size()];
+    if( mode == "batched" )
+      multiTracker->update( frame );
+    else
+      for ( size_t i = 0; i < trackers.size(); i++ )
+        trackers[i]->update( frame, boxes[i] );
+    frameIdx++;
+  }
+
+  SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,483 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+//
+//  Runs trackers over the sequences of the VOT or ALOV datasets (with the opencv_datasets module),
+//  or over synthetic sequences, and reports their speed, latency, memory and accuracy:
+//
+//  ./example_tracking_tracker_benchmark KCF,MEDIAN_FLOW,MIL --dataset=vot --path=<VOT root> --num=300
+//  ./example_tracking_tracker_benchmark KCF,MEDIAN_FLOW --targets=10
+//
+
+#include "opencv2/opencv_modules.hpp"
+#include "opencv2/core/utility.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/tracking.hpp"
+#ifdef HAVE_OPENCV_DATASETS
+#include "opencv2/datasets/track_vot.hpp"
+#include "opencv2/datasets/track_alov.hpp"
+#endif
+#include "samples_utility.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+using namespace cv;
+
+// a sequence of frames with the ground truth boxes of its targets, empty boxes for the targets that are not visible
+class Sequence
+{
+public:
+    virtual ~Sequence() {}
+    virtual string name() const = 0;
+    virtual int numTargets() const = 0;
+    // goes back to the first frame
+    virtual void reset() = 0;
+    virtual bool next(Mat &frame, vector<Rect2d> &gt) = 0;
+};
+
+// textured boxes moving over a textured background, bouncing on the borders of the frames
+class SyntheticSequence : public Sequence
+{
+public:
+    SyntheticSequence(int id_, int numTargets_, int numFrames_, Size frameSize = Size(640, 480))
+        : id(id_), frames(numFrames_), frameId(0)
+    {
+        RNG rng(id);
+        background.create(frameSize, CV_8UC3);
+        rng.fill(background, RNG::UNIFORM, 0, 256);
+        GaussianBlur(background, background, Size(7, 7), 0);
+        for (int i = 0; i < numTargets_; i++)
+        {
+            Mat object(rng.uniform(30, 61), rng.uniform(30, 61), CV_8UC3);
+            rng.fill(object, RNG::UNIFORM, 0, 256);
+            GaussianBlur(object, object, Size(3, 3), 0);
+            objects.push_back(object);
+            start.push_back(Point2d(rng.uniform(0, frameSize.width - object.cols), rng.uniform(0, frameSize.height - object.rows)));
+            velocity.push_back(Point2d(rng.uniform(-3., 3.), rng.uniform(-3., 3.)));
+        }
+        reset();
+    }
+
+    string name() const
+    {
+        ostringstream out;
+        out << "synthetic-" << id;
+        return out.str();
+    }
+
+    int numTargets() const { return (int)objects.size(); }
+
+    void reset()
+    {
+        frameId = 0;
+        position = start;
+    }
+
+    bool next(Mat &frame, vector<Rect2d> &gt)
+    {
+        if (frameId >= frames)
+            return false;
+        background.copyTo(frame);
+        gt.resize(objects.size());
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            if (frameId > 0)
+                move(i);
+            Rect box(Point(cvRound(position[i].x), cvRound(position[i].y)), objects[i].size());
+            objects[i].copyTo(frame(box));
+            gt[i] = box;
+        }
+        frameId++;
+        return true;
+    }
+
+private:
+    void move(size_t i)
+    {
+        Point2d p = position[i] + velocity[i];
+        const double maxX = background.cols - objects[i].cols - 1, maxY = background.rows - objects[i].rows - 1;
+        if (p.x < 0 || p.x > maxX)
+            velocity[i].x = -velocity[i].x;
+        if (p.y < 0 || p.y > maxY)
+            velocity[i].y = -velocity[i].y;
+        position[i] = Point2d(std::min(std::max(p.x, 0.), maxX), std::min(std::max(p.y, 0.), maxY));
+    }
+
+    int id, frames, frameId;
+    Mat background;
+    vector<Mat> objects;
+    vector<Point2d> start, position, velocity;
+};
+
+#ifdef HAVE_OPENCV_DATASETS
+template<typename T>
+static Rect2d boundingBox(const vector<Point_<T> > &corners)
+{
+    if (corners.empty())
+        return Rect2d();
+    double x0 = corners[0].x, y0 = corners[0].y, x1 = x0, y1 = y0;
+    for (size_t i = 1; i < corners.size(); i++)
+    {
+        x0 = std::min(x0, (double)corners[i].x);
+        y0 = std::min(y0, (double)corners[i].y);
+        x1 = std::max(x1, (double)corners[i].x);
+        y1 = std::max(y1, (double)corners[i].y);
+    }
+    return Rect2d(x0, y0, x1 - x0, y1 - y0);
+}
+
+// a sequence of TRACK_vot or TRACK_alov, the frames of ALOV without annotation having empty boxes
+template<typename Dataset>
+class DatasetSequence : public Sequence
+{
+public:
+    DatasetSequence(const Ptr<Dataset> &dataset_, const string &prefix_, int id_, int maxFrames_)
+        : dataset(dataset_), prefix(prefix_), id(id_), maxFrames(maxFrames_), frameId(0) {}
+
+    string name() const
+    {
+        ostringstream out;
+        out << prefix << "-" << id;
+        return out.str();
+    }
+
+    int numTargets() const { return 1; }
+
+    void reset()
+    {
+        dataset->initDataset(id);
+        frameId = 0;
+    }
+
+    bool next(Mat &frame, vector<Rect2d> &gt)
+    {
+        if (maxFrames > 0 && frameId >= maxFrames)
+            return false;
+        if (!dataset->getNextFrame(frame))
+            return false;
+        gt.assign(1, boundingBox(groundTruth()));
+        frameId++;
+        return true;
+    }
+
+private:
+    vector<Point2d> groundTruth();
+
+    Ptr<Dataset> dataset;
+    string prefix;
+    int id, maxFrames, frameId;
+};
+
+template<> vector<Point2d> DatasetSequence<datasets::TRACK_vot>::groundTruth() { return dataset->getGT(); }
+
+template<> vector<Point2d> DatasetSequence<datasets::TRACK_alov>::groundTruth()
+{
+    vector<Point2f> corners = dataset->getNextGT();
+    return vector<Point2d>(corners.begin(), corners.end());
+}
+#endif
+
+// counts the bytes of the Mat buffers allocated while it is the default allocator, until they are released
+class MemoryCounter : public MatAllocator
+{
+public:
+    MemoryCounter() : live(0), peak(0), stdAllocator(Mat::getStdAllocator()) {}
+
+    UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step, int flags, UMatUsageFlags usageFlags) const
+    {
+        UMatData *u = stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (u)
+        {
+            // the buffer comes back to this allocator when it is released
+            u->currAllocator = this;
+            count((int64)u->size);
+        }
+        return u;
+    }
+    bool allocate(UMatData *data, int accessflags, UMatUsageFlags usageFlags) const
+    {
+        return stdAllocator->allocate(data, accessflags, usageFlags);
+    }
+    void deallocate(UMatData *data) const
+    {
+        if (data)
+            count(-(int64)data->size);
+        stdAllocator->deallocate(data);
+    }
+
+    // the peak is measured again from the bytes that are live
+    void resetPeak()
+    {
+        AutoLock lock(mutex);
+        peak = live;
+    }
+
+    mutable int64 live, peak;
+
+private:
+    void count(int64 bytes) const
+    {
+        AutoLock lock(mutex);
+        live += bytes;
+        peak = std::max(peak, live);
+    }
+
+    mutable Mutex mutex;
+    MatAllocator *stdAllocator;
+};
+
+// the counted Mats keep their allocator until they are released, which may be after the trackers are destroyed
+// (e.g. buffers cached by OpenCV), so the counter is never destroyed
+static MemoryCounter &memoryCounter()
+{
+    static MemoryCounter *counter = new MemoryCounter();
+    return *counter;
+}
+
+// the Mats allocated in the scope are counted by the counter
+class CountedScope
+{
+public:
+    CountedScope(MemoryCounter &counter) : previous(Mat::getDefaultAllocator()) { Mat::setDefaultAllocator(&counter); }
+    ~CountedScope() { Mat::setDefaultAllocator(previous); }
+
+private:
+    MatAllocator *previous;
+};
+
+const int SUCCESS_THRESHOLDS = 100;
+
+// results of a tracker over all the sequences
+struct TrackerStats
+{
+    TrackerStats(const string &name_)
+        : name(name_), numFrames(0), numTargetFrames(0), numFailures(0), numPresent(0), overlapSum(0),
+          success(SUCCESS_THRESHOLDS + 1, 0), timeTotal(0), memoryPerTarget(0), peakMemoryPerTarget(0) {}
+
+    string name;
+    int numFrames;          // frames passed to the trackers
+    int numTargetFrames;    // updates of the trackers
+    int numFailures;        // updates where the tracker reported a failure
+    int numPresent;         // updates where the target is visible
+    double overlapSum;      // sum of the overlaps with the ground truth for the visible targets
+    vector<int> success;    // number of updates for each overlap percent of the visible targets
+    int64 timeTotal;        // ticks
+    vector<double> frameLatencies; // ms to update all the targets of a frame
+    double memoryPerTarget, peakMemoryPerTarget; // largest over the sequences, bytes
+
+    void addUpdate(const Rect2d &gtBox, const Rect2d &box, bool ok)
+    {
+        numTargetFrames++;
+        numFailures += ok ? 0 : 1;
+        if (gtBox.area() <= 0)
+            return;
+        numPresent++;
+        double unionArea = ok ? (gtBox | box).area() : 0.;
+        double overlap = unionArea > 0. ? (gtBox & box).area() / unionArea : 0.;
+        overlapSum += overlap;
+        success[std::min(std::max(cvFloor(overlap * SUCCESS_THRESHOLDS), 0), SUCCESS_THRESHOLDS)]++;
+    }
+
+    double latencyPercentile(double p) const
+    {
+        vector<double> sorted(frameLatencies);
+        std::sort(sorted.begin(), sorted.end());
+        return sorted.empty() ? 0. : sorted[std::min(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5))];
+    }
+
+    // area under the curve of the rate of the updates with an overlap larger than each threshold
+    double successAUC() const
+    {
+        double auc = 0;
+        int above = numPresent;
+        for (int t = 0; t <= SUCCESS_THRESHOLDS; t++)
+        {
+            auc += (double)above / std::max(numPresent, 1);
+            above -= success[t];
+        }
+        return auc / (SUCCESS_THRESHOLDS + 1);
+    }
+
+    double successRate(double threshold) const
+    {
+        int above = 0;
+        for (int t = cvCeil(threshold * SUCCESS_THRESHOLDS); t <= SUCCESS_THRESHOLDS; t++)
+            above += success[t];
+        return (double)above / std::max(numPresent, 1);
+    }
+};
+
+static void runSequence(Sequence &sequence, TrackerStats &stats, bool isVerbose)
+{
+    Mat frame;
+    vector<Rect2d> gt;
+    sequence.reset();
+    if (!sequence.next(frame, gt))
+        return;
+
+    // the memory of the sequence is what is allocated from here, the buffers of the previous ones may still be live
+    MemoryCounter &counter = memoryCounter();
+    counter.resetPeak();
+    const int64 liveBefore = counter.live;
+    vector<Ptr<Tracker> > trackers(gt.size());
+    vector<Rect2d> boxes(gt);
+    vector<bool> initialized(gt.size(), false);
+    {
+        CountedScope scope(counter);
+        for (size_t i = 0; i < gt.size(); i++)
+        {
+            trackers[i] = createTrackerByName(stats.name);
+            initialized[i] = gt[i].area() > 0 && trackers[i]->init(frame, gt[i]);
+        }
+    }
+
+    double sequenceOverlap = 0;
+    int sequencePresent = 0;
+    while (sequence.next(frame, gt))
+    {
+        int64 frameTime = 0;
+        for (size_t i = 0; i < trackers.size(); i++)
+        {
+            bool ok = false;
+            if (initialized[i])
+            {
+                CountedScope scope(counter);
+                int64 t = getTickCount();
+                ok = trackers[i]->update(frame, boxes[i]);
+                frameTime += getTickCount() - t;
+            }
+            stats.addUpdate(gt[i], boxes[i], ok);
+            if (isVerbose && gt[i].area() > 0)
+            {
+                double unionArea = ok ? (gt[i] | boxes[i]).area() : 0.;
+                sequenceOverlap += unionArea > 0. ? (gt[i] & boxes[i]).area() / unionArea : 0.;
+                sequencePresent++;
+            }
+        }
+        stats.numFrames++;
+        stats.timeTotal += frameTime;
+        stats.frameLatencies.push_back(frameTime * 1000. / getTickFrequency());
+    }
+
+    const double targets = (double)trackers.size();
+    stats.memoryPerTarget = std::max(stats.memoryPerTarget, (counter.live - liveBefore) / targets);
+    stats.peakMemoryPerTarget = std::max(stats.peakMemoryPerTarget, (counter.peak - liveBefore) / targets);
+    if (isVerbose)
+        cout << "  " << setw(16) << left << stats.name << setw(20) << sequence.name() << right
+             << " mean overlap " << sequenceOverlap / std::max(sequencePresent, 1)
+             << ", " << (counter.live - liveBefore) / targets / 1024. << " KB per target" << endl;
+
+    trackers.clear();
+}
+
+static void printStats(const vector<TrackerStats> &stats)
+{
+    cout << endl << left << setw(16) << "tracker" << right
+         << setw(10) << "fps" << setw(10) << "p50 ms" << setw(10) << "p90 ms" << setw(10) << "p99 ms" << setw(10) << "max ms"
+         << setw(12) << "KB/target" << setw(12) << "peak KB" << setw(10) << "overlap" << setw(10) << "SR@0.5" << setw(10) << "AUC"
+         << setw(10) << "failures" << endl;
+    cout << fixed << setprecision(2);
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const TrackerStats &s = stats[i];
+        double seconds = s.timeTotal / getTickFrequency();
+        cout << left << setw(16) << s.name << right
+             << setw(10) << (seconds > 0 ? s.numFrames / seconds : 0.)
+             << setw(10) << s.latencyPercentile(0.5) << setw(10) << s.latencyPercentile(0.9)
+             << setw(10) << s.latencyPercentile(0.99) << setw(10) << s.latencyPercentile(1.0)
+             << setw(12) << s.memoryPerTarget / 1024. << setw(12) << s.peakMemoryPerTarget / 1024.
+             << setw(10) << s.overlapSum / std::max(s.numPresent, 1) << setw(10) << s.successRate(0.5)
+             << setw(10) << s.successAUC() << setw(10) << s.numFailures << endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const string keys =
+        "{help h||show help}"
+        "{dataset|synthetic|vot, alov or synthetic}"
+        "{path||root of the dataset, the synthetic sequences being used when it cannot be loaded}"
+        "{id|0|sequence of the dataset (0 for all)}"
+        "{num|0|maximal number of frames per sequence (0 for all, 200 for the synthetic sequences)}"
+        "{targets|1|number of targets of the synthetic sequences}"
+        "{sequences|3|number of synthetic sequences}"
+        "{v|false|print the results of each sequence}"
+        "{@algos|KCF,MEDIAN_FLOW|comma-separated algorithm names}";
+    CommandLineParser p(argc, argv, keys);
+    p.about("Reports the frames per second, the latency percentiles of the frames, the memory held in Mats per target "
+            "and the overlap with the ground truth of trackers");
+    if (p.has("help"))
+    {
+        p.printMessage();
+        return 0;
+    }
+    string datasetName = p.get<string>("dataset");
+    string path = p.get<string>("path");
+    int id = p.get<int>("id");
+    int maxFrames = p.get<int>("num");
+    int numTargets = p.get<int>("targets");
+    int numSequences = p.get<int>("sequences");
+    bool isVerbose = p.get<bool>("v");
+    string algList = p.get<string>("@algos");
+    if (!p.check())
+    {
+        p.printErrors();
+        return 0;
+    }
+
+    vector<Ptr<Sequence> > sequences;
+#ifdef HAVE_OPENCV_DATASETS
+    if (!path.empty() && (datasetName == "vot" || datasetName == "alov"))
+    {
+        cout << "Loading " << datasetName << " from " << path << " ... ";
+        int num = 0;
+        if (datasetName == "vot")
+        {
+            Ptr<datasets::TRACK_vot> dataset = datasets::TRACK_vot::create();
+            dataset->load(path);
+            num = dataset->getDatasetsNum();
+            for (int i = 1; i <= num; i++)
+                if (id == 0 || id == i)
+                    sequences.push_back(makePtr<DatasetSequence<datasets::TRACK_vot> >(dataset, "vot", i, maxFrames));
+        }
+        else
+        {
+            Ptr<datasets::TRACK_alov> dataset = datasets::TRACK_alov::create();
+            dataset->load(path);
+            num = dataset->getDatasetsNum();
+            for (int i = 1; i <= num; i++)
+                if (id == 0 || id == i)
+                    sequences.push_back(makePtr<DatasetSequence<datasets::TRACK_alov> >(dataset, "alov", i, maxFrames));
+        }
+        cout << num << " sequences" << endl;
+    }
+#endif
+    if (sequences.empty())
+    {
+        if (datasetName != "synthetic")
+            cout << "No " << datasetName << " sequences, using the synthetic ones" << endl;
+        for (int i = 1; i <= numSequences; i++)
+            sequences.push_back(makePtr<SyntheticSequence>(i, numTargets, maxFrames > 0 ? maxFrames : 200));
+    }
+
+    vector<TrackerStats> stats;
+    istringstream input(algList);
+    for (string name; getline(input, name, ',');)
+        if (!name.empty())
+            stats.push_back(TrackerStats(name));
+
+    // each tracker runs over all the sequences before the next one, for their timings not to interfere
+    for (size_t t = 0; t < stats.size(); t++)
+    {
+        cout << "Running " << stats[t].name << " ..." << endl;
+        for (size_t s = 0; s < sequences.size(); s++)
+            runSequence(*sequences[s], stats[t], isVerbose);
+    }
+
+    printStats(stats);
+    return 0;
+}
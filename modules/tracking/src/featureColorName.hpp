@@ -0,0 +1,23 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef OPENCV_TRACKING_FEATURE_COLOR_NAME
+#define OPENCV_TRACKING_FEATURE_COLOR_NAME
+
+#include "opencv2/core.hpp"
+
+namespace cv
+{
+namespace tracking
+{
+
+/* Color Names features of a BGR patch: the CV_8UC3 patch is mapped to the 10 names of the 32x32x32
+ * RGB bins in a CV_64FC(10) matrix. The names come from an 8-bit table, within 0.003 of the float one.
+ */
+void extractColorNames(const Mat& patch, Mat& cn);
+
+} /* namespace tracking */
+} /* namespace cv */
+
+#endif
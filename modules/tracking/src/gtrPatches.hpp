@@ -0,0 +1,66 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+// The preprocessing of the GOTURN input patches. It does not depend on the network, so it is kept inline in this
+// header for the tests to check it without the model files.
+
+#ifndef OPENCV_GTR_PATCHES
+#define OPENCV_GTR_PATCHES
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+namespace cv
+{
+namespace gtr
+{
+
+static const int INPUT_SIZE = 227;
+
+// the part [start, start + len) of an axis of the given size that is inside of it, at least its nearest element,
+// and the numbers of replicated elements before and after it
+inline void axisPart(int start, int len, int size, int& first, int& last, int& before, int& after)
+{
+    first = std::min(std::max(start, 0), size - 1);
+    last = std::min(std::max(start + len, first + 1), size);
+    before = std::min(std::max(first - start, 0), len - (last - first));
+    after = len - (last - first) - before;
+}
+
+// the patch r of the image, the image being extended by replicating its border
+inline void replicatedPatch(const Mat& image, const Rect& r, Mat& patch)
+{
+    int x0, x1, left, right, y0, y1, top, bottom;
+    axisPart(r.x, r.width, image.cols, x0, x1, left, right);
+    axisPart(r.y, r.height, image.rows, y0, y1, top, bottom);
+    copyMakeBorder(image(Range(y0, y1), Range(x0, x1)), patch, top, bottom, left, right, BORDER_REPLICATE);
+}
+
+// writes the resized patch into the sample idx of the blob as blobFromImage does, swapping the blue and red channels,
+// after the subtraction of 128 from the first channel with saturation, which is what patch - 128 does
+inline void patchToBlob(const Mat& patch, Mat& resized, Mat& blob, int idx)
+{
+    resize(patch, resized, Size(INPUT_SIZE, INPUT_SIZE));
+    const int cn = resized.channels();
+    float* planes[3];
+    for (int c = 0; c < 3; c++)
+        planes[2 - c] = blob.ptr<float>(idx, c);
+    for (int y = 0; y < INPUT_SIZE; y++)
+    {
+        const uchar* src = resized.ptr<uchar>(y);
+        for (int x = 0; x < INPUT_SIZE; x++, src += cn)
+        {
+            planes[0][x] = (float)std::max(src[0] - 128, 0);
+            planes[1][x] = (float)src[1];
+            planes[2][x] = (float)src[2];
+        }
+        for (int c = 0; c < 3; c++)
+            planes[c] += INPUT_SIZE;
+    }
+}
+
+}
+}
+
+#endif
@@ -77,7 +77,7 @@ public:
     Rect2d getBoundingBox(){ return boundingBox_; }
     void setBoudingBox(Rect2d boundingBox){ boundingBox_ = boundingBox; }
     Mat getImage(){ return image_; }
-    void setImage(const Mat& image){ image.copyTo(image_); }
+    void setImage(const Mat& image){ image_ = image; }
 protected:
     Rect2d boundingBox_;
     Mat image_;
@@ -104,7 +104,7 @@ bool TrackerGOTURNImpl::initImpl(const Mat& image, const Rect2d& boundingBox)
 {
     //Make a simple model from frame and bounding box
     model = Ptr<TrackerGOTURNModel>(new TrackerGOTURNModel(params));
-    ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setImage(image);
+    ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setImage(image.clone());
     ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setBoudingBox(boundingBox);
 
     //Load GOTURN architecture from *.prototxt and pretrained weights from *.caffemodel
@@ -130,20 +130,26 @@ bool TrackerGOTURNImpl::initImpl(const Mat& image, const Rect2d& boundingBox)
     return true;
 }
 
-bool TrackerGOTURNImpl::updateImpl(const Mat& image, Rect2d& boundingBox)
+static void clearSample(Mat& blob, int idx)
+{
+    Mat(1, 3 * INPUT_SIZE * INPUT_SIZE, CV_32F, blob.ptr<float>(idx)).setTo(Scalar::all(0));
+}
+
+bool TrackerGOTURNImpl::preparePatches(const Mat& image, Mat& _targetBlob, Mat& _searchBlob, int idx)
 {
-    int INPUT_SIZE = 227;
+    if (!isInit || image.empty())
+    {
+        clearSample(_targetBlob, idx);
+        clearSample(_searchBlob, idx);
+        return false;
+    }
+    CV_Assert(image.depth() == CV_8U && (image.channels() == 3 || image.channels() == 4));
     //Using prevFrame & prevBB from model and curFrame GOTURN calculating curBB
-    Mat curFrame = image.clone();
     Mat prevFrame = ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->getImage();
     Rect2d prevBB = ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->getBoundingBox();
-    Rect2d curBB;
 
     float padTargetPatch = 2.0;
-    Rect2f searchPatchRect, targetPatchRect;
-    Point2f currCenter, prevCenter;
-    Mat prevFramePadded, curFramePadded;
-    Mat searchPatch, targetPatch;
+    Point2f prevCenter;
 
     prevCenter.x = (float)(prevBB.x + prevBB.width / 2);
     prevCenter.y = (float)(prevBB.y + prevBB.height / 2);
@@ -153,43 +159,95 @@ bool TrackerGOTURNImpl::updateImpl(const Mat& image, Rect2d& boundingBox)
     targetPatchRect.x = (float)(prevCenter.x - prevBB.width*padTargetPatch / 2.0 + targetPatchRect.width);
     targetPatchRect.y = (float)(prevCenter.y - prevBB.height*padTargetPatch / 2.0 + targetPatchRect.height);
 
-    copyMakeBorder(prevFrame, prevFramePadded, (int)targetPatchRect.height, (int)targetPatchRect.height, (int)targetPatchRect.width, (int)targetPatchRect.width, BORDER_REPLICATE);
-    targetPatch = prevFramePadded(targetPatchRect).clone();
+    //The patches are in frames padded by the size of the patch, only their parts outside of the frames are padded
+    Rect patchRect = Rect(targetPatchRect) - Point((int)targetPatchRect.width, (int)targetPatchRect.height);
+    replicatedPatch(prevFrame, patchRect, targetPatch);
+    replicatedPatch(image, patchRect, searchPatch);
 
-    copyMakeBorder(curFrame, curFramePadded, (int)targetPatchRect.height, (int)targetPatchRect.height, (int)targetPatchRect.width, (int)targetPatchRect.width, BORDER_REPLICATE);
-    searchPatch = curFramePadded(targetPatchRect).clone();
+    //Preprocess: resize, mean subtract and convert to float type
+    patchToBlob(targetPatch, resizedPatch, _targetBlob, idx);
+    patchToBlob(searchPatch, resizedPatch, _searchBlob, idx);
+    return true;
+}
 
-    //Preprocess
-    //Resize
-    resize(targetPatch, targetPatch, Size(INPUT_SIZE, INPUT_SIZE));
-    resize(searchPatch, searchPatch, Size(INPUT_SIZE, INPUT_SIZE));
+void TrackerGOTURNImpl::locate(const Mat& frame, const float* res, Rect2d& boundingBox)
+{
+    Rect2d curBB;
+    curBB.x = targetPatchRect.x + (res[0] * targetPatchRect.width / INPUT_SIZE) - targetPatchRect.width;
+    curBB.y = targetPatchRect.y + (res[1] * targetPatchRect.height / INPUT_SIZE) - targetPatchRect.height;
+    curBB.width = (res[2] - res[0]) * targetPatchRect.width / INPUT_SIZE;
+    curBB.height = (res[3] - res[1]) * targetPatchRect.height / INPUT_SIZE;
 
-    //Mean Subtract
-    targetPatch = targetPatch - 128;
-    searchPatch = searchPatch - 128;
+    //Predicted BB
+    boundingBox = curBB;
 
-    //Convert to Float type
-    Mat targetBlob = dnn::blobFromImage(targetPatch);
-    Mat searchBlob = dnn::blobFromImage(searchPatch);
+    //Set new model image and BB from current frame
+    ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setImage(frame);
+    ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setBoudingBox(curBB);
+}
 
-    net.setInput(targetBlob, ".data1");
-    net.setInput(searchBlob, ".data2");
+bool TrackerGOTURNImpl::updateImpl(const Mat& image, Rect2d& boundingBox)
+{
+    std::vector<TrackerGOTURNImpl*> trackers(1, this);
+    std::vector<Rect2d> boundingBoxes;
+    std::vector<uchar> status;
+    updateBatch(image, trackers, boundingBoxes, status);
+    if (status[0])
+        boundingBox = boundingBoxes[0];
+    return status[0] != 0;
+}
 
-    Mat resMat = net.forward("scale").reshape(1, 1);
+class GOTURNPatchesInvoker : public ParallelLoopBody
+{
+public:
+    GOTURNPatchesInvoker(const Mat& _image, const std::vector<TrackerGOTURNImpl*>& _trackers, Mat& _targetBlob,
+                         Mat& _searchBlob, std::vector<uchar>& _status)
+        : image(_image), trackers(_trackers), targetBlob(_targetBlob), searchBlob(_searchBlob), status(_status) {}
 
-    curBB.x = targetPatchRect.x + (resMat.at<float>(0) * targetPatchRect.width / INPUT_SIZE) - targetPatchRect.width;
-    curBB.y = targetPatchRect.y + (resMat.at<float>(1) * targetPatchRect.height / INPUT_SIZE) - targetPatchRect.height;
-    curBB.width = (resMat.at<float>(2) - resMat.at<float>(0)) * targetPatchRect.width / INPUT_SIZE;
-    curBB.height = (resMat.at<float>(3) - resMat.at<float>(1)) * targetPatchRect.height / INPUT_SIZE;
+    void operator()(const Range& range) const
+    {
+        for (int i = range.start; i < range.end; i++)
+            status[i] = trackers[i]->preparePatches(image, targetBlob, searchBlob, i);
+    }
 
-    //Predicted BB
-    boundingBox = curBB;
+private:
+    const Mat& image;
+    const std::vector<TrackerGOTURNImpl*>& trackers;
+    Mat& targetBlob;
+    Mat& searchBlob;
+    std::vector<uchar>& status;
 
-    //Set new model image and BB from current frame
-    ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setImage(curFrame);
-    ((TrackerGOTURNModel*)static_cast<TrackerModel*>(model))->setBoudingBox(curBB);
+    GOTURNPatchesInvoker& operator=(const GOTURNPatchesInvoker&);
+};
 
-    return true;
+void updateBatch(const Mat& image, const std::vector<TrackerGOTURNImpl*>& trackers, std::vector<Rect2d>& boundingBoxes,
+                 std::vector<uchar>& status)
+{
+    const int n = (int)trackers.size();
+    boundingBoxes.resize(n);
+    status.assign(n, 0);
+    if (n == 0)
+        return;
+
+    // all the trackers load the same network, the batches run on the one of the first tracker and in its blobs,
+    // which are only reallocated when the number of targets changes
+    TrackerGOTURNImpl& first = *trackers[0];
+    const int sizes[] = { n, 3, INPUT_SIZE, INPUT_SIZE };
+    first.targetBlob.create(4, sizes, CV_32F);
+    first.searchBlob.create(4, sizes, CV_32F);
+    parallel_for_(Range(0, n), GOTURNPatchesInvoker(image, trackers, first.targetBlob, first.searchBlob, status), n);
+    if (std::count(status.begin(), status.end(), 0) == n)
+        return;
+
+    first.net.setInput(first.targetBlob, ".data1");
+    first.net.setInput(first.searchBlob, ".data2");
+    Mat resMat = first.net.forward("scale").reshape(1, n);
+
+    // the frame is shared by the models of the trackers
+    Mat frame = image.clone();
+    for (int i = 0; i < n; i++)
+        if (status[i])
+            trackers[i]->locate(frame, resMat.ptr<float>(i), boundingBoxes[i]);
 }
 
 }
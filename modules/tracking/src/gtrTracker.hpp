@@ -46,6 +46,7 @@
 #include "precomp.hpp"
 #include "opencv2/video/tracking.hpp"
 #include "gtrUtils.hpp"
+#include "gtrPatches.hpp"
 #include "opencv2/imgproc.hpp"
 
 #include <algorithm>
@@ -69,11 +70,30 @@ public:
     bool initImpl(const Mat& image, const Rect2d& boundingBox);
     bool updateImpl(const Mat& image, Rect2d& boundingBox);
 
+    // crops and resizes the patches of the target into the sample idx of the input blobs of a batch,
+    // returns false if the tracker cannot be updated
+    bool preparePatches(const Mat& image, Mat& targetBlob, Mat& searchBlob, int idx);
+
+    // the new bounding box from the output of the network for the target
+    void locate(const Mat& frame, const float* output, Rect2d& boundingBox);
+
     TrackerGOTURN::Params params;
 
     dnn::Net net;
+
+    // buffers reused between the frames
+    Rect2f targetPatchRect;
+    Mat targetPatch, searchPatch, resizedPatch;
+    Mat targetBlob, searchBlob;
 };
 
+/*
+ * Updates GOTURN trackers on the same frame with a single forward of the network of the first one, the patches of
+ * all the targets being packed in its input blobs. status[i] is the result of the update of the i-th tracker.
+ */
+void updateBatch(const Mat& image, const std::vector<TrackerGOTURNImpl*>& trackers, std::vector<Rect2d>& boundingBoxes,
+                 std::vector<uchar>& status);
+
 }
 }
 #endif
@@ -250,195 +250,22 @@ namespace cv
 	void detect_all(const Mat& img, const Mat& imgBlurred, std::vector<Rect2d>& res, std::vector < std::vector < tld::TLDDetector::LabeledPatch > > &patches, std::vector<bool> &detect_flgs,
 		std::vector<Ptr<Tracker> > &trackers)
 	{
-		//TLD Tracker data extraction
-		Tracker* trackerPtr = trackers[0];
-		cv::tld::TrackerTLDImpl* tracker = static_cast<tld::TrackerTLDImpl*>(trackerPtr);
-		//TLD Model Extraction
-		tld::TrackerTLDModel* tldModel = ((tld::TrackerTLDModel*)static_cast<TrackerModel*>(tracker->getModel()));
-		Size initSize = tldModel->getMinSize();
-
-		for (int k = 0; k < (int)trackers.size(); k++)
-			patches[k].clear();
-
-		Mat_<uchar> standardPatch(tld::STANDARD_PATCH_SIZE, tld::STANDARD_PATCH_SIZE);
-		Mat tmp;
-		int dx = initSize.width / 10, dy = initSize.height / 10;
-		Size2d size = img.size();
-		double scale = 1.0;
-		int npos = 0, nneg = 0;
-		double maxSc = -5.0;
-		Rect2d maxScRect;
-		int scaleID;
-		std::vector <Mat> resized_imgs, blurred_imgs;
-
-		std::vector <std::vector <Point> > varBuffer(trackers.size()), ensBuffer(trackers.size());
-		std::vector <std::vector <int> > varScaleIDs(trackers.size()), ensScaleIDs(trackers.size());
-
-		std::vector <Point> tmpP;
-		std::vector <int> tmpI;
-
-		//Detection part
-		//Generate windows and filter by variance
-		scaleID = 0;
-		resized_imgs.push_back(img);
-		blurred_imgs.push_back(imgBlurred);
-		do
-		{
-			Mat_<double> intImgP, intImgP2;
-			tld::TLDDetector::computeIntegralImages(resized_imgs[scaleID], intImgP, intImgP2);
-			for (int i = 0, imax = cvFloor((0.0 + resized_imgs[scaleID].cols - initSize.width) / dx); i < imax; i++)
-			{
-				for (int j = 0, jmax = cvFloor((0.0 + resized_imgs[scaleID].rows - initSize.height) / dy); j < jmax; j++)
-				{
-					//Optimized variance calculation
-					int x = dx * i,
-						y = dy * j,
-						width = initSize.width,
-						height = initSize.height;
-					double p = 0, p2 = 0;
-					double A, B, C, D;
-
-					A = intImgP(y, x);
-					B = intImgP(y, x + width);
-					C = intImgP(y + height, x);
-					D = intImgP(y + height, x + width);
-					p = (A + D - B - C) / (width * height);
-
-					A = intImgP2(y, x);
-					B = intImgP2(y, x + width);
-					C = intImgP2(y + height, x);
-					D = intImgP2(y + height, x + width);
-					p2 = (A + D - B - C) / (width * height);
-					double windowVar = p2 - p * p;
-
-					//Loop for on all objects
-					for (int k = 0; k < (int)trackers.size(); k++)
-					{
-						//TLD Tracker data extraction
-						trackerPtr = trackers[k];
-						tracker = static_cast<tld::TrackerTLDImpl*>(trackerPtr);
-						//TLD Model Extraction
-						tldModel = ((tld::TrackerTLDModel*)static_cast<TrackerModel*>(tracker->getModel()));
-
-						//Optimized variance calculation
-						bool varPass = (windowVar > tld::VARIANCE_THRESHOLD * *tldModel->detector->originalVariancePtr);
-
-						if (!varPass)
-							continue;
-						varBuffer[k].push_back(Point(dx * i, dy * j));
-						varScaleIDs[k].push_back(scaleID);
-					}
-				}
-			}
-			scaleID++;
-			size.width /= tld::SCALE_STEP;
-			size.height /= tld::SCALE_STEP;
-			scale *= tld::SCALE_STEP;
-			resize(img, tmp, size, 0, 0, tld::DOWNSCALE_MODE);
-			resized_imgs.push_back(tmp);
-			GaussianBlur(resized_imgs[scaleID], tmp, tld::GaussBlurKernelSize, 0.0f);
-			blurred_imgs.push_back(tmp);
-		} while (size.width >= initSize.width && size.height >= initSize.height);
-
-		//Encsemble classification
+		//TLD Detectors extraction
+		std::vector<tld::TLDDetector*> detectors(trackers.size());
 		for (int k = 0; k < (int)trackers.size(); k++)
 		{
-			//TLD Tracker data extraction
-			trackerPtr = trackers[k];
-			tracker = static_cast<tld::TrackerTLDImpl*>(trackerPtr);
-			//TLD Model Extraction
-			tldModel = ((tld::TrackerTLDModel*)static_cast<TrackerModel*>(tracker->getModel()));
-
-
-			for (int i = 0; i < (int)varBuffer[k].size(); i++)
-			{
-				tldModel->detector->prepareClassifiers(static_cast<int> (blurred_imgs[varScaleIDs[k][i]].step[0]));
-
-				double ensRes = 0;
-				uchar* data = &blurred_imgs[varScaleIDs[k][i]].at<uchar>(varBuffer[k][i].y, varBuffer[k][i].x);
-				for (int x = 0; x < (int)tldModel->detector->classifiers.size(); x++)
-				{
-					int position = 0;
-					for (int n = 0; n < (int)tldModel->detector->classifiers[x].measurements.size(); n++)
-					{
-						position = position << 1;
-						if (data[tldModel->detector->classifiers[x].offset[n].x] < data[tldModel->detector->classifiers[x].offset[n].y])
-							position++;
-					}
-					double posNum = (double)tldModel->detector->classifiers[x].posAndNeg[position].x;
-					double negNum = (double)tldModel->detector->classifiers[x].posAndNeg[position].y;
-					if (posNum == 0.0 && negNum == 0.0)
-						continue;
-					else
-						ensRes += posNum / (posNum + negNum);
-				}
-				ensRes /= tldModel->detector->classifiers.size();
-				ensRes = tldModel->detector->ensembleClassifierNum(&blurred_imgs[varScaleIDs[k][i]].at<uchar>(varBuffer[k][i].y, varBuffer[k][i].x));
-
-				if ( ensRes <= tld::ENSEMBLE_THRESHOLD)
-					continue;
-				ensBuffer[k].push_back(varBuffer[k][i]);
-				ensScaleIDs[k].push_back(varScaleIDs[k][i]);
-			}
+			tld::TrackerTLDImpl* tracker = static_cast<tld::TrackerTLDImpl*>(trackers[k].get());
+			tld::TrackerTLDModel* tldModel = ((tld::TrackerTLDModel*)static_cast<TrackerModel*>(tracker->getModel()));
+			detectors[k] = tldModel->detector;
 		}
 
-		//NN classification
-		for (int k = 0; k < (int)trackers.size(); k++)
-		{
-			//TLD Tracker data extraction
-			trackerPtr = trackers[k];
-			tracker = static_cast<tld::TrackerTLDImpl*>(trackerPtr);
-			//TLD Model Extraction
-			tldModel = ((tld::TrackerTLDModel*)static_cast<TrackerModel*>(tracker->getModel()));
-
-			npos = 0;
-			nneg = 0;
-			maxSc = -5.0;
-
-			for (int i = 0; i < (int)ensBuffer[k].size(); i++)
-			{
-				tld::TLDDetector::LabeledPatch labPatch;
-				double curScale = pow(tld::SCALE_STEP, ensScaleIDs[k][i]);
-				labPatch.rect = Rect2d(ensBuffer[k][i].x*curScale, ensBuffer[k][i].y*curScale, initSize.width * curScale, initSize.height * curScale);
-				tld::resample(resized_imgs[ensScaleIDs[k][i]], Rect2d(ensBuffer[k][i], initSize), standardPatch);
-
-				double srValue, scValue;
-				srValue = tldModel->detector->Sr(standardPatch);
-
-				////To fix: Check the paper, probably this cause wrong learning
-				//
-				labPatch.isObject = srValue > tld::THETA_NN;
-				labPatch.shouldBeIntegrated = abs(srValue - tld::THETA_NN) < 0.1;
-				patches[k].push_back(labPatch);
-				//
-
-				if (!labPatch.isObject)
-				{
-					nneg++;
-					continue;
-				}
-				else
-				{
-					npos++;
-				}
-				scValue = tldModel->detector->Sc(standardPatch);
-				if (scValue > maxSc)
-				{
-					maxSc = scValue;
-					maxScRect = labPatch.rect;
-				}
-			}
-
-
+		//The windows of the first object are scanned once for all the objects
+		tld::TrackerTLDImpl* tracker = static_cast<tld::TrackerTLDImpl*>(trackers[0].get());
+		tld::TrackerTLDModel* tldModel = ((tld::TrackerTLDModel*)static_cast<TrackerModel*>(tracker->getModel()));
+		tld::TLDScanWindows windows;
+		windows.build(img, imgBlurred, tldModel->getMinSize());
 
-			if (maxSc < 0)
-				detect_flgs[k] = false;
-			else
-			{
-				res[k] = maxScRect;
-				detect_flgs[k] = true;
-			}
-		}
+		tld::TLDDetector::detectCascade(windows, detectors, patches, res, detect_flgs);
 	}
 
 #ifdef HAVE_OPENCL
@@ -40,6 +40,8 @@
  //M*/
 
 #include "precomp.hpp"
+#include "trackerKCFBatch.hpp"
+#include "gtrTracker.hpp"
 
 namespace cv {
 
@@ -77,14 +79,142 @@ namespace cv {
     return stat;
   };
 
+  // runs a step of the update of a range of the trackers on the same frame, each one writing only its own object,
+  // status and correlation
+  class MultiTrackerUpdateInvoker : public ParallelLoopBody
+  {
+  public:
+    enum { UPDATE, KCF_BEGIN, KCF_LOCATE, KCF_END };
+
+    MultiTrackerUpdateInvoker(int _step, const Mat& _image, std::vector<Ptr<Tracker> >& _trackers,
+                              const std::vector<int>& _indices, const std::vector<kcf::TrackerKCFSteps*>& _steps,
+                              std::vector<Rect2d>& _objects, std::vector<uchar>& _status,
+                              std::vector<kcf::Correlation>& _correlations)
+      : step(_step), image(_image), trackers(_trackers), indices(_indices), steps(_steps),
+        objects(_objects), status(_status), correlations(_correlations) {}
+
+    void operator()(const Range& range) const
+    {
+      for(int k = range.start; k < range.end; k++)
+      {
+        const int i = indices[k];
+        switch(step)
+        {
+        case UPDATE:
+          status[i] = trackers[i]->update(image, objects[i]);
+          break;
+        case KCF_BEGIN:
+          status[i] = steps[k]->beginUpdate(image, correlations[k]);
+          break;
+        case KCF_LOCATE:
+          if(status[i])
+            status[i] = steps[k]->locate(objects[i], correlations[k]);
+          break;
+        case KCF_END:
+          if(status[i])
+            steps[k]->endUpdate();
+          break;
+        }
+      }
+    }
+
+  private:
+    int step;
+    const Mat& image;
+    std::vector<Ptr<Tracker> >& trackers;
+    const std::vector<int>& indices;
+    const std::vector<kcf::TrackerKCFSteps*>& steps;
+    std::vector<Rect2d>& objects;
+    std::vector<uchar>& status;
+    std::vector<kcf::Correlation>& correlations;
+
+    MultiTrackerUpdateInvoker& operator=(const MultiTrackerUpdateInvoker&);
+  };
+
+  // the correlations to compute after a step of the KCF trackers
+  static std::vector<kcf::Correlation*> pendingCorrelations(std::vector<kcf::Correlation>& correlations,
+                                                            const std::vector<int>& indices, const std::vector<uchar>& status)
+  {
+    std::vector<kcf::Correlation*> pending;
+    for(size_t k = 0; k < correlations.size(); k++)
+      if(status[indices[k]] && correlations[k].kf)
+        pending.push_back(&correlations[k]);
+    return pending;
+  }
+
   // update position of the tracked objects, the result is stored in internal storage
   bool MultiTracker::update(InputArray image)
   {
-    bool status = true;
-    for(unsigned i=0;i< trackerList.size(); i++){
-      status &= trackerList[i]->update(image, objects[i]);
+    // the frame is shared read-only by all the trackers, which have their own state
+    Mat frame = image.getMat();
+    const int n = (int)trackerList.size();
+    std::vector<uchar> status(n, 0);
+
+    // the KCF trackers are updated in lockstep, their kernel correlations being computed in batches,
+    // the GOTURN trackers with one forward of the network for all their targets
+    std::vector<int> others, kcfIndices, goturnIndices;
+    std::vector<kcf::TrackerKCFSteps*> kcfSteps;
+#ifdef HAVE_OPENCV_DNN
+    std::vector<gtr::TrackerGOTURNImpl*> goturnTrackers;
+#endif
+    for(int i = 0; i < n; i++)
+    {
+      kcf::TrackerKCFSteps* steps = dynamic_cast<kcf::TrackerKCFSteps*>(trackerList[i].get());
+#ifdef HAVE_OPENCV_DNN
+      gtr::TrackerGOTURNImpl* goturn = dynamic_cast<gtr::TrackerGOTURNImpl*>(trackerList[i].get());
+      if(goturn)
+      {
+        goturnIndices.push_back(i);
+        goturnTrackers.push_back(goturn);
+        continue;
+      }
+#endif
+      if(steps && steps->batchable())
+      {
+        kcfIndices.push_back(i);
+        kcfSteps.push_back(steps);
+      }
+      else
+        others.push_back(i);
     }
-    return status;
+    std::vector<kcf::Correlation> correlations(kcfSteps.size());
+
+    // one tracker per stripe: their update times differ a lot, the pool balances them
+    const int nothers = (int)others.size();
+    parallel_for_(Range(0, nothers), MultiTrackerUpdateInvoker(MultiTrackerUpdateInvoker::UPDATE, frame, trackerList,
+                  others, kcfSteps, objects, status, correlations), nothers);
+
+    const int nkcf = (int)kcfSteps.size();
+    if(nkcf > 0)
+    {
+      // as for GOTURN, the batches run in the buffers of the first tracker, which are kept between the frames
+      kcf::BatchWorkspace& workspace = kcfSteps[0]->workspace;
+      parallel_for_(Range(0, nkcf), MultiTrackerUpdateInvoker(MultiTrackerUpdateInvoker::KCF_BEGIN, frame, trackerList,
+                    kcfIndices, kcfSteps, objects, status, correlations), nkcf);
+      kcf::batchCorrelations(pendingCorrelations(correlations, kcfIndices, status), workspace);
+      parallel_for_(Range(0, nkcf), MultiTrackerUpdateInvoker(MultiTrackerUpdateInvoker::KCF_LOCATE, frame, trackerList,
+                    kcfIndices, kcfSteps, objects, status, correlations), nkcf);
+      kcf::batchCorrelations(pendingCorrelations(correlations, kcfIndices, status), workspace);
+      parallel_for_(Range(0, nkcf), MultiTrackerUpdateInvoker(MultiTrackerUpdateInvoker::KCF_END, frame, trackerList,
+                    kcfIndices, kcfSteps, objects, status, correlations), nkcf);
+    }
+
+#ifdef HAVE_OPENCV_DNN
+    if(!goturnTrackers.empty())
+    {
+      std::vector<Rect2d> goturnObjects;
+      std::vector<uchar> goturnStatus;
+      gtr::updateBatch(frame, goturnTrackers, goturnObjects, goturnStatus);
+      for(size_t k = 0; k < goturnIndices.size(); k++)
+      {
+        status[goturnIndices[k]] = goturnStatus[k];
+        if(goturnStatus[k])
+          objects[goturnIndices[k]] = goturnObjects[k];
+      }
+    }
+#endif
+
+    return std::count(status.begin(), status.end(), 0) == 0;
   };
 
   // update position of the tracked objects, the result is copied to external variable
@@ -146,11 +146,8 @@ void ClfMilBoost::update( const Mat& posx, const Mat& negx )
   //if( !negx.ftrsComputed() )
   //  Ftr::compute( negx, _ftrs );
 
-  // initialize H
-  static std::vector<float> Hpos, Hneg;
-  Hpos.clear();
-  Hneg.clear();
-  Hpos.resize( posx.rows, 0.0f ), Hneg.resize( negx.rows, 0.0f );
+  // initialize H (not static: the MIL trackers of a MultiTracker are updated in parallel)
+  std::vector<float> Hpos( posx.rows, 0.0f ), Hneg( negx.rows, 0.0f );
 
   _selectors.clear();
   std::vector<float> posw( posx.rows ), negw( negx.rows );
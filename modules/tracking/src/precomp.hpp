@@ -50,7 +50,8 @@
 
 namespace cv
 {
-	extern const double ColorNames[][10];
+	extern const uchar ColorNames[][10];
+	extern const double ColorNamesOffset[10], ColorNamesScale[10];
 
     namespace tracking {
 
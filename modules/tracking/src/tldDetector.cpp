@@ -42,6 +42,7 @@
 #include "tldDetector.hpp"
 
 #include <opencv2/core/utility.hpp>
+#include <algorithm>
 
 namespace cv
 {
@@ -300,118 +301,272 @@ namespace cv
 
 		//Detection - returns most probable new target location (Max Sc)
 
-		class CalcScSrParallelLoopBody: public cv::ParallelLoopBody
+		// Variance of the windows, from the integral images of their scale
+		class ScanWindowsVarianceInvoker : public ParallelLoopBody
 		{
 		public:
-			explicit CalcScSrParallelLoopBody (TLDDetector * detector, Size initSize):
-				detectorF (detector),
-				initSizeF (initSize)
+			ScanWindowsVarianceInvoker(TLDScanWindows& _windows, const std::vector<Mat_<double> >& _intImgP, const std::vector<Mat_<double> >& _intImgP2) :
+				windows(_windows), intImgP(_intImgP), intImgP2(_intImgP2)
 			{
 			}
 
-			virtual void operator () (const cv::Range & r) const
+			void operator () (const Range& r) const
 			{
-				for (int ind = r.start; ind < r.end; ++ind)
+				const int width = windows.initSize.width, height = windows.initSize.height;
+				for (int ind = r.start; ind < r.end; ind++)
 				{
-					resample(detectorF->resized_imgs[detectorF->ensScaleIDs[ind]],
-						Rect2d(detectorF->ensBuffer[ind], initSizeF),
-						detectorF->standardPatches[ind]);
-
-					detectorF->scValues[ind] = detectorF->Sc (detectorF->standardPatches[ind]);
-					detectorF->srValues[ind] = detectorF->Sr (detectorF->standardPatches[ind]);
+					const Mat_<double>& P = intImgP[windows.scaleIDs[ind]];
+					const Mat_<double>& P2 = intImgP2[windows.scaleIDs[ind]];
+					const int x = windows.positions[ind].x, y = windows.positions[ind].y;
+					double A, B, C, D;
+
+					A = P(y, x);
+					B = P(y, x + width);
+					C = P(y + height, x);
+					D = P(y + height, x + width);
+					double p = (A + D - B - C) / (width * height);
+
+					A = P2(y, x);
+					B = P2(y, x + width);
+					C = P2(y + height, x);
+					D = P2(y + height, x + width);
+					double p2 = (A + D - B - C) / (width * height);
+
+					windows.variances[ind] = p2 - p * p;
 				}
 			}
 
-			TLDDetector * detectorF;
-			const Size initSizeF;
 		private:
-			CalcScSrParallelLoopBody (const CalcScSrParallelLoopBody&);
-			CalcScSrParallelLoopBody& operator= (const CalcScSrParallelLoopBody&);
+			TLDScanWindows& windows;
+			const std::vector<Mat_<double> >& intImgP;
+			const std::vector<Mat_<double> >& intImgP2;
+
+			ScanWindowsVarianceInvoker& operator= (const ScanWindowsVarianceInvoker&);
 		};
 
-		bool TLDDetector::detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize)
+		void TLDScanWindows::build(const Mat& img, const Mat& imgBlurred, Size _initSize)
 		{
-			patches.clear();
+			initSize = _initSize;
+			resized_imgs.clear();
+			blurred_imgs.clear();
+			positions.clear();
+			scaleIDs.clear();
+
+			std::vector<Mat_<double> > intImgP, intImgP2;
 			Mat tmp;
 			int dx = initSize.width / 10, dy = initSize.height / 10;
 			Size2d size = img.size();
-			double scale = 1.0;
-			int npos = 0, nneg = 0;
-			double maxSc = -5.0;
-			Rect2d maxScRect;
-			int scaleID;
-
-			resized_imgs.clear ();
-			blurred_imgs.clear ();
-			varBuffer.clear ();
-			ensBuffer.clear ();
-			varScaleIDs.clear ();
-			ensScaleIDs.clear ();
-
-			//Detection part
-			//Generate windows and filter by variance
-			scaleID = 0;
+			int scaleID = 0;
 			resized_imgs.push_back(img);
 			blurred_imgs.push_back(imgBlurred);
 			do
 			{
-				Mat_<double> intImgP, intImgP2;
-				computeIntegralImages(resized_imgs[scaleID], intImgP, intImgP2);
+				intImgP.push_back(Mat_<double>());
+				intImgP2.push_back(Mat_<double>());
+				TLDDetector::computeIntegralImages(resized_imgs[scaleID], intImgP.back(), intImgP2.back());
 				for (int i = 0, imax = cvFloor((0.0 + resized_imgs[scaleID].cols - initSize.width) / dx); i < imax; i++)
 				{
 					for (int j = 0, jmax = cvFloor((0.0 + resized_imgs[scaleID].rows - initSize.height) / dy); j < jmax; j++)
 					{
-						if (!patchVariance(intImgP, intImgP2, originalVariancePtr, Point(dx * i, dy * j), initSize))
-							continue;
-						varBuffer.push_back(Point(dx * i, dy * j));
-						varScaleIDs.push_back(scaleID);
+						positions.push_back(Point(dx * i, dy * j));
+						scaleIDs.push_back(scaleID);
 					}
 				}
 				scaleID++;
 				size.width /= SCALE_STEP;
 				size.height /= SCALE_STEP;
-				scale *= SCALE_STEP;
 				resize(img, tmp, size, 0, 0, DOWNSCALE_MODE);
 				resized_imgs.push_back(tmp);
 				GaussianBlur(resized_imgs[scaleID], tmp, GaussBlurKernelSize, 0.0f);
 				blurred_imgs.push_back(tmp);
 			} while (size.width >= initSize.width && size.height >= initSize.height);
 
-			//Encsemble classification
-			for (int i = 0; i < (int)varBuffer.size(); i++)
+			variances.resize(positions.size());
+			parallel_for_(Range(0, (int)positions.size()), ScanWindowsVarianceInvoker(*this, intImgP, intImgP2));
+		}
+
+		void TLDDetector::prepareCascade(const TLDScanWindows& windows)
+		{
+			// the fern offsets only depend on the row step of the scales
+			measuresPerScale = 0;
+			for (int i = 0; i < (int)classifiers.size(); i++)
+				measuresPerScale += (int)classifiers[i].measurements.size();
+			scaleOffsets.resize(windows.blurred_imgs.size() * measuresPerScale);
+			for (int s = 0; s < (int)windows.blurred_imgs.size(); s++)
 			{
-				prepareClassifiers(static_cast<int> (blurred_imgs[varScaleIDs[i]].step[0]));
-				if (ensembleClassifierNum(&blurred_imgs[varScaleIDs[i]].at<uchar>(varBuffer[i].y, varBuffer[i].x)) <= ENSEMBLE_THRESHOLD)
-					continue;
-				ensBuffer.push_back(varBuffer[i]);
-				ensScaleIDs.push_back(varScaleIDs[i]);
+				const int rowstep = (int)windows.blurred_imgs[s].step[0];
+				Point2i* offset = &scaleOffsets[s * measuresPerScale];
+				for (int i = 0; i < (int)classifiers.size(); i++)
+				{
+					for (int n = 0; n < (int)classifiers[i].measurements.size(); n++, offset++)
+					{
+						const Vec4b& m = classifiers[i].measurements[n];
+						offset->x = rowstep * m.val[2] + m.val[0];
+						offset->y = rowstep * m.val[3] + m.val[1];
+					}
+				}
+			}
+
+			// the sums of the examples are computed once for all the NCCs of the frame
+			const int N = STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE;
+			exampleSums.resize(*posNum + *negNum);
+			exampleSquares.resize(*posNum + *negNum);
+			for (int i = 0; i < *posNum + *negNum; i++)
+			{
+				const uchar* example = i < *posNum ? &posExp->data[i * N] : &negExp->data[(i - *posNum) * N];
+				int s = 0, s2 = 0;
+				for (int j = 0; j < N; j++)
+				{
+					s += example[j];
+					s2 += example[j] * example[j];
+				}
+				exampleSums[i] = s;
+				exampleSquares[i] = s2;
+			}
+			medianTimeStamp = timeStampsPositive->empty() ? 0 : getMedian(*timeStampsPositive);
+		}
+
+		// ensembleClassifierNum with the fern offsets of a scale
+		double TLDDetector::ensembleClassifierNum(const uchar* data, int scaleID) const
+		{
+			const Point2i* offset = &scaleOffsets[scaleID * measuresPerScale];
+			double p = 0;
+			for (int k = 0; k < (int)classifiers.size(); k++)
+			{
+				int position = 0;
+				for (int n = 0; n < (int)classifiers[k].measurements.size(); n++, offset++)
+					position = (position << 1) | (data[offset->x] < data[offset->y]);
+				double posNum = (double)classifiers[k].posAndNeg[position].x, negNum = (double)classifiers[k].posAndNeg[position].y;
+				if (posNum != 0.0 || negNum != 0.0)
+					p += posNum / (posNum + negNum);
+			}
+			p /= classifiers.size();
+			return p;
+		}
+
+		// Sr and Sc of a standard patch, with the sums of the examples computed by prepareCascade
+		void TLDDetector::SrSc(const uchar* patch, double& sr, double& sc) const
+		{
+			const int N = STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE;
+			int s = 0, s2 = 0;
+			for (int j = 0; j < N; j++)
+			{
+				s += patch[j];
+				s2 += patch[j] * patch[j];
+			}
+
+			double splusr = 0.0, splusc = 0.0, sminus = 0.0;
+			for (int i = 0; i < *posNum; i++)
+			{
+				double ncc = 0.5 * (NCC(N, exampleSums[i], s, exampleSquares[i], s2, dotProduct(&posExp->data[i * N], patch, N)) + 1.0);
+				splusr = std::max(splusr, ncc);
+				if ((int)(*timeStampsPositive)[i] <= medianTimeStamp)
+					splusc = std::max(splusc, ncc);
+			}
+			for (int i = 0; i < *negNum; i++)
+			{
+				const int e = *posNum + i;
+				sminus = std::max(sminus, 0.5 * (NCC(N, exampleSums[e], s, exampleSquares[e], s2, dotProduct(&negExp->data[i * N], patch, N)) + 1.0));
 			}
 
-			//Batch preparation
-			srValues.resize (ensBuffer.size());
-			scValues.resize (ensBuffer.size());
+			sr = (splusr + sminus == 0.0) ? 0.0 : splusr / (sminus + splusr);
+			sc = (splusc + sminus == 0.0) ? 0.0 : splusc / (sminus + splusc);
+		}
 
-			//Carefully resize standard patches with reference-counted Mat members
-			const int oldPatchesSize = (int)standardPatches.size();
-			standardPatches.resize (ensBuffer.size());
-			if ((int)ensBuffer.size() > oldPatchesSize)
+		// Variance filter and ensemble classifier of the windows of all the targets, t = k * windows + window
+		class CascadeEnsembleParallelLoopBody : public ParallelLoopBody
+		{
+		public:
+			CascadeEnsembleParallelLoopBody(const TLDScanWindows& _windows, const std::vector<TLDDetector*>& _detectors, std::vector<uchar>& _passed) :
+				windows(_windows), detectors(_detectors), passed(_passed)
 			{
-				Mat_<uchar> standardPatch(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE);
-				for (int i = oldPatchesSize; i < (int)ensBuffer.size(); ++i)
+			}
+
+			void operator () (const Range& r) const
+			{
+				const int nwindows = (int)windows.positions.size();
+				for (int t = r.start; t < r.end; t++)
 				{
-					standardPatches[i] = standardPatch.clone();
+					const TLDDetector* detector = detectors[t / nwindows];
+					const int ind = t % nwindows, scaleID = windows.scaleIDs[ind];
+					passed[t] = windows.variances[ind] > VARIANCE_THRESHOLD * *detector->originalVariancePtr &&
+						detector->ensembleClassifierNum(&windows.blurred_imgs[scaleID].at<uchar>(windows.positions[ind].y, windows.positions[ind].x), scaleID) > ENSEMBLE_THRESHOLD;
 				}
 			}
 
-			//Batch calculation
-			cv::parallel_for_ (cv::Range (0, (int)ensBuffer.size ()), CalcScSrParallelLoopBody (this, initSize));
+		private:
+			const TLDScanWindows& windows;
+			const std::vector<TLDDetector*>& detectors;
+			std::vector<uchar>& passed;
+
+			CascadeEnsembleParallelLoopBody& operator= (const CascadeEnsembleParallelLoopBody&);
+		};
+
+		// NN classifier of the windows passing the ensemble classifier, in a batch of standard patches
+		class CascadeNNParallelLoopBody : public ParallelLoopBody
+		{
+		public:
+			CascadeNNParallelLoopBody(const TLDScanWindows& _windows, const std::vector<TLDDetector*>& _detectors, const std::vector<int>& _candidates,
+				Mat_<uchar>& _standardPatches, std::vector<double>& _srValues, std::vector<double>& _scValues) :
+				windows(_windows), detectors(_detectors), candidates(_candidates), standardPatches(_standardPatches), srValues(_srValues), scValues(_scValues)
+			{
+			}
+
+			void operator () (const Range& r) const
+			{
+				const int nwindows = (int)windows.positions.size();
+				for (int i = r.start; i < r.end; i++)
+				{
+					const int ind = candidates[i] % nwindows;
+					Mat_<uchar> standardPatch(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE, standardPatches[i]);
+					resample(windows.resized_imgs[windows.scaleIDs[ind]], Rect2d(windows.positions[ind], windows.initSize), standardPatch);
+					detectors[candidates[i] / nwindows]->SrSc(standardPatch.data, srValues[i], scValues[i]);
+				}
+			}
+
+		private:
+			const TLDScanWindows& windows;
+			const std::vector<TLDDetector*>& detectors;
+			const std::vector<int>& candidates;
+			Mat_<uchar>& standardPatches;
+			std::vector<double>& srValues;
+			std::vector<double>& scValues;
+
+			CascadeNNParallelLoopBody& operator= (const CascadeNNParallelLoopBody&);
+		};
+
+		void TLDDetector::detectCascade(const TLDScanWindows& windows, const std::vector<TLDDetector*>& detectors,
+			std::vector<std::vector<LabeledPatch> >& patches, std::vector<Rect2d>& res, std::vector<bool>& found)
+		{
+			const int ntargets = (int)detectors.size(), nwindows = (int)windows.positions.size();
+			for (int k = 0; k < ntargets; k++)
+			{
+				detectors[k]->prepareCascade(windows);
+				patches[k].clear();
+			}
+
+			//Variance filter and encsemble classification
+			std::vector<uchar> passed((size_t)ntargets * nwindows);
+			parallel_for_(Range(0, ntargets * nwindows), CascadeEnsembleParallelLoopBody(windows, detectors, passed));
 
 			//NN classification
-			for (int i = 0; i < (int)ensBuffer.size(); i++)
+			std::vector<int> candidates;
+			for (int t = 0; t < ntargets * nwindows; t++)
+				if (passed[t])
+					candidates.push_back(t);
+			const int ncandidates = (int)candidates.size();
+			Mat_<uchar> standardPatches(std::max(ncandidates, 1), STANDARD_PATCH_SIZE * STANDARD_PATCH_SIZE);
+			std::vector<double> srValues(ncandidates), scValues(ncandidates);
+			parallel_for_(Range(0, ncandidates), CascadeNNParallelLoopBody(windows, detectors, candidates, standardPatches, srValues, scValues));
+
+			std::vector<double> maxSc(ntargets, -5.0);
+			for (int i = 0; i < ncandidates; i++)
 			{
+				const int k = candidates[i] / nwindows, ind = candidates[i] % nwindows;
 				LabeledPatch labPatch;
-				double curScale = pow(SCALE_STEP, ensScaleIDs[i]);
-				labPatch.rect = Rect2d(ensBuffer[i].x*curScale, ensBuffer[i].y*curScale, initSize.width * curScale, initSize.height * curScale);
+				double curScale = pow(SCALE_STEP, windows.scaleIDs[ind]);
+				labPatch.rect = Rect2d(windows.positions[ind].x*curScale, windows.positions[ind].y*curScale,
+					windows.initSize.width * curScale, windows.initSize.height * curScale);
 
 				const double srValue = srValues[i];
 				const double scValue = scValues[i];
@@ -420,33 +575,35 @@ namespace cv
 				//
 				labPatch.isObject = srValue > THETA_NN;
 				labPatch.shouldBeIntegrated = abs(srValue - THETA_NN) < 0.1;
-				patches.push_back(labPatch);
+				patches[k].push_back(labPatch);
 				//
 
-				if (!labPatch.isObject)
-				{
-					nneg++;
-					continue;
-				}
-				else
-				{
-					npos++;
-				}
-
-				if (scValue > maxSc)
+				if (labPatch.isObject && scValue > maxSc[k])
 				{
-					maxSc = scValue;
-					maxScRect = labPatch.rect;
+					maxSc[k] = scValue;
+					res[k] = labPatch.rect;
 				}
 			}
 
-			if (maxSc < 0)
-				return false;
-			else
-			{
-				res = maxScRect;
-				return true;
-			}
+			for (int k = 0; k < ntargets; k++)
+				found[k] = maxSc[k] >= 0;
+		}
+
+		bool TLDDetector::detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize)
+		{
+			TLDScanWindows windows;
+			windows.build(img, imgBlurred, initSize);
+
+			std::vector<TLDDetector*> detectors(1, this);
+			std::vector<std::vector<LabeledPatch> > targetPatches(1);
+			std::vector<Rect2d> targetRes(1, res);
+			std::vector<bool> found(1);
+			detectCascade(windows, detectors, targetPatches, targetRes, found);
+
+			patches.swap(targetPatches[0]);
+			if (found[0])
+				res = targetRes[0];
+			return found[0];
 		}
 
 #ifdef HAVE_OPENCL
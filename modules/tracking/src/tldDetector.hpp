@@ -68,6 +68,20 @@ namespace cv
 
 
 
+		/* The scanning windows of the detector on the image pyramid of a frame, with their variance. The targets of
+		 * MultiTrackerTLD have the same windows, which are built once per frame for all of them.
+		 */
+		struct TLDScanWindows
+		{
+			void build(const Mat& img, const Mat& imgBlurred, Size initSize);
+
+			Size initSize;
+			std::vector<Mat> resized_imgs, blurred_imgs;
+			std::vector<Point> positions;
+			std::vector<int> scaleIDs;
+			std::vector<double> variances;
+		};
+
 		class TLDDetector
 		{
 		public:
@@ -89,12 +103,6 @@ namespace cv
 			std::vector<Mat_<uchar> > *positiveExamples, *negativeExamples;
 			std::vector<int> *timeStampsPositive, *timeStampsNegative;
 			double *originalVariancePtr;
-			std::vector<double> scValues, srValues;
-			std::vector<Mat_<uchar> > standardPatches;
-
-			std::vector <Mat> resized_imgs, blurred_imgs;
-			std::vector <Point> varBuffer, ensBuffer;
-			std::vector <int> varScaleIDs, ensScaleIDs;
 
 			static void generateScanGrid(int rows, int cols, Size initBox, std::vector<Rect2d>& res, bool withScaling = false);
 			struct LabeledPatch
@@ -105,9 +113,28 @@ namespace cv
 			bool detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize);
 			bool ocl_detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches,  Size initSize);
 
+			/* The cascade of the detectors of several targets on the same windows: variance filter, ensemble classifier
+			 * and nearest-neighbour classifier, each stage running in parallel over the windows of all the targets.
+			 * found[k] tells whether res[k] is the detection of the k-th target.
+			 */
+			static void detectCascade(const TLDScanWindows& windows, const std::vector<TLDDetector*>& detectors,
+				std::vector<std::vector<LabeledPatch> >& patches, std::vector<Rect2d>& res, std::vector<bool>& found);
+
+			// thread-safe stages of the cascade, once prepareCascade is called on the windows of the frame
+			void prepareCascade(const TLDScanWindows& windows);
+			double ensembleClassifierNum(const uchar* data, int scaleID) const;
+			void SrSc(const uchar* patch, double& sr, double& sc) const;
+
 			friend class MyMouseCallbackDEBUG;
 			static void computeIntegralImages(const Mat& img, Mat_<double>& intImgP, Mat_<double>& intImgP2){ integral(img, intImgP, intImgP2, CV_64F); }
 			static inline bool patchVariance(Mat_<double>& intImgP, Mat_<double>& intImgP2, double *originalVariance, Point pt, Size size);
+
+		private:
+			// fern offsets of the ensemble classifier in each scale, statistics of the examples of the NN classifier
+			std::vector<Point2i> scaleOffsets;
+			int measuresPerScale;
+			std::vector<int> exampleSums, exampleSquares;
+			int medianTimeStamp;
 		};
 
 
@@ -40,6 +40,7 @@
  //M*/
 
 #include "tldUtils.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 
 namespace cv
@@ -182,11 +183,36 @@ double NCC(const Mat_<uchar>& patch1, const Mat_<uchar>& patch2)
             prod += (p1 * p2);
         }
     }
+    return NCC(N, s1, s2, n1, n2, prod);
+}
+
+double NCC(int N, int s1, int s2, int n1, int n2, int prod)
+{
     double sq1 = sqrt(std::max(0.0, n1 - 1.0 * s1 * s1 / N)), sq2 = sqrt(std::max(0.0, n2 - 1.0 * s2 * s2 / N));
     double ares = (sq2 == 0) ? sq1 / abs(sq1) : (prod - s1 * s2 / N) / sq1 / sq2;
     return ares;
 }
 
+int dotProduct(const uchar* p1, const uchar* p2, int n)
+{
+    int i = 0, prod = 0;
+#if CV_SIMD128
+    v_int32x4 vprod = v_setzero_s32();
+    for( ; i <= n - 16; i += 16 )
+    {
+        v_uint16x8 a0, a1, b0, b1;
+        v_expand(v_load(p1 + i), a0, a1);
+        v_expand(v_load(p2 + i), b0, b1);
+        vprod += v_dotprod(v_reinterpret_as_s16(a0), v_reinterpret_as_s16(b0));
+        vprod += v_dotprod(v_reinterpret_as_s16(a1), v_reinterpret_as_s16(b1));
+    }
+    prod = v_reduce_sum(vprod);
+#endif
+    for( ; i < n; i++ )
+        prod += p1[i] * p2[i];
+    return prod;
+}
+
 int getMedian(const std::vector<int>& values, int size)
 {
     if( size == -1 )
@@ -49,6 +49,11 @@ namespace cv
 		/** Computes normalized corellation coefficient between the two patches (they should be
 		* of the same size).*/
 		double NCC(const Mat_<uchar>& patch1, const Mat_<uchar>& patch2);
+		/** NCC() of two patches of N pixels from their sums s1 and s2, their sums of squares n1 and n2 and their
+		* dot product prod, for the sums of a patch to be computed once when it is correlated with many others.*/
+		double NCC(int N, int s1, int s2, int n1, int n2, int prod);
+		/** Dot product of two arrays of n pixels.*/
+		int dotProduct(const uchar* p1, const uchar* p2, int n);
 		void getClosestN(std::vector<Rect2d>& scanGrid, Rect2d bBox, int n, std::vector<Rect2d>& res);
 		double scaleAndBlur(const Mat& originalImg, int scale, Mat& scaledImg, Mat& blurredImg, Size GaussBlurKernelSize, double scaleStep);
 		int getMedian(const std::vector<int>& values, int size = -1);
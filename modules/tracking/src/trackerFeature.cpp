@@ -195,6 +195,109 @@ bool TrackerFeatureHAAR::swapFeature( int source, int target )
   return true;
 }
 
+/*
+ * Batched evaluation of the features on samples which are views of the same integral image with the same size, as
+ * the samples of TrackerSamplerCSC: the corners of the areas of the features are offsets from the origin of the
+ * samples, computed once, and each feature is evaluated on a range of samples in a tight loop.
+ */
+template<typename T>
+class HaarBatchInvoker : public cv::ParallelLoopBody
+{
+ public:
+  HaarBatchInvoker( const std::vector<Mat>& _samples, const std::vector<int>& _areaStart, const std::vector<Vec4i>& _corners,
+                    const std::vector<float>& _weights, const std::vector<int>& _rows, Mat& _response ) :
+      samples( _samples ),
+      areaStart( _areaStart ),
+      corners( _corners ),
+      weights( _weights ),
+      rows( _rows ),
+      response( _response )
+  {
+  }
+
+  virtual void operator()( const cv::Range &r ) const
+  {
+    AutoBuffer<const T*> _origins( r.end - r.start );
+    const T** origins = _origins;
+    for ( int i = r.start; i < r.end; i++ )
+      origins[i - r.start] = samples[i].ptr<T>();
+
+    for ( int j = 0; j < (int) rows.size(); j++ )
+    {
+      float* out = response.ptr<float>( rows[j] ) + r.start;
+      for ( int i = 0; i < r.end - r.start; i++ )
+      {
+        const T* origin = origins[i];
+        float res = 0.0f;
+        for ( int a = areaStart[j]; a < areaStart[j + 1]; a++ )
+        {
+          const Vec4i& c = corners[a];
+          res += static_cast<float>( origin[c[3]] + origin[c[0]] - origin[c[1]] - origin[c[2]] ) * weights[a];
+        }
+        out[i] = res;
+      }
+    }
+  }
+
+ private:
+  const std::vector<Mat>& samples;
+  const std::vector<int>& areaStart;
+  const std::vector<Vec4i>& corners;
+  const std::vector<float>& weights;
+  const std::vector<int>& rows;
+  Mat& response;
+
+  HaarBatchInvoker& operator=( const HaarBatchInvoker& );
+};
+
+// returns false if the samples cannot be evaluated in a batch
+static bool computeHaarBatch( const std::vector<CvHaarEvaluator::FeatureHaar>& features, const std::vector<int>& ids,
+                              const std::vector<Mat>& images, Mat& response )
+{
+  const Mat& first = images[0];
+  const int depth = first.depth();
+  if( first.channels() != 1 || ( depth != CV_32S && depth != CV_32F && depth != CV_64F ) )
+    return false;
+  for ( size_t i = 1; i < images.size(); i++ )
+  {
+    if( images[i].size() != first.size() || images[i].type() != first.type() || images[i].step != first.step )
+      return false;
+  }
+
+  // the areas are clipped to the samples as in FeatureHaar::eval
+  const int step = (int) first.step1();
+  std::vector<int> areaStart( 1, 0 );
+  std::vector<Vec4i> corners;
+  std::vector<float> weights;
+  for ( size_t j = 0; j < ids.size(); j++ )
+  {
+    const std::vector<Rect>& areas = features[ids[j]].getAreas();
+    const std::vector<float>& w = features[ids[j]].getWeights();
+    for ( size_t a = 0; a < areas.size(); a++ )
+    {
+      const Rect& area = areas[a];
+      int width = area.width, height = area.height;
+      if( area.x + width >= first.cols - 1 )
+        width = ( first.cols - 1 ) - area.x;
+      if( area.y + height >= first.rows - 1 )
+        height = ( first.rows - 1 ) - area.y;
+      corners.push_back( Vec4i( area.y * step + area.x, area.y * step + area.x + width,
+                                ( area.y + height ) * step + area.x, ( area.y + height ) * step + area.x + width ) );
+      weights.push_back( (float) w[a] / (float) ( area.width * area.height ) );
+    }
+    areaStart.push_back( (int) corners.size() );
+  }
+
+  const Range range( 0, (int) images.size() );
+  if( depth == CV_32S )
+    parallel_for_( range, HaarBatchInvoker<int>( images, areaStart, corners, weights, ids, response ) );
+  else if( depth == CV_32F )
+    parallel_for_( range, HaarBatchInvoker<float>( images, areaStart, corners, weights, ids, response ) );
+  else
+    parallel_for_( range, HaarBatchInvoker<double>( images, areaStart, corners, weights, ids, response ) );
+  return true;
+}
+
 bool TrackerFeatureHAAR::extractSelected( const std::vector<int> selFeatures, const std::vector<Mat>& images, Mat& response )
 {
   if( images.empty() )
@@ -209,6 +312,9 @@ bool TrackerFeatureHAAR::extractSelected( const std::vector<int> selFeatures, co
   response.create( Size( (int)images.size(), numFeatures ), CV_32F );
   response.setTo( 0 );
 
+  if( computeHaarBatch( featureEvaluator->getFeatures(), selFeatures, images, response ) )
+    return true;
+
   //double t = getTickCount();
   //for each sample compute #n_feature -> put each feature (n Rect) in response
   for ( size_t i = 0; i < images.size(); i++ )
@@ -275,7 +381,12 @@ bool TrackerFeatureHAAR::computeImpl( const std::vector<Mat>& images, Mat& respo
 
   response = Mat_<float>( Size( (int)images.size(), numFeatures ) );
 
-  std::vector<CvHaarEvaluator::FeatureHaar> f = featureEvaluator->getFeatures();
+  std::vector<int> allFeatures( numFeatures );
+  for ( int j = 0; j < numFeatures; j++ )
+    allFeatures[j] = j;
+  if( computeHaarBatch( featureEvaluator->getFeatures(), allFeatures, images, response ) )
+    return true;
+
   //for each sample compute #n_feature -> put each feature (n Rect) in response
   parallel_for_( Range( 0, (int)images.size() ), Parallel_compute( featureEvaluator, images, response ) );
 
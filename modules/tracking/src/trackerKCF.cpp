@@ -40,6 +40,8 @@
  //M*/
 
 #include "precomp.hpp"
+#include "trackerKCFBatch.hpp"
+#include "featureColorName.hpp"
 #include <complex>
 
 /*---------------------------
@@ -68,13 +70,21 @@ namespace cv{
   /*
  * Prototype
  */
-  class TrackerKCFImpl : public TrackerKCF {
+  class TrackerKCFImpl : public TrackerKCF, public kcf::TrackerKCFSteps {
   public:
     TrackerKCFImpl( const TrackerKCF::Params &parameters = TrackerKCF::Params() );
     void read( const FileNode& /*fn*/ );
     void write( FileStorage& /*fs*/ ) const;
     void setFeatureExtractor(void (*f)(const Mat, const Rect, Mat&), bool pca_func = false);
 
+    /*
+    * steps of updateImpl, for the batches of MultiTracker
+    */
+    bool batchable() const;
+    bool beginUpdate( const Mat& image, kcf::Correlation& detection );
+    bool locate( Rect2d& boundingBox, kcf::Correlation& learning );
+    void endUpdate();
+
   protected:
      /*
     * basic functions and vars
@@ -91,18 +101,18 @@ namespace cv{
     void inline fft2(const Mat src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const;
     void inline fft2(const Mat src, Mat & dest) const;
     void inline ifft2(const Mat src, Mat & dest) const;
-    void inline pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB=false) const;
-    void inline sumChannels(std::vector<Mat> src, Mat & dest) const;
+    void inline sumConjProducts(const std::vector<Mat> & src1, const std::vector<Mat> & src2, Mat & dest) const;
     void inline updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix,double pca_rate, int compressed_sz,
-                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat v) const;
-    void inline compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const;
-    bool getSubWindow(const Mat img, const Rect roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc = GRAY) const;
+                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat & pca_data, Mat & new_cov, Mat & w, Mat & u, Mat & vt) const;
+    void inline compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & compressed) const;
+    bool getSubWindow(const Mat img, const Rect roi, Mat& feat, Mat& patch, Mat& gray, TrackerKCF::MODE desc = GRAY) const;
     bool getSubWindow(const Mat img, const Rect roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) const;
     void extractCN(Mat patch_data, Mat & cnFeatures) const;
-    void denseGaussKernel(const double sigma, const Mat , const Mat y_data, Mat & k_data,
-                          std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> xyf_v, Mat xy, Mat xyf ) const;
+    void denseGaussKernel(const double sigma, const Mat x_data, const Mat y_data, Mat & k_data,
+                          std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, Mat & xy, Mat & xyf ) const;
     void calcResponse(const Mat alphaf_data, const Mat kf_data, Mat & response_data, Mat & spec_data) const;
     void calcResponse(const Mat alphaf_data, const Mat alphaf_den_data, const Mat kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const;
+    void correlate(const kcf::Correlation& correlation);
 
     void shiftRows(Mat& mat) const;
     void shiftRows(Mat& mat, int n) const;
@@ -124,18 +134,19 @@ namespace cv{
     Mat response; // detection result
     Mat old_cov_mtx, proj_mtx; // for feature compression
 
-    // pre-defined Mat variables for optimization of private functions
+    // pre-defined Mat variables for optimization of private functions: they are sized by the first
+    // updates, after which updateImpl does not allocate any Mat
     Mat spec, spec2;
     std::vector<Mat> layers;
-    std::vector<Mat> vxf,vyf,vxyf;
+    std::vector<Mat> vxf,vyf;
     Mat xy_data,xyf_data;
-    Mat data_temp, compress_data;
+    Mat compress_data;
     std::vector<Mat> layers_pca_data;
     std::vector<Scalar> average_data;
-    Mat img_Patch;
+    Mat img_Frame, img_Resized, img_Patch, img_Gray; // img_Frame is the image of the current update
 
-    // storage for the extracted features, KRLS model, KRLS compressed model
-    Mat X[2],Z[2],Zc[2];
+    // storage for the extracted features, compressed features, KRLS model, KRLS compressed model
+    Mat X[2],Xc[2],Z[2],Zc[2];
 
     // storage of the extracted features
     std::vector<Mat> features_pca;
@@ -268,26 +279,62 @@ namespace cv{
   }
 
   /*
-   * Main part of the KCF algorithm
+   * Main part of the KCF algorithm: the detection at the previous position of the target and
+   * the learning at the new one, each one with a kernel correlation
    */
   bool TrackerKCFImpl::updateImpl( const Mat& image, Rect2d& boundingBox ){
-    double minVal, maxVal;	// min-max response
-    Point minLoc,maxLoc;	// min-max location
+    kcf::Correlation detection, learning;
+    if(!beginUpdate(image, detection))
+      return false;
+    if(detection.kf)
+      correlate(detection);
+    if(!locate(boundingBox, learning))
+      return false;
+    correlate(learning);
+    endUpdate();
+    return true;
+  }
 
-    Mat img=image.clone();
+  bool TrackerKCFImpl::batchable() const {
+    // the batches do not wrap the kernel
+    return !params.wrap_kernel;
+  }
+
+  void TrackerKCFImpl::correlate(const kcf::Correlation& correlation){
+    //compute the gaussian kernel
+    denseGaussKernel(correlation.sigma,correlation.x,correlation.z.empty()?correlation.x:correlation.z,k,layers,vxf,vyf,xy_data,xyf_data);
+
+    // compute the fourier transform of the kernel
+    fft2(k,*correlation.kf);
+  }
+
+  /*
+   * Features of the detection
+   */
+  bool TrackerKCFImpl::beginUpdate( const Mat& image, kcf::Correlation& detection ){
+    if(!isInit || image.empty())
+      return false;
+
+    // the image is only read, it is not copied unless it is resized
+    img_Frame=image;
     // check the channels of the input image, grayscale is preferred
-    CV_Assert(img.channels() == 1 || img.channels() == 3);
+    CV_Assert(image.channels() == 1 || image.channels() == 3);
 
     // resize the image whenever needed
-    if(resizeImage)resize(img,img,Size(img.cols/2,img.rows/2));
+    if(resizeImage){
+      resize(image,img_Resized,Size(image.cols/2,image.rows/2));
+      img_Frame=img_Resized;
+    }
+    const Mat& img=img_Frame;
 
     // detection part
+    detection.kf=0;
     if(frame>0){
 
       // extract and pre-process the patch
       // get non compressed descriptors
       for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
-        if(!getSubWindow(img,roi, features_npca[i], img_Patch, descriptors_npca[i]))return false;
+        if(!getSubWindow(img,roi, features_npca[i], img_Patch, img_Gray, descriptors_npca[i]))return false;
       }
       //get non-compressed custom descriptors
       for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
@@ -297,7 +344,7 @@ namespace cv{
 
       // get compressed descriptors
       for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
-        if(!getSubWindow(img,roi, features_pca[i], img_Patch, descriptors_pca[i]))return false;
+        if(!getSubWindow(img,roi, features_pca[i], img_Patch, img_Gray, descriptors_pca[i]))return false;
       }
       //get compressed custom descriptors
       for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
@@ -307,30 +354,46 @@ namespace cv{
 
       //compress the features and the KRSL model
       if(params.desc_pca !=0){
-        compress(proj_mtx,X[0],X[0],data_temp,compress_data);
-        compress(proj_mtx,Z[0],Zc[0],data_temp,compress_data);
+        compress(proj_mtx,X[0],Xc[0],compress_data);
+        compress(proj_mtx,Z[0],Zc[0],compress_data);
+      }else{
+        Xc[0] = X[0];
+        Zc[0] = Z[0];
       }
 
-      // copy the compressed KRLS model
+      // copy the non-compressed features and KRLS model
+      Xc[1] = X[1];
       Zc[1] = Z[1];
 
       // merge all features
       if(features_npca.size()==0){
-        x = X[0];
+        x = Xc[0];
         z = Zc[0];
       }else if(features_pca.size()==0){
         x = X[1];
         z = Z[1];
       }else{
-        merge(X,2,x);
+        merge(Xc,2,x);
         merge(Zc,2,z);
       }
 
-      //compute the gaussian kernel
-      denseGaussKernel(params.sigma,x,z,k,layers,vxf,vyf,vxyf,xy_data,xyf_data);
+      detection.x=x;
+      detection.z=z;
+      detection.sigma=params.sigma;
+      detection.kf=&kf;
+    }
+    return true;
+  }
+
+  /*
+   * Location of the target from the kernel correlation of the detection, and features of the learning
+   */
+  bool TrackerKCFImpl::locate( Rect2d& boundingBox, kcf::Correlation& learning ){
+    double minVal, maxVal;	// min-max response
+    Point minLoc,maxLoc;	// min-max location
+    const Mat& img=img_Frame;
 
-      // compute the fourier transform of the kernel
-      fft2(k,kf);
+    if(frame>0){
       if(frame==1)spec2=Mat_<Vec2d >(kf.rows, kf.cols);
 
       // calculate filter response
@@ -358,7 +421,7 @@ namespace cv{
     // extract the patch for learning purpose
     // get non compressed descriptors
     for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
-      if(!getSubWindow(img,roi, features_npca[i], img_Patch, descriptors_npca[i]))return false;
+      if(!getSubWindow(img,roi, features_npca[i], img_Patch, img_Gray, descriptors_npca[i]))return false;
     }
     //get non-compressed custom descriptors
     for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
@@ -368,7 +431,7 @@ namespace cv{
 
     // get compressed descriptors
     for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
-      if(!getSubWindow(img,roi, features_pca[i], img_Patch, descriptors_pca[i]))return false;
+      if(!getSubWindow(img,roi, features_pca[i], img_Patch, img_Gray, descriptors_pca[i]))return false;
     }
     //get compressed custom descriptors
     for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
@@ -381,8 +444,8 @@ namespace cv{
       Z[0] = X[0].clone();
       Z[1] = X[1].clone();
     }else{
-      Z[0]=(1.0-params.interp_factor)*Z[0]+params.interp_factor*X[0];
-      Z[1]=(1.0-params.interp_factor)*Z[1]+params.interp_factor*X[1];
+      addWeighted(Z[0],1.0-params.interp_factor,X[0],params.interp_factor,0.0,Z[0]);
+      addWeighted(Z[1],1.0-params.interp_factor,X[1],params.interp_factor,0.0,Z[1]);
     }
 
     if(params.desc_pca !=0 || use_custom_extractor_pca){
@@ -394,32 +457,41 @@ namespace cv{
 
       // feature compression
       updateProjectionMatrix(Z[0],old_cov_mtx,proj_mtx,params.pca_learning_rate,params.compressed_size,layers_pca_data,average_data,data_pca, new_covar,w_data,u_data,vt_data);
-      compress(proj_mtx,X[0],X[0],data_temp,compress_data);
-    }
+      compress(proj_mtx,X[0],Xc[0],compress_data);
+    }else
+      Xc[0] = X[0];
+    Xc[1] = X[1];
 
     // merge all features
     if(features_npca.size()==0)
-      x = X[0];
+      x = Xc[0];
     else if(features_pca.size()==0)
       x = X[1];
     else
-      merge(X,2,x);
+      merge(Xc,2,x);
 
     // initialize some required Mat variables
     if(frame==0){
       layers.resize(x.channels());
       vxf.resize(x.channels());
       vyf.resize(x.channels());
-      vxyf.resize(vyf.size());
       new_alphaf=Mat_<Vec2d >(yf.rows, yf.cols);
     }
 
-    // Kernel Regularized Least-Squares, calculate alphas
-    denseGaussKernel(params.sigma,x,x,k,layers,vxf,vyf,vxyf,xy_data,xyf_data);
+    // Kernel Regularized Least-Squares, from the auto-correlation of x
+    learning.x=x;
+    learning.z=Mat();
+    learning.sigma=params.sigma;
+    learning.kf=&kf;
+    return true;
+  }
 
-    // compute the fourier transform of the kernel and add a small value
-    fft2(k,kf);
-    kf_lambda=kf+params.lambda;
+  /*
+   * Update of the model from the kernel correlation of the learning
+   */
+  void TrackerKCFImpl::endUpdate(){
+    // calculate alphas, adding a small value to the fourier transform of the kernel
+    add(kf,Scalar(params.lambda),kf_lambda);
 
     double den;
     if(params.split_coeff){
@@ -443,12 +515,12 @@ namespace cv{
       alphaf=new_alphaf.clone();
       if(params.split_coeff)alphaf_den=new_alphaf_den.clone();
     }else{
-      alphaf=(1.0-params.interp_factor)*alphaf+params.interp_factor*new_alphaf;
-      if(params.split_coeff)alphaf_den=(1.0-params.interp_factor)*alphaf_den+params.interp_factor*new_alphaf_den;
+      addWeighted(alphaf,1.0-params.interp_factor,new_alphaf,params.interp_factor,0.0,alphaf);
+      if(params.split_coeff)addWeighted(alphaf_den,1.0-params.interp_factor,new_alphaf_den,params.interp_factor,0.0,alphaf_den);
     }
 
+    img_Frame.release();
     frame++;
-    return true;
   }
 
 
@@ -517,21 +589,29 @@ namespace cv{
   }
 
   /*
-   * Point-wise multiplication of two Multichannel Mat data
+   * Sum over the channels of the point-wise products src1[i] * conj(src2[i]) of complex spectra,
+   * as mulSpectrums with conjB then the sum of the channels, in a single pass over the rows
    */
-  void inline TrackerKCFImpl::pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB) const {
-    for(unsigned i=0;i<src1.size();i++){
-      mulSpectrums(src1[i], src2[i], dest[i],flags,conjB);
-    }
-  }
-
-  /*
-   * Combines all channels in a multi-channels Mat data into a single channel
-   */
-  void inline TrackerKCFImpl::sumChannels(std::vector<Mat> src, Mat & dest) const {
-    dest=src[0].clone();
-    for(unsigned i=1;i<src.size();i++){
-      dest+=src[i];
+  void inline TrackerKCFImpl::sumConjProducts(const std::vector<Mat> & src1, const std::vector<Mat> & src2, Mat & dest) const {
+    dest.create(src1[0].size(), CV_64FC2);
+    const int n = dest.cols*2;
+    for(int i=0;i<dest.rows;i++){
+      double* d = dest.ptr<double>(i);
+      for(unsigned c=0;c<src1.size();c++){
+        const double* a = src1[c].ptr<double>(i);
+        const double* b = src2[c].ptr<double>(i);
+        if(c==0){
+          for(int j=0;j<n;j+=2){
+            d[j]=a[j]*b[j]+a[j+1]*b[j+1];
+            d[j+1]=a[j+1]*b[j]-a[j]*b[j+1];
+          }
+        }else{
+          for(int j=0;j<n;j+=2){
+            d[j]+=a[j]*b[j]+a[j+1]*b[j+1];
+            d[j+1]+=a[j+1]*b[j]-a[j]*b[j+1];
+          }
+        }
+      }
     }
   }
 
@@ -539,7 +619,7 @@ namespace cv{
    * obtains the projection matrix using PCA
    */
   void inline TrackerKCFImpl::updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix, double pca_rate, int compressed_sz,
-                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat vt) const {
+                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat & pca_data, Mat & new_cov, Mat & w, Mat & u, Mat & vt) const {
     CV_Assert(compressed_sz<=src.channels());
 
     split(src,layers_pca);
@@ -551,38 +631,42 @@ namespace cv{
 
     // calc covariance matrix
     merge(layers_pca,pca_data);
-    pca_data=pca_data.reshape(1,src.rows*src.cols);
+    Mat data=pca_data.reshape(1,src.rows*src.cols);
 
-    new_cov=1.0/(double)(src.rows*src.cols-1)*(pca_data.t()*pca_data);
+    gemm(data,data,1.0/(double)(src.rows*src.cols-1),noArray(),0.0,new_cov,GEMM_1_T);
     if(old_cov.rows==0)old_cov=new_cov.clone();
 
     // calc PCA
-    SVD::compute((1.0-pca_rate)*old_cov+pca_rate*new_cov, w, u, vt);
+    addWeighted(old_cov,1.0-pca_rate,new_cov,pca_rate,0.0,new_cov);
+    SVD::compute(new_cov, w, u, vt);
 
     // extract the projection matrix
-    proj_matrix=u(Rect(0,0,compressed_sz,src.channels())).clone();
-    Mat proj_vars=Mat::eye(compressed_sz,compressed_sz,proj_matrix.type());
-    for(int i=0;i<compressed_sz;i++){
-      proj_vars.at<double>(i,i)=w.at<double>(i);
+    Mat proj_u=u(Rect(0,0,compressed_sz,src.channels()));
+    proj_u.copyTo(proj_matrix);
+
+    // update the covariance matrix with proj_matrix*diag(w)*proj_matrix^t, scaling the columns of u in place
+    for(int i=0;i<proj_u.rows;i++){
+      double* ui=proj_u.ptr<double>(i);
+      for(int j=0;j<compressed_sz;j++)
+        ui[j]*=w.at<double>(j);
     }
-
-    // update the covariance matrix
-    old_cov=(1.0-pca_rate)*old_cov+pca_rate*proj_matrix*proj_vars*proj_matrix.t();
+    gemm(proj_u,proj_matrix,pca_rate,old_cov,1.0-pca_rate,new_cov,GEMM_2_T);
+    new_cov.copyTo(old_cov);
   }
 
   /*
    * compress the features
    */
-  void inline TrackerKCFImpl::compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const {
-    data=src.reshape(1,src.rows*src.cols);
-    compressed=data*proj_matrix;
-    dest=compressed.reshape(proj_matrix.cols,src.rows).clone();
+  void inline TrackerKCFImpl::compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & compressed) const {
+    Mat data=src.reshape(1,src.rows*src.cols);
+    gemm(data,proj_matrix,1.0,noArray(),0.0,compressed);
+    compressed.reshape(proj_matrix.cols,src.rows).copyTo(dest);
   }
 
   /*
    * obtain the patch and apply hann window filter to it
    */
-  bool TrackerKCFImpl::getSubWindow(const Mat img, const Rect _roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc) const {
+  bool TrackerKCFImpl::getSubWindow(const Mat img, const Rect _roi, Mat& feat, Mat& patch, Mat& gray, TrackerKCF::MODE desc) const {
 
     Rect region=_roi;
 
@@ -598,8 +682,6 @@ namespace cv{
     if(region.width>img.cols)region.width=img.cols;
     if(region.height>img.rows)region.height=img.rows;
 
-    patch=img(region).clone();
-
     // add some padding to compensate when the patch is outside image border
     int addTop,addBottom, addLeft, addRight;
     addTop=region.y-_roi.y;
@@ -607,7 +689,8 @@ namespace cv{
     addLeft=region.x-_roi.x;
     addRight=(_roi.width+_roi.x>img.cols?_roi.width+_roi.x-img.cols:0);
 
-    copyMakeBorder(patch,patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE);
+    // the patch has the size of the roi, hence it is only allocated once
+    copyMakeBorder(img(region),patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE|BORDER_ISOLATED);
     if(patch.rows==0 || patch.cols==0)return false;
 
     // extract the desired descriptors
@@ -615,16 +698,16 @@ namespace cv{
       case CN:
         CV_Assert(img.channels() == 3);
         extractCN(patch,feat);
-        feat=feat.mul(hann_cn); // hann window filter
+        multiply(feat,hann_cn,feat); // hann window filter
         break;
       default: // GRAY
-        if(img.channels()>1)
-          cvtColor(patch,feat, CV_BGR2GRAY);
-        else
-          feat=patch;
-        feat.convertTo(feat,CV_64F);
-        feat=feat/255.0-0.5; // normalize to range -0.5 .. 0.5
-        feat=feat.mul(hann); // hann window filter
+        // normalize to range -0.5 .. 0.5
+        if(img.channels()>1){
+          cvtColor(patch,gray, CV_BGR2GRAY);
+          gray.convertTo(feat,CV_64F,1.0/255.0,-0.5);
+        }else
+          patch.convertTo(feat,CV_64F,1.0/255.0,-0.5);
+        multiply(feat,hann,feat); // hann window filter
         break;
     }
 
@@ -667,63 +750,48 @@ namespace cv{
   /* Convert BGR to ColorNames
    */
   void TrackerKCFImpl::extractCN(Mat patch_data, Mat & cnFeatures) const {
-    Vec3b & pixel = patch_data.at<Vec3b>(0,0);
-    unsigned index;
-
-    if(cnFeatures.type() != CV_64FC(10))
-      cnFeatures = Mat::zeros(patch_data.rows,patch_data.cols,CV_64FC(10));
-
-    for(int i=0;i<patch_data.rows;i++){
-      for(int j=0;j<patch_data.cols;j++){
-        pixel=patch_data.at<Vec3b>(i,j);
-        index=(unsigned)(floor((float)pixel[2]/8)+32*floor((float)pixel[1]/8)+32*32*floor((float)pixel[0]/8));
-
-        //copy the values
-        for(int _k=0;_k<10;_k++){
-          cnFeatures.at<Vec<double,10> >(i,j)[_k]=ColorNames[index][_k];
-        }
-      }
-    }
-
+    tracking::extractColorNames(patch_data,cnFeatures);
   }
 
   /*
    *  dense gauss kernel function
    */
   void TrackerKCFImpl::denseGaussKernel(const double sigma, const Mat x_data, const Mat y_data, Mat & k_data,
-                                        std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> xyf_v, Mat xy, Mat xyf ) const {
+                                        std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, Mat & xy, Mat & xyf ) const {
     double normX, normY;
 
+    // the auto-correlation only needs the transform of x
+    const bool autoCorrelation = x_data.data == y_data.data;
     fft2(x_data,xf_data,layers_data);
-    fft2(y_data,yf_data,layers_data);
+    if(!autoCorrelation)
+      fft2(y_data,yf_data,layers_data);
 
     normX=norm(x_data);
     normX*=normX;
-    normY=norm(y_data);
-    normY*=normY;
+    normY=autoCorrelation?normX:norm(y_data);
+    if(!autoCorrelation)
+      normY*=normY;
 
-    pixelWiseMult(xf_data,yf_data,xyf_v,0,true);
-    sumChannels(xyf_v,xyf);
-    ifft2(xyf,xyf);
+    sumConjProducts(xf_data,autoCorrelation?xf_data:yf_data,xyf);
+    ifft2(xyf,xy);
 
     if(params.wrap_kernel){
-      shiftRows(xyf, x_data.rows/2);
-      shiftCols(xyf, x_data.cols/2);
+      shiftRows(xy, x_data.rows/2);
+      shiftCols(xy, x_data.cols/2);
     }
 
-    //(xx + yy - 2 * xy) / numel(x)
-    xy=(normX+normY-2*xyf)/(x_data.rows*x_data.cols*x_data.channels());
-
+    // -max(0, (xx + yy - 2 * xy) / numel(x)) / sigma^2, in place
     // TODO: check wether we really need thresholding or not
-    //threshold(xy,xy,0.0,0.0,THRESH_TOZERO);//max(0, (xx + yy - 2 * xy) / numel(x))
+    const double numel=(double)(x_data.rows*x_data.cols*x_data.channels());
+    const double alpha=-2.0/numel, beta=(normX+normY)/numel;
+    const double sig=-1.0/(sigma*sigma);
     for(int i=0;i<xy.rows;i++){
+      double* xyData=xy.ptr<double>(i);
       for(int j=0;j<xy.cols;j++){
-        if(xy.at<double>(i,j)<0.0)xy.at<double>(i,j)=0.0;
+        double v=xyData[j]*alpha+beta;
+        xyData[j]=sig*(v<0.0?0.0:v);
       }
     }
-
-    double sig=-1.0/(sigma*sigma);
-    xy=sig*xy;
     exp(xy,k_data);
 
   }
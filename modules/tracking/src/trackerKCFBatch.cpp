@@ -0,0 +1,286 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "trackerKCFBatch.hpp"
+
+namespace cv
+{
+namespace kcf
+{
+
+/*
+ * The 2D FFT of the real h x w planes stacked in a matrix is done as:
+ * - the FFT of all the rows, in the CCS packed format,
+ * - the transposition of the half spectra (the w/2 + 1 first frequencies, the others are their conjugates),
+ * - the FFT of the rows of the transpositions, that is of the columns of the half spectra.
+ * A plane is then represented by a (w/2 + 1) x h complex block, transposed with respect to the output of dft.
+ */
+
+// unpacks the CCS rows of the plane p into its transposed half spectrum
+static void unpackPlane(const Mat& ccs, int p, int h, Mat& spec)
+{
+    const int w = ccs.cols, hw = w/2 + 1;
+    Vec2d* S = spec.ptr<Vec2d>(p*hw);
+    for( int r = 0; r < h; r++ )
+    {
+        const double* src = ccs.ptr<double>(p*h + r);
+        S[r] = Vec2d(src[0], 0.0);
+        int j = 1;
+        for( ; j*2 < w; j++ )
+            S[(size_t)j*h + r] = Vec2d(src[j*2 - 1], src[j*2]);
+        if( j*2 == w )
+            S[(size_t)j*h + r] = Vec2d(src[w - 1], 0.0);
+    }
+}
+
+// packs the transposed half spectrum of the plane p into CCS rows
+static void packPlane(const Mat& spec, int p, int w, Mat& ccs)
+{
+    const int h = spec.cols, hw = w/2 + 1;
+    const Vec2d* S = spec.ptr<Vec2d>(p*hw);
+    for( int r = 0; r < h; r++ )
+    {
+        double* dst = ccs.ptr<double>(p*h + r);
+        dst[0] = S[r][0];
+        int j = 1;
+        for( ; j*2 < w; j++ )
+        {
+            const Vec2d& s = S[(size_t)j*h + r];
+            dst[j*2 - 1] = s[0];
+            dst[j*2] = s[1];
+        }
+        if( j*2 == w )
+            dst[w - 1] = S[(size_t)j*h + r][0];
+    }
+}
+
+// copies the channels of src into consecutive planes
+static void splitPlanes(const Mat& src, int first, Mat& planes)
+{
+    const int cn = src.channels(), h = src.rows, w = src.cols;
+    for( int r = 0; r < h; r++ )
+    {
+        const double* s = src.ptr<double>(r);
+        for( int c = 0; c < cn; c++ )
+        {
+            double* d = planes.ptr<double>((first + c)*h + r);
+            for( int j = 0; j < w; j++ )
+                d[j] = s[j*cn + c];
+        }
+    }
+}
+
+struct Batch
+{
+    std::vector<Correlation*> jobs;
+    // first plane of x and z of each job, z being x in the auto-correlations
+    std::vector<int> xPlanes, zPlanes;
+    int h, w;
+    // views of the first rows of the buffers, which are kept between the calls
+    Mat planes, ccs, spec, sums, kernels;
+    Mat planesBuf, ccsBuf, specBuf, sumsBuf, kernelsBuf;
+};
+
+// the first rows of buf, which is only reallocated to grow: the detections have twice
+// as many planes as the learnings, so the batches of a frame alternate between two sizes
+static Mat reserveRows(Mat& buf, int rows, int cols, int type)
+{
+    if( buf.rows < rows || buf.cols != cols || buf.type() != type )
+        buf.create(buf.cols == cols && buf.type() == type ? std::max(rows, buf.rows) : rows, cols, type);
+    return buf.rowRange(0, rows);
+}
+
+class BatchInvoker : public ParallelLoopBody
+{
+public:
+    enum { SPLIT_PLANES, UNPACK_PLANES, SUM_PRODUCTS, PACK_SUMS, GAUSSIAN_KERNELS, UNPACK_KERNELS, EXPAND_SPECTRA };
+
+    BatchInvoker(Batch& _batch, int _stage) : batch(_batch), stage(_stage) {}
+
+    void operator()(const Range& range) const
+    {
+        for( int i = range.start; i < range.end; i++ )
+        {
+            switch( stage )
+            {
+            case SPLIT_PLANES:
+                splitPlanes(batch.jobs[i]->x, batch.xPlanes[i], batch.planes);
+                if( !batch.jobs[i]->z.empty() )
+                    splitPlanes(batch.jobs[i]->z, batch.zPlanes[i], batch.planes);
+                break;
+            case UNPACK_PLANES: // i is a plane
+                unpackPlane(batch.ccs, i, batch.h, batch.spec);
+                break;
+            case SUM_PRODUCTS:
+                sumProducts(i);
+                break;
+            case PACK_SUMS:
+                packPlane(batch.sums, i, batch.w, batch.ccs);
+                break;
+            case GAUSSIAN_KERNELS:
+                gaussianKernel(i);
+                break;
+            case UNPACK_KERNELS:
+                unpackPlane(batch.ccs, i, batch.h, batch.sums);
+                break;
+            case EXPAND_SPECTRA:
+                expandSpectrum(i);
+                break;
+            }
+        }
+    }
+
+private:
+    // sum over the channels of fft2(x_c) .* conj(fft2(z_c))
+    void sumProducts(int i) const
+    {
+        const int hw = batch.w/2 + 1, n = hw*batch.h*2;
+        const int cn = batch.jobs[i]->x.channels();
+        double* d = batch.sums.ptr<double>(i*hw);
+        for( int c = 0; c < cn; c++ )
+        {
+            const double* a = batch.spec.ptr<double>((batch.xPlanes[i] + c)*hw);
+            const double* b = batch.spec.ptr<double>((batch.zPlanes[i] + c)*hw);
+            if( c == 0 )
+            {
+                for( int j = 0; j < n; j += 2 )
+                {
+                    d[j] = a[j]*b[j] + a[j + 1]*b[j + 1];
+                    d[j + 1] = a[j + 1]*b[j] - a[j]*b[j + 1];
+                }
+            }
+            else
+            {
+                for( int j = 0; j < n; j += 2 )
+                {
+                    d[j] += a[j]*b[j] + a[j + 1]*b[j + 1];
+                    d[j + 1] += a[j + 1]*b[j] - a[j]*b[j + 1];
+                }
+            }
+        }
+    }
+
+    void gaussianKernel(int i) const
+    {
+        const Correlation& c = *batch.jobs[i];
+        const int h = batch.h, w = batch.w;
+        double normX = norm(c.x), normZ = c.z.empty() ? normX : norm(c.z);
+        normX *= normX;
+        normZ *= normZ;
+        // the inverse transforms are not scaled
+        const double numel = (double)h*w*c.x.channels();
+        const double alpha = -2.0/(numel*h*w), beta = (normX + normZ)/numel;
+        const double sig = -1.0/(c.sigma*c.sigma);
+        Mat k = batch.kernels.rowRange(i*h, (i + 1)*h);
+        for( int r = 0; r < h; r++ )
+        {
+            double* p = k.ptr<double>(r);
+            for( int j = 0; j < w; j++ )
+            {
+                const double v = p[j]*alpha + beta;
+                p[j] = sig*(v > 0 ? v : 0);
+            }
+        }
+        exp(k, k);
+    }
+
+    // the full spectrum from the half one, using the conjugate symmetry of the spectra of real planes
+    void expandSpectrum(int i) const
+    {
+        const int h = batch.h, w = batch.w, hw = w/2 + 1;
+        Mat& kf = *batch.jobs[i]->kf;
+        kf.create(h, w, CV_64FC2);
+        const Vec2d* T = batch.sums.ptr<Vec2d>(i*hw);
+        for( int u = 0; u < h; u++ )
+        {
+            Vec2d* K = kf.ptr<Vec2d>(u);
+            const int v = u > 0 ? h - u : 0;
+            for( int j = 0; j < hw; j++ )
+                K[j] = T[(size_t)j*h + u];
+            for( int j = hw; j < w; j++ )
+            {
+                const Vec2d& t = T[(size_t)(w - j)*h + v];
+                K[j] = Vec2d(t[0], -t[1]);
+            }
+        }
+    }
+
+    Batch& batch;
+    int stage;
+
+    BatchInvoker& operator=(const BatchInvoker&);
+};
+
+static void runBatch(Batch& batch)
+{
+    const int njobs = (int)batch.jobs.size(), h = batch.h, w = batch.w, hw = w/2 + 1;
+
+    int nplanes = 0;
+    batch.xPlanes.resize(njobs);
+    batch.zPlanes.resize(njobs);
+    for( int i = 0; i < njobs; i++ )
+    {
+        const Correlation& c = *batch.jobs[i];
+        CV_Assert( c.x.depth() == CV_64F && c.kf );
+        CV_Assert( c.z.empty() || (c.z.size() == c.x.size() && c.z.type() == c.x.type()) );
+        batch.xPlanes[i] = nplanes;
+        nplanes += c.x.channels();
+        batch.zPlanes[i] = c.z.empty() ? batch.xPlanes[i] : nplanes;
+        if( !c.z.empty() )
+            nplanes += c.z.channels();
+    }
+
+    // 2D FFT of all the planes
+    batch.planes = reserveRows(batch.planesBuf, nplanes*h, w, CV_64F);
+    parallel_for_(Range(0, njobs), BatchInvoker(batch, BatchInvoker::SPLIT_PLANES));
+    batch.ccs = reserveRows(batch.ccsBuf, nplanes*h, w, CV_64F);
+    dft(batch.planes, batch.ccs, DFT_ROWS);
+    batch.spec = reserveRows(batch.specBuf, nplanes*hw, h, CV_64FC2);
+    parallel_for_(Range(0, nplanes), BatchInvoker(batch, BatchInvoker::UNPACK_PLANES));
+    dft(batch.spec, batch.spec, DFT_ROWS);
+
+    // cross-correlations, back to the spatial domain
+    batch.sums = reserveRows(batch.sumsBuf, njobs*hw, h, CV_64FC2);
+    parallel_for_(Range(0, njobs), BatchInvoker(batch, BatchInvoker::SUM_PRODUCTS));
+    dft(batch.sums, batch.sums, DFT_ROWS | DFT_INVERSE);
+    batch.ccs = reserveRows(batch.ccsBuf, njobs*h, w, CV_64F);
+    parallel_for_(Range(0, njobs), BatchInvoker(batch, BatchInvoker::PACK_SUMS));
+    batch.kernels = reserveRows(batch.kernelsBuf, njobs*h, w, CV_64F);
+    dft(batch.ccs, batch.kernels, DFT_ROWS | DFT_INVERSE | DFT_REAL_OUTPUT);
+
+    // gaussian kernels and their 2D FFT
+    parallel_for_(Range(0, njobs), BatchInvoker(batch, BatchInvoker::GAUSSIAN_KERNELS));
+    dft(batch.kernels, batch.ccs, DFT_ROWS);
+    parallel_for_(Range(0, njobs), BatchInvoker(batch, BatchInvoker::UNPACK_KERNELS));
+    dft(batch.sums, batch.sums, DFT_ROWS);
+    parallel_for_(Range(0, njobs), BatchInvoker(batch, BatchInvoker::EXPAND_SPECTRA));
+}
+
+Batch& BatchWorkspace::batch(int h, int w)
+{
+    Ptr<Batch>& b = batches[std::make_pair(h, w)];
+    if( !b )
+        b = makePtr<Batch>();
+    return *b;
+}
+
+void batchCorrelations(const std::vector<Correlation*>& correlations, BatchWorkspace& workspace)
+{
+    // the targets with the same window size
+    std::map<std::pair<int, int>, std::vector<Correlation*> > groups;
+    for( size_t i = 0; i < correlations.size(); i++ )
+        groups[std::make_pair(correlations[i]->x.rows, correlations[i]->x.cols)].push_back(correlations[i]);
+
+    for( std::map<std::pair<int, int>, std::vector<Correlation*> >::iterator it = groups.begin(); it != groups.end(); ++it )
+    {
+        Batch& batch = workspace.batch(it->first.first, it->first.second);
+        batch.jobs = it->second;
+        batch.h = it->first.first;
+        batch.w = it->first.second;
+        runBatch(batch);
+    }
+}
+
+} /* namespace kcf */
+} /* namespace cv */
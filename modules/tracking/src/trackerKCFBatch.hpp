@@ -0,0 +1,82 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#ifndef OPENCV_TRACKER_KCF_BATCH
+#define OPENCV_TRACKER_KCF_BATCH
+
+#include "precomp.hpp"
+#include <map>
+#include <vector>
+
+namespace cv
+{
+namespace kcf
+{
+
+/*
+ * Gaussian kernel correlation of the features x and z of a KCF target (z is x when it is empty):
+ * kf = fft2(exp(-max(0, (|x|^2 + |z|^2 - 2 * ifft2(sum_c fft2(x_c) .* conj(fft2(z_c)))) / numel(x)) / sigma^2))
+ * x and z are CV_64F matrices with the same size and number of channels, kf is CV_64FC2.
+ */
+struct Correlation
+{
+    Correlation() : sigma(0), kf(0) {}
+    Mat x, z;
+    double sigma;
+    Mat* kf;
+};
+
+struct Batch;
+
+/*
+ * The buffers of the batched correlations for each window size, kept by the caller between the frames.
+ * A KCF target keeps its window size, so there are at most as many entries as window sizes tracked.
+ */
+class BatchWorkspace
+{
+public:
+    Batch& batch(int h, int w);
+
+private:
+    std::map<std::pair<int, int>, Ptr<Batch> > batches;
+};
+
+/*
+ * Computes the correlations of many targets. The targets with the same window size are processed together:
+ * their 2D FFTs are done as a few row transforms of stacked planes, with only the half spectra of the real
+ * planes being transformed along the columns.
+ */
+void batchCorrelations(const std::vector<Correlation*>& correlations, BatchWorkspace& workspace);
+
+/*
+ * The update of TrackerKCF in steps, the kernel correlations being computed in between by the caller.
+ * MultiTracker runs the steps of all its KCF targets in lockstep and computes their correlations in batches.
+ */
+class TrackerKCFSteps
+{
+public:
+    virtual ~TrackerKCFSteps() {}
+
+    // false if the correlations of the tracker must be computed by the tracker itself
+    virtual bool batchable() const = 0;
+
+    // extracts the features of the detection, detection.kf is null on the first frame where there is none;
+    // returns false if the tracker cannot be updated
+    virtual bool beginUpdate(const Mat& image, Correlation& detection) = 0;
+
+    // locates the target from the correlation of the detection and extracts the features of the learning;
+    // returns false if the target is lost
+    virtual bool locate(Rect2d& boundingBox, Correlation& learning) = 0;
+
+    // updates the model from the correlation of the learning
+    virtual void endUpdate() = 0;
+
+    // the buffers of the batches of MultiTracker, which runs them in the workspace of its first KCF tracker
+    BatchWorkspace workspace;
+};
+
+} /* namespace kcf */
+} /* namespace cv */
+
+#endif
@@ -42,6 +42,7 @@
 #include "precomp.hpp"
 #include "opencv2/video/tracking.hpp"
 #include "opencv2/imgproc.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <algorithm>
 #include <limits.h>
 
@@ -68,7 +69,6 @@ using namespace cv;
  *
  * FIXME:
  * when patch is cut from image to compute NCC, there can be problem with size
- * optimize (allocation<-->reallocation)
  */
 
 class TrackerMedianFlowImpl : public TrackerMedianFlow{
@@ -79,7 +79,7 @@ public:
 private:
     bool initImpl( const Mat& image, const Rect2d& boundingBox );
     bool updateImpl( const Mat& image, Rect2d& boundingBox );
-    bool medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& oldBox);
+    bool medianFlowImpl(const Mat& newImage,Rect2d& oldBox);
     Rect2d vote(const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,const Rect2d& oldRect,Point2f& mD);
     float dist(Point2f p1,Point2f p2);
     std::string type2str(int type);
@@ -90,6 +90,10 @@ private:
                    const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status);
 
     TrackerMedianFlow::Params params;
+
+    // gray image and pyramid of the previous frame, which are those of the current frame once it is tracked
+    Mat prevImage_gray, nextImage_gray;
+    std::vector<Mat> prevImagePyr, nextImagePyr;
 };
 
 template<typename T>
@@ -125,11 +129,8 @@ public:
     TrackerMedianFlowModel(TrackerMedianFlow::Params /*params*/){}
     Rect2d getBoundingBox(){return boundingBox_;}
     void setBoudingBox(Rect2d boundingBox){boundingBox_=boundingBox;}
-    Mat getImage(){return image_;}
-    void setImage(const Mat& image){image.copyTo(image_);}
 protected:
     Rect2d boundingBox_;
-    Mat image_;
     void modelEstimationImpl( const std::vector<Mat>& /*responses*/ ){}
     void modelUpdateImpl(){}
 };
@@ -146,20 +147,24 @@ void TrackerMedianFlowImpl::write( cv::FileStorage& fs ) const
 
 bool TrackerMedianFlowImpl::initImpl( const Mat& image, const Rect2d& boundingBox ){
     model=Ptr<TrackerMedianFlowModel>(new TrackerMedianFlowModel(params));
-    ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image);
+    if (image.channels() != 1)
+        cvtColor( image, prevImage_gray, COLOR_BGR2GRAY );
+    else
+        image.copyTo(prevImage_gray);
+    buildOpticalFlowPyramid(prevImage_gray, prevImagePyr, params.winSize, params.maxLevel, false);
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setBoudingBox(boundingBox);
     return true;
 }
 
 bool TrackerMedianFlowImpl::updateImpl( const Mat& image, Rect2d& boundingBox ){
-    Mat oldImage=((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->getImage();
-
     Rect2d oldBox=((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->getBoundingBox();
-    if(!medianFlowImpl(oldImage,image,oldBox)){
+    if(!medianFlowImpl(image,oldBox)){
         return false;
     }
     boundingBox=oldBox;
-    ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image);
+    // the pyramid of this frame is the previous one of the next frame, the old buffers are reused for the next frame
+    std::swap(prevImage_gray, nextImage_gray);
+    std::swap(prevImagePyr, nextImagePyr);
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setBoudingBox(oldBox);
     return true;
 }
@@ -197,15 +202,12 @@ size_t filterPointsInVectors(std::vector<T>& status, std::vector<Point2f>& vec1,
     return first_bad_idx;
 }
 
-bool TrackerMedianFlowImpl::medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& oldBox){
+bool TrackerMedianFlowImpl::medianFlowImpl(const Mat& newImage,Rect2d& oldBox){
     std::vector<Point2f> pointsToTrackOld,pointsToTrackNew;
 
-    Mat oldImage_gray,newImage_gray;
-    if (oldImage.channels() != 1)
-        cvtColor( oldImage, oldImage_gray, COLOR_BGR2GRAY );
-    else
-        oldImage.copyTo(oldImage_gray);
-
+    // the gray image and the pyramid of the old frame are kept from the previous update
+    const Mat& oldImage_gray=prevImage_gray;
+    Mat& newImage_gray=nextImage_gray;
     if (newImage.channels() != 1)
         cvtColor( newImage, newImage_gray, COLOR_BGR2GRAY );
     else
@@ -223,10 +225,8 @@ bool TrackerMedianFlowImpl::medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& old
     std::vector<uchar> status(pointsToTrackOld.size());
     std::vector<float> errors(pointsToTrackOld.size());
 
-    std::vector<Mat> oldImagePyr;
-    buildOpticalFlowPyramid(oldImage_gray, oldImagePyr, params.winSize, params.maxLevel, false);
-
-    std::vector<Mat> newImagePyr;
+    const std::vector<Mat>& oldImagePyr=prevImagePyr;
+    std::vector<Mat>& newImagePyr=nextImagePyr;
     buildOpticalFlowPyramid(newImage_gray, newImagePyr, params.winSize, params.maxLevel, false);
 
     calcOpticalFlowPyrLK(oldImagePyr,newImagePyr,pointsToTrackOld,pointsToTrackNew,status,errors,
@@ -376,25 +376,92 @@ void TrackerMedianFlowImpl::check_FB(const std::vector<Mat>& oldImagePyr, const
         status[i]=status[i] && (FBerror[i] <= FBerrorMedian);
     }
 }
+// sums, sums of squares and dot product of two rows of n pixels
+static void addPatchSums(const uchar* p1, const uchar* p2, int n, int& s1, int& s2, int& n1, int& n2, int& prod)
+{
+    int j = 0;
+#if CV_SIMD128
+    const v_int16x8 one = v_setall_s16(1);
+    v_int32x4 vs1 = v_setzero_s32(), vs2 = v_setzero_s32(), vn1 = v_setzero_s32(), vn2 = v_setzero_s32(), vprod = v_setzero_s32();
+    for( ; j <= n - 16; j += 16 )
+    {
+        v_uint16x8 a0, a1, b0, b1;
+        v_expand(v_load(p1 + j), a0, a1);
+        v_expand(v_load(p2 + j), b0, b1);
+        v_int16x8 x0 = v_reinterpret_as_s16(a0), x1 = v_reinterpret_as_s16(a1);
+        v_int16x8 y0 = v_reinterpret_as_s16(b0), y1 = v_reinterpret_as_s16(b1);
+        vs1 += v_dotprod(x0, one) + v_dotprod(x1, one);
+        vs2 += v_dotprod(y0, one) + v_dotprod(y1, one);
+        vn1 += v_dotprod(x0, x0) + v_dotprod(x1, x1);
+        vn2 += v_dotprod(y0, y0) + v_dotprod(y1, y1);
+        vprod += v_dotprod(x0, y0) + v_dotprod(x1, y1);
+    }
+    s1 += v_reduce_sum(vs1);
+    s2 += v_reduce_sum(vs2);
+    n1 += v_reduce_sum(vn1);
+    n2 += v_reduce_sum(vn2);
+    prod += v_reduce_sum(vprod);
+#endif
+    for( ; j < n; j++ )
+    {
+        int a = p1[j], b = p2[j];
+        s1 += a; s2 += b;
+        n1 += a * a; n2 += b * b;
+        prod += a * b;
+    }
+}
+
+// NCC of the patches around the tracked points, the points being split between the threads
+class MedianFlowNCCInvoker : public ParallelLoopBody
+{
+public:
+    MedianFlowNCCInvoker(const Mat& _oldImage, const Mat& _newImage, const std::vector<Point2f>& _oldPoints,
+                         const std::vector<Point2f>& _newPoints, Size _winSizeNCC, std::vector<float>& _NCC)
+        : oldImage(_oldImage), newImage(_newImage), oldPoints(_oldPoints), newPoints(_newPoints),
+          winSizeNCC(_winSizeNCC), NCC(_NCC) {}
+
+    void operator()(const Range& range) const
+    {
+        const int patch_area=winSizeNCC.area();
+        for (int i = range.start; i < range.end; i++) {
+            // the patches are views of the images, unless they cross their borders
+            Mat p1 = getPatch(oldImage, winSizeNCC, oldPoints[i]);
+            Mat p2 = getPatch(newImage, winSizeNCC, newPoints[i]);
+            CV_Assert(p1.type() == CV_8UC1 && p2.type() == CV_8UC1);
+
+            // the sums of a row fit in int, those of the patch are accumulated in double
+            double s1=0,s2=0,n1=0,n2=0,prod=0;
+            for (int y = 0; y < winSizeNCC.height; y++) {
+                int rs1=0,rs2=0,rn1=0,rn2=0,rprod=0;
+                addPatchSums(p1.ptr<uchar>(y), p2.ptr<uchar>(y), winSizeNCC.width, rs1, rs2, rn1, rn2, rprod);
+                s1+=rs1; s2+=rs2; n1+=rn1; n2+=rn2; prod+=rprod;
+            }
+
+            double sq1=sqrt(std::max(0.0,n1-s1*s1/patch_area)),sq2=sqrt(std::max(0.0,n2-s2*s2/patch_area));
+            double ares=(sq2==0)?sq1/abs(sq1):(prod-s1*s2/patch_area)/sq1/sq2;
+
+            NCC[i] = (float)ares;
+        }
+    }
+
+private:
+    const Mat& oldImage;
+    const Mat& newImage;
+    const std::vector<Point2f>& oldPoints;
+    const std::vector<Point2f>& newPoints;
+    Size winSizeNCC;
+    std::vector<float>& NCC;
+
+    MedianFlowNCCInvoker& operator=(const MedianFlowNCCInvoker&);
+};
+
 void TrackerMedianFlowImpl::check_NCC(const Mat& oldImage,const Mat& newImage,
                                       const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status){
 
     std::vector<float> NCC(oldPoints.size(),0.0);
-    Mat p1,p2;
+    parallel_for_(Range(0, (int)oldPoints.size()),
+                  MedianFlowNCCInvoker(oldImage, newImage, oldPoints, newPoints, params.winSizeNCC, NCC));
 
-    for (size_t i = 0; i < oldPoints.size(); i++) {
-        p1 = getPatch(oldImage, params.winSizeNCC, oldPoints[i]);
-        p2 = getPatch(newImage, params.winSizeNCC, newPoints[i]);
-
-        const int patch_area=params.winSizeNCC.area();
-        double s1=sum(p1)(0),s2=sum(p2)(0);
-        double n1=norm(p1),n2=norm(p2);
-        double prod=p1.dot(p2);
-        double sq1=sqrt(n1*n1-s1*s1/patch_area),sq2=sqrt(n2*n2-s2*s2/patch_area);
-        double ares=(sq2==0)?sq1/abs(sq1):(prod-s1*s2/patch_area)/sq1/sq2;
-
-        NCC[i] = (float)ares;
-    }
     float median = getMedian(NCC);
     for(size_t i = 0; i < oldPoints.size(); i++) {
         status[i] = status[i] && (NCC[i] >= median);
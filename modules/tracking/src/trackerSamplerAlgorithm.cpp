@@ -186,24 +186,22 @@ std::vector<Mat> TrackerSamplerCSC::sampleImage( const Mat& img, int x, int y, i
 
   //fprintf(stderr,"inrad=%f minrow=%d maxrow=%d mincol=%d maxcol=%d\n",inrad,minrow,maxrow,mincol,maxcol);
 
-  std::vector<Mat> samples;
-  samples.resize( ( maxrow - minrow + 1 ) * ( maxcol - mincol + 1 ) );
-  int i = 0;
+  // the origins of the samples are selected first, the views of the image are only made for the kept ones
+  std::vector<Point> origins;
 
-  float prob = ( (float) ( maxnum ) ) / samples.size();
+  float prob = ( (float) ( maxnum ) ) / ( ( maxrow - minrow + 1 ) * ( maxcol - mincol + 1 ) );
 
   for ( int r = minrow; r <= int( maxrow ); r++ )
     for ( int c = mincol; c <= int( maxcol ); c++ )
     {
       dist = ( y - r ) * ( y - r ) + ( x - c ) * ( x - c );
       if( float( rng.uniform( 0.f, 1.f ) ) < prob && dist < inradsq && dist >= outradsq )
-      {
-        samples[i] = img( Rect( c, r, w, h ) );
-        i++;
-      }
+        origins.push_back( Point( c, r ) );
     }
 
-  samples.resize( min( i, maxnum ) );
+  std::vector<Mat> samples( min( (int) origins.size(), maxnum ) );
+  for ( size_t i = 0; i < samples.size(); i++ )
+    samples[i] = img( Rect( origins[i], Size( w, h ) ) );
   return samples;
 }
 ;
@@ -0,0 +1,487 @@
+// This file is part of OpenCV project.
+// It is subject to the license terms in the LICENSE file found in the top-level directory
+// of this distribution and at http://opencv.org/license.html.
+
+#include "precomp.hpp"
+#include "opencv2/tracking/kalman_filters.hpp"
+
+namespace cv
+{
+namespace tracking
+{
+
+void UkfSystemModel::batchStateConversionFunction( const Mat& X_k, const Mat& U_k, Mat& X_kplus1 )
+{
+    Mat v = Mat::zeros( X_k.rows, 1, X_k.type() );
+    Mat x_kplus1;
+    for ( int i = 0; i < X_k.cols; i++ )
+    {
+        x_kplus1 = X_kplus1.col( i );
+        stateConversionFunction( X_k.col( i ), U_k.empty() ? U_k : U_k.col( i ), v, x_kplus1 );
+    }
+}
+
+void UkfSystemModel::batchMeasurementFunction( const Mat& X_k, Mat& Z_k )
+{
+    Mat n = Mat::zeros( Z_k.rows, 1, Z_k.type() );
+    Mat z_k;
+    for ( int i = 0; i < X_k.cols; i++ )
+    {
+        z_k = Z_k.col( i );
+        measurementFunction( X_k.col( i ), n, z_k );
+    }
+}
+
+/*
+ * The kernels below process the filters of a range, a matrix of size n x m of all the filters being stored in n*m
+ * rows with one column per filter: the loops over the filters are on contiguous memory and are vectorized.
+ */
+
+// Cholesky decompositions A = L*Lt of n x n matrices, only the lower triangles are used
+template<typename T>
+static void choleskyDecompositions( const Mat& A, Mat& L, int n, const Range& range )
+{
+    const int len = range.end - range.start;
+    for ( int i = 0; i < n; i++ )
+        for ( int j = 0; j <= i; j++ )
+        {
+            const T* a = A.ptr<T>( i*n + j ) + range.start;
+            T* l = L.ptr<T>( i*n + j ) + range.start;
+            for ( int f = 0; f < len; f++ )
+                l[f] = a[f];
+            for ( int k = 0; k < j; k++ )
+            {
+                const T* lik = L.ptr<T>( i*n + k ) + range.start;
+                const T* ljk = L.ptr<T>( j*n + k ) + range.start;
+                for ( int f = 0; f < len; f++ )
+                    l[f] -= lik[f]*ljk[f];
+            }
+            if ( i == j )
+            {
+                for ( int f = 0; f < len; f++ )
+                    l[f] = std::sqrt( l[f] );
+            }
+            else
+            {
+                const T* ljj = L.ptr<T>( j*n + j ) + range.start;
+                for ( int f = 0; f < len; f++ )
+                    l[f] /= ljj[f];
+            }
+        }
+}
+
+// mean = SUM_i( W[i]*F_i ), center_i = F_i - mean, the values at the i-th sigma points of the N filters being
+// the columns i*N..(i+1)*N-1 of F
+template<typename T>
+static void weightedMeans( const Mat& F, const std::vector<T>& W, int N, Mat& mean, Mat& center, const Range& range )
+{
+    const int len = range.end - range.start;
+    for ( int d = 0; d < F.rows; d++ )
+    {
+        T* m = mean.ptr<T>( d ) + range.start;
+        for ( int f = 0; f < len; f++ )
+            m[f] = 0;
+        for ( size_t i = 0; i < W.size(); i++ )
+        {
+            const T* v = F.ptr<T>( d ) + i*N + range.start;
+            const T w = W[i];
+            for ( int f = 0; f < len; f++ )
+                m[f] += w*v[f];
+        }
+        for ( size_t i = 0; i < W.size(); i++ )
+        {
+            const T* v = F.ptr<T>( d ) + i*N + range.start;
+            T* c = center.ptr<T>( d ) + i*N + range.start;
+            for ( int f = 0; f < len; f++ )
+                c[f] = v[f] - m[f];
+        }
+    }
+}
+
+// cov(a, b) = SUM_i( W[i]*A_i(a)*B_i(b) ) + noise(a, b), computed for b <= a only when A and B are the same
+template<typename T>
+static void weightedCovariances( const Mat& A, const Mat& B, const std::vector<T>& W, int N, const Mat& noise,
+                                 Mat& cov, const Range& range )
+{
+    const int len = range.end - range.start;
+    const bool symmetric = A.data == B.data;
+    for ( int a = 0; a < A.rows; a++ )
+        for ( int b = 0; b < ( symmetric ? a + 1 : B.rows ); b++ )
+        {
+            T* c = cov.ptr<T>( a*B.rows + b ) + range.start;
+            const T n = noise.empty() ? T( 0 ) : noise.at<T>( a, b );
+            for ( int f = 0; f < len; f++ )
+                c[f] = 0;
+            for ( size_t i = 0; i < W.size(); i++ )
+            {
+                const T* x = A.ptr<T>( a ) + i*N + range.start;
+                const T* y = B.ptr<T>( b ) + i*N + range.start;
+                const T w = W[i];
+                for ( int f = 0; f < len; f++ )
+                    c[f] += w*x[f]*y[f];
+            }
+            for ( int f = 0; f < len; f++ )
+                c[f] += n;
+            if ( symmetric && b < a )
+            {
+                T* ct = cov.ptr<T>( b*B.rows + a ) + range.start;
+                for ( int f = 0; f < len; f++ )
+                    ct[f] = c[f];
+            }
+        }
+}
+
+template<typename T>
+class UnscentedKalmanFilterBatchImpl: public UnscentedKalmanFilterBatch
+{
+    int DP;                                     // dimensionality of the state vector
+    int MP;                                     // dimensionality of the measurement vector
+    int CP;                                     // dimensionality of the control vector
+    int N;                                      // number of filters
+    int dataType;                               // type of elements of vectors and matrices
+
+    Mat state;                                  // estimates of the system states (x*), DP x N
+    Mat errorCov;                               // estimates of the state cross-covariance matrices (P), DP*DP x N
+
+    Mat processNoiseCov;                        // process noise cross-covariance matrix (Q), DP x DP
+    Mat measurementNoiseCov;                    // measurement noise cross-covariance matrix (R), MP x MP
+
+    Ptr<UkfSystemModel> model;                  // object of the class containing functions for computing the next state and the measurement.
+
+    double sigmaCoef;                           // sqrt( alpha*alpha*( DP + k ) )
+    std::vector<T> Wm;                          // weights for estimate mean, 2*DP+1
+    std::vector<T> Wc;                          // weights for estimate covariance, 2*DP+1
+
+// Auxillary members, the values at the sigma points of the filters being stored as ( 2*DP+1 ) blocks of N columns
+    Mat errorCovL;                              // cholesky( P ), DP*DP x N
+    Mat sigmaPoints;                            // DP x ( 2*DP+1 )*N
+    Mat controls;                               // controls repeated for each sigma point, CP x ( 2*DP+1 )*N
+
+    Mat transitionSPFuncVals;                   // f_i, DP x ( 2*DP+1 )*N
+    Mat transitionSPFuncValsCenter;             // fc_i, DP x ( 2*DP+1 )*N
+    Mat measurementSPFuncVals;                  // h_i, MP x ( 2*DP+1 )*N
+    Mat measurementSPFuncValsCenter;            // hc_i, MP x ( 2*DP+1 )*N
+
+    Mat measurementEstimate;                    // y*, MP x N
+    Mat measurement;                            // current measurement (y), MP x N
+    Mat xyCov;                                  // Sxy, DP*MP x N
+    Mat yyCov;                                  // Syy, MP*MP x N
+    Mat yyCovL;                                 // cholesky( Syy ), MP*MP x N
+    Mat gain;                                   // K, DP*MP x N
+
+public:
+
+    UnscentedKalmanFilterBatchImpl( const UnscentedKalmanFilterParams& params, int numFilters );
+
+    Mat predict( InputArray control = noArray() );
+    Mat correct( InputArray measurement );
+
+    Mat getErrorCov( int idx ) const;
+    Mat getState() const;
+    int getNumFilters() const;
+
+// steps of the algorithm for a range of the filters
+    void computeSigmaPoints( const Range& range );
+    void predictMoments( const Range& range );
+    void correctMoments( const Range& range );
+};
+
+template<typename T>
+class UkfBatchInvoker : public ParallelLoopBody
+{
+public:
+    enum { SIGMA_POINTS, PREDICT_MOMENTS, CORRECT_MOMENTS };
+
+    UkfBatchInvoker( UnscentedKalmanFilterBatchImpl<T>& _filters, int _stage ) : filters( _filters ), stage( _stage ) {}
+
+    void operator()( const Range& range ) const
+    {
+        switch ( stage )
+        {
+        case SIGMA_POINTS:
+            filters.computeSigmaPoints( range );
+            break;
+        case PREDICT_MOMENTS:
+            filters.predictMoments( range );
+            break;
+        case CORRECT_MOMENTS:
+            filters.correctMoments( range );
+            break;
+        }
+    }
+
+private:
+    UnscentedKalmanFilterBatchImpl<T>& filters;
+    int stage;
+
+    UkfBatchInvoker& operator=( const UkfBatchInvoker& );
+};
+
+template<typename T>
+UnscentedKalmanFilterBatchImpl<T>::UnscentedKalmanFilterBatchImpl( const UnscentedKalmanFilterParams& params, int numFilters )
+{
+    CV_Assert( params.DP > 0 && params.MP > 0 && numFilters > 0 );
+    CV_Assert( params.dataType == DataType<T>::depth );
+    DP = params.DP;
+    MP = params.MP;
+    CP = std::max( params.CP, 0 );
+    N = numFilters;
+    dataType = params.dataType;
+
+    model = params.model;
+    CV_Assert( !model.empty() );
+
+    CV_Assert( params.stateInit.rows == DP && ( params.stateInit.cols == 1 || params.stateInit.cols == N ) );
+    CV_Assert( params.errorCovInit.cols == DP && params.errorCovInit.rows == DP );
+    params.stateInit.convertTo( state, dataType );
+    if ( state.cols == 1 )
+        state = repeat( state, 1, N );
+    Mat errorCovInit;
+    params.errorCovInit.convertTo( errorCovInit, dataType );
+    errorCov.create( DP*DP, N, dataType );
+    for ( int i = 0; i < DP; i++ )
+        for ( int j = 0; j < DP; j++ )
+            errorCov.row( i*DP + j ).setTo( errorCovInit.at<T>( i, j ) );
+
+    CV_Assert( params.processNoiseCov.cols == DP && params.processNoiseCov.rows == DP );
+    CV_Assert( params.measurementNoiseCov.cols == MP && params.measurementNoiseCov.rows == MP );
+    params.processNoiseCov.convertTo( processNoiseCov, dataType );
+    params.measurementNoiseCov.convertTo( measurementNoiseCov, dataType );
+
+    const double lambda = params.alpha*params.alpha*( DP + params.k ) - DP;
+    const double tmpLambda = lambda + DP;
+    sigmaCoef = std::sqrt( tmpLambda );
+    Wm.assign( 2*DP+1, (T)( 0.5/tmpLambda ) );
+    Wc.assign( 2*DP+1, (T)( 0.5/tmpLambda ) );
+    Wm[0] = (T)( lambda/tmpLambda );
+    Wc[0] = (T)( lambda/tmpLambda + 1.0 - params.alpha*params.alpha + params.beta );
+
+    const int S = 2*DP+1;
+    errorCovL.create( DP*DP, N, dataType );
+    sigmaPoints.create( DP, S*N, dataType );
+    if ( CP > 0 )
+        controls.create( CP, S*N, dataType );
+    transitionSPFuncVals = Mat::zeros( DP, S*N, dataType );
+    transitionSPFuncValsCenter = Mat::zeros( DP, S*N, dataType );
+    measurementSPFuncVals = Mat::zeros( MP, S*N, dataType );
+    measurementSPFuncValsCenter = Mat::zeros( MP, S*N, dataType );
+    measurementEstimate.create( MP, N, dataType );
+    xyCov.create( DP*MP, N, dataType );
+    yyCov.create( MP*MP, N, dataType );
+    yyCovL.create( MP*MP, N, dataType );
+    gain.create( DP*MP, N, dataType );
+}
+
+template<typename T>
+void UnscentedKalmanFilterBatchImpl<T>::computeSigmaPoints( const Range& range )
+{
+// x_0 = x*
+// x_i = x* + coef * cholesky( P )_i, i = 1..DP
+// x_(i+DP) = x* - coef * cholesky( P )_i, i = 1..DP
+    choleskyDecompositions<T>( errorCov, errorCovL, DP, range );
+
+    const int len = range.end - range.start;
+    const T coef = (T)sigmaCoef;
+    for ( int d = 0; d < DP; d++ )
+    {
+        const T* x = state.ptr<T>( d ) + range.start;
+        T* points = sigmaPoints.ptr<T>( d ) + range.start;
+        for ( int f = 0; f < len; f++ )
+            points[f] = x[f];
+        for ( int j = 0; j < DP; j++ )
+        {
+            T* plus = points + ( 1 + j )*N;
+            T* minus = points + ( 1 + DP + j )*N;
+            if ( j > d )
+            {
+                for ( int f = 0; f < len; f++ )
+                    plus[f] = minus[f] = x[f];
+                continue;
+            }
+            const T* l = errorCovL.ptr<T>( d*DP + j ) + range.start;
+            for ( int f = 0; f < len; f++ )
+            {
+                plus[f] = x[f] + coef*l[f];
+                minus[f] = x[f] - coef*l[f];
+            }
+        }
+    }
+}
+
+template<typename T>
+void UnscentedKalmanFilterBatchImpl<T>::predictMoments( const Range& range )
+{
+// x* = SUM_{i=0}^{2*DP}( Wm[i]*f_i ), fc_i = f_i - x*
+    weightedMeans<T>( transitionSPFuncVals, Wm, N, state, transitionSPFuncValsCenter, range );
+
+// P = SUM_{i=0}^{2*DP}( Wc[i]*fc_i*fc_i.t ) + Q
+    weightedCovariances<T>( transitionSPFuncValsCenter, transitionSPFuncValsCenter, Wc, N, processNoiseCov, errorCov, range );
+}
+
+template<typename T>
+void UnscentedKalmanFilterBatchImpl<T>::correctMoments( const Range& range )
+{
+    const int len = range.end - range.start;
+
+// y* = SUM_{i=0}^{2*DP}( Wm[i]*h_i ), hc_i = h_i - y*
+    weightedMeans<T>( measurementSPFuncVals, Wm, N, measurementEstimate, measurementSPFuncValsCenter, range );
+
+// Syy = SUM_{i=0}^{2*DP}( Wc[i]*hc_i*hc_i.t ) + R
+    weightedCovariances<T>( measurementSPFuncValsCenter, measurementSPFuncValsCenter, Wc, N, measurementNoiseCov, yyCov, range );
+
+// Sxy = SUM_{i=0}^{2*DP}( Wc[i]*fc_i*hc_i.t )
+    weightedCovariances<T>( transitionSPFuncValsCenter, measurementSPFuncValsCenter, Wc, N, Mat(), xyCov, range );
+
+// K = Sxy * Syy^(-1), each row of K being the solution of Syy * K_d.t = Sxy_d.t with Syy = L*Lt
+    choleskyDecompositions<T>( yyCov, yyCovL, MP, range );
+    AutoBuffer<T> _z( MP*len );
+    T* z = _z;
+    for ( int d = 0; d < DP; d++ )
+    {
+        for ( int m = 0; m < MP; m++ )
+        {
+            T* zm = z + m*len;
+            const T* s = xyCov.ptr<T>( d*MP + m ) + range.start;
+            for ( int f = 0; f < len; f++ )
+                zm[f] = s[f];
+            for ( int k = 0; k < m; k++ )
+            {
+                const T* l = yyCovL.ptr<T>( m*MP + k ) + range.start;
+                const T* zk = z + k*len;
+                for ( int f = 0; f < len; f++ )
+                    zm[f] -= l[f]*zk[f];
+            }
+            const T* lmm = yyCovL.ptr<T>( m*MP + m ) + range.start;
+            for ( int f = 0; f < len; f++ )
+                zm[f] /= lmm[f];
+        }
+        for ( int m = MP - 1; m >= 0; m-- )
+        {
+            T* g = gain.ptr<T>( d*MP + m ) + range.start;
+            const T* zm = z + m*len;
+            for ( int f = 0; f < len; f++ )
+                g[f] = zm[f];
+            for ( int k = m + 1; k < MP; k++ )
+            {
+                const T* l = yyCovL.ptr<T>( k*MP + m ) + range.start;
+                const T* gk = gain.ptr<T>( d*MP + k ) + range.start;
+                for ( int f = 0; f < len; f++ )
+                    g[f] -= l[f]*gk[f];
+            }
+            const T* lmm = yyCovL.ptr<T>( m*MP + m ) + range.start;
+            for ( int f = 0; f < len; f++ )
+                g[f] /= lmm[f];
+        }
+    }
+
+// x* = x* + K*(y - y*)
+    for ( int m = 0; m < MP; m++ )
+    {
+        T* innovation = z + m*len;
+        const T* y = measurement.ptr<T>( m ) + range.start;
+        const T* yEst = measurementEstimate.ptr<T>( m ) + range.start;
+        for ( int f = 0; f < len; f++ )
+            innovation[f] = y[f] - yEst[f];
+    }
+    for ( int d = 0; d < DP; d++ )
+    {
+        T* x = state.ptr<T>( d ) + range.start;
+        for ( int m = 0; m < MP; m++ )
+        {
+            const T* g = gain.ptr<T>( d*MP + m ) + range.start;
+            const T* innovation = z + m*len;
+            for ( int f = 0; f < len; f++ )
+                x[f] += g[f]*innovation[f];
+        }
+    }
+
+// P = P - K*Sxy.t
+    for ( int a = 0; a < DP; a++ )
+        for ( int b = 0; b < DP; b++ )
+        {
+            T* p = errorCov.ptr<T>( a*DP + b ) + range.start;
+            for ( int m = 0; m < MP; m++ )
+            {
+                const T* g = gain.ptr<T>( a*MP + m ) + range.start;
+                const T* s = xyCov.ptr<T>( b*MP + m ) + range.start;
+                for ( int f = 0; f < len; f++ )
+                    p[f] -= g[f]*s[f];
+            }
+        }
+}
+
+template<typename T>
+Mat UnscentedKalmanFilterBatchImpl<T>::predict( InputArray _control )
+{
+    Mat control = _control.getMat();
+    const int S = 2*DP+1;
+    if ( !control.empty() )
+    {
+        CV_Assert( control.rows == CP && control.cols == N && control.type() == dataType );
+        for ( int i = 0; i < S; i++ )
+            control.copyTo( controls.colRange( i*N, ( i + 1 )*N ) );
+    }
+
+    parallel_for_( Range( 0, N ), UkfBatchInvoker<T>( *this, UkfBatchInvoker<T>::SIGMA_POINTS ) );
+
+// f_i = f(x_i, control, 0), i = 0..2*DP
+    model->batchStateConversionFunction( sigmaPoints, control.empty() ? control : controls, transitionSPFuncVals );
+    CV_Assert( transitionSPFuncVals.rows == DP && transitionSPFuncVals.cols == S*N && transitionSPFuncVals.type() == dataType );
+
+    parallel_for_( Range( 0, N ), UkfBatchInvoker<T>( *this, UkfBatchInvoker<T>::PREDICT_MOMENTS ) );
+
+    return state.clone();
+}
+
+template<typename T>
+Mat UnscentedKalmanFilterBatchImpl<T>::correct( InputArray _measurement )
+{
+    measurement = _measurement.getMat();
+    CV_Assert( measurement.rows == MP && measurement.cols == N && measurement.type() == dataType );
+    const int S = 2*DP+1;
+
+    parallel_for_( Range( 0, N ), UkfBatchInvoker<T>( *this, UkfBatchInvoker<T>::SIGMA_POINTS ) );
+
+// h_i = h(x_i, 0), i = 0..2*DP
+    model->batchMeasurementFunction( sigmaPoints, measurementSPFuncVals );
+    CV_Assert( measurementSPFuncVals.rows == MP && measurementSPFuncVals.cols == S*N && measurementSPFuncVals.type() == dataType );
+
+    parallel_for_( Range( 0, N ), UkfBatchInvoker<T>( *this, UkfBatchInvoker<T>::CORRECT_MOMENTS ) );
+    measurement.release();
+
+    return state.clone();
+}
+
+template<typename T>
+Mat UnscentedKalmanFilterBatchImpl<T>::getErrorCov( int idx ) const
+{
+    CV_Assert( 0 <= idx && idx < N );
+    Mat P( DP, DP, dataType );
+    for ( int i = 0; i < DP; i++ )
+        for ( int j = 0; j < DP; j++ )
+            P.at<T>( i, j ) = errorCov.at<T>( i*DP + j, idx );
+    return P;
+}
+
+template<typename T>
+Mat UnscentedKalmanFilterBatchImpl<T>::getState() const
+{
+    return state.clone();
+}
+
+template<typename T>
+int UnscentedKalmanFilterBatchImpl<T>::getNumFilters() const
+{
+    return N;
+}
+
+Ptr<UnscentedKalmanFilterBatch> createUnscentedKalmanFilterBatch( const UnscentedKalmanFilterParams &params, int numFilters )
+{
+    CV_Assert( params.dataType == CV_32F || params.dataType == CV_64F );
+    if ( params.dataType == CV_64F )
+        return makePtr<UnscentedKalmanFilterBatchImpl<double> >( params, numFilters );
+    return makePtr<UnscentedKalmanFilterBatchImpl<float> >( params, numFilters );
+}
+
+} // tracking
+} // cv
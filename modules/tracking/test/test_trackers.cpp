@@ -41,7 +41,12 @@
 
 #include "test_precomp.hpp"
 #include "opencv2/tracking.hpp"
+#include "opencv2/opencv_modules.hpp"
 #include <fstream>
+#ifdef HAVE_OPENCV_DNN
+#include "opencv2/dnn.hpp"
+#include "../src/gtrPatches.hpp"
+#endif
 
 using namespace cv;
 using namespace testing;
@@ -538,4 +543,298 @@ TEST_P(DistanceAndOverlap, DISABLED_GOTURN)
 
 INSTANTIATE_TEST_CASE_P( Tracking, DistanceAndOverlap, TESTSET_NAMES);
 
+// counts the Mat allocations while it is the default allocator
+class CountingMatAllocator : public MatAllocator
+{
+public:
+  CountingMatAllocator() : allocations(0), stdAllocator(Mat::getStdAllocator()) {}
+
+  UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags, UMatUsageFlags usageFlags) const
+  {
+    CV_XADD(&allocations, 1);
+    return stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+  }
+  bool allocate(UMatData* data, int accessflags, UMatUsageFlags usageFlags) const
+  {
+    return stdAllocator->allocate(data, accessflags, usageFlags);
+  }
+  void deallocate(UMatData* data) const
+  {
+    stdAllocator->deallocate(data);
+  }
+
+  mutable int allocations;
+  MatAllocator* stdAllocator;
+};
+
+// a textured square moving by 2 pixels per frame over a textured background
+static void movingSquareSequence(int numFrames, const Rect& square, std::vector<Mat>& frames)
+{
+  RNG rng(7);
+  Mat background(240, 320, CV_8UC3), object(square.size(), CV_8UC3);
+  rng.fill(background, RNG::UNIFORM, 0, 256);
+  rng.fill(object, RNG::UNIFORM, 0, 256);
+  GaussianBlur(background, background, Size(5, 5), 0);
+  GaussianBlur(object, object, Size(3, 3), 0);
+  for( int i = 0; i < numFrames; i++ )
+  {
+    Mat frame = background.clone();
+    object.copyTo(frame(square + Point(2 * i, i)));
+    frames.push_back(frame);
+  }
+}
+
+TEST(KCF, steadyStateUpdateDoesNotAllocate)
+{
+  // the second roi is large enough for the image to be resized
+  const Rect squares[] = { Rect(60, 60, 40, 40), Rect(60, 40, 100, 100) };
+  for( int s = 0; s < 2; s++ )
+  {
+    std::vector<Mat> frames;
+    movingSquareSequence(20, squares[s], frames);
+
+    Ptr<Tracker> tracker = TrackerKCF::create();
+    Rect2d bb = squares[s];
+    ASSERT_TRUE(tracker->init(frames[0], bb));
+    // the first updates size the buffers of the tracker
+    for( int i = 1; i < 4; i++ )
+      ASSERT_TRUE(tracker->update(frames[i], bb));
+
+    CountingMatAllocator allocator;
+    MatAllocator* defaultAllocator = Mat::getDefaultAllocator();
+    Mat::setDefaultAllocator(&allocator);
+    bool tracked = true;
+    for( size_t i = 4; i < frames.size(); i++ )
+      tracked &= tracker->update(frames[i], bb);
+    Mat::setDefaultAllocator(defaultAllocator);
+
+    EXPECT_TRUE(tracked);
+    EXPECT_EQ(0, allocator.allocations);
+    // the tracker still follows the square
+    const Rect2d expected = Rect2d(squares[s]) + Point2d(2.0 * (frames.size() - 1), (double)(frames.size() - 1));
+    EXPECT_GT((bb & expected).area(), 0.5 * expected.area());
+  }
+}
+
+TEST(MultiTracker, batchedKCFMatchesIndependentTrackers)
+{
+  // two window sizes, the last tracker wrapping its kernel is not batched
+  const Rect squares[] = { Rect(30, 30, 40, 40), Rect(120, 40, 40, 40), Rect(60, 120, 60, 50), Rect(180, 100, 40, 40) };
+  const int numTargets = 4;
+  TrackerKCF::Params wrapped;
+  wrapped.wrap_kernel = true;
+
+  std::vector<Mat> frames;
+  RNG rng(11);
+  Mat background(240, 320, CV_8UC3);
+  rng.fill(background, RNG::UNIFORM, 0, 256);
+  GaussianBlur(background, background, Size(5, 5), 0);
+  for( int i = 0; i < 12; i++ )
+  {
+    Mat frame = background.clone();
+    for( int t = 0; t < numTargets; t++ )
+    {
+      Mat object(squares[t].size(), CV_8UC3, Scalar::all(40 + 50 * t));
+      rectangle(object, Rect(5, 5, object.cols / 2, object.rows / 3), Scalar::all(255 - 40 * t), -1);
+      object.copyTo(frame(squares[t] + Point(i, i / 2)));
+    }
+    frames.push_back(frame);
+  }
+
+  Ptr<MultiTracker> multiTracker = MultiTracker::create();
+  std::vector<Ptr<Tracker> > trackers;
+  std::vector<Rect2d> boxes;
+  for( int t = 0; t < numTargets; t++ )
+  {
+    ASSERT_TRUE(multiTracker->add(t < 3 ? TrackerKCF::create() : TrackerKCF::create(wrapped), frames[0], squares[t]));
+    trackers.push_back(t < 3 ? TrackerKCF::create() : TrackerKCF::create(wrapped));
+    boxes.push_back(squares[t]);
+    ASSERT_TRUE(trackers.back()->init(frames[0], boxes.back()));
+  }
+
+  for( size_t i = 1; i < frames.size(); i++ )
+  {
+    ASSERT_TRUE(multiTracker->update(frames[i]));
+    for( int t = 0; t < numTargets; t++ )
+    {
+      ASSERT_TRUE(trackers[t]->update(frames[i], boxes[t]));
+      const Rect2d& batched = multiTracker->getObjects()[t];
+      EXPECT_LE(std::abs(batched.x - boxes[t].x), 1.0) << "frame " << i << ", target " << t;
+      EXPECT_LE(std::abs(batched.y - boxes[t].y), 1.0) << "frame " << i << ", target " << t;
+      EXPECT_EQ(batched.size(), boxes[t].size());
+    }
+  }
+}
+
+// update_opt runs the detector cascade once for all the targets, which have the same size
+TEST(MultiTrackerTLD, optimizedUpdateMatchesIndependentTrackers)
+{
+  const Rect squares[] = { Rect(30, 30, 40, 40), Rect(150, 40, 40, 40), Rect(80, 130, 40, 40) };
+  const int numTargets = 3;
+
+  std::vector<Mat> frames;
+  RNG rng(13);
+  Mat background(240, 320, CV_8UC3);
+  rng.fill(background, RNG::UNIFORM, 0, 256);
+  GaussianBlur(background, background, Size(0, 0), 4.0);
+  std::vector<Mat> objects(numTargets);
+  for( int t = 0; t < numTargets; t++ )
+  {
+    objects[t].create(squares[t].size(), CV_8UC3);
+    rng.fill(objects[t], RNG::UNIFORM, 0, 256);
+    GaussianBlur(objects[t], objects[t], Size(0, 0), 1.0);
+  }
+  for( int i = 0; i < 6; i++ )
+  {
+    Mat frame = background.clone();
+    for( int t = 0; t < numTargets; t++ )
+      objects[t].copyTo(frame(squares[t] + Point(i, i / 2)));
+    frames.push_back(frame);
+  }
+
+  MultiTrackerTLD multiTracker;
+  std::vector<Ptr<Tracker> > trackers;
+  std::vector<Rect2d> boxes;
+  for( int t = 0; t < numTargets; t++ )
+  {
+    ASSERT_TRUE(multiTracker.addTarget(frames[0], squares[t], TrackerTLD::create()));
+    trackers.push_back(TrackerTLD::create());
+    boxes.push_back(squares[t]);
+    ASSERT_TRUE(trackers.back()->init(frames[0], boxes.back()));
+  }
+
+  for( size_t i = 1; i < frames.size(); i++ )
+  {
+    const bool optFound = multiTracker.update_opt(frames[i]);
+    bool found = true;
+    for( int t = 0; t < numTargets; t++ )
+      found = trackers[t]->update(frames[i], boxes[t]) && found;
+    ASSERT_EQ(found, optFound) << "frame " << i;
+    // update_opt stops at the first target that is lost
+    if( !optFound )
+      break;
+    for( int t = 0; t < numTargets; t++ )
+    {
+      const Rect2d& opt = multiTracker.boundingBoxes[t];
+      EXPECT_NEAR(boxes[t].x, opt.x, 1e-6) << "frame " << i << ", target " << t;
+      EXPECT_NEAR(boxes[t].y, opt.y, 1e-6) << "frame " << i << ", target " << t;
+      EXPECT_NEAR(boxes[t].width, opt.width, 1e-6) << "frame " << i << ", target " << t;
+      EXPECT_NEAR(boxes[t].height, opt.height, 1e-6) << "frame " << i << ", target " << t;
+    }
+  }
+}
+
+TEST(TrackerFeatureHAAR, batchedEvaluationMatchesFeatureEval)
+{
+  // the samples are views of the same integral image, as the ones of TrackerSamplerCSC
+  RNG rng(5);
+  Mat image(120, 160, CV_8UC1), sum, sqsum, sumf;
+  rng.fill(image, RNG::UNIFORM, 0, 256);
+  integral(image, sum, sqsum, CV_32S);
+  integral(image, sumf, CV_32F);
+
+  TrackerFeatureHAAR::Params params;
+  params.numFeatures = 100;
+  params.rectSize = Size(30, 25);
+  params.isIntegral = true;
+  TrackerFeatureHAAR haar(params);
+
+  std::vector<int> selected;
+  for( int j = 0; j < params.numFeatures; j += 3 )
+    selected.push_back(j);
+
+  const Mat* integrals[] = { &sum, &sumf };
+  for( int k = 0; k < 2; k++ )
+  {
+    std::vector<Mat> samples;
+    for( int i = 0; i < 60; i++ )
+      samples.push_back((*integrals[k])(Rect(Point(rng.uniform(0, 120), rng.uniform(0, 90)), params.rectSize)));
+
+    Mat response, selectedResponse;
+    haar.compute(samples, response);
+    ASSERT_TRUE(haar.extractSelected(selected, samples, selectedResponse));
+    ASSERT_EQ(Size((int)samples.size(), params.numFeatures), response.size());
+    ASSERT_EQ(response.size(), selectedResponse.size());
+
+    for( int j = 0; j < params.numFeatures; j++ )
+    {
+      const bool isSelected = j % 3 == 0;
+      for( size_t i = 0; i < samples.size(); i++ )
+      {
+        float expected = 0;
+        haar.getFeatureAt(j).eval(samples[i], Rect(Point(), params.rectSize), &expected);
+        EXPECT_EQ(expected, response.at<float>(j, (int)i)) << "feature " << j << ", sample " << i;
+        EXPECT_EQ(isSelected ? expected : 0.f, selectedResponse.at<float>(j, (int)i)) << "feature " << j << ", sample " << i;
+      }
+    }
+  }
+}
+
+// needs goturn.prototxt and goturn.caffemodel in the working directory, as the GOTURN tests above
+TEST(MultiTracker, DISABLED_batchedGOTURNMatchesIndependentTrackers)
+{
+  const Rect squares[] = { Rect(30, 30, 40, 40), Rect(150, 40, 50, 40), Rect(60, 130, 40, 60) };
+  const int numTargets = 3;
+  std::vector<Mat> frames;
+  movingSquareSequence(6, squares[0], frames);
+
+  Ptr<MultiTracker> multiTracker = MultiTracker::create();
+  std::vector<Ptr<Tracker> > trackers;
+  std::vector<Rect2d> boxes;
+  for( int t = 0; t < numTargets; t++ )
+  {
+    ASSERT_TRUE(multiTracker->add(TrackerGOTURN::create(), frames[0], squares[t]));
+    trackers.push_back(TrackerGOTURN::create());
+    boxes.push_back(squares[t]);
+    ASSERT_TRUE(trackers.back()->init(frames[0], boxes.back()));
+  }
+
+  for( size_t i = 1; i < frames.size(); i++ )
+  {
+    ASSERT_TRUE(multiTracker->update(frames[i]));
+    for( int t = 0; t < numTargets; t++ )
+    {
+      ASSERT_TRUE(trackers[t]->update(frames[i], boxes[t]));
+      const Rect2d& batched = multiTracker->getObjects()[t];
+      EXPECT_NEAR(boxes[t].x, batched.x, 1e-3) << "frame " << i << ", target " << t;
+      EXPECT_NEAR(boxes[t].y, batched.y, 1e-3) << "frame " << i << ", target " << t;
+      EXPECT_NEAR(boxes[t].width, batched.width, 1e-3) << "frame " << i << ", target " << t;
+      EXPECT_NEAR(boxes[t].height, batched.height, 1e-3) << "frame " << i << ", target " << t;
+    }
+  }
+}
+
+#ifdef HAVE_OPENCV_DNN
+// the preprocessing of GOTURN, checked against the padding of the whole frame and blobFromImage that it replaces
+TEST(GOTURN, patchesMatchPaddedFrame)
+{
+  Mat image(120, 160, CV_8UC3);
+  RNG rng(5);
+  rng.fill(image, RNG::UNIFORM, 0, 256);
+
+  // inside, straddling the borders, larger than the frame and fully outside of it, within the padding of the patch size
+  const Rect boxes[] = { Rect(30, 20, 40, 30), Rect(-15, -10, 40, 30), Rect(140, 100, 40, 30),
+                         Rect(-20, -20, 200, 160), Rect(-40, -30, 40, 30), Rect(160, 120, 40, 30) };
+  const int sizes[] = { 2, 3, gtr::INPUT_SIZE, gtr::INPUT_SIZE };
+  Mat blob(4, sizes, CV_32F), resized;
+  for( size_t i = 0; i < sizeof(boxes) / sizeof(boxes[0]); i++ )
+  {
+    const Rect& r = boxes[i];
+    Mat padded, patch;
+    copyMakeBorder(image, padded, r.height, r.height, r.width, r.width, BORDER_REPLICATE);
+    Mat expectedPatch = padded(r + Point(r.width, r.height));
+    gtr::replicatedPatch(image, r, patch);
+    ASSERT_EQ(expectedPatch.size(), patch.size()) << "box " << i;
+    EXPECT_EQ(0, cvtest::norm(expectedPatch, patch, NORM_INF)) << "box " << i;
+
+    Mat expectedResized;
+    resize(expectedPatch, expectedResized, Size(gtr::INPUT_SIZE, gtr::INPUT_SIZE));
+    Mat expectedBlob = dnn::blobFromImage(expectedResized - 128);
+    gtr::patchToBlob(patch, resized, blob, 1);
+    Mat sample(1, 3 * gtr::INPUT_SIZE * gtr::INPUT_SIZE, CV_32F, blob.ptr<float>(1));
+    EXPECT_EQ(0, cvtest::norm(expectedBlob.reshape(1, 1), sample, NORM_INF)) << "box " << i;
+  }
+}
+#endif
+
 /* End of file. */
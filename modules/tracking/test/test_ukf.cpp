@@ -432,3 +432,90 @@ TEST(UKF, DISABLED_ungm_mean_squared_error)
 
     ASSERT_GE( mse_treshold, average_error );
 }
+
+// A target moving on a plane, accelerated by the control and observed by its range and bearing.
+class RangeBearingModel: public UkfSystemModel
+{
+    static const double step;
+
+public:
+    void stateConversionFunction(const Mat& x_k, const Mat& u_k, const Mat& v_k, Mat& x_kplus1)
+    {
+        double ax = u_k.at<double>(0, 0) + v_k.at<double>(2, 0);
+        double ay = u_k.at<double>(1, 0) + v_k.at<double>(3, 0);
+
+        x_kplus1.at<double>(0, 0) = x_k.at<double>(0, 0) + step*x_k.at<double>(2, 0) + v_k.at<double>(0, 0);
+        x_kplus1.at<double>(1, 0) = x_k.at<double>(1, 0) + step*x_k.at<double>(3, 0) + v_k.at<double>(1, 0);
+        x_kplus1.at<double>(2, 0) = x_k.at<double>(2, 0) + step*ax;
+        x_kplus1.at<double>(3, 0) = x_k.at<double>(3, 0) + step*ay;
+    }
+    void measurementFunction(const Mat& x_k, const Mat& n_k, Mat& z_k)
+    {
+        double x = x_k.at<double>(0, 0);
+        double y = x_k.at<double>(1, 0);
+
+        z_k.at<double>(0, 0) = sqrt( x*x + y*y ) + n_k.at<double>(0, 0);
+        z_k.at<double>(1, 0) = atan2( y, x ) + n_k.at<double>(1, 0);
+    }
+};
+
+const double RangeBearingModel::step = 0.1;
+
+TEST(UKF, batch_matches_independent_filters)
+{
+    const int numFilters = 16;
+    const int nIterations = 50;
+
+    int DP = 4;
+    int MP = 2;
+    int CP = 2;
+    int type = CV_64F;
+
+    RNG rng( 321 );
+
+    Ptr<RangeBearingModel> model( new RangeBearingModel() );
+    UnscentedKalmanFilterParams params( DP, MP, CP, 1e-3, 1e-2, model );
+    params.alpha = 1;
+    params.k = -1.0;
+
+    Mat states( DP, numFilters, type );
+    rng.fill( states, RNG::UNIFORM, Scalar::all(5), Scalar::all(20) );
+    params.stateInit = states.clone();
+
+    Ptr<UnscentedKalmanFilterBatch> batch = createUnscentedKalmanFilterBatch( params, numFilters );
+    std::vector<Ptr<UnscentedKalmanFilter> > filters;
+    for (int j = 0; j < numFilters; j++)
+    {
+        params.stateInit = states.col( j ).clone();
+        filters.push_back( createUnscentedKalmanFilter( params ) );
+    }
+
+    Mat controls( CP, numFilters, type ), measurements( MP, numFilters, type );
+    Mat v = Mat::zeros( DP, 1, type ), n( MP, 1, type ), x, z;
+    for (int i = 0; i < nIterations; i++)
+    {
+        rng.fill( controls, RNG::NORMAL, Scalar::all(0), Scalar::all(1) );
+        for (int j = 0; j < numFilters; j++)
+        {
+            x = states.col( j );
+            model->stateConversionFunction( x.clone(), controls.col( j ), v, x );
+            rng.fill( n, RNG::NORMAL, Scalar::all(0), Scalar::all(0.1) );
+            z = measurements.col( j );
+            model->measurementFunction( x, n, z );
+        }
+
+        batch->predict( controls );
+        Mat batchStates = batch->correct( measurements );
+        ASSERT_EQ( Size( numFilters, DP ), batchStates.size() );
+
+        for (int j = 0; j < numFilters; j++)
+        {
+            filters[j]->predict( controls.col( j ) );
+            Mat state = filters[j]->correct( measurements.col( j ) );
+            ASSERT_LE( norm( state, batchStates.col( j ), NORM_INF ), 1e-9 * norm( state, NORM_INF ) )
+                << "iteration " << i << ", filter " << j;
+            ASSERT_LE( norm( filters[j]->getErrorCov(), batch->getErrorCov( j ), NORM_INF ), 1e-9 )
+                << "iteration " << i << ", filter " << j;
+        }
+    }
+}